@@ -28,11 +28,19 @@ define DEMO_RULES
   ifneq (,$(strip $$(demos_$1_OFILES)))
     demos_$1_WASMMOD:=$(demos_MIDDIR)/$1/1.wasm
     $$(demos_$1_WASMMOD):$$(demos_$1_OFILES);$$(PRECMD) $(demos_LD) -o$$@ $$(demos_$1_OFILES) $(demos_LDPOST)
+    # AOT modules, if configured. eggrom takes the qualifier from the directory name.
+    ifneq (,$(strip $(WAMRC)))
+      demos_$1_AOTMODS:=$$(foreach T,$(demos_AOT_TARGETS),$(demos_MIDDIR)/$1/wasm/$$T/1.aot)
+      $(demos_MIDDIR)/$1/wasm/%/1.aot:$$(demos_$1_WASMMOD);$$(PRECMD) $(WAMRC) --target=$$* -o $$@ $$<
+    else
+      demos_$1_AOTMODS:=
+    endif
   else
     demos_$1_WASMMOD:=
+    demos_$1_AOTMODS:=
   endif
   demos_$1_DATAFILES:=$$(filter src/demo/$1/data/%,$$(demos_$1_SRCFILES))
-  $$(demos_$1_ROM):$$(demos_$1_WASMMOD) $$(demos_$1_DATAFILES) $(tools_eggrom_EXE);$$(PRECMD) $(tools_eggrom_EXE) -c -o$$@ $$(demos_$1_WASMMOD) src/demo/$1/data
+  $$(demos_$1_ROM):$$(demos_$1_WASMMOD) $$(demos_$1_AOTMODS) $$(demos_$1_DATAFILES) $(tools_eggrom_EXE);$$(PRECMD) $(tools_eggrom_EXE) -c -o$$@ $$(demos_$1_WASMMOD) $$(demos_$1_AOTMODS) src/demo/$1/data
 endef
 
 demos_DEMOS:=$(notdir $(wildcard src/demo/*))
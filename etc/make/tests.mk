@@ -6,7 +6,7 @@ tests_OUTDIR:=out/tests
 
 # Name here the units that should be able to build for any build host.
 # OS-specific things, declare in config.mk.
-tests_OPT_ENABLE+=bmp fs gif hostio ico midi png qoi rawimg rlead serial wav qjs wamr romr romw
+tests_OPT_ENABLE+=bmp fs gif hostio ico midi png qoi rawimg rlead serial wav qjs wamr romr romw inlog localstore synth sfg
 
 tests_CCINC:=-I$(WAMR_SDK)/core/iwasm/include -I$(QJS_SDK) -Isrc -I$(tests_MIDDIR)
 tests_CCDEF:=$(patsubst %,-DUSE_%=1,$(tests_OPT_ENABLE))
@@ -36,10 +36,14 @@ $(tests_MIDDIR)/test/unit/% \
   :$(tests_MIDDIR)/test/unit/%.o $(tests_OFILES_COMMON)|$(tests_GENHEADERS) \
   ;$(PRECMD) $(tests_UNIT_LD) -o$@ $< $(tests_OFILES_COMMON) $(tests_UNIT_LDPOST)
 
+# Integration tests for a unit live under src/test/int/UNIT/, and build only when that unit does.
+# Never put them under src/opt: Everything there gets linked into tools and runtimes.
 tests_CFILES_INT:=$(filter \
-  src/test/int/% \
   $(addprefix src/opt/,$(addsuffix /%,$(tests_OPT_ENABLE))) \
-,$(CFILES)) $(tests_CFILES_COMMON)
+  $(addprefix src/test/int/,$(addsuffix /%,$(tests_OPT_ENABLE))) \
+,$(CFILES)) \
+  $(filter $(addprefix src/test/int/,$(notdir $(filter src/test/int/%,$(CFILES)))),$(CFILES)) \
+  $(tests_CFILES_COMMON)
 
 tests_OFILES_INT:=$(patsubst src/%,$(tests_MIDDIR)/%.o,$(basename $(tests_CFILES_INT)))
 -include $(tests_OFILES_INT:.o=.d)
@@ -29,6 +29,10 @@ endif
 ifneq (,$(strip $(filter pulse,$(tools_OPT_ENABLE))))
   tools_LDPOST+=-lpulse -lpulse-simple
 endif
+ifneq (,$(strip $(filter qjs,$(tools_OPT_ENABLE))))
+  tools_CC+=-I$(QJS_SDK)
+  tools_LDPOST+=$(QJS_SDK)/libquickjs.a -ldl
+endif
 
 $(tools_MIDDIR)/%.o:src/%.c;$(PRECMD) $(tools_CC) -o$@ $<
 $(tools_MIDDIR)/%.o:src/%.cxx;$(PRECMD) $(tools_CXX) -o$@ $<
@@ -1,6 +1,6 @@
 # The truly optional things should be set by config.mk:
 #   glx x11fb xinerama drmgx drmfb alsafd asound pulse evdev
-linux_OPT_ENABLE+=hostio fs serial qjs wamr timer romr romw strfmt localstore http render softrender synth midi sfg
+linux_OPT_ENABLE+=hostio fs serial qjs wamr timer romr romw strfmt localstore http render softrender synth midi sfg trace inlog
 linux_OPT_ENABLE+=qoi rlead rawimg gif bmp ico png
 
 linux_CCWARN:=-Werror -Wimplicit
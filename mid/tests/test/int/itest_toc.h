@@ -0,0 +1,20 @@
+/* itest_toc.h
+ * Generated at Mon Oct 19 06:01:00 UTC 2026.
+ * Careful where you include this -- each include site gets its own copy of the TOC.
+ */
+ 
+#ifndef ITEST_TOC_H
+#define ITEST_TOC_H
+
+
+static const struct itest {
+  int (*fn)();
+  const char *name;
+  const char *tags;
+  const char *file;
+  int line;
+  int if_unspecified;
+} itestv[]={
+};
+
+#endif
@@ -0,0 +1,184 @@
+/* drawbench: Per-call vs batched draw submission, measured from Wasm.
+ * Runs a fixed schedule of cases, logs a table, and quits. No input.
+ *   egg out/rom/drawbench.egg
+ *   egg --bench=1000000 out/rom/drawbench.egg   # Headless and unthrottled; the ROM still ends itself.
+ * Each case draws the same sprites for FRAMES_PER_CASE frames, and we time only the submission, from Wasm's side.
+ * With the GL renderer that's mostly the cost of crossing into the host. With softrender it includes the rasterizing.
+ */
+
+#include "egg/egg.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SPRITE_LIMIT 4096
+#define WARMUP_FRAMES 20
+#define FRAMES_PER_CASE 200
+#define DECAL_LEN 18
+#define TILE_HDR_LEN 8
+#define TILE_VTX_LEN 6
+
+#define METHOD_DECAL_CALLS 0 /* egg_draw_decal per sprite. */
+#define METHOD_DECAL_BATCH 1 /* One egg_draw_batch with a DECAL per sprite. */
+#define METHOD_TILE_CALL   2 /* One egg_draw_tile for all sprites. */
+#define METHOD_TILE_BATCH  3 /* One egg_draw_batch with one TILE command for all sprites. */
+
+static const struct bench_case {
+  int method;
+  int spritec;
+} casev[]={
+  {METHOD_DECAL_CALLS,256},
+  {METHOD_DECAL_BATCH,256},
+  {METHOD_DECAL_CALLS,1024},
+  {METHOD_DECAL_BATCH,1024},
+  {METHOD_DECAL_CALLS,4096},
+  {METHOD_DECAL_BATCH,4096},
+  {METHOD_TILE_CALL,4096},
+  {METHOD_TILE_BATCH,4096},
+};
+#define CASEC (int)(sizeof(casev)/sizeof(casev[0]))
+
+static int screenw=0,screenh=0;
+static int texid_sprites=0;
+static struct sprite {
+  int16_t x,y;
+  uint8_t xform;
+} spritev[SPRITE_LIMIT];
+static uint8_t cmdv[SPRITE_LIMIT*DECAL_LEN];
+static struct egg_draw_tile vtxv[SPRITE_LIMIT];
+
+static int casep=0;
+static int framec=0; // Within current case, including warmup.
+static double timesum=0.0;
+static double resultv[CASEC]; // Average ms per frame.
+
+static const char *method_name(int method) {
+  switch (method) {
+    case METHOD_DECAL_CALLS: return "decal calls";
+    case METHOD_DECAL_BATCH: return "decal batch";
+    case METHOD_TILE_CALL: return "tile call";
+    case METHOD_TILE_BATCH: return "tile batch";
+  }
+  return "?";
+}
+
+void egg_client_quit() {
+  egg_log("drawbench: %-12s %7s %12s %12s","method","sprites","ms/frame","ns/sprite");
+  int i=0; for (;i<casep;i++) {
+    egg_log(
+      "drawbench: %-12s %7d %12.4f %12.1f",
+      method_name(casev[i].method),casev[i].spritec,resultv[i],(resultv[i]*1000000.0)/casev[i].spritec
+    );
+  }
+  if (casep<CASEC) egg_log("drawbench: Ended early, %d of %d cases complete.",casep,CASEC);
+}
+
+int egg_client_init() {
+  egg_texture_get_header(&screenw,&screenh,0,1);
+  if ((screenw<32)||(screenh<32)) return -1;
+
+  // A 16x16 sprite with a transparent border, so xforms and blending do real work.
+  uint8_t pixels[16*16*4];
+  uint8_t *p=pixels;
+  int y=0; for (;y<16;y++) {
+    int x=0; for (;x<16;x++,p+=4) {
+      p[0]=x*16;
+      p[1]=y*16;
+      p[2]=0x80;
+      p[3]=((x>0)&&(y>0)&&(x<15)&&(y<15))?0xff:0x00;
+    }
+  }
+  if ((texid_sprites=egg_texture_new())<1) return -1;
+  if (egg_texture_upload(texid_sprites,16,16,16*4,EGG_TEX_FMT_RGBA,pixels,sizeof(pixels))<0) return -1;
+
+  srand(12345);
+  struct sprite *sprite=spritev;
+  int i=SPRITE_LIMIT;
+  for (;i-->0;sprite++) {
+    sprite->x=rand()%(screenw-16);
+    sprite->y=rand()%(screenh-16);
+    sprite->xform=rand()&7;
+  }
+  return 0;
+}
+
+void egg_client_update(double elapsed) {
+  // Deliberately nothing. Sprites hold still, so every case draws exactly the same thing.
+}
+
+static void put16(uint8_t *dst,int v) {
+  dst[0]=v;
+  dst[1]=v>>8;
+}
+
+static void submit(int method,int spritec) {
+  const struct sprite *sprite=spritev;
+  int i=spritec;
+  switch (method) {
+
+    case METHOD_DECAL_CALLS: {
+        for (;i-->0;sprite++) egg_draw_decal(1,texid_sprites,sprite->x,sprite->y,0,0,16,16,sprite->xform);
+      } break;
+
+    case METHOD_DECAL_BATCH: {
+        uint8_t *dst=cmdv;
+        for (;i-->0;sprite++,dst+=DECAL_LEN) {
+          dst[0]=EGG_DRAW_OP_DECAL;
+          dst[1]=sprite->xform;
+          put16(dst+2,1);
+          put16(dst+4,texid_sprites);
+          put16(dst+6,sprite->x);
+          put16(dst+8,sprite->y);
+          put16(dst+10,0);
+          put16(dst+12,0);
+          put16(dst+14,16);
+          put16(dst+16,16);
+        }
+        egg_draw_batch(cmdv,DECAL_LEN*spritec);
+      } break;
+
+    case METHOD_TILE_CALL: {
+        struct egg_draw_tile *vtx=vtxv;
+        for (;i-->0;sprite++,vtx++) {
+          vtx->x=sprite->x+8;
+          vtx->y=sprite->y+8;
+          vtx->tileid=0;
+          vtx->xform=sprite->xform;
+        }
+        egg_draw_tile(1,texid_sprites,vtxv,spritec);
+      } break;
+
+    case METHOD_TILE_BATCH: {
+        uint8_t *dst=cmdv;
+        dst[0]=EGG_DRAW_OP_TILE;
+        dst[1]=0;
+        put16(dst+2,1);
+        put16(dst+4,texid_sprites);
+        put16(dst+6,spritec);
+        dst+=TILE_HDR_LEN;
+        for (;i-->0;sprite++,dst+=TILE_VTX_LEN) {
+          put16(dst,sprite->x+8);
+          put16(dst+2,sprite->y+8);
+          dst[4]=0;
+          dst[5]=sprite->xform;
+        }
+        egg_draw_batch(cmdv,TILE_HDR_LEN+TILE_VTX_LEN*spritec);
+      } break;
+  }
+}
+
+void egg_client_render() {
+  egg_draw_rect(1,0,0,screenw,screenh,0x000000ff);
+  if (casep>=CASEC) return;
+  const struct bench_case *bcase=casev+casep;
+  double starttime=egg_time_real();
+  submit(bcase->method,bcase->spritec);
+  double elapsed=egg_time_real()-starttime;
+  if (framec++>=WARMUP_FRAMES) timesum+=elapsed;
+  if (framec>=WARMUP_FRAMES+FRAMES_PER_CASE) {
+    resultv[casep]=(timesum*1000.0)/FRAMES_PER_CASE;
+    casep++;
+    framec=0;
+    timesum=0.0;
+    if (casep>=CASEC) egg_request_termination();
+  }
+}
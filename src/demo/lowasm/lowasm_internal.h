@@ -59,6 +59,7 @@ struct menu *lowasm_menu_new_xform_clipping();
 struct menu *lowasm_menu_new_too_many_sprites();
 struct menu *lowasm_menu_new_tint_alpha();
 struct menu *lowasm_menu_new_offscreen();
+struct menu *lowasm_menu_new_draw_batch();
 struct menu *lowasm_menu_new_resources();
 struct menu *lowasm_menu_new_strings();
 struct menu *lowasm_menu_new_persistence();
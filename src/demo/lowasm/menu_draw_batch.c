@@ -0,0 +1,142 @@
+/* menu_draw_batch.c
+ * Lots of decals, drawn either with one egg_draw_decal per sprite or one egg_draw_batch for all of them.
+ * Space or Enter to switch. Left and right to halve or double the sprite count.
+ * We report the average time spent submitting draws, for both methods, so you can compare at the same count.
+ */
+
+#include "lowasm_internal.h"
+
+#define SPRITE_LIMIT 8192
+#define TOP_SPEED 200
+#define AVG_FRAMES 60
+#define DECAL_LEN 18
+
+struct menu_draw_batch {
+  struct menu hdr;
+  struct bsprite {
+    double x,y;
+    double dx,dy;
+    uint8_t xform;
+  } *spritev;
+  int spritec,spritea;
+  uint8_t *cmdv;
+  int batch; // Nonzero to use egg_draw_batch.
+  double timesum;
+  int timec;
+  double avgcall,avgbatch; // ms per frame, zero if not measured yet at this count.
+};
+
+#define MENU ((struct menu_draw_batch*)menu)
+
+static void _db_del(struct menu *menu) {
+  if (MENU->spritev) free(MENU->spritev);
+  if (MENU->cmdv) free(MENU->cmdv);
+}
+
+static void db_reset_timing(struct menu *menu) {
+  MENU->timesum=0.0;
+  MENU->timec=0;
+}
+
+static void db_set_sprite_count(struct menu *menu,int nc) {
+  if ((nc<1)||(nc>SPRITE_LIMIT)) return;
+  MENU->avgcall=MENU->avgbatch=0.0;
+  db_reset_timing(menu);
+  if (nc<MENU->spritec) {
+    MENU->spritec=nc;
+    return;
+  }
+  if (nc>MENU->spritea) {
+    void *nv=realloc(MENU->spritev,sizeof(struct bsprite)*nc);
+    if (!nv) return;
+    MENU->spritev=nv;
+    if (!(nv=realloc(MENU->cmdv,DECAL_LEN*nc))) return;
+    MENU->cmdv=nv;
+    MENU->spritea=nc;
+  }
+  while (MENU->spritec<nc) {
+    struct bsprite *sprite=MENU->spritev+MENU->spritec++;
+    sprite->x=rand()%lowasm.screenw;
+    sprite->y=rand()%lowasm.screenh;
+    sprite->dx=(rand()%TOP_SPEED)-(TOP_SPEED>>1);
+    sprite->dy=(rand()%TOP_SPEED)-(TOP_SPEED>>1);
+    sprite->xform=rand()&7;
+  }
+}
+
+static void _db_event(struct menu *menu,const struct egg_event *event) {
+  switch (event->type) {
+    case EGG_EVENT_KEY: if (event->v[1]) switch (event->v[0]) {
+        case 0x00070028:
+        case 0x0007002c: MENU->batch=!MENU->batch; db_reset_timing(menu); break;
+        case 0x0007004f: db_set_sprite_count(menu,MENU->spritec<<1); break;
+        case 0x00070050: db_set_sprite_count(menu,MENU->spritec>>1); break;
+      } break;
+  }
+}
+
+static void _db_update(struct menu *menu,double elapsed) {
+  struct bsprite *sprite=MENU->spritev;
+  int i=MENU->spritec;
+  for (;i-->0;sprite++) {
+    sprite->x+=sprite->dx*elapsed;
+    if (((sprite->x<0.0)&&(sprite->dx<0.0))||((sprite->x>lowasm.screenw)&&(sprite->dx>0.0))) sprite->dx=-sprite->dx;
+    sprite->y+=sprite->dy*elapsed;
+    if (((sprite->y<0.0)&&(sprite->dy<0.0))||((sprite->y>lowasm.screenh)&&(sprite->dy>0.0))) sprite->dy=-sprite->dy;
+  }
+}
+
+static void db_put16(uint8_t *dst,int v) {
+  dst[0]=v;
+  dst[1]=v>>8;
+}
+
+static void _db_render(struct menu *menu) {
+  const int srcx=144,srcy=16,srcw=16,srch=16;
+  const struct bsprite *sprite=MENU->spritev;
+  int i=MENU->spritec;
+  double starttime=egg_time_real();
+  if (MENU->batch) {
+    uint8_t *dst=MENU->cmdv;
+    for (;i-->0;sprite++,dst+=DECAL_LEN) {
+      dst[0]=EGG_DRAW_OP_DECAL;
+      dst[1]=sprite->xform;
+      db_put16(dst+2,1);
+      db_put16(dst+4,lowasm.texid_misc);
+      db_put16(dst+6,(int)sprite->x-(srcw>>1));
+      db_put16(dst+8,(int)sprite->y-(srch>>1));
+      db_put16(dst+10,srcx);
+      db_put16(dst+12,srcy);
+      db_put16(dst+14,srcw);
+      db_put16(dst+16,srch);
+    }
+    egg_draw_batch(MENU->cmdv,DECAL_LEN*MENU->spritec);
+  } else {
+    for (;i-->0;sprite++) {
+      egg_draw_decal(1,lowasm.texid_misc,(int)sprite->x-(srcw>>1),(int)sprite->y-(srch>>1),srcx,srcy,srcw,srch,sprite->xform);
+    }
+  }
+  MENU->timesum+=egg_time_real()-starttime;
+  if (++(MENU->timec)>=AVG_FRAMES) {
+    double avg=(MENU->timesum*1000.0)/MENU->timec;
+    if (MENU->batch) MENU->avgbatch=avg;
+    else MENU->avgcall=avg;
+    db_reset_timing(menu);
+  }
+  lowasm_tiles_begin(lowasm.texid_font,0xffffffff,0xc0);
+  lowasm_tiles_stringf(6,lowasm.screenh-22,"%d %s",MENU->spritec,MENU->batch?"batch":"calls");
+  lowasm_tiles_stringf(6,lowasm.screenh-14,"calls: %f ms",MENU->avgcall);
+  lowasm_tiles_stringf(6,lowasm.screenh-6,"batch: %f ms",MENU->avgbatch);
+  lowasm_tiles_end();
+}
+
+struct menu *lowasm_menu_new_draw_batch() {
+  struct menu *menu=lowasm_menu_push(sizeof(struct menu_draw_batch));
+  if (!menu) return 0;
+  menu->del=_db_del;
+  menu->event=_db_event;
+  menu->update=_db_update;
+  menu->render=_db_render;
+  db_set_sprite_count(menu,256);
+  return menu;
+}
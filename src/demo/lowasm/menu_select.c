@@ -157,6 +157,7 @@ static void _select_video_activate(struct menu *menu) {
     case 1: lowasm_menu_new_too_many_sprites(); break;
     case 2: lowasm_menu_new_tint_alpha(); break;
     case 3: lowasm_menu_new_offscreen(); break;
+    case 4: lowasm_menu_new_draw_batch(); break;
   }
 }
  
@@ -172,6 +173,7 @@ struct menu *lowasm_menu_new_video() {
   _select_add_option(menu,"Too many sprites");
   _select_add_option(menu,"Global tint and alpha");
   _select_add_option(menu,"Offscreen render");
+  _select_add_option(menu,"Batched draws");
   return menu;
 }
 
@@ -35,6 +35,7 @@ const enum EventType {
   TEXT          = 12, /* [codepoint,_,_,_] */
   TOUCH         = 13, /* [id,state(0,1,2),x,y] (0,1,2)=(release,press,move) */
   ACCELEROMETER = 14, /* [x,y,z,_] m/s**2 s16.16 */
+  TEXTURE_LOADED = 15, /* [texid,status,_,_] status 0 or <0 */
 }
 
 const enum GamepadMapping {
@@ -52,6 +53,17 @@ interface Event {
 
 function event_next(): Event[];
 
+/* Same as event_next, but without allocating anything.
+ * Events are written into (dst) 5 words each: [eventType, v0, v1, v2, v3].
+ * Returns the count of events written. If it filled (dst), call again, there could be more.
+ * eg:
+ *   const events = new Int32Array(5 * 32); // once, at init
+ *   for (let c; c = egg.event_next_packed(events); ) {
+ *     for (let p=0; c-->0; p+=5) switch (events[p]) { ... }
+ *   }
+ */
+function event_next_packed(dst: Int32Array): number;
+
 /**
  * Ask for one bit of the event mask, or change one.
  * In your request:
@@ -142,6 +154,12 @@ function texture_new(): number;
  * These return <0 on errors.
  */
 function texture_load_image(texid: number, qual: number, imageid: number): number;
+
+/* Same as texture_load_image, but the decode happens in the background.
+ * Returns <0 if the request is invalid, otherwise you'll get TEXTURE_LOADED for (texid) later.
+ * The texture keeps its old content until then. Deleting the texture cancels the load, and there's no event.
+ */
+function texture_load_image_async(texid: number, qual: number, imageid: number): number;
 function texture_upload(
   texid: number,
   w: number,
@@ -211,6 +229,16 @@ function draw_tile(
   c: number
 ): void;
 
+/* Run a packed list of draw commands in one call, instead of one call per draw.
+ * (cmds) holds (len) bytes of commands, all integers little-endian. See egg_draw_batch in egg.h for the full layout.
+ *   MODE  (8): [0x01, xfermode, alpha, 0, tint(4)]
+ *   RECT  (16): [0x02, 0, texid(2), x(2), y(2), w(2), h(2), pixel(4)]
+ *   DECAL (18): [0x03, xform, dsttexid(2), srctexid(2), dstx(2), dsty(2), srcx(2), srcy(2), w(2), h(2)]
+ *   TILE  (8+6*c): [0x04, 0, dsttexid(2), srctexid(2), c(2), ...tiles as for draw_tile]
+ * Returns the count of commands run. We stop at the first unknown or truncated command.
+ */
+function draw_batch(cmds: ArrayBuffer, len: number): number;
+
 /* Audio.
  * The host provides an opinionated synthesizer.
  * Games interact with it only at a very high level.
@@ -254,6 +282,12 @@ const enum ResType { // Canonical list: src/opt/romr/romr.h
  //XXX This actually returns Uint8Array, and that is better -- otherwise we would have to copy each resource internally.
 function res_get(tid: number, qual: number, rid: number): ArrayBuffer | null;
 
+/* Like res_get, but the first call makes the copy and every call after returns the same one, until res_unmap.
+ * All callers share that buffer, so don't modify it.
+ */
+function res_map(tid: number, qual: number, rid: number): ArrayBuffer | null;
+function res_unmap(tid: number, qual: number, rid: number): void;
+
 /* Examine the resource TOC.
  * You shouldn't need this -- they're your resources.
  */
@@ -326,6 +360,11 @@ function log(fmt: string, ...args: any[]): void;
  */
 function time_real(): number;
 
+/* During egg_client_render, how far we are from the last update toward the next, 0..1.
+ * Only native --fixed-step leaves time between updates; elsewhere it's always 1.
+ */
+function render_alpha(): number;
+
 /* Current real local time, split out.
  */
 function time_get(): { year: number, month: number, day: number, hour: number, minute: number, second: number, milli: number };
@@ -55,6 +55,7 @@ void egg_client_render();
 #define EGG_EVENT_TEXT          12 /* [codepoint,_,_,_] */
 #define EGG_EVENT_TOUCH         13 /* [id,state(0,1,2),x,y] (0,1,2)=(release,press,move) */
 #define EGG_EVENT_ACCELEROMETER 14 /* [x,y,z,_] ms/s**2 s16.16 */
+#define EGG_EVENT_TEXTURE_LOADED 15 /* [texid,status,_,_] status 0 or <0 */
 
 /* Native platforms will usually only be able to use RAW here.
  * But if we become able to canonicalize gamepad layouts, eventually we may do so.
@@ -80,12 +81,20 @@ int egg_event_next(struct egg_event *eventv,int eventa);
  *   DISABLED: Turn off.
  *   ENABLED: Turn on if available, and do not take any extraordinary measures.
  *   REQUIRED: Turn on if available, or fake it if possible.
+ *   COALESCE: Turn on, and keep only the latest of rapid-fire events that haven't been read yet.
  * We respond:
  *   IMPOSSIBLE: Feature is not available. (If you asked ENABLED, REQUIRED might work).
  *   DISABLED: Feature is disabled.
  *   ENABLED: Feature is enabled.
  *   REQUIRED: Feature is enabled and can not be disabled.
+ *   COALESCE: Feature is enabled and coalescing.
  * Enabling any of (MMOTION,MBUTTON,MWHEEL) should make the cursor visible.
+ * Only MMOTION and INPUT can coalesce. For other types, COALESCE is the same as ENABLED, and we respond ENABLED.
+ *   MMOTION: A motion event replaces the previous one if it's the last thing in the queue.
+ *   INPUT: An event replaces the unread one for the same (devid,btnid), wherever it is in the queue.
+ *     So you only ever see the latest value. A press and release between two reads might vanish entirely.
+ *     Good for analogue axes, maybe not for buttons, depending on how you use them.
+ * ENABLED or REQUIRED turns coalescing back off.
  */
 int egg_event_enable(int evttype,int evtstate);
 #define EGG_EVTSTATE_QUERY      0
@@ -93,6 +102,7 @@ int egg_event_enable(int evttype,int evtstate);
 #define EGG_EVTSTATE_DISABLED   2
 #define EGG_EVTSTATE_ENABLED    3
 #define EGG_EVTSTATE_REQUIRED   4
+#define EGG_EVTSTATE_COALESCE   5
 
 /* You'll want to do these after EGG_EVENT_CONNECT to examine each new device.
  */
@@ -152,6 +162,14 @@ int egg_texture_new();
 int egg_texture_load_image(int texid,int qual,int imageid);
 int egg_texture_upload(int texid,int w,int h,int stride,int fmt,const void *src,int srcc);
 
+/* Same as egg_texture_load_image, but the decode happens in the background.
+ * Returns <0 if the request is invalid, otherwise you'll get EGG_EVENT_TEXTURE_LOADED for (texid) later.
+ * The texture is replaced at the start of some later render, just before the event goes out.
+ * Until then, the texture keeps its old content. Deleting the texture cancels the load, and there's no event.
+ * Synchronous loads to a texture with an async load pending will be overwritten when the async one lands.
+ */
+int egg_texture_load_image_async(int texid,int qual,int imageid);
+
 /* Get size and format of a texture.
  */
 void egg_texture_get_header(int *w,int *h,int *fmt,int texid);
@@ -204,6 +222,24 @@ void egg_draw_tile(
   const struct egg_draw_tile *v,int c
 );
 
+/* Run a packed list of draw commands in one call.
+ * Same effect as calling egg_draw_mode, egg_draw_rect, egg_draw_decal, and egg_draw_tile in order,
+ * but the platform boundary is crossed once, not once per command. Worth it when you have lots of decals.
+ * Each command starts with an opcode byte, and all of them have even length.
+ * Integers are little-endian. Texture IDs are 16 bits; coordinates and sizes are signed 16 bits.
+ *   MODE  (8): [op, xfermode, alpha, 0, tint(4)]
+ *   RECT  (16): [op, 0, texid(2), x(2), y(2), w(2), h(2), pixel(4)]
+ *   DECAL (18): [op, xform, dsttexid(2), srctexid(2), dstx(2), dsty(2), srcx(2), srcy(2), w(2), h(2)]
+ *   TILE  (8+6*c): [op, 0, dsttexid(2), srctexid(2), c(2), ...struct egg_draw_tile]
+ * (cmds) needn't be aligned. TILE's vertices are laid out like struct egg_draw_tile on a little-endian client, eg Wasm.
+ * Returns the count of commands run. We stop at the first unknown or truncated command.
+ */
+#define EGG_DRAW_OP_MODE  0x01
+#define EGG_DRAW_OP_RECT  0x02
+#define EGG_DRAW_OP_DECAL 0x03
+#define EGG_DRAW_OP_TILE  0x04
+int egg_draw_batch(const void *cmds,int len);
+
 /* Audio.
  * The host provides an opinionated synthesizer.
  * Games interact with it only at a very high level.
@@ -245,6 +281,18 @@ double egg_audio_get_playhead();
  */
 int egg_res_get(void *dst,int dsta,int tid,int qual,int rid);
 
+/* Get a pointer to a resource, without copying it every time.
+ * Returns the length and sets (*dstpp), or returns zero if missing or unsupported. Then use egg_res_get instead.
+ * Native clients point directly into the ROM.
+ * Wasm clients get a copy in their own heap, made at the first call, and the same one every call after.
+ * That copy is ordinary writable memory, shared by every map of the same resource. Don't modify it, and don't free it.
+ * It stays valid until egg_res_unmap, which releases the copy. Native, unmap does nothing and the pointer stays valid.
+ * The web runtime does not support this yet.
+ * Javascript has the same pair: egg.res_map returns one shared ArrayBuffer per resource until egg.res_unmap.
+ */
+int egg_res_map(const void **dstpp,int tid,int qual,int rid);
+void egg_res_unmap(int tid,int qual,int rid);
+
 /* Examine the resource TOC.
  * You shouldn't need this -- they're your resources.
  */
@@ -321,6 +369,13 @@ void egg_log(const char *fmt,...);
  */
 double egg_time_real();
 
+/* During egg_client_render, how far we are from the last update toward the next, 0..1.
+ * Only the native runtime's --fixed-step mode leaves time over between updates.
+ * There, draw each moving thing at previous+(current-previous)*alpha if you want motion smoother than the update rate.
+ * With variable timing, and in the web runtime, it's always 1: Draw the current state.
+ */
+double egg_render_alpha();
+
 /* Current real local time, split out.
  * OK to pass null for fields you don't need.
  */
@@ -0,0 +1,61 @@
+/* egg_native_bench.c
+ * Report for --bench.
+ * The run itself is egg_native_main.c: Configure forces dummy video and audio, no input, and softrender.
+ * Main skips timer_tick's sleep and reports a constant elapsed time, and stops after the requested frame count.
+ * So given the same ROM and the same build, every run should produce exactly the same frames.
+ */
+
+#include "egg_native_internal.h"
+
+/* Hash the framebuffer, FNV-1a 64 over its rows.
+ */
+ 
+static uint64_t egg_bench_hash_fb(int *w,int *h) {
+  *w=*h=0;
+  if (!egg.hostio||!egg.hostio->video) return 0;
+  const struct hostio_video_type *type=egg.hostio->video->type;
+  if (!type->fb_describe||!type->fb_begin||!type->fb_end) return 0;
+  struct hostio_video_fb_description desc={0};
+  if (type->fb_describe(&desc,egg.hostio->video)<0) return 0;
+  const uint8_t *fb=type->fb_begin(egg.hostio->video);
+  if (!fb) return 0;
+  uint64_t hash=0xcbf29ce484222325ull;
+  int rowlen=(desc.w*desc.pixelsize+7)>>3;
+  int y=0; for (;y<desc.h;y++,fb+=desc.stride) {
+    const uint8_t *p=fb;
+    int i=rowlen;
+    for (;i-->0;p++) {
+      hash^=*p;
+      hash*=0x100000001b3ull;
+    }
+  }
+  type->fb_end(egg.hostio->video);
+  *w=desc.w;
+  *h=desc.h;
+  return hash;
+}
+
+/* Report.
+ */
+ 
+void egg_native_bench_report() {
+  int framec=egg.timer.vframec;
+  if (framec<1) return;
+  double elapsed=timer_now()-egg.bench_stats.starttime;
+  double ms=1000.0/framec;
+  fprintf(stderr,
+    "Bench: %d frames in %.03f s, %.01f frames/s\n",
+    framec,elapsed,(elapsed>0.0)?(framec/elapsed):0.0
+  );
+  fprintf(stderr,
+    "Bench: per frame: input %.03f ms, update %.03f ms, render %.03f ms, finalize %.03f ms, present %.03f ms\n",
+    egg.bench_stats.inputtime*ms,
+    egg.client_stats.updatetime*ms,
+    egg.client_stats.rendertime*ms,
+    egg.bench_stats.finalizetime*ms,
+    egg.bench_stats.presenttime*ms
+  );
+  int w,h;
+  uint64_t hash=egg_bench_hash_fb(&w,&h);
+  fprintf(stderr,"Bench: final frame %dx%d hash %016llx\n",w,h,(unsigned long long)hash);
+}
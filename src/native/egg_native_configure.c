@@ -13,6 +13,10 @@ void egg_configure_cleanup() {
   if (egg.input_device) free(egg.input_device);
   if (egg.rompath) free(egg.rompath);
   if (egg.storepath) free(egg.storepath);
+  if (egg.wasm_cache) free(egg.wasm_cache);
+  if (egg.tracepath) free(egg.tracepath);
+  if (egg.recordpath) free(egg.recordpath);
+  if (egg.replaypath) free(egg.replaypath);
 }
 
 /* Set string field.
@@ -60,6 +64,17 @@ static void egg_native_configure_print_help(const char *topic,int topicc) {
     "  --no-save                Don't save game data. Will still attempt to load it initially.\n"
     "  --lang=NAME              ISO 639 eg \"en\"=English. Overrides LANG variable.\n"
     "  --no-net                 Forbid all network access.\n"
+    "  --ws-batch=BOOLEAN       Hold WebSocket sends until the end of each frame, and send them all together.\n"
+    "  --wasm-tier=TIER         auto|interp|jit|aot. auto is JIT if supported, otherwise interp. aot uses the cache, see below.\n"
+    "  --wasm-cache=DIR         AOT modules you compiled with wamrc, named by hash of the Wasm module. Default ~/.cache/egg/aot, empty for none.\n"
+    "  --js-gc=POLICY           auto|idle|off. idle (default) collects garbage only in spare time between frames.\n"
+    "  --js-memory-limit=MB     Javascript heap limit, zero for none.\n"
+    "  --trust-rom=BOOLEAN      Use precompiled JS bytecode and Wasm AOT code from the ROM. Neither can be validated; only for ROMs you built yourself.\n"
+    "  --fixed-step=N           Update at exactly the nominal rate, up to N times per render when behind. Zero (default) for variable timing.\n"
+    "  --trace=PATH             Profile frames, and write Chrome trace JSON at exit. See chrome://tracing.\n"
+    "  --bench=FRAMES           Run headless for so many frames, without sleeping, then report speed and a hash of the final frame.\n"
+    "  --record=PATH            Log input events and frame timing, to reproduce this session with --replay.\n"
+    "  --replay=PATH            Play back a log from --record instead of live input. Ends when the log does.\n"
     "\n"
   );
   {
@@ -161,6 +176,29 @@ static int egg_native_configure_kv(const char *k,int kc,const char *v,int vc) {
     return 0;
   }
   
+  if ((kc==9)&&!memcmp(k,"wasm-tier",9)) {
+    if ((vc==4)&&!memcmp(v,"auto",4)) egg.wasm_tier=WAMR_TIER_AUTO;
+    else if ((vc==6)&&!memcmp(v,"interp",6)) egg.wasm_tier=WAMR_TIER_INTERP;
+    else if ((vc==3)&&!memcmp(v,"jit",3)) egg.wasm_tier=WAMR_TIER_JIT;
+    else if ((vc==3)&&!memcmp(v,"aot",3)) egg.wasm_tier=WAMR_TIER_AOT;
+    else {
+      fprintf(stderr,"%s: Expected 'auto', 'interp', 'jit', or 'aot' for Wasm tier, found '%.*s'.\n",egg.exename,vc,v);
+      return -2;
+    }
+    return 0;
+  }
+  
+  if ((kc==5)&&!memcmp(k,"js-gc",5)) {
+    if ((vc==4)&&!memcmp(v,"auto",4)) egg.js_gc=QJS_GC_AUTO;
+    else if ((vc==4)&&!memcmp(v,"idle",4)) egg.js_gc=QJS_GC_IDLE;
+    else if ((vc==3)&&!memcmp(v,"off",3)) egg.js_gc=QJS_GC_OFF;
+    else {
+      fprintf(stderr,"%s: Expected 'auto', 'idle', or 'off' for JS GC policy, found '%.*s'.\n",egg.exename,vc,v);
+      return -2;
+    }
+    return 0;
+  }
+  
   #define STROPT(arg,fld) if ((kc==sizeof(arg)-1)&&!memcmp(k,arg,kc)) { \
     return egg_native_configure_set_string(&egg.fld,v,vc); \
   }
@@ -196,6 +234,15 @@ static int egg_native_configure_kv(const char *k,int kc,const char *v,int vc) {
   STROPT("store",storepath)
   BOOLOPT("save",save_permit)
   BOOLOPT("net",net_permit)
+  BOOLOPT("ws-batch",ws_batch)
+  STROPT("wasm-cache",wasm_cache)
+  INTOPT("js-memory-limit",js_memory_limit)
+  BOOLOPT("trust-rom",trust_rom)
+  INTOPT("fixed-step",fixed_step)
+  STROPT("trace",tracepath)
+  INTOPT("bench",bench_frames)
+  STROPT("record",recordpath)
+  STROPT("replay",replaypath)
   
   #undef STROPT
   #undef INTOPT
@@ -291,18 +338,59 @@ static int egg_native_configure_default_storepath() {
   return 0;
 }
 
+/* Default AOT cache: $XDG_CACHE_HOME/egg/aot or ~/.cache/egg/aot
+ * Set before reading argv, so "--wasm-cache=" can clear it.
+ * No $HOME is not an error, we just don't have a cache.
+ */
+ 
+static int egg_native_configure_default_wasm_cache() {
+  char tmp[1024];
+  int tmpc=0;
+  const char *src;
+  if ((src=getenv("XDG_CACHE_HOME"))&&src[0]) {
+    tmpc=snprintf(tmp,sizeof(tmp),"%s/egg/aot",src);
+  } else if ((src=getenv("HOME"))&&src[0]) {
+    tmpc=snprintf(tmp,sizeof(tmp),"%s/.cache/egg/aot",src);
+  }
+  if ((tmpc<1)||(tmpc>=sizeof(tmp))) return 0;
+  return egg_native_configure_set_string(&egg.wasm_cache,tmp,tmpc);
+}
+
 /* Done reading configuration. Validate or set defaults.
  */
  
 static int egg_native_configure_finish() {
   int err;
 
-  if (!egg.storepath) {
+  // No default store for benchmarks: Whatever the user's last session saved would change the outcome.
+  if (!egg.storepath&&!egg.bench_frames) {
     if ((err=egg_native_configure_default_storepath())<0) return err;
   }
   
+  // Benchmark mode overrides drivers and renderer: No window, no sound card, no input, and software rendering to the dummy's framebuffer.
+  if (egg.bench_frames<0) {
+    fprintf(stderr,"%s: --bench must be a positive frame count, found %d.\n",egg.exename,egg.bench_frames);
+    return -2;
+  }
+  if (egg.bench_frames) {
+    if (egg_native_configure_set_string(&egg.video_driver,"dummy",5)<0) return -1;
+    if (egg_native_configure_set_string(&egg.audio_driver,"dummy",5)<0) return -1;
+    egg.render_choice=2;
+    egg.save_permit=0;
+  }
+  
   egg.localstore.save_permit=egg.save_permit;
   
+  if ((egg.fixed_step<0)||(egg.fixed_step>60)) {
+    fprintf(stderr,"%s: --fixed-step must be in 0..60, found %d.\n",egg.exename,egg.fixed_step);
+    return -2;
+  }
+  
+  if ((egg.js_memory_limit<0)||(egg.js_memory_limit>=0x800)) {
+    fprintf(stderr,"%s: --js-memory-limit must be in 0..2047 MB, found %d.\n",egg.exename,egg.js_memory_limit);
+    return -2;
+  }
+  
   return 0;
 }
 
@@ -317,6 +405,8 @@ int egg_native_configure(int argc,char **argv) {
   // All nonzero defaults.
   egg.save_permit=1;
   egg.net_permit=1;
+  egg.js_gc=QJS_GC_IDLE;
+  if ((err=egg_native_configure_default_wasm_cache())<0) return err;
   
   //TODO environment? config files?
   
@@ -5,8 +5,9 @@
  
 struct egg_event *egg_native_push_event() {
   if (egg.eventc>=EGG_EVENT_QUEUE_LENGTH) {
-    fprintf(stderr,"*** WARNING *** Event queue overflow, dropping oldest event.\n");
-    egg.eventp++;
+    // Warn once, the exit report has the total. Printing every one only makes a bad frame worse.
+    if (!egg.event_overflowc++) fprintf(stderr,"*** WARNING *** Event queue overflow, dropping oldest event.\n");
+    if (++(egg.eventp)>=EGG_EVENT_QUEUE_LENGTH) egg.eventp=0;
     egg.eventc=EGG_EVENT_QUEUE_LENGTH-1;
   }
   int np=(egg.eventp+egg.eventc)%EGG_EVENT_QUEUE_LENGTH;
@@ -16,10 +17,50 @@ struct egg_event *egg_native_push_event() {
   return event;
 }
 
+/* Push an event that might replace a pending one, if its type is coalescing.
+ * MMOTION: Only if the newest event is also MMOTION.
+ * INPUT: Any unread event with the same (devid,btnid). There can be only one, since we always replace it.
+ * Caller fills in the whole event either way; it might not be zeroed.
+ */
+ 
+static struct egg_event *egg_native_push_event_coalesce(int type,int v0,int v1) {
+  if (egg.eventc&&(egg.coalescemask&(1<<type))) switch (type) {
+    case EGG_EVENT_MMOTION: {
+        struct egg_event *event=egg.eventq+(egg.eventp+egg.eventc-1)%EGG_EVENT_QUEUE_LENGTH;
+        if (event->type==EGG_EVENT_MMOTION) {
+          egg.event_coalescec++;
+          return event;
+        }
+      } break;
+    case EGG_EVENT_INPUT: {
+        int i=egg.eventc,p=egg.eventp+egg.eventc;
+        while (i-->0) {
+          if (--p>=EGG_EVENT_QUEUE_LENGTH) p-=EGG_EVENT_QUEUE_LENGTH;
+          struct egg_event *event=egg.eventq+p;
+          if (event->type!=EGG_EVENT_INPUT) continue;
+          if (event->v[0]!=v0) continue;
+          if (event->v[1]!=v1) continue;
+          egg.event_coalescec++;
+          return event;
+        }
+      } break;
+  }
+  return egg_native_push_event();
+}
+
+/* Report.
+ */
+ 
+void egg_native_event_report() {
+  if (!egg.event_coalescec&&!egg.event_overflowc) return;
+  fprintf(stderr,"Event queue: %d coalesced, %d dropped on overflow\n",egg.event_coalescec,egg.event_overflowc);
+}
+
 /* Public API: Pull from event queue.
+ * Recording or replaying, all events pass through here.
  */
  
-int egg_event_next(struct egg_event *eventv,int eventa) {
+static int egg_event_next_live(struct egg_event *eventv,int eventa) {
   if (eventa>egg.eventc) eventa=egg.eventc;
   if (eventa<1) return 0;
   int cpc=EGG_EVENT_QUEUE_LENGTH-egg.eventp;
@@ -41,6 +82,13 @@ int egg_event_next(struct egg_event *eventv,int eventa) {
   return eventa;
 }
 
+int egg_event_next(struct egg_event *eventv,int eventa) {
+  if (egg.replay&&egg.replaypath) return egg_native_replay_next_events(eventv,eventa);
+  int eventc=egg_event_next_live(eventv,eventa);
+  if (egg.replay&&(eventc>0)) egg_native_replay_record_events(eventv,eventc);
+  return eventc;
+}
+
 /* Update cursor visibility after a change to event mask or cursor_desired.
  */
  
@@ -104,12 +152,17 @@ int egg_event_enable(int evttype,int evtstate) {
   if ((evttype<1)||(evttype>31)) return EGG_EVTSTATE_IMPOSSIBLE;
   int hardstate=egg_event_get_hard_state(evttype);
   if (hardstate) return hardstate;
-  if (evtstate==EGG_EVTSTATE_QUERY) return (egg.eventmask&(1<<evttype))?EGG_EVTSTATE_ENABLED:EGG_EVTSTATE_DISABLED;
-  
   int mask=1<<evttype;
-  int nstate=((evtstate==EGG_EVTSTATE_ENABLED)||(evtstate==EGG_EVTSTATE_REQUIRED))?mask:0;
-  #define ACCEPT if (nstate) egg.eventmask|=mask; else egg.eventmask&=~mask;
-  #define RETURN return (egg.eventmask&mask)?EGG_EVTSTATE_ENABLED:EGG_EVTSTATE_DISABLED;
+  #define CURRENT ((egg.coalescemask&mask)?EGG_EVTSTATE_COALESCE:(egg.eventmask&mask)?EGG_EVTSTATE_ENABLED:EGG_EVTSTATE_DISABLED)
+  if (evtstate==EGG_EVTSTATE_QUERY) return CURRENT;
+  
+  int nstate=((evtstate==EGG_EVTSTATE_ENABLED)||(evtstate==EGG_EVTSTATE_REQUIRED)||(evtstate==EGG_EVTSTATE_COALESCE))?mask:0;
+  int ncoalesce=((evtstate==EGG_EVTSTATE_COALESCE)&&((evttype==EGG_EVENT_MMOTION)||(evttype==EGG_EVENT_INPUT)))?mask:0;
+  #define ACCEPT { \
+    if (nstate) egg.eventmask|=mask; else egg.eventmask&=~mask; \
+    if (ncoalesce) egg.coalescemask|=mask; else egg.coalescemask&=~mask; \
+  }
+  #define RETURN return CURRENT;
   switch (evttype) {
 
     // TODO Should we call Input Bus events IMPOSSIBLE when hostio has no input driver?
@@ -140,9 +193,12 @@ int egg_event_enable(int evttype,int evtstate) {
     case EGG_EVENT_TOUCH: ACCEPT RETURN
     case EGG_EVENT_ACCELEROMETER: ACCEPT RETURN
     
+    case EGG_EVENT_TEXTURE_LOADED: ACCEPT RETURN
+    
   }
   #undef ACCEPT
   #undef RETURN
+  #undef CURRENT
   return EGG_EVTSTATE_IMPOSSIBLE;
 }
 
@@ -173,6 +229,7 @@ int egg_native_event_init() {
     (1<<EGG_EVENT_WS_DISCONNECT)|
     (1<<EGG_EVENT_WS_MESSAGE)|
     (1<<EGG_EVENT_KEY)|
+    (1<<EGG_EVENT_TEXTURE_LOADED)|
     // MMOTION, MBUTTON, MWHEEL, TEXT, TOUCH, ACCELEROMETER: off by default
   0;
   egg.cursor_desired=1; // Make the cursor visible if events enabled.
@@ -231,7 +288,7 @@ void egg_native_cb_mmotion(struct hostio_video *driver,int x,int y) {
   egg.mousex=x;
   egg.mousey=y;
   if (egg.eventmask&(1<<EGG_EVENT_MMOTION)) {
-    struct egg_event *event=egg_native_push_event();
+    struct egg_event *event=egg_native_push_event_coalesce(EGG_EVENT_MMOTION,0,0);
     event->type=EGG_EVENT_MMOTION;
     event->v[0]=egg.mousex;
     event->v[1]=egg.mousey;
@@ -264,7 +321,15 @@ void egg_native_cb_mwheel(struct hostio_video *driver,int dx,int dy) {
  */
  
 void egg_native_cb_pcm_out(int16_t *v,int c,struct hostio_audio *driver) {
+  // Drivers own their I/O threads, so we name it at its first callback. Tracing is already up by then.
+  static __thread int named=0;
+  if (!named) {
+    trace_thread_name("audio");
+    named=1;
+  }
+  TRACE_BEGIN(audio)
   synth_updatei(v,c,egg.synth);
+  TRACE_END(audio)
 }
 
 /* Joystick.
@@ -290,7 +355,7 @@ void egg_native_cb_disconnect(struct hostio_input *driver,int devid) {
 
 void egg_native_cb_button(struct hostio_input *driver,int devid,int btnid,int value) {
   if (egg.eventmask&(1<<EGG_EVENT_INPUT)) {
-    struct egg_event *event=egg_native_push_event();
+    struct egg_event *event=egg_native_push_event_coalesce(EGG_EVENT_INPUT,devid,btnid);
     event->type=EGG_EVENT_INPUT;
     event->v[0]=devid;
     event->v[1]=btnid;
@@ -45,7 +45,7 @@ void egg_audio_play_sound(int qual,int soundid,double trim,double pan) {
 
 double egg_audio_get_playhead() {
   // Do not lock driver.
-  return synth_get_playhead(egg.synth);//TODO also ask the audio driver its buffer position
+  return synth_get_audible_playhead(egg.synth,hostio_audio_get_latency(egg.hostio));
 }
 
 /* Resource store.
@@ -55,10 +55,25 @@ int egg_res_get(void *dst,int dsta,int tid,int qual,int rid) {
   const void *src=0;
   int srcc=romr_get_qualified(&src,&egg.romr,tid,qual,rid);
   if (srcc<0) return 0;
-  if (srcc<=dsta) memcpy(dst,src,srcc);
+  if (srcc<=dsta) {
+    memcpy(dst,src,srcc);
+    egg.copy_stats.frame+=srcc;
+  }
+  return srcc;
+}
+
+int egg_res_map(const void **dstpp,int tid,int qual,int rid) {
+  const void *src=0;
+  int srcc=romr_get_qualified(&src,&egg.romr,tid,qual,rid);
+  if (srcc<1) return 0;
+  *dstpp=src;
   return srcc;
 }
 
+void egg_res_unmap(int tid,int qual,int rid) {
+  // Native clients point directly into the ROM, nothing to release.
+}
+
 void egg_res_id_by_index(int *tid,int *qual,int *rid,int index) {
   romr_id_by_index(tid,qual,rid,&egg.romr,index);
 }
@@ -80,17 +95,14 @@ int egg_store_get(char *dst,int dsta,const char *k,int kc) {
   if (srcc<=dsta) {
     memcpy(dst,src,srcc);
     if (srcc<dsta) dst[srcc]=0;
+    egg.copy_stats.frame+=srcc;
   }
   return srcc;
 }
 
 int egg_store_key_by_index(char *dst,int dsta,int index) {
   const char *k=0;
-  int kc=0;
-  if ((index>=0)&&(index<egg.localstore.entryc)) {
-    k=egg.localstore.entryv[index].k;
-    kc=egg.localstore.entryv[index].kc;
-  }
+  int kc=localstore_key_by_index(&k,&egg.localstore,index);
   if (kc<=dsta) {
     memcpy(dst,k,kc);
     if (kc<dsta) dst[kc]=0;
@@ -125,6 +137,11 @@ void egg_time_get(int *year,int *month,int *day,int *hour,int *minute,int *secon
   }
 }
 
+double egg_render_alpha() {
+  if (egg.bench_frames) return 1.0;
+  return timer_alpha(&egg.timer);
+}
+
 /* User langauges.
  */
 
@@ -315,6 +332,18 @@ static JSValue egg_js_event_next(JSContext *ctx,JSValueConst this,int argc,JSVal
   return dst;
 }
 
+/* Same thing, but into the client's Int32Array, 5 words per event: [type,v0,v1,v2,v3].
+ * struct egg_event has exactly that layout, so we dequeue straight into it and allocate nothing.
+ */
+static JSValue egg_js_event_next_packed(JSContext *ctx,JSValueConst this,int argc,JSValueConst *argv) {
+  JSASSERTARGC(1)
+  int32_t *dst=0;
+  int dstc=qjs_borrow_int32_array(&dst,ctx,&argv[0]);
+  if (dstc<0) return JS_ThrowTypeError(ctx,"event_next_packed requires an Int32Array");
+  int eventa=dstc/5;
+  return JS_NewInt32(ctx,egg_event_next((struct egg_event*)dst,eventa));
+}
+
 static int egg_wasm_event_next(wasm_exec_env_t ee,struct egg_event *eventv,int eventa) {
   return egg_event_next(eventv,eventa);
 }
@@ -516,6 +545,7 @@ int egg_image_decode(void *dst,int dsta,int stride,int qual,int imageid) {
         memcpy(dstrow,srcrow,rawimg->stride);
       }
     }
+    egg.copy_stats.frame+=dstc;
   }
   rawimg_del(rawimg);
   return dstc;
@@ -557,18 +587,21 @@ static JSValue egg_js_texture_del(JSContext *ctx,JSValueConst this,int argc,JSVa
   JSASSERTARGC(1)
   int32_t texid=0;
   JS_ToInt32(ctx,&texid,argv[0]);
+  egg_native_texload_cancel(texid);
   if (egg.render) render_texture_del(egg.render,texid);
   else if (egg.softrender) softrender_texture_del(egg.softrender,texid);
   return JS_NULL;
 }
 
 static void egg_wasm_texture_del(wasm_exec_env_t ee,int texid) {
+  egg_native_texload_cancel(texid);
   if (egg.render) render_texture_del(egg.render,texid);
   else if (egg.softrender) softrender_texture_del(egg.softrender,texid);
 }
 #endif
 
 void egg_texture_del(int texid) {
+  egg_native_texload_cancel(texid);
   if (egg.render) render_texture_del(egg.render,texid);
   else if (egg.softrender) softrender_texture_del(egg.softrender,texid);
 }
@@ -626,6 +659,32 @@ static int egg_wasm_texture_load_image(wasm_exec_env_t ee,int texid,int qual,int
 }
 #endif
 
+/* egg_texture_load_image_async
+ */
+
+int egg_texture_load_image_async(int texid,int qual,int imageid) {
+  const void *serial=0;
+  int serialc=romr_get_qualified(&serial,&egg.romr,EGG_TID_image,qual,imageid);
+  if (serialc<=0) return -1;
+  return egg_native_texload_request(texid,serial,serialc);
+}
+ 
+#if EGG_ENABLE_VM
+static JSValue egg_js_texture_load_image_async(JSContext *ctx,JSValueConst this,int argc,JSValueConst *argv) {
+  JSASSERTARGC(3)
+  int32_t texid=0,qual=0,imageid=0;
+  JS_ToInt32(ctx,&texid,argv[0]);
+  JS_ToInt32(ctx,&qual,argv[1]);
+  JS_ToInt32(ctx,&imageid,argv[2]);
+  int err=egg_texture_load_image_async(texid,qual,imageid);
+  return JS_NewInt32(ctx,err);
+}
+
+static int egg_wasm_texture_load_image_async(wasm_exec_env_t ee,int texid,int qual,int imageid) {
+  return egg_texture_load_image_async(texid,qual,imageid);
+}
+#endif
+
 /* egg_texture_upload
  */
  
@@ -853,6 +912,98 @@ void egg_draw_tile(int dsttexid,int srctexid,const struct egg_draw_tile *vtxv,in
   else if (egg.softrender) softrender_draw_tile(egg.softrender,dsttexid,srctexid,vtxv,c);
 }
 
+/* egg_draw_batch
+ */
+
+#if EGG_ENABLE_VM
+static JSValue egg_js_draw_batch(JSContext *ctx,JSValueConst this,int argc,JSValueConst *argv) {
+  JSASSERTARGC(2)
+  int32_t len=0;
+  JS_ToInt32(ctx,&len,argv[1]);
+  if (len<1) return JS_NewInt32(ctx,0);
+  size_t a=0;
+  const void *cmds=JS_GetArrayBuffer(ctx,&a,argv[0]);
+  if (!cmds||(len>a)) return JS_NewInt32(ctx,0);
+  return JS_NewInt32(ctx,egg_draw_batch(cmds,len));
+}
+
+static int egg_wasm_draw_batch(wasm_exec_env_t ee,int vaddr,int len) {
+  if (len<1) return 0;
+  const void *cmds=wamr_validate_pointer(egg.wamr,1,vaddr,len);
+  if (!cmds) return 0;
+  return egg_draw_batch(cmds,len);
+}
+#endif
+
+int egg_draw_batch(const void *cmds,int len) {
+  if (!cmds||(len<1)) return 0;
+  struct render *render=egg.render;
+  struct softrender *softrender=egg.softrender;
+  if (!render&&!softrender) return 0;
+  #define U16(p) (src[p]|(src[(p)+1]<<8))
+  #define S16(p) (int16_t)U16(p)
+  #define U32(p) (src[p]|(src[(p)+1]<<8)|(src[(p)+2]<<16)|((uint32_t)src[(p)+3]<<24))
+  const uint8_t *src=cmds;
+  int cmdc=0;
+  while (len>=2) {
+    switch (src[0]) {
+    
+      case EGG_DRAW_OP_MODE: {
+          if (len<8) return cmdc;
+          if (render) render_draw_mode(render,src[1],U32(4),src[2]);
+          else softrender_draw_mode(softrender,src[1],U32(4),src[2]);
+          src+=8; len-=8;
+        } break;
+        
+      case EGG_DRAW_OP_RECT: {
+          if (len<16) return cmdc;
+          if (render) render_draw_rect(render,U16(2),S16(4),S16(6),S16(8),S16(10),U32(12));
+          else softrender_draw_rect(softrender,U16(2),S16(4),S16(6),S16(8),S16(10),U32(12));
+          src+=16; len-=16;
+        } break;
+        
+      case EGG_DRAW_OP_DECAL: {
+          if (len<18) return cmdc;
+          if (render) render_draw_decal(render,U16(2),U16(4),S16(6),S16(8),S16(10),S16(12),S16(14),S16(16),src[1]);
+          else softrender_draw_decal(softrender,U16(2),U16(4),S16(6),S16(8),S16(10),S16(12),S16(14),S16(16),src[1]);
+          src+=18; len-=18;
+        } break;
+        
+      case EGG_DRAW_OP_TILE: {
+          if (len<8) return cmdc;
+          int c=U16(6);
+          int cmdlen=8+c*6;
+          if (len<cmdlen) return cmdc;
+          // Vertices in the stream are little-endian and only byte-aligned, so decode them into a proper array.
+          int dsttexid=U16(2),srctexid=U16(4);
+          struct egg_draw_tile vtxv[256];
+          src+=8; len-=8;
+          while (c>0) {
+            int vtxc=(c>256)?256:c;
+            struct egg_draw_tile *vtx=vtxv;
+            int i=vtxc;
+            for (;i-->0;vtx++,src+=6,len-=6) {
+              vtx->x=S16(0);
+              vtx->y=S16(2);
+              vtx->tileid=src[4];
+              vtx->xform=src[5];
+            }
+            if (render) render_draw_tile(render,dsttexid,srctexid,vtxv,vtxc);
+            else softrender_draw_tile(softrender,dsttexid,srctexid,vtxv,vtxc);
+            c-=vtxc;
+          }
+        } break;
+        
+      default: return cmdc;
+    }
+    cmdc++;
+  }
+  #undef U16
+  #undef S16
+  #undef U32
+  return cmdc;
+}
+
 /* egg_audio_play_song
  */
 
@@ -922,6 +1073,7 @@ static JSValue egg_js_res_get(JSContext *ctx,JSValueConst this,int argc,JSValueC
   const void *src=0;
   int srcc=romr_get_qualified(&src,&egg.romr,tid,qual,rid);
   if (srcc<1) return JS_NULL;
+  egg.copy_stats.frame+=srcc;
   return JS_NewArrayBufferCopy(ctx,src,srcc);
 }
  
@@ -930,6 +1082,137 @@ static int egg_wasm_res_get(wasm_exec_env_t ee,void *dst,int dsta,int tid,int qu
 }
 #endif
 
+/* egg_res_map, egg_res_unmap
+ * VMs can't see our memory, so we copy at the first request, and keep it until the client unmaps.
+ * Wasm gets a copy in the module's heap, and Javascript an ArrayBuffer. One list of mappings serves both.
+ * The copies are ordinary writable memory. We can't protect them; clients are told not to modify.
+ * (dstp) is a wasm address and not validated until after the allocation, which might move memory around.
+ */
+ 
+#if EGG_ENABLE_VM
+static struct egg_res_mapping *egg_res_mapping_find(int tid,int qual,int rid) {
+  struct egg_res_mapping *mapping=egg.res_mapv;
+  int i=egg.res_mapc;
+  for (;i-->0;mapping++) {
+    if ((mapping->tid==tid)&&(mapping->qual==qual)&&(mapping->rid==rid)) return mapping;
+  }
+  return 0;
+}
+
+static struct egg_res_mapping *egg_res_mapping_add(int tid,int qual,int rid,int c) {
+  if (egg.res_mapc>=egg.res_mapa) {
+    int na=egg.res_mapa+16;
+    if (na>INT_MAX/sizeof(struct egg_res_mapping)) return 0;
+    void *nv=realloc(egg.res_mapv,sizeof(struct egg_res_mapping)*na);
+    if (!nv) return 0;
+    egg.res_mapv=nv;
+    egg.res_mapa=na;
+  }
+  struct egg_res_mapping *mapping=egg.res_mapv+egg.res_mapc++;
+  mapping->tid=tid;
+  mapping->qual=qual;
+  mapping->rid=rid;
+  mapping->c=c;
+  mapping->waddr=0;
+  mapping->jsbuf=JS_UNDEFINED;
+  return mapping;
+}
+
+// Drop the mapping if neither VM is using it anymore.
+static void egg_res_mapping_collect(struct egg_res_mapping *mapping) {
+  if (mapping->waddr||!JS_IsUndefined(mapping->jsbuf)) return;
+  int p=mapping-egg.res_mapv;
+  egg.res_mapc--;
+  memmove(mapping,mapping+1,sizeof(struct egg_res_mapping)*(egg.res_mapc-p));
+}
+
+static int egg_wasm_res_map(wasm_exec_env_t ee,uint32_t dstp,int tid,int qual,int rid) {
+  const void *src=0;
+  int srcc=romr_get_qualified(&src,&egg.romr,tid,qual,rid);
+  if (srcc<1) return 0;
+  struct egg_res_mapping *mapping=egg_res_mapping_find(tid,qual,rid);
+  if (!mapping&&!(mapping=egg_res_mapping_add(tid,qual,rid,srcc))) return 0;
+  if (!mapping->waddr) {
+    void *dst=0;
+    if (!(mapping->waddr=wamr_module_malloc(egg.wamr,1,srcc,&dst))) {
+      egg_res_mapping_collect(mapping);
+      return 0;
+    }
+    memcpy(dst,src,srcc);
+    egg.copy_stats.frame+=srcc;
+  }
+  uint32_t waddr=mapping->waddr;
+  uint32_t *dstpp=wamr_validate_pointer(egg.wamr,1,dstp,4);
+  if (!dstpp) return 0;
+  *dstpp=waddr;
+  return srcc;
+}
+
+static void egg_wasm_res_unmap(wasm_exec_env_t ee,int tid,int qual,int rid) {
+  struct egg_res_mapping *mapping=egg_res_mapping_find(tid,qual,rid);
+  if (!mapping||!mapping->waddr) return;
+  wamr_module_free(egg.wamr,1,mapping->waddr);
+  mapping->waddr=0;
+  egg_res_mapping_collect(mapping);
+}
+
+static JSValue egg_js_res_map(JSContext *ctx,JSValueConst this,int argc,JSValueConst *argv) {
+  JSASSERTARGC(3)
+  int32_t tid=0,qual=0,rid=0;
+  JS_ToInt32(ctx,&tid,argv[0]);
+  JS_ToInt32(ctx,&qual,argv[1]);
+  JS_ToInt32(ctx,&rid,argv[2]);
+  if ((tid&~0xff)||(qual&~0xffff)||(rid&~0xffff)) return JS_NULL;
+  const void *src=0;
+  int srcc=romr_get_qualified(&src,&egg.romr,tid,qual,rid);
+  if (srcc<1) return JS_NULL;
+  struct egg_res_mapping *mapping=egg_res_mapping_find(tid,qual,rid);
+  if (!mapping&&!(mapping=egg_res_mapping_add(tid,qual,rid,srcc))) return JS_NULL;
+  if (JS_IsUndefined(mapping->jsbuf)) {
+    JSValue jsbuf=JS_NewArrayBufferCopy(ctx,src,srcc);
+    if (JS_IsException(jsbuf)) {
+      egg_res_mapping_collect(mapping);
+      return jsbuf;
+    }
+    mapping->jsbuf=jsbuf;
+    egg.copy_stats.frame+=srcc;
+  }
+  return JS_DupValue(ctx,mapping->jsbuf);
+}
+
+static JSValue egg_js_res_unmap(JSContext *ctx,JSValueConst this,int argc,JSValueConst *argv) {
+  JSASSERTARGC(3)
+  int32_t tid=0,qual=0,rid=0;
+  JS_ToInt32(ctx,&tid,argv[0]);
+  JS_ToInt32(ctx,&qual,argv[1]);
+  JS_ToInt32(ctx,&rid,argv[2]);
+  struct egg_res_mapping *mapping=egg_res_mapping_find(tid,qual,rid);
+  if (mapping&&!JS_IsUndefined(mapping->jsbuf)) {
+    JS_FreeValue(ctx,mapping->jsbuf);
+    mapping->jsbuf=JS_UNDEFINED;
+    egg_res_mapping_collect(mapping);
+  }
+  return JS_NULL;
+}
+#endif
+
+/* Drop all mappings. Must happen before the VMs are deleted.
+ * Wasm copies would go away with the module anyway, but Javascript needs its references released.
+ */
+ 
+void egg_native_res_cleanup() {
+  #if EGG_ENABLE_VM
+    struct egg_res_mapping *mapping=egg.res_mapv;
+    int i=egg.res_mapc;
+    for (;i-->0;mapping++) {
+      if (!JS_IsUndefined(mapping->jsbuf)) JS_FreeValue(qjs_get_context(egg.qjs),mapping->jsbuf);
+    }
+  #endif
+  if (egg.res_mapv) free(egg.res_mapv);
+  egg.res_mapv=0;
+  egg.res_mapc=egg.res_mapa=0;
+}
+
 /* egg_res_id_by_index
  */
 
@@ -1231,6 +1514,19 @@ static double egg_wasm_time_real(wasm_exec_env_t ee) {
 }
 #endif
 
+/* egg_render_alpha
+ */
+ 
+#if EGG_ENABLE_VM
+static JSValue egg_js_render_alpha(JSContext *ctx,JSValueConst this,int argc,JSValueConst *argv) {
+  return JS_NewFloat64(ctx,egg_render_alpha());
+}
+ 
+static double egg_wasm_render_alpha(wasm_exec_env_t ee) {
+  return egg_render_alpha();
+}
+#endif
+
 /* egg_time_get
  */
  
@@ -1309,6 +1605,7 @@ static int egg_wasm_is_terminable(wasm_exec_env_t ee) {
 static const JSCFunctionListEntry egg_native_js_exports[]={
   JS_CFUNC_DEF("log",0,egg_js_log),
   JS_CFUNC_DEF("event_next",0,egg_js_event_next),
+  JS_CFUNC_DEF("event_next_packed",1,egg_js_event_next_packed),
   JS_CFUNC_DEF("event_enable",0,egg_js_event_enable),
   JS_CFUNC_DEF("input_device_get_name",0,egg_js_input_device_get_name),
   JS_CFUNC_DEF("input_device_get_ids",0,egg_js_input_device_get_ids),
@@ -1320,6 +1617,7 @@ static const JSCFunctionListEntry egg_native_js_exports[]={
   JS_CFUNC_DEF("texture_del",0,egg_js_texture_del),
   JS_CFUNC_DEF("texture_new",0,egg_js_texture_new),
   JS_CFUNC_DEF("texture_load_image",0,egg_js_texture_load_image),
+  JS_CFUNC_DEF("texture_load_image_async",0,egg_js_texture_load_image_async),
   JS_CFUNC_DEF("texture_upload",0,egg_js_texture_upload),
   JS_CFUNC_DEF("texture_get_header",0,egg_js_texture_get_header),
   JS_CFUNC_DEF("texture_clear",0,egg_js_texture_clear),
@@ -1327,10 +1625,13 @@ static const JSCFunctionListEntry egg_native_js_exports[]={
   JS_CFUNC_DEF("draw_rect",0,egg_js_draw_rect),
   JS_CFUNC_DEF("draw_decal",0,egg_js_draw_decal),
   JS_CFUNC_DEF("draw_tile",0,egg_js_draw_tile),
+  JS_CFUNC_DEF("draw_batch",2,egg_js_draw_batch),
   JS_CFUNC_DEF("audio_play_song",0,egg_js_audio_play_song),
   JS_CFUNC_DEF("audio_play_sound",0,egg_js_audio_play_sound),
   JS_CFUNC_DEF("audio_get_playhead",0,egg_js_audio_get_playhead),
   JS_CFUNC_DEF("res_get",0,egg_js_res_get),
+  JS_CFUNC_DEF("res_map",0,egg_js_res_map),
+  JS_CFUNC_DEF("res_unmap",0,egg_js_res_unmap),
   JS_CFUNC_DEF("res_id_by_index",0,egg_js_res_id_by_index),
   JS_CFUNC_DEF("store_set",0,egg_js_store_set),
   JS_CFUNC_DEF("store_get",0,egg_js_store_get),
@@ -1344,6 +1645,7 @@ static const JSCFunctionListEntry egg_native_js_exports[]={
   JS_CFUNC_DEF("ws_get_message",0,egg_js_ws_get_message),
   JS_CFUNC_DEF("ws_send",0,egg_js_ws_send),
   JS_CFUNC_DEF("time_real",0,egg_js_time_real),
+  JS_CFUNC_DEF("render_alpha",0,egg_js_render_alpha),
   JS_CFUNC_DEF("time_get",0,egg_js_time_get),
   JS_CFUNC_DEF("get_user_languages",0,egg_js_get_user_languages),
   JS_CFUNC_DEF("request_termination",0,egg_js_request_termination),
@@ -1371,6 +1673,7 @@ static NativeSymbol egg_native_wasm_exports[]={
   {"egg_texture_del",egg_wasm_texture_del,"(i)"},
   {"egg_texture_new",egg_wasm_texture_new,"()i"},
   {"egg_texture_load_image",egg_wasm_texture_load_image,"(iii)i"},
+  {"egg_texture_load_image_async",egg_wasm_texture_load_image_async,"(iii)i"},
   {"egg_texture_upload",egg_wasm_texture_upload,"(iiiiiii)i"},
   {"egg_texture_get_header",egg_wasm_texture_get_header,"(***i)"},
   {"egg_texture_clear",egg_wasm_texture_clear,"(i)"},
@@ -1378,10 +1681,13 @@ static NativeSymbol egg_native_wasm_exports[]={
   {"egg_draw_rect",egg_wasm_draw_rect,"(iiiiii)"},
   {"egg_draw_decal",egg_wasm_draw_decal,"(iiiiiiiii)"},
   {"egg_draw_tile",egg_wasm_draw_tile,"(iiii)"},
+  {"egg_draw_batch",egg_wasm_draw_batch,"(ii)i"},
   {"egg_audio_play_song",egg_wasm_audio_play_song,"(iiii)"},
   {"egg_audio_play_sound",egg_wasm_audio_play_sound,"(iiFF)"},
   {"egg_audio_get_playhead",egg_wasm_audio_get_playhead,"()F"},
   {"egg_res_get",egg_wasm_res_get,"(*~iii)i"},
+  {"egg_res_map",egg_wasm_res_map,"(iiii)i"},
+  {"egg_res_unmap",egg_wasm_res_unmap,"(iii)"},
   {"egg_res_id_by_index",egg_wasm_res_id_by_index,"(***i)"},
   {"egg_store_set",egg_wasm_store_set,"(*~*~)i"},
   {"egg_store_get",egg_wasm_store_get,"(*~*~)i"},
@@ -1395,6 +1701,7 @@ static NativeSymbol egg_native_wasm_exports[]={
   {"egg_ws_get_message",egg_wasm_ws_get_message,"(*~ii)i"},
   {"egg_ws_send",egg_wasm_ws_send,"(ii*~)"},
   {"egg_time_real",egg_wasm_time_real,"()F"},
+  {"egg_render_alpha",egg_wasm_render_alpha,"()F"},
   {"egg_time_get",egg_wasm_time_get,"(*******)"},
   {"egg_get_user_languages",egg_wasm_get_user_languages,"(*i)i"},
   {"egg_request_termination",egg_wasm_request_termination,"()"},
@@ -19,6 +19,7 @@
 #include "opt/render/render.h"
 #include "opt/softrender/softrender.h"
 #include "opt/synth/synth.h"
+#include "opt/trace/trace.h"
 #include "quickjs.h"
 #if USE_curlwrap
   #include "opt/curlwrap/curlwrap.h"
@@ -51,7 +52,18 @@ extern struct egg {
   char *storepath;
   int lang; // Big-endian ISO 639, or zero for default.
   int net_permit;
+  int ws_batch; // Nonzero to hold egg_ws_send until the end of each frame, and send them all together.
   int save_permit;
+  int wasm_tier; // WAMR_TIER_*
+  char *wasm_cache; // Directory of AOT modules named by hash of the Wasm module, for WAMR_TIER_AOT. Empty to disable.
+  int js_gc; // QJS_GC_*
+  int js_memory_limit; // MB, zero for none.
+  int trust_rom; // Nonzero to use precompiled JS bytecode and Wasm AOT code from the ROM. They run unvalidated.
+  char *tracepath; // Chrome trace JSON, written at exit. Null to not trace.
+  int fixed_step; // Max updates per render, for fixed-step timing. Zero for variable.
+  int bench_frames; // Nonzero to run so many frames headless with fixed timing, then report and quit.
+  char *recordpath; // Input log to write, at exit.
+  char *replaypath; // Input log to play back instead of live input.
   
   // From ROM file.
   char *romtitle;
@@ -60,11 +72,35 @@ extern struct egg {
   int romfbw,romfbh;
   void *romserial;
   int romserialc;
+  void *wasm_aot; // AOT module read from (wasm_cache), must outlive (wamr).
   
   struct egg_function_location loc_client_init;
   struct egg_function_location loc_client_quit;
   struct egg_function_location loc_client_update;
   struct egg_function_location loc_client_render;
+  struct egg_client_stats {
+    double updatetime,rendertime; // Total seconds inside egg_client_update and egg_client_render.
+    int updatec,renderc;
+  } client_stats;
+  struct egg_bench_stats {
+    double starttime;
+    double inputtime; // hostio, net, and vm updates.
+    double finalizetime; // Copying the frame to the main output (render_draw_to_main or softrender_finalize_frame).
+    double presenttime; // Committing the frame to the driver (gx_end or fb_end).
+  } bench_stats;
+  struct egg_copy_stats {
+    int64_t frame; // Bytes copied into client memory during the current frame.
+    int64_t total; // Completed frames only.
+    int64_t max; // Most in one frame.
+    int framec;
+  } copy_stats;
+  struct egg_res_mapping {
+    int tid,qual,rid;
+    int c;
+    uint32_t waddr; // Copy in the Wasm module's heap, or zero.
+    JSValue jsbuf; // ArrayBuffer for Javascript, or JS_UNDEFINED.
+  } *res_mapv; // egg_res_map() from VMs: Copies made once, until the client unmaps.
+  int res_mapc,res_mapa;
   
   void *appicon_rgba;
   int appiconw,appiconh;
@@ -74,6 +110,9 @@ extern struct egg {
   struct egg_event eventq[EGG_EVENT_QUEUE_LENGTH];
   int eventp,eventc;
   uint32_t eventmask; // bitfields; 1<<EGG_EVENT_*
+  uint32_t coalescemask; // Subset of (eventmask) that's EGG_EVTSTATE_COALESCE.
+  int event_coalescec; // Events that replaced a pending one instead of queueing.
+  int event_overflowc; // Events dropped because the queue was full.
   int mousex,mousey;
   int cursor_desired; // egg_show_cursor()
   struct egg_input_device {
@@ -95,6 +134,8 @@ extern struct egg {
   struct render *render;
   struct softrender *softrender;
   struct synth *synth;
+  struct egg_texload *texload;
+  struct egg_replay *replay;
   #if USE_curlwrap
     struct curlwrap *curlwrap;
   #endif
@@ -107,14 +148,37 @@ void egg_configure_cleanup();
 void egg_appicon_init();
 
 void egg_native_rom_cleanup();
+void egg_native_res_cleanup(); // Before deleting VMs.
 int egg_native_rom_init();
 int egg_native_uses_rom_file(); // constant but private
+void egg_native_client_report(); // Time spent in client code, for the exit report.
 
 void egg_native_net_cleanup();
 int egg_native_net_init();
 int egg_native_net_update();
+void egg_native_net_flush();
 
 void egg_native_input_cleanup();
+
+// --bench: Headless run with fixed timing. Report includes a hash of the final frame, for catching output changes.
+void egg_native_bench_report();
+
+// --record and --replay. Inert if neither was requested.
+// egg_native_replay_frame takes the live elapsed time, and returns the one to actually use.
+void egg_native_replay_cleanup();
+int egg_native_replay_init();
+void egg_native_replay_finish(); // Write the log if recording, and report.
+double egg_native_replay_frame(double elapsed);
+void egg_native_replay_record_events(const struct egg_event *eventv,int eventc);
+int egg_native_replay_next_events(struct egg_event *eventv,int eventa);
+
+// Background image decoding for egg_texture_load_image_async.
+// Update uploads finished images and must be called in the render context.
+void egg_native_texload_cleanup();
+int egg_native_texload_request(int texid,const void *serial,int serialc);
+void egg_native_texload_cancel(int texid);
+void egg_native_texload_update();
+void egg_native_texload_report();
 void egg_native_input_add_device(struct hostio_input *driver,int devid);
 void egg_native_input_remove_device(int devid);
 
@@ -125,9 +189,11 @@ void egg_native_call_client_quit();
 int egg_native_call_client_update(double elapsed);
 int egg_native_call_client_render();
 int egg_native_vm_update();
+void egg_native_vm_idle(double budget); // Spare time before the next frame, eg for GC.
 
 // Never fails. May overwrite the oldest event.
 struct egg_event *egg_native_push_event();
+void egg_native_event_report();
 
 int egg_native_event_init();
 
@@ -15,24 +15,51 @@ static void egg_native_rcvsig(int sigid) {
   }
 }
 
+/* Write the trace file, if we were asked to.
+ * All other threads must be stopped first.
+ */
+ 
+static void egg_native_write_trace() {
+  if (!egg.tracepath) return;
+  struct sr_encoder encoder={0};
+  if (trace_encode(&encoder)<0) {
+    fprintf(stderr,"%s: Failed to encode trace.\n",egg.tracepath);
+  } else if (file_write(egg.tracepath,encoder.v,encoder.c)<0) {
+    fprintf(stderr,"%s: Failed to write trace, %d bytes.\n",egg.tracepath,encoder.c);
+  } else {
+    fprintf(stderr,"%s: Wrote trace, %d bytes.\n",egg.tracepath,encoder.c);
+  }
+  sr_encoder_cleanup(&encoder);
+  trace_cleanup();
+}
+
 /* Quit.
  */
  
 static void egg_native_quit(int status) {
   egg_native_call_client_quit();
+  egg_native_replay_finish();
   if (egg.localstore.dirty&&egg.storepath) {
-    localstore_save(&egg.localstore,egg.storepath);
+    localstore_flush(&egg.localstore); // Writer thread finishes it at localstore_cleanup.
   }
   if (!status) {
+    if (egg.bench_frames) egg_native_bench_report();
     timer_report(&egg.timer);
+    egg_native_client_report();
+    egg_native_texload_report();
+    egg_native_event_report();
     fprintf(stderr,"%s: Normal exit.\n",egg.exename);
   } else {
     fprintf(stderr,"%s: Abnormal exit.\n",egg.exename);
   }
+  egg_native_texload_cleanup();
+  egg_native_replay_cleanup();
   render_del(egg.render);
   softrender_del(egg.softrender);
   hostio_del(egg.hostio);
+  egg_native_write_trace();
   synth_del(egg.synth);
+  egg_native_res_cleanup();
   wamr_del(egg.wamr);
   qjs_del(egg.qjs);
   egg_native_net_cleanup();
@@ -48,8 +75,16 @@ static void egg_native_quit(int status) {
 static int egg_native_init() {
   int err;
   
+  if (egg.tracepath) {
+    if (trace_init()<0) {
+      fprintf(stderr,"%s: Built without profiler, ignoring '--trace'.\n",egg.exename);
+      free(egg.tracepath);
+      egg.tracepath=0;
+    }
+  }
+  
   if (egg.storepath) {
-    if (localstore_load(&egg.localstore,egg.storepath)<0) {
+    if (localstore_open(&egg.localstore,egg.storepath)<0) {
       fprintf(stderr,"%s: Failed to load game's data store.\n",egg.storepath);
     } else {
       fprintf(stderr,"%s: Loaded game's data store.\n",egg.storepath);
@@ -61,6 +96,7 @@ static int egg_native_init() {
   }
   
   if ((err=egg_native_event_init())<0) return err;
+  if ((err=egg_native_replay_init())<0) return err;
 
   if ((err=egg_native_rom_init())<0) {
     if (err!=-2) fprintf(stderr,"%s: Unspecified error loading ROM.\n",egg.exename);
@@ -184,7 +220,7 @@ static int egg_native_init() {
   struct hostio_input_setup input_setup={
     .path=egg.input_device,
   };
-  if (hostio_init_input(egg.hostio,egg.input_driver,&input_setup)<0) {
+  if (hostio_init_input(egg.hostio,egg.bench_frames?"":egg.input_driver,&input_setup)<0) {
     fprintf(stderr,"%s: Failed to initialize input.\n",egg.exename);
     return -2;
   }
@@ -216,6 +252,8 @@ static int egg_native_init() {
   hostio_audio_play(egg.hostio,1);
   
   timer_init(&egg.timer,60,0.25);
+  if (egg.fixed_step) timer_set_fixed(&egg.timer,egg.fixed_step);
+  egg.bench_stats.starttime=timer_now();
   
   return 0;
 }
@@ -230,16 +268,34 @@ static int egg_native_render_gx() {
     return -2;
   }
   
+  TRACE_BEGIN(texload)
+  egg_native_texload_update();
+  TRACE_END(texload)
   render_draw_mode(egg.render,EGG_XFERMODE_ALPHA,0,0xff);
   
-  if ((err=egg_native_call_client_render())<0) {
+  TRACE_BEGIN(render)
+  double starttime=timer_now();
+  err=egg_native_call_client_render();
+  egg.client_stats.rendertime+=timer_now()-starttime;
+  egg.client_stats.renderc++;
+  TRACE_END(render)
+  if (err<0) {
     if (err!=-2) fprintf(stderr,"%s: Error rendering game.\n",egg.exename);
     return -2;
   }
   
+  TRACE_BEGIN(finalize)
+  starttime=timer_now();
   render_draw_to_main(egg.render,egg.hostio->video->w,egg.hostio->video->h,1);
+  egg.bench_stats.finalizetime+=timer_now()-starttime;
+  TRACE_END(finalize)
 
-  if (egg.hostio->video->type->gx_end(egg.hostio->video)<0) {
+  TRACE_BEGIN(present)
+  starttime=timer_now();
+  err=egg.hostio->video->type->gx_end(egg.hostio->video);
+  egg.bench_stats.presenttime+=timer_now()-starttime;
+  TRACE_END(present)
+  if (err<0) {
     fprintf(stderr,"%s: Error exiting GX context.\n",egg.exename);
     return -2;
   }
@@ -255,16 +311,34 @@ static int egg_native_render_fb() {
   }
   
   softrender_set_main(egg.softrender,fb);
+  TRACE_BEGIN(texload)
+  egg_native_texload_update();
+  TRACE_END(texload)
   softrender_draw_mode(egg.softrender,EGG_XFERMODE_ALPHA,0,0xff);
   
-  if ((err=egg_native_call_client_render())<0) {
+  TRACE_BEGIN(render)
+  double starttime=timer_now();
+  err=egg_native_call_client_render();
+  egg.client_stats.rendertime+=timer_now()-starttime;
+  egg.client_stats.renderc++;
+  TRACE_END(render)
+  if (err<0) {
     if (err!=-2) fprintf(stderr,"%s: Error rendering game.\n",egg.exename);
     return -2;
   }
   
+  TRACE_BEGIN(finalize)
+  starttime=timer_now();
   softrender_finalize_frame(egg.softrender);
+  egg.bench_stats.finalizetime+=timer_now()-starttime;
+  TRACE_END(finalize)
   
-  if (egg.hostio->video->type->fb_end(egg.hostio->video)<0) {
+  TRACE_BEGIN(present)
+  starttime=timer_now();
+  err=egg.hostio->video->type->fb_end(egg.hostio->video);
+  egg.bench_stats.presenttime+=timer_now()-starttime;
+  TRACE_END(present)
+  if (err<0) {
     fprintf(stderr,"%s: Failed to commit direct-render frame.\n",egg.exename);
     return -2;
   }
@@ -276,30 +350,69 @@ static int egg_native_render_fb() {
  
 static int egg_native_update() {
   int err;
-  if (hostio_update(egg.hostio)<0) {
+  double inputstart=timer_now();
+  TRACE_BEGIN(hostio)
+  err=hostio_update(egg.hostio);
+  TRACE_END(hostio)
+  if (err<0) {
     fprintf(stderr,"%s: Unspecified error updating drivers.\n",egg.exename);
     return -2;
   }
-  if ((err=egg_native_net_update())<0) {
+  TRACE_BEGIN(net)
+  err=egg_native_net_update();
+  TRACE_END(net)
+  if (err<0) {
     if (err!=-2) fprintf(stderr,"%s: Error updating network.\n",egg.exename);
     return -2;
   }
-  if ((err=egg_native_vm_update())<0) {
+  TRACE_BEGIN(vm)
+  err=egg_native_vm_update();
+  TRACE_END(vm)
+  if (err<0) {
     if (err!=-2) fprintf(stderr,"%s: Error updating Javascript or Wasm runtime.\n",egg.exename);
     return -2;
   }
   
-  double elapsed=timer_tick(&egg.timer);
-  if ((err=egg_native_call_client_update(elapsed))<0) {
-    if (err!=-2) fprintf(stderr,"%s: Error updating game.\n",egg.exename);
-    return -2;
+  egg.bench_stats.inputtime+=timer_now()-inputstart;
+  
+  // Benchmarks don't sleep, and report exactly the nominal interval every frame.
+  // Fixed-step timing may run several updates per render, if we're behind.
+  TRACE_BEGIN(idle)
+  double elapsed;
+  int updatec=1;
+  if (egg.bench_frames) {
+    egg_native_vm_idle(0.0);
+    egg.timer.vframec++;
+    elapsed=egg.timer.interval;
+  } else if (egg.fixed_step) {
+    egg_native_vm_idle(timer_remaining(&egg.timer));
+    updatec=timer_tick_fixed(&egg.timer);
+    elapsed=egg.timer.interval;
+  } else {
+    egg_native_vm_idle(timer_remaining(&egg.timer));
+    elapsed=timer_tick(&egg.timer);
+  }
+  TRACE_END(idle)
+  while (updatec-->0) {
+    double step=egg_native_replay_frame(elapsed);
+    if (egg.terminate) return 0; // Replay finished.
+    TRACE_BEGIN(update)
+    double starttime=timer_now();
+    err=egg_native_call_client_update(step);
+    egg.client_stats.updatetime+=timer_now()-starttime;
+    egg.client_stats.updatec++;
+    TRACE_END(update)
+    if (err<0) {
+      if (err!=-2) fprintf(stderr,"%s: Error updating game.\n",egg.exename);
+      return -2;
+    }
   }
+  egg_native_net_flush();
   
+  // Hand off this frame's changes to the store's writer thread. Doesn't wait for the disk.
   if (egg.localstore.dirty&&egg.storepath&&egg.localstore.save_permit) {
-    if (localstore_save(&egg.localstore,egg.storepath)<0) {
-      fprintf(stderr,"%s: Failed to save game data.\n",egg.storepath);
-    } else {
-      fprintf(stderr,"%s: Saved.\n",egg.storepath);
+    if (localstore_flush(&egg.localstore)<0) {
+      fprintf(stderr,"%s: Failed to save game data. Will try again.\n",egg.storepath);
     }
   }
   
@@ -313,6 +426,12 @@ static int egg_native_update() {
     );
     return -2;
   }
+  
+  // Close out the tally of bytes copied into client memory.
+  egg.copy_stats.total+=egg.copy_stats.frame;
+  if (egg.copy_stats.frame>egg.copy_stats.max) egg.copy_stats.max=egg.copy_stats.frame;
+  egg.copy_stats.framec++;
+  egg.copy_stats.frame=0;
 
   return 0;
 }
@@ -338,11 +457,15 @@ int main(int argc,char **argv) {
   
   fprintf(stderr,"%s: Running.\n",egg.exename);
   while (!egg.sigc&&!egg.terminate) {
-    if ((err=egg_native_update())<0) {
+    TRACE_BEGIN(frame)
+    err=egg_native_update();
+    TRACE_END(frame)
+    if (err<0) {
       if (err!=-2) fprintf(stderr,"%s: Unspecified error updating.\n",egg.exename);
       egg_native_quit(1);
       return 1;
     }
+    if (egg.bench_frames&&(egg.timer.vframec>=egg.bench_frames)) break;
   }
   
   egg_native_quit(0);
@@ -62,6 +62,7 @@ int egg_native_net_init() {
       .cb_ws_message=egg_net_cb_ws_message,
     };
     if (!(egg.curlwrap=curlwrap_new(&delegate))) return -1;
+    if (egg.ws_batch) curlwrap_set_ws_batch(egg.curlwrap,1);
   #endif
   return 0;
 }
@@ -78,6 +79,16 @@ int egg_native_net_update() {
   return 0;
 }
 
+/* End of frame.
+ * With --ws-batch, everything the game sent this frame goes out now.
+ */
+ 
+void egg_native_net_flush() {
+  #if USE_curlwrap
+    if (egg.curlwrap&&egg.ws_batch) curlwrap_ws_flush(egg.curlwrap);
+  #endif
+}
+
 /* Public API: HTTP requests.
  */
  
@@ -127,6 +138,7 @@ int egg_http_get_body(void *dst,int dsta,int reqid) {
         if (vc<=dsta) {
           memcpy(dst,v,vc);
           if (vc<dsta) ((char*)dst)[vc]=0;
+          egg.copy_stats.frame+=vc;
         }
         return vc;
       }
@@ -165,6 +177,7 @@ int egg_ws_get_message(void *dst,int dsta,int wsid,int msgid) {
         if (vc<=dsta) {
           memcpy(dst,v,vc);
           if (vc<dsta) ((char*)dst)[vc]=0;
+          egg.copy_stats.frame+=vc;
         }
         return vc;
       }
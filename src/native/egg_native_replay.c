@@ -0,0 +1,122 @@
+/* egg_native_replay.c
+ * Input recording and playback, for --record and --replay.
+ *
+ * We record at the point of delivery, in egg_event_next, not in egg_native_push_event:
+ * Pushers fill in the event after we hand it out, and the client never sees events it doesn't ask for anyway.
+ * Along with the events, we record the (elapsed) passed to each egg_client_update.
+ * Replaying, the client gets exactly the same events in the same frames, and the same clock.
+ * Live events are dropped at the start of each frame.
+ *
+ * Things we don't capture: Polled input state (egg_input_device_get_button), network response bodies, the real clock.
+ * A game that depends on those won't replay exactly.
+ *
+ * File format is in opt/inlog/inlog.h.
+ */
+
+#include "egg_native_internal.h"
+#include "opt/inlog/inlog.h"
+
+struct egg_replay {
+  int recording;
+  struct inlog_writer writer; // Recording.
+  void *src; // Replaying.
+  int srcc;
+  struct inlog_reader reader; // Replaying.
+};
+
+/* Cleanup.
+ */
+
+void egg_native_replay_cleanup() {
+  struct egg_replay *replay=egg.replay;
+  if (!replay) return;
+  inlog_writer_cleanup(&replay->writer);
+  if (replay->src) free(replay->src);
+  free(replay);
+  egg.replay=0;
+}
+
+/* Init.
+ */
+
+int egg_native_replay_init() {
+  if (!egg.recordpath&&!egg.replaypath) return 0;
+  if (egg.recordpath&&egg.replaypath) {
+    fprintf(stderr,"%s: --record and --replay are mutually exclusive.\n",egg.exename);
+    return -2;
+  }
+  if (!(egg.replay=calloc(1,sizeof(struct egg_replay)))) return -1;
+  struct egg_replay *replay=egg.replay;
+  if (egg.recordpath) {
+    replay->recording=1;
+    if (inlog_writer_init(&replay->writer)<0) return -1;
+  } else {
+    if ((replay->srcc=file_read(&replay->src,egg.replaypath))<0) {
+      fprintf(stderr,"%s: Failed to read input log.\n",egg.replaypath);
+      return -2;
+    }
+    if (inlog_reader_init(&replay->reader,replay->src,replay->srcc)<0) {
+      fprintf(stderr,"%s: Not an input log, or truncated.\n",egg.replaypath);
+      return -2;
+    }
+  }
+  return 0;
+}
+
+/* Finish and report.
+ */
+
+void egg_native_replay_finish() {
+  struct egg_replay *replay=egg.replay;
+  if (!replay) return;
+  if (replay->recording) {
+    if (
+      (inlog_writer_finish(&replay->writer)<0)||
+      (file_write(egg.recordpath,replay->writer.dst.v,replay->writer.dst.c)<0)
+    ) {
+      fprintf(stderr,"%s: Failed to write input log, %d bytes.\n",egg.recordpath,replay->writer.dst.c);
+    } else {
+      fprintf(stderr,
+        "%s: Recorded %d frames and %d events, %d bytes.\n",
+        egg.recordpath,replay->writer.framec,replay->writer.eventc,replay->writer.dst.c
+      );
+    }
+  } else {
+    fprintf(stderr,"%s: Replayed %d frames and %d events.\n",egg.replaypath,replay->reader.framec,replay->reader.eventtotal);
+  }
+}
+
+/* Start of frame, just before egg_client_update.
+ */
+
+double egg_native_replay_frame(double elapsed) {
+  struct egg_replay *replay=egg.replay;
+  if (!replay) return elapsed;
+
+  if (replay->recording) {
+    inlog_write_frame(&replay->writer,elapsed);
+    return elapsed;
+  }
+
+  // Replaying. Drop live events, and skip any of the last frame's events that the client didn't ask for.
+  egg.eventp=egg.eventc=0;
+  double logged=elapsed;
+  if (inlog_read_frame(&logged,&replay->reader)>0) return logged;
+
+  // End of log, end of session.
+  egg.terminate=1;
+  return elapsed;
+}
+
+/* egg_event_next hooks.
+ */
+
+void egg_native_replay_record_events(const struct egg_event *eventv,int eventc) {
+  struct egg_replay *replay=egg.replay;
+  if (!replay||!replay->recording) return;
+  inlog_write_events(&replay->writer,eventv,eventc);
+}
+
+int egg_native_replay_next_events(struct egg_event *eventv,int eventa) {
+  return inlog_read_events(eventv,eventa,&egg.replay->reader);
+}
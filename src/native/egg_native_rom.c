@@ -34,6 +34,7 @@ void egg_native_rom_cleanup() {
   if (egg.romserial) free(egg.romserial);
   if (egg.romtitle) free(egg.romtitle);
   if (egg.romicon) free(egg.romicon);
+  if (egg.wasm_aot) free(egg.wasm_aot);
 }
 
 /* With egg.romr populated, read metadata:1 and record whatever we need.
@@ -190,6 +191,119 @@ int egg_native_rom_init() {
   return 0;
 }
 
+/* Load the Wasm module, and AOT code only if the user asked for it.
+ * AOT modules are native code and run outside the Wasm sandbox, so we never pick one on our own.
+ * From the ROM, a wasm resource qualified by our architecture: Only with --trust-rom.
+ * From the cache, a file named by hash of the Wasm module, which the user populates with wamrc: Only with --wasm-tier=aot.
+ * Cached modules sit next to a copy of the Wasm they were compiled from, and we use them only if that matches exactly.
+ * Anything wrong with those, we quietly use the Wasm module.
+ */
+ 
+#if EGG_ROM_SOURCE!=NATIVE
+
+#if defined(__x86_64__)
+  #define EGG_WASM_HOST_ARCH "x86_64"
+  #define EGG_WASM_QUAL_HOST EGG_WASM_QUAL_x86_64
+#elif defined(__aarch64__)
+  #define EGG_WASM_HOST_ARCH "aarch64"
+  #define EGG_WASM_QUAL_HOST EGG_WASM_QUAL_aarch64
+#elif defined(__arm__)&&defined(__thumb__)
+  #define EGG_WASM_HOST_ARCH "thumbv7"
+  #define EGG_WASM_QUAL_HOST EGG_WASM_QUAL_thumbv7
+#elif defined(__arm__)
+  #define EGG_WASM_HOST_ARCH "armv7"
+  #define EGG_WASM_QUAL_HOST EGG_WASM_QUAL_armv7
+#elif defined(__i386__)
+  #define EGG_WASM_HOST_ARCH "i386"
+  #define EGG_WASM_QUAL_HOST EGG_WASM_QUAL_i386
+#elif defined(__riscv)&&(__riscv_xlen==64)
+  #define EGG_WASM_HOST_ARCH "riscv64"
+  #define EGG_WASM_QUAL_HOST EGG_WASM_QUAL_riscv64
+#else
+  #define EGG_WASM_HOST_ARCH ""
+  #define EGG_WASM_QUAL_HOST 0
+#endif
+
+static int egg_native_wasm_cache_path(char *dst,int dsta,const void *src,int srcc,const char *sfx) {
+  if (!egg.wasm_cache||!egg.wasm_cache[0]||!EGG_WASM_QUAL_HOST) return -1;
+  uint64_t hash=0xcbf29ce484222325ull; // FNV-1a. Only to find the file; the Wasm copy beside it is the real check.
+  const uint8_t *SRC=src;
+  for (;srcc-->0;SRC++) hash=(hash^*SRC)*0x100000001b3ull;
+  int dstc=snprintf(dst,dsta,"%s/%016llx-%s.%s",egg.wasm_cache,(unsigned long long)hash,EGG_WASM_HOST_ARCH,sfx);
+  if ((dstc<1)||(dstc>=dsta)) return -1;
+  return dstc;
+}
+
+/* Nonzero if the cache has a copy of exactly this Wasm module, ie the AOT module beside it was compiled from it.
+ * If not, write the copy and tell the user how to compile it.
+ */
+ 
+static int egg_native_wasm_cache_verify(const void *serial,int serialc,const char *refname) {
+  char wasmpath[1024],aotpath[1024];
+  if (egg_native_wasm_cache_path(wasmpath,sizeof(wasmpath),serial,serialc,"wasm")<0) return 0;
+  if (egg_native_wasm_cache_path(aotpath,sizeof(aotpath),serial,serialc,"aot")<0) return 0;
+  void *prev=0;
+  int prevc=file_read(&prev,wasmpath);
+  int match=((prevc==serialc)&&!memcmp(prev,serial,serialc));
+  if (prev) free(prev);
+  if (match&&(file_get_type(aotpath)=='f')) return 1;
+  if (!match) {
+    if ((dir_mkdirp(egg.wasm_cache)<0)||(file_write(wasmpath,serial,serialc)<0)) {
+      fprintf(stderr,"%s: Failed to write Wasm module for AOT compilation.\n",wasmpath);
+      return 0;
+    }
+  }
+  fprintf(stderr,
+    "%s: No AOT module for this ROM. To make one: wamrc --target=%s -o %s %s\n",
+    refname,EGG_WASM_HOST_ARCH,aotpath,wasmpath
+  );
+  return 0;
+}
+
+/* Try to load an AOT module, ROM first, then cache.
+ */
+ 
+static int egg_native_load_wasm_aot(void *serial,int serialc,const char *refname,int tier) {
+  void *aot=0;
+  int aotc;
+  if (EGG_WASM_QUAL_HOST&&((aotc=romr_get_qualified(&aot,&egg.romr,EGG_TID_wasm,EGG_WASM_QUAL_HOST,1))>0)) {
+    if (!egg.trust_rom) {
+      fprintf(stderr,"%s: Ignoring AOT module from ROM. Launch with --trust-rom to use it.\n",refname);
+    } else if (wamr_add_module(egg.wamr,1,aot,aotc,refname)>=0) {
+      return 0;
+    } else {
+      fprintf(stderr,"%s: Failed to load AOT module from ROM.\n",refname);
+    }
+  }
+  if (tier!=WAMR_TIER_AOT) return -1;
+  char path[1024];
+  if (!egg_native_wasm_cache_verify(serial,serialc,refname)) return -1;
+  if (egg_native_wasm_cache_path(path,sizeof(path),serial,serialc,"aot")<0) return -1;
+  if ((aotc=file_read(&aot,path))<=0) return -1;
+  if (wamr_add_module(egg.wamr,1,aot,aotc,path)<0) {
+    free(aot);
+    fprintf(stderr,"%s: Failed to load cached AOT module.\n",path);
+    return -1;
+  }
+  egg.wasm_aot=aot;
+  return 0;
+}
+ 
+static int egg_native_load_wasm(void *serial,int serialc,const char *refname) {
+  int tier=wamr_set_tier(egg.wamr,egg.wasm_tier);
+  if (tier!=egg.wasm_tier) {
+    fprintf(stderr,"%s: Wasm tier '%s' not available, using '%s'.\n",refname,wamr_tier_repr(egg.wasm_tier),wamr_tier_repr(tier));
+  }
+  if ((tier==WAMR_TIER_AOT)||((tier==WAMR_TIER_AUTO)&&egg.trust_rom)) {
+    wamr_set_tier(egg.wamr,WAMR_TIER_AOT);
+    if (egg_native_load_wasm_aot(serial,serialc,refname,tier)>=0) return 0;
+    wamr_set_tier(egg.wamr,tier);
+  }
+  return wamr_add_module(egg.wamr,1,serial,serialc,refname);
+}
+
+#endif
+
 /* Initialize client hooks.
  */
  
@@ -214,13 +328,16 @@ int egg_native_init_client_code() {
     const char *refname=egg.rompath?egg.rompath:egg.exename;
     void *serial;
     int serialc;
-    if ((serialc=romr_get(&serial,&egg.romr,EGG_TID_wasm,1))>0) {
-      if (wamr_add_module(egg.wamr,1,serial,serialc,refname)<0) {
+    if ((serialc=romr_get_qualified(&serial,&egg.romr,EGG_TID_wasm,0,1))>0) {
+      if (egg_native_load_wasm(serial,serialc,refname)<0) {
         fprintf(stderr,"%s: Error loading wasm:1\n",refname);
         return -2;
       }
     }
     if ((serialc=romr_get(&serial,&egg.romr,EGG_TID_js,1))>0) {
+      qjs_set_gc_policy(egg.qjs,egg.js_gc);
+      qjs_set_memory_limit(egg.qjs,(size_t)egg.js_memory_limit<<20);
+      qjs_set_allow_bytecode(egg.qjs,egg.trust_rom);
       if (qjs_add_module(egg.qjs,1,serial,serialc,refname)<0) {
         fprintf(stderr,"%s: Error loading js:1\n",refname);
         return -2;
@@ -249,6 +366,7 @@ void egg_native_call_client_quit() { egg_client_quit(); }
 int egg_native_call_client_update(double elapsed) { egg_client_update(elapsed); return 0; }
 int egg_native_call_client_render() { egg_client_render(); return 0; }
 int egg_native_vm_update() { return 0; }
+void egg_native_vm_idle(double budget) {}
 
 #else
  
@@ -299,4 +417,47 @@ int egg_native_vm_update() {
   return qjs_update(egg.qjs);
 }
 
+void egg_native_vm_idle(double budget) {
+  if ((egg.loc_client_update.tid==EGG_TID_js)||(egg.loc_client_render.tid==EGG_TID_js)) qjs_gc_idle(egg.qjs,budget);
+}
+
 #endif
+
+/* Report time spent in client code.
+ */
+ 
+void egg_native_client_report() {
+  const struct egg_client_stats *stats=&egg.client_stats;
+  if ((stats->updatec<1)&&(stats->renderc<1)) return;
+  const char *tier="native";
+  #if EGG_ROM_SOURCE!=NATIVE
+    switch (egg.loc_client_update.tid?egg.loc_client_update.tid:egg.loc_client_render.tid) {
+      case EGG_TID_wasm: tier=wamr_tier_repr(wamr_get_tier(egg.wamr,egg.loc_client_update.modid)); break;
+      case EGG_TID_js: tier="js"; break;
+    }
+  #endif
+  fprintf(stderr,
+    "Client (%s): update average %.03f ms, render average %.03f ms\n",
+    tier,
+    (stats->updatec>0)?((stats->updatetime*1000.0)/stats->updatec):0.0,
+    (stats->renderc>0)?((stats->rendertime*1000.0)/stats->renderc):0.0
+  );
+  if (egg.copy_stats.total>0) {
+    const struct egg_copy_stats *cstats=&egg.copy_stats;
+    fprintf(stderr,
+      "Copied to client: %lld bytes, average %.0f per frame, max %lld\n",
+      (long long)cstats->total,(cstats->framec>0)?((double)cstats->total/cstats->framec):0.0,(long long)cstats->max
+    );
+  }
+  #if EGG_ROM_SOURCE!=NATIVE
+    if ((egg.loc_client_update.tid==EGG_TID_js)||(egg.loc_client_render.tid==EGG_TID_js)) {
+      struct qjs_stats qstats;
+      qjs_get_stats(&qstats,egg.qjs);
+      fprintf(stderr,
+        "JS heap: %lld bytes used of %lld allocated, %lld objects. %d idle GCs, average %.03f ms, max %.03f ms\n",
+        (long long)qstats.used_size,(long long)qstats.heap_size,(long long)qstats.objc,
+        qstats.gcc,(qstats.gcc>0)?((qstats.gctime*1000.0)/qstats.gcc):0.0,qstats.gcmax*1000.0
+      );
+    }
+  #endif
+}
@@ -0,0 +1,253 @@
+/* egg_native_texload.c
+ * Background image decoding, for egg_texture_load_image_async().
+ * One worker thread, started at the first request.
+ * Main thread queues jobs with the encoded image, which we borrow from the ROM (it doesn't change after init).
+ * Worker decodes to a staging rawimg in an Egg texture format, then moves the job to the finished list.
+ * At the start of each render, main thread uploads finished jobs and fires EGG_EVENT_TEXTURE_LOADED.
+ */
+
+#include "egg_native_internal.h"
+#include "opt/rawimg/rawimg.h"
+#include <pthread.h>
+
+struct egg_texload_job {
+  struct egg_texload_job *next;
+  int texid;
+  const void *serial; // WEAK, points into the ROM.
+  int serialc;
+  int cancelled;
+  struct rawimg *rawimg; // Null if decode failed.
+  int fmt;
+  double reqtime; // Real time at request.
+  double dectime; // Duration of decode.
+};
+
+struct egg_texload {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int quit;
+
+  // Both lists are FIFO. Everything below is guarded by (mutex).
+  struct egg_texload_job *pending,*pendingtail;
+  struct egg_texload_job *busy; // Worker's current job, so we can cancel it.
+  struct egg_texload_job *done,*donetail;
+  int depth; // pending+busy+done
+
+  // Stats, for the exit report. Main thread only.
+  int jobc;
+  int depthmax;
+  double dectotal;
+  double latencytotal;
+};
+
+/* Job.
+ */
+
+static void egg_texload_job_del(struct egg_texload_job *job) {
+  if (!job) return;
+  rawimg_del(job->rawimg);
+  free(job);
+}
+
+static void egg_texload_job_list_del(struct egg_texload_job *job) {
+  while (job) {
+    struct egg_texload_job *next=job->next;
+    egg_texload_job_del(job);
+    job=next;
+  }
+}
+
+/* Decode one job. Worker thread, unlocked.
+ * Output format is whatever softrender would store it as, even when we upload to render.
+ */
+
+static void egg_texload_decode(struct egg_texload_job *job) {
+  struct rawimg *rawimg=rawimg_decode(job->serial,job->serialc);
+  if (!rawimg) return;
+  int fmt=softrender_force_valid_format(rawimg);
+  if (fmt<=0) {
+    rawimg_del(rawimg);
+    return;
+  }
+  // Uploads want minimum stride.
+  if (rawimg->stride!=rawimg_minimum_stride(rawimg->w,rawimg->pixelsize)) {
+    struct rawimg *copy=rawimg_new_copy(rawimg);
+    rawimg_del(rawimg);
+    if (!(rawimg=copy)) return;
+  }
+  job->rawimg=rawimg;
+  job->fmt=fmt;
+}
+
+/* Worker thread.
+ */
+
+static void *egg_texload_thread(void *arg) {
+  struct egg_texload *texload=arg;
+  pthread_mutex_lock(&texload->mutex);
+  for (;;) {
+    while (!texload->quit&&!texload->pending) pthread_cond_wait(&texload->cond,&texload->mutex);
+    if (texload->quit) break;
+    struct egg_texload_job *job=texload->pending;
+    if (!(texload->pending=job->next)) texload->pendingtail=0;
+    job->next=0;
+    texload->busy=job;
+    int cancelled=job->cancelled;
+    pthread_mutex_unlock(&texload->mutex);
+
+    // Cancelled while pending? Skip the decode, but it still goes through (done) so main can count it off.
+    if (!cancelled) {
+      double starttime=timer_now();
+      egg_texload_decode(job);
+      job->dectime=timer_now()-starttime;
+    }
+
+    pthread_mutex_lock(&texload->mutex);
+    texload->busy=0;
+    if (texload->donetail) texload->donetail->next=job;
+    else texload->done=job;
+    texload->donetail=job;
+  }
+  pthread_mutex_unlock(&texload->mutex);
+  return 0;
+}
+
+/* Cleanup.
+ */
+
+void egg_native_texload_cleanup() {
+  struct egg_texload *texload=egg.texload;
+  if (!texload) return;
+  pthread_mutex_lock(&texload->mutex);
+  texload->quit=1;
+  pthread_cond_broadcast(&texload->cond);
+  pthread_mutex_unlock(&texload->mutex);
+  pthread_join(texload->thread,0);
+  pthread_cond_destroy(&texload->cond);
+  pthread_mutex_destroy(&texload->mutex);
+  egg_texload_job_list_del(texload->pending);
+  egg_texload_job_list_del(texload->done);
+  free(texload);
+  egg.texload=0;
+}
+
+/* Start up, the first time we get a request.
+ */
+
+static int egg_texload_init() {
+  struct egg_texload *texload=calloc(1,sizeof(struct egg_texload));
+  if (!texload) return -1;
+  if (pthread_mutex_init(&texload->mutex,0)) {
+    free(texload);
+    return -1;
+  }
+  if (pthread_cond_init(&texload->cond,0)) {
+    pthread_mutex_destroy(&texload->mutex);
+    free(texload);
+    return -1;
+  }
+  if (pthread_create(&texload->thread,0,egg_texload_thread,texload)) {
+    pthread_cond_destroy(&texload->cond);
+    pthread_mutex_destroy(&texload->mutex);
+    free(texload);
+    return -1;
+  }
+  egg.texload=texload;
+  return 0;
+}
+
+/* Request.
+ */
+
+int egg_native_texload_request(int texid,const void *serial,int serialc) {
+  if ((texid<2)||!serial||(serialc<1)) return -1;
+  if (!egg.texload&&(egg_texload_init()<0)) return -1;
+  struct egg_texload *texload=egg.texload;
+  struct egg_texload_job *job=calloc(1,sizeof(struct egg_texload_job));
+  if (!job) return -1;
+  job->texid=texid;
+  job->serial=serial;
+  job->serialc=serialc;
+  job->reqtime=timer_now();
+  pthread_mutex_lock(&texload->mutex);
+  if (texload->pendingtail) texload->pendingtail->next=job;
+  else texload->pending=job;
+  texload->pendingtail=job;
+  if (++(texload->depth)>texload->depthmax) texload->depthmax=texload->depth;
+  pthread_cond_signal(&texload->cond);
+  pthread_mutex_unlock(&texload->mutex);
+  return 0;
+}
+
+/* Cancel.
+ */
+
+void egg_native_texload_cancel(int texid) {
+  struct egg_texload *texload=egg.texload;
+  if (!texload) return;
+  pthread_mutex_lock(&texload->mutex);
+  struct egg_texload_job *job;
+  for (job=texload->pending;job;job=job->next) if (job->texid==texid) job->cancelled=1;
+  for (job=texload->done;job;job=job->next) if (job->texid==texid) job->cancelled=1;
+  if (texload->busy&&(texload->busy->texid==texid)) texload->busy->cancelled=1;
+  pthread_mutex_unlock(&texload->mutex);
+}
+
+/* Update.
+ * Caller must be in the render context.
+ */
+
+void egg_native_texload_update() {
+  struct egg_texload *texload=egg.texload;
+  if (!texload) return;
+  pthread_mutex_lock(&texload->mutex);
+  struct egg_texload_job *job=texload->done;
+  texload->done=texload->donetail=0;
+  pthread_mutex_unlock(&texload->mutex);
+  if (!job) return;
+  double now=timer_now();
+  int jobc=0;
+  while (job) {
+    struct egg_texload_job *next=job->next;
+    jobc++;
+    if (!job->cancelled) {
+      int status=-1;
+      if (job->rawimg) {
+        status=egg_texture_upload(
+          job->texid,job->rawimg->w,job->rawimg->h,job->rawimg->stride,job->fmt,
+          job->rawimg->v,job->rawimg->stride*job->rawimg->h
+        );
+        if (status>0) status=0;
+      }
+      texload->jobc++;
+      texload->dectotal+=job->dectime;
+      texload->latencytotal+=now-job->reqtime;
+      if (egg.eventmask&(1<<EGG_EVENT_TEXTURE_LOADED)) {
+        struct egg_event *event=egg_native_push_event();
+        event->type=EGG_EVENT_TEXTURE_LOADED;
+        event->v[0]=job->texid;
+        event->v[1]=status;
+      }
+    }
+    egg_texload_job_del(job);
+    job=next;
+  }
+  pthread_mutex_lock(&texload->mutex);
+  texload->depth-=jobc;
+  pthread_mutex_unlock(&texload->mutex);
+}
+
+/* Report.
+ */
+
+void egg_native_texload_report() {
+  struct egg_texload *texload=egg.texload;
+  if (!texload||(texload->jobc<1)) return;
+  fprintf(stderr,
+    "%d async texture loads, max queue depth %d, average decode %.03f ms, average latency %.03f ms\n",
+    texload->jobc,texload->depthmax,
+    (texload->dectotal*1000.0)/texload->jobc,
+    (texload->latencytotal*1000.0)/texload->jobc
+  );
+}
@@ -99,6 +99,11 @@ int alsafd_get_chanc(const struct alsafd *alsafd);
 const char *alsafd_get_device(const struct alsafd *alsafd);
 int alsafd_get_running(const struct alsafd *alsafd);
 
+/* Frames generated by pcm_out that haven't been played yet, from any thread, without locking.
+ * That's what's waiting in our buffer, plus the device's SNDRV_PCM_IOCTL_DELAY.
+ */
+int alsafd_get_latency(struct alsafd *alsafd);
+
 /* A new context is stopped until you explicitly set_running(1).
  */
 void alsafd_set_running(struct alsafd *alsafd,int run);
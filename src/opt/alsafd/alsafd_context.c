@@ -12,6 +12,9 @@ static void *alsafd_iothd(void *arg) {
       usleep(1000);
       continue;
     }
+    // Count the buffer as unwritten before generating it. pcm_out advances the synth's stamped frame count,
+    // and a playhead reader that sees the new count with the old unwrittenc would come out a buffer early.
+    __atomic_store_n(&alsafd->unwrittenc,alsafd->bufa/alsafd->chanc,__ATOMIC_RELAXED);
     if (alsafd->running) {
       alsafd->delegate.pcm_out(alsafd->buf,alsafd->bufa,alsafd->delegate.userdata);
     } else {
@@ -22,6 +25,7 @@ static void *alsafd_iothd(void *arg) {
     const uint8_t *src=(uint8_t*)alsafd->buf;
     int srcc=alsafd->bufa<<1; // bytes (from samples)
     int srcp=0;
+    int framesize=alsafd->chanc<<1;
     while (srcp<srcc) {
       pthread_testcancel();
       int pvcancel;
@@ -47,6 +51,7 @@ static void *alsafd_iothd(void *arg) {
         }
       } else {
         srcp+=err;
+        __atomic_store_n(&alsafd->unwrittenc,(srcc-srcp)/framesize,__ATOMIC_RELAXED);
       }
     }
   }
@@ -319,6 +324,15 @@ int alsafd_get_running(const struct alsafd *alsafd) {
   return alsafd->running;
 }
 
+int alsafd_get_latency(struct alsafd *alsafd) {
+  if (!alsafd||(alsafd->fd<0)) return -1;
+  snd_pcm_sframes_t delay=0;
+  if (ioctl(alsafd->fd,SNDRV_PCM_IOCTL_DELAY,&delay)<0) delay=0; // eg underrun: Nothing queued.
+  if (delay<0) delay=0;
+  if (delay>INT_MAX>>1) delay=INT_MAX>>1;
+  return (int)delay+__atomic_load_n(&alsafd->unwrittenc,__ATOMIC_RELAXED);
+}
+
 void alsafd_set_running(struct alsafd *alsafd,int run) {
   if (!alsafd) return;
   alsafd->running=run?1:0;
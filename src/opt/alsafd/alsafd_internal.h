@@ -39,6 +39,7 @@ struct alsafd {
   int ioerror;
   int16_t *buf;
   int bufa; // samples
+  int unwrittenc; // frames; Generated but not yet written to the device. Atomic.
 };
 
 // Log if enabled, and always returns -1. Null (fmt) to use errno.
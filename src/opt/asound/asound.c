@@ -1,5 +1,11 @@
 #include "asound_internal.h"
 
+static int64_t asound_now_us() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (int64_t)ts.tv_sec*1000000+ts.tv_nsec/1000;
+}
+
 /* I/O thread.
  */
  
@@ -12,6 +18,8 @@ static void *asound_iothd(void *arg) {
       usleep(1000);
       continue;
     }
+    // Unwritten from before pcm_out, which advances the synth's frame count. Otherwise latency under-reports by a buffer.
+    __atomic_store_n(&asound->unwrittenc,asound->bufa_frames,__ATOMIC_RELAXED);
     if (asound->playing&&asound->delegate.cb_pcm_out) {
       asound->delegate.cb_pcm_out(asound->buf,asound->bufa,asound->delegate.userdata);
     } else {
@@ -32,7 +40,13 @@ static void *asound_iothd(void *arg) {
         break;
       }
       framep+=err;
+      __atomic_store_n(&asound->unwrittenc,framec-framep,__ATOMIC_RELAXED);
     }
+    snd_pcm_sframes_t delay=0;
+    if (snd_pcm_delay(asound->alsa,&delay)<0) delay=0;
+    if (delay<0) delay=0;
+    __atomic_store_n(&asound->drain_us,asound_now_us()+((int64_t)delay*1000000)/asound->rate,__ATOMIC_RELAXED);
+    __atomic_store_n(&asound->unwrittenc,0,__ATOMIC_RELAXED);
   }
 }
 
@@ -135,6 +149,14 @@ int asound_get_playing(const struct asound *asound) {
   return asound->playing;
 }
 
+int asound_get_latency(struct asound *asound) {
+  if (!asound) return -1;
+  int64_t remaining=__atomic_load_n(&asound->drain_us,__ATOMIC_RELAXED)-asound_now_us();
+  int framec=__atomic_load_n(&asound->unwrittenc,__ATOMIC_RELAXED);
+  if (remaining>0) framec+=(int)((remaining*asound->rate)/1000000);
+  return framec;
+}
+
 void asound_play(struct asound *asound,int play) {
   if (!asound) return;
   if (play) {
@@ -37,6 +37,11 @@ int asound_get_rate(const struct asound *asound);
 int asound_get_chanc(const struct asound *asound);
 int asound_get_playing(const struct asound *asound);
 
+/* Frames generated by pcm_out that haven't been played yet, from any thread, without locking.
+ * We check snd_pcm_delay after each write, and estimate from there.
+ */
+int asound_get_latency(struct asound *asound);
+
 void asound_play(struct asound *asound,int play);
 int asound_lock(struct asound *asound);
 void asound_unlock(struct asound *asound);
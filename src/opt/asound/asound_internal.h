@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <pthread.h>
+#include <time.h>
 #include <alsa/asoundlib.h>
 
 struct asound {
@@ -19,6 +20,8 @@ struct asound {
   pthread_t iothd;
   pthread_mutex_t iomtx;
   int ioabort;
+  int unwrittenc; // frames; Generated but not yet accepted by ALSA. Atomic.
+  int64_t drain_us; // CLOCK_MONOTONIC microseconds when ALSA will have played all we've written. Atomic.
 };
 
 #endif
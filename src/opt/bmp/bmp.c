@@ -181,11 +181,11 @@ static void bmp_copy_flip(uint8_t *dst,const uint8_t *src,int stride,int h) {
   for (;h-->0;dst+=stride,src-=stride) memcpy(dst,src,stride);
 }
 
-/* Decode.
+/* Decode everything but the pixels, into a fresh image.
+ * On success, (*srcp) is the start of pixels, which are known to be in bounds.
  */
 
-struct bmp_image *bmp_decode(const void *src,int srcc) {
-  const uint8_t *SRC=src;
+static int bmp_decode_prelude(struct bmp_image *image,int *srcpp,int *flipp,const uint8_t *SRC,int srcc) {
   int srcp=0;
   int pixelsp=0;
   
@@ -193,9 +193,9 @@ struct bmp_image *bmp_decode(const void *src,int srcc) {
    * Optional, because ICO files don't include it.
    * If present, this is the authority for (pixelsp).
    */
-  if ((srcp<=srcc-14)&&!memcmp(src,"BM",2)) {
+  if ((srcp<=srcc-14)&&!memcmp(SRC,"BM",2)) {
     pixelsp=SRC[10]|(SRC[11]<<8)|(SRC[12]<<16)|(SRC[13]<<24);
-    if (pixelsp<14) return 0;
+    if (pixelsp<14) return -1;
     srcp+=14;
   }
   
@@ -203,13 +203,10 @@ struct bmp_image *bmp_decode(const void *src,int srcc) {
    * There are several versions of this. They all begin with 4-byte header length.
    * If we find a sensible length, create the image before proceeding.
    */
-  if (srcp>srcc-4) return 0;
+  if (srcp>srcc-4) return -1;
   int hdrlen=SRC[srcp]|(SRC[srcp+1]<<8)|(SRC[srcp+2]<<16)|(SRC[srcp+3]<<24);
-  if (hdrlen<4) return 0;
-  if (srcp>srcc-hdrlen) return 0;
-  
-  struct bmp_image *image=calloc(1,sizeof(struct bmp_image));
-  if (!image) return 0;
+  if (hdrlen<4) return -1;
+  if (srcp>srcc-hdrlen) return -1;
   
   // https://en.wikipedia.org/wiki/BMP_file_format
   int err=-1;
@@ -225,8 +222,7 @@ struct bmp_image *bmp_decode(const void *src,int srcc) {
     case 124: err=bmp_decode_BITMAPV5HEADER(image,SRC+srcp,hdrlen); break;
   }
   if (err<0) {
-    bmp_image_del(image);
-    return 0;
+    return -1;
   }
   srcp+=hdrlen;
   
@@ -241,8 +237,7 @@ struct bmp_image *bmp_decode(const void *src,int srcc) {
     (image->pixelsize<1)||
     (image->pixelsize>32)
   ) {
-    bmp_image_del(image);
-    return 0;
+    return -1;
   }
   
   switch (image->compression) {
@@ -258,8 +253,7 @@ struct bmp_image *bmp_decode(const void *src,int srcc) {
     case 11: // CMYK
     case 12: // CMYKRLE8
     case 13: // CMYKRLE4
-      bmp_image_del(image);
-      return 0;
+      return -1;
   }
   
   /* Color table.
@@ -271,14 +265,12 @@ struct bmp_image *bmp_decode(const void *src,int srcc) {
   if (image->ctabc) {
     int ctablen=image->ctabc<<2;
     if (srcp>srcc-ctablen) {
-      bmp_image_del(image);
       fprintf(stderr,"ctab overrun\n");
-      return 0;
+      return -1;
     }
     if (bmp_decode_ctab(image,SRC+srcp,image->ctabc)<0) {
-      bmp_image_del(image);
       fprintf(stderr,"ctab error\n");
-      return 0;
+      return -1;
     }
     srcp+=ctablen;
   }
@@ -288,8 +280,7 @@ struct bmp_image *bmp_decode(const void *src,int srcc) {
    */
   if (pixelsp) {
     if (pixelsp<srcp) {
-      bmp_image_del(image);
-      return 0;
+      return -1;
     }
     srcp=pixelsp;
   } else if (srcp&3) {
@@ -297,14 +288,35 @@ struct bmp_image *bmp_decode(const void *src,int srcc) {
   }
   
   image->stride=((image->w*image->pixelsize+31)>>3)&~3;
-  if ((image->stride<1)||(image->stride>INT_MAX/image->h)) {
-    bmp_image_del(image);
+  if ((image->h<1)||(image->stride<1)||(image->stride>INT_MAX/image->h)) {
       fprintf(stderr,"pixels too long\n");
-    return 0;
+    return -1;
   }
   int pixelslen=image->stride*image->h;
-  if ((srcp>srcc-pixelslen)||!(image->v=malloc(pixelslen))) {
+  if (srcp>srcc-pixelslen) {
       fprintf(stderr,"pixels overrun stride=%d srcp=%d/%d w=%d h=%d\n",image->stride,srcp,srcc,image->w,image->h);
+    return -1;
+  }
+  
+  *srcpp=srcp;
+  *flipp=flip;
+  return 0;
+}
+
+/* Decode.
+ */
+
+struct bmp_image *bmp_decode(const void *src,int srcc) {
+  const uint8_t *SRC=src;
+  int srcp=0,flip=0;
+  struct bmp_image *image=calloc(1,sizeof(struct bmp_image));
+  if (!image) return 0;
+  if (bmp_decode_prelude(image,&srcp,&flip,SRC,srcc)<0) {
+    bmp_image_del(image);
+    return 0;
+  }
+  int pixelslen=image->stride*image->h;
+  if (!(image->v=malloc(pixelslen))) {
     bmp_image_del(image);
     return 0;
   }
@@ -314,6 +326,43 @@ struct bmp_image *bmp_decode(const void *src,int srcc) {
   return image;
 }
 
+/* Decode in bands.
+ * BMP pixels are stored plain, so this is just a copy of each band's rows.
+ * The win is that we never hold the full decoded image.
+ */
+ 
+int bmp_decode_bands(
+  const void *src,int srcc,int bandh,
+  int (*cb)(const struct bmp_image *band,int y,int h,void *userdata),
+  void *userdata
+) {
+  if (!cb) return -1;
+  const uint8_t *SRC=src;
+  int srcp=0,flip=0,err=0;
+  struct bmp_image band={0};
+  if (bmp_decode_prelude(&band,&srcp,&flip,SRC,srcc)<0) {
+    bmp_image_cleanup(&band);
+    return -1;
+  }
+  int h=band.h;
+  if (bandh<1) bandh=1;
+  else if (bandh>h) bandh=h;
+  if (!(band.v=malloc(band.stride*bandh))) {
+    bmp_image_cleanup(&band);
+    return -1;
+  }
+  int y=0;
+  while (y<h) {
+    if ((band.h=h-y)>bandh) band.h=bandh;
+    if (flip) bmp_copy_flip(band.v,SRC+srcp+band.stride*(h-y-band.h),band.stride,band.h);
+    else memcpy(band.v,SRC+srcp+band.stride*y,band.stride*band.h);
+    if (err=cb(&band,y,h,userdata)) break;
+    y+=band.h;
+  }
+  bmp_image_cleanup(&band);
+  return err;
+}
+
 /* Reformat from packed 16-bit pixels.
  */
  
@@ -28,6 +28,17 @@ int bmp_encode(struct sr_encoder *dst,const struct bmp_image *image,int skip_fil
 
 struct bmp_image *bmp_decode(const void *src,int srcc);
 
+/* Decode incrementally, delivering up to (bandh) rows at a time to (cb), top to bottom regardless of storage order.
+ * We only hold one band of pixels at a time.
+ * (band->h) rows starting at row (y), and (h) is the full height. Color table and masks are set in (band).
+ * If (cb) returns nonzero, we stop and return it.
+ */
+int bmp_decode_bands(
+  const void *src,int srcc,int bandh,
+  int (*cb)(const struct bmp_image *band,int y,int h,void *userdata),
+  void *userdata
+);
+
 /* BMP supports a loose set of pixel formats.
  * To constrain that a bit, call this to rewrite the pixels in place such that they are PNG-legal.
  */
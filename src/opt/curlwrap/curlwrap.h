@@ -65,6 +65,15 @@ void curlwrap_ws_disconnect(struct curlwrap *cw,int wsid);
 int curlwrap_ws_get_message(void *dstpp,const struct curlwrap *cw,int wsid,int msgid);
 int curlwrap_ws_send(struct curlwrap *cw,int wsid,int opcode,const void *v,int c);
 
+/* In batch mode, curlwrap_ws_send only queues its message, and we send everything queued at curlwrap_ws_flush.
+ * Update flushes too, before reading.
+ * Also, a send that curl can't take right now gets queued and retried, in either mode.
+ * In batch mode, messages sent before the connection is established are held until it is.
+ * Turning batch mode off flushes immediately.
+ */
+void curlwrap_set_ws_batch(struct curlwrap *cw,int batch);
+void curlwrap_ws_flush(struct curlwrap *cw);
+
 int curlwrap_ws_for_each(
   const struct curlwrap *cw,
   int (*cb)(int wsid,void *userdata),
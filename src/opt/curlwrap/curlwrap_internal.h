@@ -6,15 +6,24 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <curl/curl.h>
 
 #define CURLWRAP_MAGIC_HTTP 12345
 #define CURLWRAP_MAGIC_WS   12346
 
+/* Growable byte buffer, reused in place. We only ever reset (c), never free until the owner dies.
+ */
+struct curlwrap_buffer {
+  void *v;
+  int c,a;
+};
+
 struct curlwrap {
   struct curlwrap_delegate delegate;
   CURL *multi;
   int id_next; // reqid,wsid,msgid all share this id counter. The context is dead if it exceeds INT_MAX.
+  int ws_batch; // Nonzero to queue WebSocket sends until the next flush or update.
   
   struct curlwrap_http {
     int magic;
@@ -38,10 +47,14 @@ struct curlwrap {
     struct curlwrap_ws_msg {
       int msgid;
       int opcode;
-      void *v;
+      int p; // Position in (msgbuf). Offset, not pointer, since msgbuf can move while more messages arrive.
       int c;
     } *msgv;
     int msgc,msga;
+    struct curlwrap_buffer msgbuf; // Payloads of all messages in (msgv), dropped together at the next update.
+    struct curlwrap_buffer outbuf; // Queued outgoing messages: u8 opcode, u32 length (native order), payload.
+    int outbufp;
+    int outsent; // Payload bytes of the message at (outbufp) that curl already took. The rest must follow before anything else.
     CURL *removable;
     struct curlwrap *parent;
     CURL *easy; // Always present
@@ -16,13 +16,9 @@ static void curlwrap_http_del(struct curlwrap_http *http) {
 
 static void curlwrap_ws_del(struct curlwrap_ws *ws) {
   if (!ws) return;
-  if (ws->msgv) {
-    while (ws->msgc-->0) {
-      struct curlwrap_ws_msg *msg=ws->msgv+ws->msgc;
-      if (msg->v) free(msg->v);
-    }
-    free(ws->msgv);
-  }
+  if (ws->msgv) free(ws->msgv);
+  if (ws->msgbuf.v) free(ws->msgbuf.v);
+  if (ws->outbuf.v) free(ws->outbuf.v);
   free(ws);
 }
 
@@ -41,6 +37,29 @@ void curlwrap_del(struct curlwrap *cw) {
   free(cw);
 }
 
+/* Buffers.
+ */
+ 
+static int curlwrap_buffer_require(struct curlwrap_buffer *buffer,int addc) {
+  if (addc<1) return 0;
+  if (buffer->c>INT_MAX-addc) return -1;
+  if (buffer->c<=buffer->a-addc) return 0;
+  int na=buffer->c+addc;
+  if (na<INT_MAX-4096) na=(na+4096)&~4095;
+  void *nv=realloc(buffer->v,na);
+  if (!nv) return -1;
+  buffer->v=nv;
+  buffer->a=na;
+  return 0;
+}
+
+static int curlwrap_buffer_append(struct curlwrap_buffer *buffer,const void *src,int srcc) {
+  if (curlwrap_buffer_require(buffer,srcc)<0) return -1;
+  memcpy((char*)buffer->v+buffer->c,src,srcc);
+  buffer->c+=srcc;
+  return 0;
+}
+
 /* New.
  */
 
@@ -217,7 +236,7 @@ int curlwrap_ws_get_message(void *dstpp,const struct curlwrap *cw,int wsid,int m
   int i=ws->msgc;
   for (;i-->0;msg++) {
     if (msg->msgid!=msgid) continue;
-    if (dstpp) *(const void**)dstpp=msg->v;
+    if (dstpp) *(const void**)dstpp=(char*)ws->msgbuf.v+msg->p;
     return msg->c;
   }
   return 0;
@@ -256,15 +275,9 @@ int curlwrap_update(struct curlwrap *cw) {
       curlwrap_ws_remove(cw,ws);
       continue;
     }
-    if (ws->msgc) {
-      // Drop all messages; they've already had their chance to fetch.
-      int mi=ws->msgc;
-      struct curlwrap_ws_msg *msg=ws->msgv;
-      for (;mi-->0;msg++) {
-        if (msg->v) free(msg->v);
-      }
-      ws->msgc=0;
-    }
+    // Drop all messages; they've already had their chance to fetch. Keep the buffers for the next batch.
+    ws->msgc=0;
+    ws->msgbuf.c=0;
     if (ws->almost&&!ws->status) {
       // We got end-of-headers in the last update. Now it should be safe to report the connection.
       ws->status=1;
@@ -274,6 +287,9 @@ int curlwrap_update(struct curlwrap *cw) {
     }
   }
 
+  // Anything queued since the last flush goes out before we read, so an echo can come back this update.
+  curlwrap_ws_flush(cw);
+
   int running_handles=0;
   CURLMcode perr=curl_multi_perform(cw->multi,&running_handles);
   if (perr) return -1;
@@ -475,8 +491,11 @@ static size_t curlwrap_cb_ws_message(char *v,size_t size,size_t c,void *userdata
         if (frame->flags&CURLWS_BINARY) msg->opcode=2; else msg->opcode=1;
       }
     }
-    if (!(msg->v=malloc(c))) return -1;
-    memcpy(msg->v,v,c);
+    msg->p=ws->msgbuf.c;
+    if (curlwrap_buffer_append(&ws->msgbuf,v,c)<0) {
+      ws->msgc--;
+      return -1;
+    }
     msg->c=c;
     // If we didn't get the connect signal, pretend we did.
     if (ws->status==0) {
@@ -556,21 +575,84 @@ void curlwrap_ws_disconnect(struct curlwrap *cw,int wsid) {
   curlwrap_ws_remove(cw,ws);
 }
 
-/* Send WebSocket packet.
+/* Send WebSocket packet, or the rest of one.
+ * (*sentp) is how much of the payload curl has taken already. We send from there, and advance it.
+ * Returns 0 when it's all sent, >0 if curl wants us to try the rest later, or <0 for errors.
+ * Once curl has taken any of a frame, it expects the remainder before anything else, so the caller must keep it.
  */
  
-int curlwrap_ws_send(struct curlwrap *cw,int wsid,int opcode,const void *v,int c) {
-  if ((c<0)||(c&&!v)) return -1;
-  struct curlwrap_ws *ws=curlwrap_ws_by_wsid(cw,wsid);
-  if (!ws) return -1;
-  if (!ws->easy) return -1;
+static int curlwrap_ws_send_now(struct curlwrap_ws *ws,int opcode,const void *v,int c,int *sentp) {
   size_t sent=0;
   int flags=0;
   switch (opcode) {
     case 1: flags=CURLWS_TEXT; break;
     case 2: flags=CURLWS_BINARY; break;
   }
-  int err=curl_ws_send(ws->easy,v,c,&sent,0,flags);
-  if (err||(sent!=c)) return -1;
+  int err=curl_ws_send(ws->easy,(const uint8_t*)v+(*sentp),c-(*sentp),&sent,0,flags);
+  (*sentp)+=sent;
+  if (err==CURLE_AGAIN) return 1;
+  if (err) return -1;
+  if (*sentp<c) return 1;
+  return 0;
+}
+
+static int curlwrap_ws_enqueue(struct curlwrap_ws *ws,int opcode,const void *v,int c) {
+  if (curlwrap_buffer_require(&ws->outbuf,5+c)<0) return -1;
+  uint8_t *dst=(uint8_t*)ws->outbuf.v+ws->outbuf.c;
+  dst[0]=opcode;
+  memcpy(dst+1,&c,4);
+  memcpy(dst+5,v,c);
+  ws->outbuf.c+=5+c;
   return 0;
 }
+ 
+int curlwrap_ws_send(struct curlwrap *cw,int wsid,int opcode,const void *v,int c) {
+  if ((c<0)||(c&&!v)) return -1;
+  struct curlwrap_ws *ws=curlwrap_ws_by_wsid(cw,wsid);
+  if (!ws) return -1;
+  if (!ws->easy) return -1;
+  // Queue it if we're batching, or if something's already queued; messages must stay in order.
+  if (cw->ws_batch||(ws->outbufp<ws->outbuf.c)) return curlwrap_ws_enqueue(ws,opcode,v,c);
+  int sent=0;
+  int err=curlwrap_ws_send_now(ws,opcode,v,c,&sent);
+  if (err>0) {
+    // Queue was empty, so this is the first message in it. Flush resumes after the part curl already took.
+    if (curlwrap_ws_enqueue(ws,opcode,v,c)<0) return -1;
+    ws->outsent=sent;
+    return 0;
+  }
+  return err;
+}
+
+/* Flush queued WebSocket packets.
+ */
+ 
+static void curlwrap_ws_flush_1(struct curlwrap_ws *ws) {
+  if (ws->outbufp>=ws->outbuf.c) return;
+  if (ws->easy&&!ws->status) return; // Not connected yet; hold everything.
+  if (ws->easy&&(ws->status==1)) {
+    while (ws->outbufp<=ws->outbuf.c-5) {
+      const uint8_t *src=(uint8_t*)ws->outbuf.v+ws->outbufp;
+      int c;
+      memcpy(&c,src+1,4);
+      if (curlwrap_ws_send_now(ws,src[0],src+5,c,&ws->outsent)>0) return; // Try again next time, from here.
+      ws->outbufp+=5+c; // Failures are dropped, same as unbatched sends.
+      ws->outsent=0;
+    }
+  }
+  ws->outbufp=0;
+  ws->outbuf.c=0;
+  ws->outsent=0;
+}
+
+void curlwrap_ws_flush(struct curlwrap *cw) {
+  if (!cw) return;
+  int i=cw->wsc;
+  while (i-->0) curlwrap_ws_flush_1(cw->wsv[i]);
+}
+
+void curlwrap_set_ws_batch(struct curlwrap *cw,int batch) {
+  if (!cw) return;
+  cw->ws_batch=batch?1:0;
+  if (!cw->ws_batch) curlwrap_ws_flush(cw);
+}
@@ -31,9 +31,22 @@ void *evdev_get_userdata(const struct evdev *evdev);
  */
 int evdev_update(struct evdev *evdev);
 
+/* Read devices on a separate thread, so nothing is lost or delayed if updates are far apart.
+ * The thread waits on all devices and inotify with epoll, and queues events for evdev_update.
+ * Device management and callbacks all still happen in evdev_update, on your thread.
+ * Once started, the thread runs until evdev_del.
+ */
+int evdev_start_thread(struct evdev *evdev);
+
+/* During cb_button, the kernel's timestamp for this event, in CLOCK_MONOTONIC seconds.
+ * Compare to now, to see how long it waited for you.
+ */
+double evdev_get_event_time(const struct evdev *evdev);
+
 /* If you prefer to use your own poller, call these each cycle.
  * All files we report should poll with POLLIN; update them individually when the poll or fail.
  * Beware that files are not necessarily devices: There's normally one for inotify.
+ * With the input thread running, there are no files for you to poll. Just call evdev_update.
  */
 int evdev_for_each_file(const struct evdev *evdev,int (*cb)(int fd,void *userdata),void *userdata);
 int evdev_update_file(struct evdev *evdev,int fd);
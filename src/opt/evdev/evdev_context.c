@@ -5,6 +5,7 @@
 
 void evdev_del(struct evdev *evdev) {
   if (!evdev) return;
+  evdev_thread_stop(evdev);
   if (evdev->devicev) {
     while (evdev->devicec-->0) evdev_device_del(evdev->devicev[evdev->devicec]);
     free(evdev->devicev);
@@ -27,6 +28,8 @@ struct evdev *evdev_new(
   if (!evdev) return 0;
   
   evdev->inofd=-1;
+  evdev->epfd=-1;
+  evdev->wakefd=-1;
   evdev->rescan=1;
   if (delegate) evdev->delegate=*delegate;
   
@@ -49,6 +52,11 @@ void *evdev_get_userdata(const struct evdev *evdev) {
   return evdev->delegate.userdata;
 }
 
+double evdev_get_event_time(const struct evdev *evdev) {
+  if (!evdev) return 0.0;
+  return evdev->event_time;
+}
+
 /* Access to device list.
  */
  
@@ -106,6 +114,7 @@ void evdev_device_disconnect(struct evdev *evdev,struct evdev_device *device) {
     if (evdev->devicev[p]==device) {
       evdev->devicec--;
       memmove(evdev->devicev+p,evdev->devicev+p+1,sizeof(void*)*(evdev->devicec-p));
+      if (evdev_thread_retire(evdev,device->fd)) device->fd=-1;
       evdev_device_del(device);
       return;
     }
@@ -69,7 +69,7 @@ int evdev_device_acquire_ids(struct evdev_device *device) {
 
 int evdev_device_update(struct evdev *evdev,struct evdev_device *device) {
   if (device->fd<0) return -1;
-  struct input_event buf[32];
+  struct input_event buf[EVDEV_READ_SIZE];
   int eventc=read(device->fd,buf,sizeof(buf));
   if (eventc<=0) {
     if (evdev->delegate.cb_disconnect) evdev->delegate.cb_disconnect(evdev,device);
@@ -82,6 +82,7 @@ int evdev_device_update(struct evdev *evdev,struct evdev_device *device) {
     for (;eventc-->0;event++) {
       if (event->type==EV_SYN) continue;
       if (event->type==EV_MSC) continue;
+      evdev->event_time=evdev_time_from_event(event);
       evdev->delegate.cb_button(evdev,device,event->type,event->code,event->value);
     }
   }
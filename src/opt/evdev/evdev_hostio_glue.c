@@ -58,6 +58,9 @@ static int _evdev_init(struct hostio_input *driver,const struct hostio_input_set
   if (!driver->delegate.cb_disconnect) delegate.cb_disconnect=0;
   if (!driver->delegate.cb_button) delegate.cb_button=0;
   if (!(DRIVER->evdev=evdev_new(setup->path,&delegate))) return -1;
+  if (evdev_start_thread(DRIVER->evdev)<0) {
+    fprintf(stderr,"evdev: Failed to start input thread. Will poll from the main loop instead.\n");
+  }
   return 0;
 }
 
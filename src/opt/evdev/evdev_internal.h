@@ -13,6 +13,18 @@
 #include <unistd.h>
 #include <linux/input.h>
 #include <sys/inotify.h>
+#include <pthread.h>
+
+#define EVDEV_QUEUE_SIZE 4096 /* Events, power of two. */
+#define EVDEV_READ_SIZE 256 /* Events per read, on the input thread. */
+#define EVDEV_TYPE_LOST 0xffff /* Queued in place of an event type, when the device's file fails. */
+
+struct evdev_event {
+  double time; // Kernel's timestamp, CLOCK_MONOTONIC seconds.
+  int tag;
+  uint16_t type,code;
+  int value;
+};
 
 struct evdev {
   struct evdev_delegate delegate;
@@ -24,6 +36,22 @@ struct evdev {
   struct pollfd *pollfdv;
   int pollfda;
   int rescan;
+  double event_time;
+  
+  // Input thread, after evdev_start_thread. See evdev_thread.c.
+  pthread_t thread;
+  int thread_running;
+  int epfd;
+  int wakefd; // eventfd, to interrupt epoll_wait.
+  int quit; // Atomic.
+  int hotplug; // Atomic. Input thread saw inotify activity; main should rescan.
+  struct evdev_event *queuev; // EVDEV_QUEUE_SIZE.
+  uint32_t queue_head; // Atomic. Input thread advances.
+  uint32_t queue_tail; // Atomic. Main advances.
+  pthread_mutex_t retire_mutex;
+  int *retirev; // Files main is done with, for the input thread to close.
+  int retirec,retirea;
+  int tagnext;
 };
 
 struct evdev_device {
@@ -32,6 +60,7 @@ struct evdev_device {
   int kid;
   char *name;
   int vid,pid,version;
+  int tag; // Nonzero and unique if registered with the input thread.
 };
 
 int evdev_add_device(struct evdev *evdev,struct evdev_device *device);
@@ -42,4 +71,16 @@ int evdev_device_acquire_ids(struct evdev_device *device);
 // Manages disconnect and removal on errors. <0 returned here is a serious fatal error.
 int evdev_device_update(struct evdev *evdev,struct evdev_device *device);
 
+/* Input thread, evdev_thread.c.
+ * Register a device after opening it, and retire instead of closing it.
+ * Both are noop if the thread isn't running.
+ * Retire returns nonzero if it took ownership of the file.
+ */
+void evdev_thread_stop(struct evdev *evdev);
+int evdev_thread_register(struct evdev *evdev,struct evdev_device *device);
+int evdev_thread_retire(struct evdev *evdev,int fd);
+int evdev_thread_update(struct evdev *evdev);
+
+double evdev_time_from_event(const struct input_event *event);
+
 #endif
@@ -0,0 +1,286 @@
+/* evdev_thread.c
+ * Optional input thread.
+ * It waits on every device and inotify with epoll, reads events in big batches, and queues them for the main thread.
+ * The queue is a ring with one producer and one consumer, no lock.
+ * Main still owns the device list, opening, ioctls, and callbacks. The input thread only reads.
+ * Main never closes a device file while the thread is running: It retires it, and the thread closes it between waits.
+ * That way a file number can't get reused for a new device while we're still reading the old one.
+ */
+
+#include "evdev_internal.h"
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+/* Time from an event, in seconds.
+ */
+
+double evdev_time_from_event(const struct input_event *event) {
+  #ifdef input_event_sec
+    return (double)event->input_event_sec+(double)event->input_event_usec/1000000.0;
+  #else
+    return (double)event->time.tv_sec+(double)event->time.tv_usec/1000000.0;
+  #endif
+}
+
+/* Input thread: Add one event to the queue.
+ * If it's full, wait for main to catch up. Dropping would be worse.
+ * Returns <0 only if we're quitting.
+ */
+
+static int evdev_queue_push(struct evdev *evdev,double time,int tag,int type,int code,int value) {
+  uint32_t head=evdev->queue_head;
+  for (;;) {
+    uint32_t tail=__atomic_load_n(&evdev->queue_tail,__ATOMIC_ACQUIRE);
+    if (head-tail<EVDEV_QUEUE_SIZE) break;
+    if (__atomic_load_n(&evdev->quit,__ATOMIC_ACQUIRE)) return -1;
+    usleep(1000);
+  }
+  struct evdev_event *event=evdev->queuev+(head&(EVDEV_QUEUE_SIZE-1));
+  event->time=time;
+  event->tag=tag;
+  event->type=type;
+  event->code=code;
+  event->value=value;
+  __atomic_store_n(&evdev->queue_head,head+1,__ATOMIC_RELEASE);
+  return 0;
+}
+
+/* Input thread: Close whatever main has retired.
+ * Only between waits, so we're not holding any stale epoll events for them.
+ */
+
+static void evdev_thread_close_retired(struct evdev *evdev) {
+  pthread_mutex_lock(&evdev->retire_mutex);
+  while (evdev->retirec>0) close(evdev->retirev[--(evdev->retirec)]);
+  pthread_mutex_unlock(&evdev->retire_mutex);
+}
+
+/* Input thread: Read from one device.
+ * On errors, stop watching it and tell main. Main will retire it.
+ */
+
+static int evdev_thread_read_device(struct evdev *evdev,int fd,int tag) {
+  struct input_event buf[EVDEV_READ_SIZE];
+  int bufc=read(fd,buf,sizeof(buf));
+  if (bufc<=0) {
+    if ((bufc<0)&&((errno==EAGAIN)||(errno==EINTR))) return 0;
+    epoll_ctl(evdev->epfd,EPOLL_CTL_DEL,fd,0);
+    return evdev_queue_push(evdev,0.0,tag,EVDEV_TYPE_LOST,0,0);
+  }
+  bufc/=sizeof(struct input_event);
+  const struct input_event *event=buf;
+  for (;bufc-->0;event++) {
+    if (event->type==EV_SYN) continue;
+    if (event->type==EV_MSC) continue;
+    if (evdev_queue_push(evdev,evdev_time_from_event(event),tag,event->type,event->code,event->value)<0) return -1;
+  }
+  return 0;
+}
+
+/* Input thread: inotify.
+ * We don't need the names. Main rescans the directory, and that skips files already open.
+ */
+
+static void evdev_thread_read_inotify(struct evdev *evdev) {
+  char tmp[4096];
+  int tmpc=read(evdev->inofd,tmp,sizeof(tmp));
+  if (tmpc<=0) {
+    if ((tmpc<0)&&((errno==EAGAIN)||(errno==EINTR))) return;
+    epoll_ctl(evdev->epfd,EPOLL_CTL_DEL,evdev->inofd,0);
+    return;
+  }
+  __atomic_store_n(&evdev->hotplug,1,__ATOMIC_RELEASE);
+}
+
+/* Input thread, main loop.
+ * Epoll data is the tag in the high 32 bits and the file in the low.
+ */
+
+static void *evdev_thread_main(void *arg) {
+  struct evdev *evdev=arg;
+  for (;;) {
+    evdev_thread_close_retired(evdev);
+    if (__atomic_load_n(&evdev->quit,__ATOMIC_ACQUIRE)) break;
+    struct epoll_event eventv[16];
+    int eventc=epoll_wait(evdev->epfd,eventv,sizeof(eventv)/sizeof(eventv[0]),-1);
+    if (eventc<0) {
+      if (errno==EINTR) continue;
+      break;
+    }
+    const struct epoll_event *event=eventv;
+    for (;eventc-->0;event++) {
+      int fd=(int)(uint32_t)event->data.u64;
+      int tag=(int)(event->data.u64>>32);
+      if (fd==evdev->wakefd) {
+        uint64_t v;
+        if (read(evdev->wakefd,&v,sizeof(v))<0) {} // Only fails if already drained. Either way we're awake now.
+      } else if (fd==evdev->inofd) {
+        evdev_thread_read_inotify(evdev);
+      } else {
+        if (evdev_thread_read_device(evdev,fd,tag)<0) break;
+      }
+    }
+  }
+  return 0;
+}
+
+/* Add a file to epoll.
+ */
+
+static int evdev_epoll_add(struct evdev *evdev,int fd,int tag) {
+  struct epoll_event event={
+    .events=EPOLLIN,
+    .data.u64=((uint64_t)(uint32_t)tag<<32)|(uint32_t)fd,
+  };
+  return epoll_ctl(evdev->epfd,EPOLL_CTL_ADD,fd,&event);
+}
+
+/* Register device.
+ */
+
+int evdev_thread_register(struct evdev *evdev,struct evdev_device *device) {
+  if (!evdev->thread_running) return 0;
+  if (device->fd<0) return -1;
+  int flags=fcntl(device->fd,F_GETFL);
+  if (flags>=0) fcntl(device->fd,F_SETFL,flags|O_NONBLOCK);
+  if (evdev->tagnext<1) evdev->tagnext=1;
+  device->tag=evdev->tagnext++;
+  if (evdev_epoll_add(evdev,device->fd,device->tag)<0) {
+    device->tag=0;
+    return -1;
+  }
+  return 0;
+}
+
+/* Retire file.
+ */
+
+int evdev_thread_retire(struct evdev *evdev,int fd) {
+  if (!evdev->thread_running) return 0;
+  if (fd<0) return 0;
+  epoll_ctl(evdev->epfd,EPOLL_CTL_DEL,fd,0);
+  pthread_mutex_lock(&evdev->retire_mutex);
+  if (evdev->retirec>=evdev->retirea) {
+    int na=evdev->retirea+8;
+    void *nv=realloc(evdev->retirev,sizeof(int)*na);
+    if (!nv) {
+      // Better to leak a file than risk closing it under the reader.
+      pthread_mutex_unlock(&evdev->retire_mutex);
+      return 1;
+    }
+    evdev->retirev=nv;
+    evdev->retirea=na;
+  }
+  evdev->retirev[evdev->retirec++]=fd;
+  pthread_mutex_unlock(&evdev->retire_mutex);
+  uint64_t v=1;
+  if (write(evdev->wakefd,&v,sizeof(v))<0) {} // Eventfd writes only fail when the counter is full, ie a wake is already pending.
+  return 1;
+}
+
+/* Stop.
+ */
+
+void evdev_thread_stop(struct evdev *evdev) {
+  if (evdev->thread_running) {
+    __atomic_store_n(&evdev->quit,1,__ATOMIC_RELEASE);
+    uint64_t v=1;
+    if (write(evdev->wakefd,&v,sizeof(v))<0) {} // As above, a failure means the thread is waking anyway.
+    pthread_join(evdev->thread,0);
+    evdev->thread_running=0;
+    while (evdev->retirec>0) close(evdev->retirev[--(evdev->retirec)]);
+    pthread_mutex_destroy(&evdev->retire_mutex);
+  }
+  if (evdev->epfd>=0) close(evdev->epfd);
+  evdev->epfd=-1;
+  if (evdev->wakefd>=0) close(evdev->wakefd);
+  evdev->wakefd=-1;
+  if (evdev->queuev) free(evdev->queuev);
+  evdev->queuev=0;
+  if (evdev->retirev) free(evdev->retirev);
+  evdev->retirev=0;
+  evdev->retirea=0;
+}
+
+/* Start.
+ */
+
+int evdev_start_thread(struct evdev *evdev) {
+  if (!evdev) return -1;
+  if (evdev->thread_running) return 0;
+  if (!(evdev->queuev=malloc(sizeof(struct evdev_event)*EVDEV_QUEUE_SIZE))) return -1;
+  evdev->queue_head=evdev->queue_tail=0;
+  if ((evdev->epfd=epoll_create1(EPOLL_CLOEXEC))<0) {
+    evdev_thread_stop(evdev);
+    return -1;
+  }
+  if ((evdev->wakefd=eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC))<0) {
+    evdev_thread_stop(evdev);
+    return -1;
+  }
+  if (evdev_epoll_add(evdev,evdev->wakefd,0)<0) {
+    evdev_thread_stop(evdev);
+    return -1;
+  }
+  if (evdev->inofd>=0) {
+    int flags=fcntl(evdev->inofd,F_GETFL);
+    if (flags>=0) fcntl(evdev->inofd,F_SETFL,flags|O_NONBLOCK);
+    evdev_epoll_add(evdev,evdev->inofd,0);
+  }
+  if (pthread_mutex_init(&evdev->retire_mutex,0)) {
+    evdev_thread_stop(evdev);
+    return -1;
+  }
+
+  // Register devices already open, before the thread exists, so we don't need to worry about it yet.
+  evdev->thread_running=1;
+  int i=evdev->devicec;
+  while (i-->0) {
+    if (evdev_thread_register(evdev,evdev->devicev[i])<0) evdev->devicev[i]->tag=0;
+  }
+  if (pthread_create(&evdev->thread,0,evdev_thread_main,evdev)) {
+    evdev->thread_running=0;
+    pthread_mutex_destroy(&evdev->retire_mutex);
+    for (i=evdev->devicec;i-->0;) evdev->devicev[i]->tag=0;
+    evdev_thread_stop(evdev);
+    return -1;
+  }
+  return 0;
+}
+
+/* Main thread: Device by tag.
+ */
+
+static struct evdev_device *evdev_device_by_tag(const struct evdev *evdev,int tag) {
+  struct evdev_device **p=evdev->devicev;
+  int i=evdev->devicec;
+  for (;i-->0;p++) if ((*p)->tag==tag) return *p;
+  return 0;
+}
+
+/* Main thread: Deliver everything queued so far.
+ * Events for devices we no longer have are dropped quietly; they were in flight when it disconnected.
+ */
+
+int evdev_thread_update(struct evdev *evdev) {
+  uint32_t head=__atomic_load_n(&evdev->queue_head,__ATOMIC_ACQUIRE);
+  uint32_t tail=evdev->queue_tail;
+  for (;tail!=head;tail++) {
+    struct evdev_event event=evdev->queuev[tail&(EVDEV_QUEUE_SIZE-1)];
+    __atomic_store_n(&evdev->queue_tail,tail+1,__ATOMIC_RELEASE);
+    struct evdev_device *device=evdev_device_by_tag(evdev,event.tag);
+    if (!device) continue;
+    if (event.type==EVDEV_TYPE_LOST) {
+      if (evdev->delegate.cb_disconnect) evdev->delegate.cb_disconnect(evdev,device);
+      evdev_device_disconnect(evdev,device);
+      continue;
+    }
+    if (evdev->delegate.cb_button) {
+      evdev->event_time=event.time;
+      evdev->delegate.cb_button(evdev,device,event.type,event.code,event.value);
+    }
+  }
+  return 0;
+}
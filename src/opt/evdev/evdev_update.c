@@ -1,4 +1,5 @@
 #include "evdev_internal.h"
+#include <time.h>
 
 /* Check a file newly discovered in the devices directory.
  * Errors are for fatal context-wide problems only.
@@ -52,6 +53,15 @@ static int evdev_try_file(struct evdev *evdev,const char *base) {
     return 0;
   }
   
+  /* Timestamps on the monotonic clock, and if the input thread is running, give it the file.
+   */
+  int clockid=CLOCK_MONOTONIC;
+  ioctl(device->fd,EVIOCSCLOCKID,&clockid);
+  if (evdev_thread_register(evdev,device)<0) {
+    evdev_device_disconnect(evdev,device);
+    return 0;
+  }
+  
   /* Alert our owner.
    * Beware that owner may disconnect the device during this callback, which will delete it for real.
    * So this must be the last step here. (which it should be anyway)
@@ -112,6 +122,7 @@ static int evdev_update_inotify(struct evdev *evdev) {
  */
  
 int evdev_for_each_file(const struct evdev *evdev,int (*cb)(int fd,void *userdata),void *userdata) {
+  if (evdev->thread_running) return 0;
   int err;
   if (evdev->inofd>=0) {
     if (err=cb(evdev->inofd,userdata)) return err;
@@ -130,6 +141,7 @@ int evdev_for_each_file(const struct evdev *evdev,int (*cb)(int fd,void *userdat
  
 int evdev_update_file(struct evdev *evdev,int fd) {
   if (fd<0) return 0;
+  if (evdev->thread_running) return 0;
   if (fd==evdev->inofd) return evdev_update_inotify(evdev);
   struct evdev_device *device=evdev_device_by_fd(evdev,fd);
   if (device) return evdev_device_update(evdev,device);
@@ -162,6 +174,13 @@ int evdev_update(struct evdev *evdev) {
   }
   evdev_drop_defunct_devices(evdev);
   
+  if (evdev->thread_running) {
+    if (__atomic_exchange_n(&evdev->hotplug,0,__ATOMIC_ACQ_REL)) {
+      if (evdev_scan(evdev)<0) return -1;
+    }
+    return evdev_thread_update(evdev);
+  }
+  
   int pollfdc=evdev->devicec;
   if (evdev->inofd>=0) pollfdc++;
   if (pollfdc>evdev->pollfda) {
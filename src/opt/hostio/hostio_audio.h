@@ -41,6 +41,11 @@ struct hostio_audio_type {
   int (*update)(struct hostio_audio *driver);
   int (*lock)(struct hostio_audio *driver);
   void (*unlock)(struct hostio_audio *driver);
+  
+  /* Frames delivered by cb_pcm_out that aren't audible yet: Our own buffers, the system's, and the device's.
+   * Called from any thread, without the lock. Return <0 if you can't tell.
+   */
+  int (*get_latency)(struct hostio_audio *driver);
 };
 
 void hostio_audio_del(struct hostio_audio *driver);
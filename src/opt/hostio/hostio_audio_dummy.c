@@ -156,4 +156,8 @@ const struct hostio_audio_type hostio_audio_type_dummy={
   // Typical:
   // int lock(struct hostio_audio *driver);
   // void unlock(struct hostio_audio *driver);
+  
+  // Optional, but games need it to sync to music:
+  // int get_latency(struct hostio_audio *driver);
+  // We have nothing buffered, so our latency is zero.
 };
@@ -270,3 +270,10 @@ void hostio_audio_unlock(struct hostio *hostio) {
   if (!hostio||!hostio->audio||!hostio->audio->type->unlock) return;
   hostio->audio->type->unlock(hostio->audio);
 }
+
+int hostio_audio_get_latency(struct hostio *hostio) {
+  if (!hostio||!hostio->audio||!hostio->audio->type->get_latency) return 0;
+  int latency=hostio->audio->type->get_latency(hostio->audio);
+  if (latency<0) return 0;
+  return latency;
+}
@@ -34,11 +34,25 @@ struct http_limits {
   double active_timeout; // sec. Drop socket mid-transaction.
   int transfer_size; // Max size for open-ended constructions like HTTP headers.
   int body_size; // Max size for HTTP bodies and WebSocket packets.
+  int pipeline; // Max outbound GETs to queue behind one in flight, on a connection known to persist. Zero to disable.
 };
 
 void http_context_get_limits(struct http_limits *limits,const struct http_context *ctx);
 int http_context_set_limits(struct http_context *ctx,const struct http_limits *limits);
 
+/* Counters for outbound requests, since the context was created.
+ * (connectc+reusec+pipelinec) is every request started, retries included.
+ */
+struct http_stats {
+  int connectc; // Sent on a new TCP connection.
+  int reusec; // Sent on an idle connection left over from a previous request to the same host.
+  int pipelinec; // Queued behind another request on a busy connection, per (limits.pipeline).
+  int retryc; // Started over, because a reused connection closed before responding.
+  int completec; // Responses delivered.
+};
+
+void http_context_get_stats(struct http_stats *stats,const struct http_context *ctx);
+
 /* Create or destroy a TCP server to receive incoming connections.
  */
 int http_listen(struct http_context *ctx,int local_only,int port);
@@ -53,6 +67,13 @@ int http_update(struct http_context *ctx,int toms);
 int http_get_files(struct pollfd *dst,int dsta,struct http_context *ctx);
 int http_update_file(struct http_context *ctx,int fd);
 
+/* Switch to epoll instead of poll, if the platform supports it. Fails if not, and we keep using poll.
+ * Sockets stay registered, and we only touch them when they switch between reading and writing.
+ * http_get_files then reports just the one epoll file, which you can still poll alongside your own.
+ * Worth it with a lot of sockets, eg hundreds of WebSockets. poll is fine for a handful.
+ */
+int http_context_use_epoll(struct http_context *ctx);
+
 /* WebSocket.
  ****************************************************************/
 
@@ -95,6 +116,8 @@ struct http_websocket *http_websocket_check_upgrade(struct http_xfer *req,struct
 /* Prepare an outgoing HTTP request.
  * The TCP connection may be established during this call, but no data is sent.
  * Context provides a request backlog, and only allows so many in flight at a time.
+ * Connections are HTTP/1.1 keep-alive: When the response is complete, the socket waits up to (limits.idle_timeout)
+ * for another request to the same host and port. Send "Connection: close" to prevent that.
  * Caller is expected to provide headers and body after this succeeds.
  * Do not provide "Host" or "Content-Length" headers, those are automatic.
  * On success, returns a WEAK object owned by the context.
@@ -145,6 +168,34 @@ int http_xfer_get_param_int(int *v,const struct http_xfer *xfer,const char *k,in
 
 struct sr_encoder *http_xfer_get_body(struct http_xfer *xfer);
 
+/* Send the body straight from an open file, instead of the body encoder, eg with sendfile().
+ * (fd) is HANDOFF, whether we succeed or fail. We send (c) bytes from the start of the file.
+ * Responses only. Platforms without sendfile read the file into the body encoder right away.
+ */
+int http_xfer_set_body_file(struct http_xfer *xfer,int fd,int c);
+
+/* Stream the body from a callback, instead of holding it all at once.
+ * As the socket drains, we call (produce) to append the next piece to (dst). Keep the pieces modest, say 64 kB.
+ * It returns >0 if there's more to come, 0 when finished, or <0 to abort the connection.
+ * If you know the total length, give it as (c) and we send Content-Length. Otherwise (c<0), chunked encoding.
+ * Responses to HTTP/1.0 can't be chunked: Those go bare with "Connection: close", and we close to end the body.
+ * (cleanup) if not null is called exactly once, when the xfer deletes, whether we finished or not.
+ * Works for requests and responses.
+ */
+int http_xfer_set_body_producer(
+  struct http_xfer *xfer,
+  int c,
+  int (*produce)(struct sr_encoder *dst,void *userdata),
+  void (*cleanup)(void *userdata),
+  void *userdata
+);
+
+/* Client requests only: Take the response body piecemeal as it arrives, instead of collecting it in the response.
+ * (consume) returns <0 to abort. (limits.body_size) doesn't apply.
+ * The request's callback fires at the end as usual, with an empty body.
+ */
+int http_xfer_set_body_consumer(struct http_xfer *req,int (*consume)(struct http_xfer *req,const void *v,int c));
+
 /* Assemble the full request or response, suitable for putting right on the wire.
  */
 int http_xfer_encode(struct sr_encoder *dst,const struct http_xfer *xfer);
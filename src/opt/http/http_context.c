@@ -28,6 +28,10 @@ void http_context_del(struct http_context *ctx) {
     free(ctx->backlogv);
   }
   if (ctx->pollfdv) free(ctx->pollfdv);
+  if (ctx->epollfd>=0) close(ctx->epollfd);
+  #if HTTP_EPOLL
+    if (ctx->epeventv) free(ctx->epeventv);
+  #endif
   free(ctx);
 }
 
@@ -38,6 +42,7 @@ struct http_context *http_context_new(const struct http_context_delegate *delega
   struct http_context *ctx=calloc(1,sizeof(struct http_context));
   if (!ctx) return 0;
   if (delegate) ctx->delegate=*delegate;
+  ctx->epollfd=-1;
   
   ctx->limits.requests=10;
   ctx->limits.websockets=10;
@@ -63,12 +68,16 @@ int http_context_set_limits(struct http_context *ctx,const struct http_limits *l
   return 0;
 }
 
+void http_context_get_stats(struct http_stats *stats,const struct http_context *ctx) {
+  *stats=ctx->stats;
+}
+
 /* Grow socketv if needed.
  */
  
 static int http_context_socketv_require(struct http_context *ctx) {
   if (ctx->socketc<ctx->socketa) return 0;
-  int na=ctx->socketa=16;
+  int na=ctx->socketa+16;
   if (na>INT_MAX/sizeof(void*)) return -1;
   void *nv=realloc(ctx->socketv,sizeof(void*)*na);
   if (!nv) return -1;
@@ -117,6 +126,7 @@ struct http_socket *http_context_socket_for_websocket(
   const struct http_context *ctx,
   const struct http_websocket *ws
 ) {
+  if (ws->sock&&(ws->sock->ws==ws)) return ws->sock;
   struct http_socket **sockp=ctx->socketv;
   int i=ctx->socketc;
   for (;i-->0;sockp++) {
@@ -125,6 +135,182 @@ struct http_socket *http_context_socket_for_websocket(
   return 0;
 }
 
+/* Grow backlogv if needed.
+ */
+ 
+static int http_context_backlogv_require(struct http_context *ctx) {
+  if (ctx->backlogc<ctx->backloga) return 0;
+  int na=ctx->backloga+16;
+  if (na>INT_MAX/sizeof(void*)) return -1;
+  void *nv=realloc(ctx->backlogv,sizeof(void*)*na);
+  if (!nv) return -1;
+  ctx->backlogv=nv;
+  ctx->backloga=na;
+  return 0;
+}
+
+/* Handoff client request xfer to backlog.
+ */
+ 
+static int http_context_handoff_backlog(struct http_context *ctx,struct http_xfer *req) {
+  if (ctx->backlogc>=ctx->limits.backlog) return -1;
+  if (http_context_backlogv_require(ctx)<0) return -1;
+  ctx->backlogv[ctx->backlogc++]=req;
+  return 0;
+}
+
+/* Put a request that we're starting over at the front of the backlog.
+ * It was accepted already, so (limits.backlog) doesn't apply.
+ */
+ 
+static int http_context_requeue(struct http_context *ctx,struct http_xfer *req) {
+  if (http_context_backlogv_require(ctx)<0) return -1;
+  memmove(ctx->backlogv+1,ctx->backlogv,sizeof(void*)*ctx->backlogc);
+  ctx->backlogv[0]=req;
+  ctx->backlogc++;
+  ctx->stats.retryc++;
+  return 0;
+}
+
+/* Nonzero if (req) can queue behind the request in flight on (sock).
+ * Only GETs, only if the remote has already shown that it keeps connections alive.
+ * Requests starting over don't pipeline again: Give them a connection of their own, so they can't get bumped forever.
+ */
+ 
+static int http_context_xfer_is_get(const struct http_xfer *xfer) {
+  char method[4];
+  return ((http_xfer_get_method(method,sizeof(method),xfer)==3)&&!memcmp(method,"GET",3));
+}
+ 
+static int http_context_can_pipeline(const struct http_context *ctx,const struct http_socket *sock,const struct http_xfer *req) {
+  if (sock->pipec>=ctx->limits.pipeline) return 0;
+  if (req->retryc) return 0;
+  if (!sock->transactionc) return 0;
+  if (!sock->req) return 0;
+  if (!http_context_xfer_is_get(sock->req)) return 0;
+  if (!http_context_xfer_is_get(req)) return 0;
+  return 1;
+}
+
+/* Start a client request: On an idle connection to the same host, pipelined behind another, or on a new connection.
+ * Returns >0 if started, 0 if it has to wait for (limits.requests), or <0 for errors.
+ * On success, (req) is HANDOFF.
+ */
+ 
+static int http_context_start_request(struct http_context *ctx,struct http_xfer *req) {
+  char hoststr[300];
+  int hoststrc=http_socket_hoststr_for_url(hoststr,sizeof(hoststr),req->url,req->urlc);
+  if ((hoststrc<1)||(hoststrc>=sizeof(hoststr))) return -1;
+  int atlimit=(http_context_count_requests(ctx)>=ctx->limits.requests);
+
+  struct http_socket *pipesock=0;
+  int i=ctx->socketc;
+  while (i-->0) {
+    struct http_socket *sock=ctx->socketv[i];
+    if (sock->role!=HTTP_SOCKET_ROLE_CLIENT_STREAM) continue;
+    if ((sock->fd<0)||sock->close_after) continue;
+    if ((sock->hoststrc!=hoststrc)||memcmp(sock->hoststr,hoststr,hoststrc)) continue;
+    if (sock->state==HTTP_STREAM_STATE_IDLE) {
+      if (atlimit) continue;
+      if (http_socket_reuse_client_stream(sock,req)<0) continue;
+      ctx->stats.reusec++;
+      return 1;
+    }
+    if (!http_context_can_pipeline(ctx,sock,req)) continue;
+    if (!pipesock||(sock->pipec<pipesock->pipec)) pipesock=sock;
+  }
+  if (pipesock) {
+    if (http_socket_pipeline_request(pipesock,req)<0) return -1;
+    ctx->stats.pipelinec++;
+    return 1;
+  }
+  
+  if (atlimit) return 0;
+  if (http_context_socketv_require(ctx)<0) return -1;
+  struct http_socket *sock=http_socket_new(ctx);
+  if (!sock) return -1;
+  if (http_socket_configure_client_stream(sock,req,req->url,req->urlc)<0) {
+    sock->req=0; // Caller still owns (req) on failure.
+    http_socket_del(sock);
+    return -1;
+  }
+  ctx->socketv[ctx->socketc++]=sock;
+  ctx->stats.connectc++;
+  return 1;
+}
+
+/* Start as many backlogged requests as we're allowed.
+ */
+ 
+static void http_context_drain_backlog(struct http_context *ctx) {
+  while (ctx->backlogc>0) {
+    struct http_xfer *req=ctx->backlogv[0];
+    int err=http_context_start_request(ctx,req);
+    if (!err) return;
+    ctx->backlogc--;
+    memmove(ctx->backlogv,ctx->backlogv+1,sizeof(void*)*ctx->backlogc);
+    if (err<0) http_xfer_del(req);
+  }
+}
+
+/* A client stream is about to be deleted.
+ * Start over any of its requests that never got a response and are safe to send again.
+ * Pipelined requests are all GETs. The one in flight, only if this was a reused connection:
+ * That's the remote closing an idle connection just as we picked it up, and a fresh one will probably work.
+ */
+ 
+static void http_context_salvage_requests(struct http_context *ctx,struct http_socket *sock) {
+  if (sock->role!=HTTP_SOCKET_ROLE_CLIENT_STREAM) return;
+  while (sock->pipec>0) {
+    struct http_xfer *req=sock->pipev[--(sock->pipec)];
+    if ((req->retryc++>=HTTP_RETRY_LIMIT)||(http_context_requeue(ctx,req)<0)) http_xfer_del(req);
+  }
+  sock->pipeencc=0;
+  struct http_xfer *req=sock->req;
+  if (!req||sock->rsp||!sock->transactionc) return;
+  if (req->retryc||req->cancelled||!http_xfer_is_idempotent(req)) return;
+  sock->req=0;
+  req->retryc++;
+  if (http_context_requeue(ctx,req)<0) http_xfer_del(req);
+}
+
+/* Cancel client request.
+ */
+ 
+void http_context_cancel_request(struct http_context *ctx,struct http_xfer *req) {
+  int i=ctx->backlogc;
+  while (i-->0) {
+    if (ctx->backlogv[i]!=req) continue;
+    ctx->backlogc--;
+    memmove(ctx->backlogv+i,ctx->backlogv+i+1,sizeof(void*)*(ctx->backlogc-i));
+    http_xfer_del(req);
+    return;
+  }
+  for (i=ctx->socketc;i-->0;) {
+    struct http_socket *sock=ctx->socketv[i];
+    if (sock->role!=HTTP_SOCKET_ROLE_CLIENT_STREAM) continue;
+    if (sock->req==req) {
+      // Socket deletes it, eventually.
+      req->cancelled=1;
+      http_socket_force_defunct(sock);
+      return;
+    }
+    int p=sock->pipec;
+    while (p-->0) {
+      if (sock->pipev[p]!=req) continue;
+      sock->pipec--;
+      memmove(sock->pipev+p,sock->pipev+p+1,sizeof(void*)*(sock->pipec-p));
+      if (p<sock->pipeencc) {
+        // Already sent, so a response is coming that nobody wants. Drop the connection, and the others will start over.
+        sock->pipeencc--;
+        http_socket_force_defunct(sock);
+      }
+      http_xfer_del(req);
+      return;
+    }
+  }
+}
+
 /* Add server.
  */
 
@@ -174,10 +360,101 @@ int http_unlisten(struct http_context *ctx,int port) {
   return -1;
 }
 
+/* Switch to epoll.
+ */
+ 
+int http_context_use_epoll(struct http_context *ctx) {
+  #if HTTP_EPOLL
+    if (ctx->epollfd>=0) return 0;
+    if (!ctx->epeventv) {
+      if (!(ctx->epeventv=malloc(sizeof(struct epoll_event)*HTTP_EPOLL_BATCH))) return -1;
+    }
+    if ((ctx->epollfd=epoll_create1(EPOLL_CLOEXEC))<0) return -1;
+    return 0;
+  #else
+    return -1;
+  #endif
+}
+
+/* Drop any pending epoll results for a socket that's about to delete.
+ */
+ 
+void http_context_forget_socket(struct http_context *ctx,struct http_socket *sock) {
+  #if HTTP_EPOLL
+    int i=ctx->epeventp;
+    for (;i<ctx->epeventc;i++) {
+      if (ctx->epeventv[i].data.ptr==sock) ctx->epeventv[i].data.ptr=0;
+    }
+  #endif
+}
+
+/* Register a socket with epoll, or change its interest, if needed.
+ * Closed files drop out of epoll on their own, and file numbers get reused. So ADD and MOD can both be wrong, try the other.
+ */
+ 
+#if HTTP_EPOLL
+static int http_context_epoll_sync(struct http_context *ctx,struct http_socket *sock) {
+  int events=http_socket_wants_write(sock)?EPOLLOUT:EPOLLIN;
+  if ((sock->pollfd==sock->fd)&&(sock->pollevents==events)) return 0;
+  struct epoll_event event={.events=events,.data.ptr=sock};
+  int op=(sock->pollfd==sock->fd)?EPOLL_CTL_MOD:EPOLL_CTL_ADD;
+  if (epoll_ctl(ctx->epollfd,op,sock->fd,&event)<0) {
+    if ((op==EPOLL_CTL_ADD)&&(errno==EEXIST)) op=EPOLL_CTL_MOD;
+    else if ((op==EPOLL_CTL_MOD)&&(errno==ENOENT)) op=EPOLL_CTL_ADD;
+    else return -1;
+    if (epoll_ctl(ctx->epollfd,op,sock->fd,&event)<0) return -1;
+  }
+  sock->pollfd=sock->fd;
+  sock->pollevents=events;
+  return 0;
+}
+#endif
+
+/* Remove a socket from the list and delete it.
+ */
+ 
+static void http_context_drop_socket(struct http_context *ctx,struct http_socket *sock) {
+  http_context_salvage_requests(ctx,sock);
+  int i=ctx->socketc;
+  while (i-->0) {
+    if (ctx->socketv[i]!=sock) continue;
+    ctx->socketc--;
+    memmove(ctx->socketv+i,ctx->socketv+i+1,sizeof(void*)*(ctx->socketc-i));
+    break;
+  }
+  http_socket_del(sock);
+}
+
+/* Wait on epoll and update whichever sockets are ready.
+ * Sockets are identified directly by the event, no searching.
+ */
+ 
+#if HTTP_EPOLL
+static int http_context_epoll_update(struct http_context *ctx,int toms) {
+  ctx->epeventp=ctx->epeventc=0;
+  int eventc=epoll_wait(ctx->epollfd,ctx->epeventv,HTTP_EPOLL_BATCH,toms);
+  if (eventc<=0) return 0;
+  ctx->epeventc=eventc;
+  while (ctx->epeventp<ctx->epeventc) {
+    struct http_socket *sock=ctx->epeventv[ctx->epeventp++].data.ptr;
+    if (!sock) continue;
+    if ((http_socket_update(sock)<0)||(http_socket_try_write(sock)<0)) http_context_drop_socket(ctx,sock);
+  }
+  ctx->epeventp=ctx->epeventc=0;
+  return 1;
+}
+#endif
+
 /* Update, we poll.
  */
 
 int http_update(struct http_context *ctx,int toms) {
+  #if HTTP_EPOLL
+    if (ctx->epollfd>=0) {
+      if (http_get_files(0,0,ctx)<0) return -1;
+      return http_context_epoll_update(ctx,toms);
+    }
+  #endif
   int pollfdc=0;
   for (;;) {
     if ((pollfdc=http_get_files(ctx->pollfdv,ctx->pollfda,ctx))<0) return -1;
@@ -207,11 +484,14 @@ int http_update(struct http_context *ctx,int toms) {
 
 /* List pollable files.
  * This is also the general non-I/O update.
+ * With epoll, it's also where we register sockets and change their interest.
  */
   
 int http_get_files(struct pollfd *dst,int dsta,struct http_context *ctx) {
 
   double now=http_now();
+  
+  http_context_drain_backlog(ctx);
 
   int dstc=0,i=ctx->socketc;
   while (i-->0) {
@@ -224,15 +504,23 @@ int http_get_files(struct pollfd *dst,int dsta,struct http_context *ctx) {
     if (http_socket_is_defunct(sock,now)) {
       ctx->socketc--;
       memmove(ctx->socketv+i,ctx->socketv+i+1,sizeof(void*)*(ctx->socketc-i));
+      http_context_salvage_requests(ctx,sock);
       http_socket_del(sock);
       continue;
     }
     
+    #if HTTP_EPOLL
+      if (ctx->epollfd>=0) {
+        if (http_context_epoll_sync(ctx,sock)<0) http_socket_force_defunct(sock);
+        continue;
+      }
+    #endif
+    
     if (dstc<dsta) {
       struct pollfd *pollfd=dst+dstc++;
       memset(pollfd,0,sizeof(struct pollfd));
       pollfd->fd=sock->fd;
-      if (sock->wbufp<sock->wbuf.c) {
+      if (http_socket_wants_write(sock)) {
         pollfd->events=POLLOUT|POLLERR|POLLHUP;
       } else {
         pollfd->events=POLLIN|POLLERR|POLLHUP;
@@ -241,6 +529,14 @@ int http_get_files(struct pollfd *dst,int dsta,struct http_context *ctx) {
       dstc++;
     }
   }
+  if (ctx->epollfd>=0) {
+    if (dsta>=1) {
+      memset(dst,0,sizeof(struct pollfd));
+      dst->fd=ctx->epollfd;
+      dst->events=POLLIN;
+    }
+    return 1;
+  }
   return dstc;
 }
 
@@ -248,6 +544,12 @@ int http_get_files(struct pollfd *dst,int dsta,struct http_context *ctx) {
  */
  
 int http_update_file(struct http_context *ctx,int fd) {
+  #if HTTP_EPOLL
+    if ((fd>=0)&&(fd==ctx->epollfd)) {
+      http_context_epoll_update(ctx,0);
+      return 0;
+    }
+  #endif
   int i=ctx->socketc;
   while (i-->0) {
     struct http_socket *sock=ctx->socketv[i];
@@ -255,6 +557,7 @@ int http_update_file(struct http_context *ctx,int fd) {
     if (http_socket_update(sock)<0) {
       ctx->socketc--;
       memmove(ctx->socketv+i,ctx->socketv+i+1,sizeof(void*)*(ctx->socketc-i));
+      http_context_salvage_requests(ctx,sock);
       http_socket_del(sock);
     }
     return 0;
@@ -301,50 +604,6 @@ struct http_websocket *http_websocket_connect(
   return sock->ws;
 }
 
-/* Handoff client request xfer to backlog.
- */
- 
-static int http_context_handoff_backlog(struct http_context *ctx,struct http_xfer *req) {
-  if (ctx->backlogc>=ctx->limits.backlog) return -1;
-  if (ctx->backlogc>=ctx->backloga) {
-    int na=ctx->backloga+16;
-    if (na>INT_MAX/sizeof(void*)) return -1;
-    void *nv=realloc(ctx->backlogv,sizeof(void*)*na);
-    if (!nv) return -1;
-    ctx->backlogv=nv;
-    ctx->backloga=na;
-  }
-  ctx->backlogv[ctx->backlogc++]=req;
-  return 0;
-}
-
-/* Handoff client request to a new socket, and register that socket.
- * Or reuse an idle socket if one exists.
- */
- 
-static struct http_socket *http_context_handoff_request(struct http_context *ctx,struct http_xfer *req,const char *url,int urlc) {
-
-  int i=ctx->socketc;
-  while (i-->0) {
-    struct http_socket *sock=ctx->socketv[i];
-    if (sock->role!=HTTP_SOCKET_ROLE_CLIENT_STREAM) continue;
-    if (sock->state!=HTTP_STREAM_STATE_IDLE) continue;
-    if (http_socket_is_defunct(sock,-1.0)) continue;
-    if (http_socket_configure_client_stream(sock,req,url,urlc)<0) return 0;
-    return sock;
-  }
-
-  if (http_context_socketv_require(ctx)<0) return 0;
-  struct http_socket *sock=http_socket_new(ctx);
-  if (!sock) return 0;
-  if (http_socket_configure_client_stream(sock,req,url,urlc)<0) {
-    http_socket_del(sock);
-    return 0;
-  }
-  ctx->socketv[ctx->socketc++]=sock;
-  return sock;
-}
-
 /* New HTTP client request.
  */
  
@@ -364,19 +623,11 @@ struct http_xfer *http_request(
     return 0;
   }
   
-  int requestc=http_context_count_requests(ctx);
-  if (requestc>=ctx->limits.requests) {
-    if (http_context_handoff_backlog(ctx,req)<0) {
-      http_xfer_del(req);
-      return 0;
-    }
-
-  } else {
-    struct http_socket *sock=http_context_handoff_request(ctx,req,url,urlc);
-    if (!sock) {
-      http_xfer_del(req);
-      return 0;
-    }
+  int err=http_context_start_request(ctx,req);
+  if (!err) err=http_context_handoff_backlog(ctx,req);
+  if (err<0) {
+    http_xfer_del(req);
+    return 0;
   }
   return req;
 }
@@ -22,6 +22,36 @@
   #include <netdb.h>
 #endif
 
+#if USE_mswin||USE_macos
+  #define HTTP_EPOLL 0
+#else
+  #define HTTP_EPOLL 1
+  #include <sys/epoll.h>
+#endif
+
+#define HTTP_EPOLL_BATCH 256
+
+#define HTTP_CHUNK_HEADER_SIZE 10 /* "XXXXXXXX\r\n": Chunk sizes always take 8 hex digits, so we can reserve space before producing. */
+
+#define HTTP_RETRY_LIMIT 3 /* Pipelined requests can get bumped more than once if the remote keeps closing. */
+
+/* Writing to a socket the remote already closed must fail, not kill the process.
+ * Reusing idle connections makes that routine: The remote may close one just as we pick it up.
+ * With SIGPIPE, we'd die before we could start the request over.
+ */
+#ifdef MSG_NOSIGNAL
+  #define HTTP_SEND_FLAGS MSG_NOSIGNAL
+#else
+  #define HTTP_SEND_FLAGS 0
+#endif
+
+#if USE_mswin||USE_macos
+  #define HTTP_SENDFILE 0
+#else
+  #define HTTP_SENDFILE 1
+  #define HTTP_SENDFILE_CHUNK (1<<20) /* Most per update, so a fast remote and a huge file don't hog the context. */
+#endif
+
 /* Context.
  ************************************************************/
 
@@ -34,8 +64,18 @@ struct http_context {
   int backlogc,backloga;
   struct pollfd *pollfdv;
   int pollfda;
+  struct http_stats stats;
+  int epollfd; // <0 if using poll.
+  #if HTTP_EPOLL
+    struct epoll_event *epeventv; // Results of the last epoll_wait, which http_socket_del may nullify.
+    int epeventp,epeventc;
+  #endif
 };
 
+/* Sockets must call this as they delete, in case we're iterating epoll results.
+ */
+void http_context_forget_socket(struct http_context *ctx,struct http_socket *sock);
+
 struct http_socket *http_context_add_server_stream(
   struct http_context *ctx,
   int rfd,
@@ -48,6 +88,11 @@ struct http_socket *http_context_socket_for_request(
   const struct http_xfer *req
 );
 
+/* Remove a client request from wherever it is, and delete it.
+ * If it's in flight, its connection closes too.
+ */
+void http_context_cancel_request(struct http_context *ctx,struct http_xfer *req);
+
 struct http_socket *http_context_socket_for_websocket(
   const struct http_context *ctx,
   const struct http_websocket *ws
@@ -85,11 +130,20 @@ struct http_socket {
   void *saddr; // struct sockaddr. Local for SERVER, remote for others.
   int saddrc;
   double activity_time;
+  int pollfd,pollevents; // What we're registered with epoll as. (pollevents) zero if unregistered.
   char *hoststr; // "HOST:PORT" for streams
   int hoststrc;
   int chunked;
   int expectc;
   int awaiting_upgrade;
+  int transactionc; // STREAM: Completed so far. Nonzero means the remote keeps connections alive.
+  int close_after; // CLIENT_STREAM: Either side said "Connection: close", or the body is unframed. Don't reuse. SERVER_STREAM: Close when the response is sent.
+  
+  /* CLIENT_STREAM: Requests pipelined behind (req), in order.
+   * The first (pipeencc) are already encoded into (wbuf), and their responses will follow (req)'s.
+   */
+  struct http_xfer **pipev;
+  int pipec,pipea,pipeencc;
   
   /* Read and write buffers.
    * When (wbufp<wbuf.c), we must write out before doing anything else.
@@ -98,6 +152,10 @@ struct http_socket {
   int rbufp;
   struct sr_encoder wbuf;
   int wbufp;
+  int sendfd; // Response body from http_xfer_set_body_file, sent after (wbuf) drains.
+  int sendp,sendc;
+  struct http_xfer *producer; // WEAK, (req) or (rsp). Body from http_xfer_set_body_producer, produced as (wbuf) drains.
+  int produceremain; // Bytes we still expect from (producer), or <0 if chunked.
   
   /* High-level context objects. These are how we communicate beyond the http unit.
    * (ws) must always be set if our role is WEBSOCKET.
@@ -123,6 +181,16 @@ int http_socket_configure_server_stream(struct http_socket *sock); // Must have
 int http_socket_configure_client_stream(struct http_socket *sock,struct http_xfer *req,const char *url,int urlc); // (req) HANDOFF
 int http_socket_configure_websocket_client(struct http_socket *sock,const char *url,int urlc);
 
+/* "HOST:PORT" as a client stream to (url) would have it in (hoststr), to find reusable connections.
+ */
+int http_socket_hoststr_for_url(char *dst,int dsta,const char *url,int urlc);
+
+/* Start another request on an idle client stream, or queue one behind the request in flight.
+ * Caller checks eligibility. (req) HANDOFF on success.
+ */
+int http_socket_reuse_client_stream(struct http_socket *sock,struct http_xfer *req);
+int http_socket_pipeline_request(struct http_socket *sock,struct http_xfer *req);
+
 /* (now<0.0) to skip timeout checks.
  */
 int http_socket_is_defunct(const struct http_socket *sock,double now);
@@ -134,11 +202,22 @@ void http_socket_force_defunct(struct http_socket *sock);
 int http_socket_preupdate(struct http_socket *sock);
 int http_socket_update(struct http_socket *sock);
 
+/* Nonzero if we have something to write, ie we should poll for writing instead of reading.
+ */
+int http_socket_wants_write(const struct http_socket *sock);
+
+/* If there's anything to write, try to write it now, without blocking.
+ * Replies generated during an update usually fit in the kernel's buffer,
+ * and then we needn't switch our epoll interest to writing and back.
+ */
+int http_socket_try_write(struct http_socket *sock);
+
 /* WebSocket.
  ***************************************************************/
  
 struct http_websocket {
   struct http_context *ctx;
+  struct http_socket *sock; // WEAK. The socket owns us, so it's always valid.
   int (*cb)(struct http_websocket *ws,int opcode,const void *v,int c);
   void *userdata;
 };
@@ -158,8 +237,20 @@ int http_websocket_encode_upgrade_request(
 struct http_xfer {
   struct http_context *ctx;
   struct sr_encoder body;
+  int bodyfd; // If >=0, (bodyfdc) bytes of this file are the body instead of (body).
+  int bodyfdc;
+  int (*produce)(struct sr_encoder *dst,void *userdata); // If set, the body comes from here instead of (body).
+  void (*produce_cleanup)(void *userdata);
+  void *produce_userdata;
+  int producec; // <0 for chunked.
+  int unframed; // Chunked producer answering HTTP/1.0: Body goes bare, and the connection closes to end it.
+  int (*consume)(struct http_xfer *req,const void *v,int c); // Client requests: Response body goes here instead.
   int (*cb)(struct http_xfer *req,struct http_xfer *rsp);
   void *userdata;
+  char *url; // Client requests only, so we can start them over.
+  int urlc;
+  int retryc; // How many times we've started it over.
+  int cancelled; // Don't start it over.
   char *topline;
   int toplinec;
   struct http_header {
@@ -174,6 +265,14 @@ void http_xfer_del(struct http_xfer *xfer);
 
 struct http_xfer *http_xfer_new(struct http_context *ctx);
 
+/* Nonzero for methods that are safe to send twice, eg after a stale connection dropped it.
+ */
+int http_xfer_is_idempotent(const struct http_xfer *xfer);
+
+/* Nonzero if header (k) is a comma-delimited list containing (token), case-insensitively. eg ("Connection","close").
+ */
+int http_xfer_header_has_token(const struct http_xfer *xfer,const char *k,int kc,const char *token,int tokenc);
+
 int http_xfer_configure_client_request(
   struct http_xfer *xfer,
   const char *method,
@@ -1,11 +1,16 @@
 #include "http_internal.h"
+#if HTTP_SENDFILE
+  #include <sys/sendfile.h>
+#endif
 
 /* Delete.
  */
 
 void http_socket_del(struct http_socket *sock) {
   if (!sock) return;
+  if (sock->ctx) http_context_forget_socket(sock->ctx,sock);
   if (sock->fd>=0) close(sock->fd);
+  if (sock->sendfd>=0) close(sock->sendfd);
   if (sock->saddr) free(sock->saddr);
   if (sock->hoststr) free(sock->hoststr);
   sr_encoder_cleanup(&sock->rbuf);
@@ -13,6 +18,10 @@ void http_socket_del(struct http_socket *sock) {
   http_websocket_del(sock->ws);
   http_xfer_del(sock->req);
   http_xfer_del(sock->rsp);
+  if (sock->pipev) {
+    while (sock->pipec-->0) http_xfer_del(sock->pipev[sock->pipec]);
+    free(sock->pipev);
+  }
   free(sock);
 }
 
@@ -25,6 +34,8 @@ struct http_socket *http_socket_new(struct http_context *ctx) {
   sock->fd=-1;
   sock->ctx=ctx;
   sock->activity_time=http_now();
+  sock->pollfd=-1;
+  sock->sendfd=-1;
   return sock;
 }
 
@@ -35,6 +46,8 @@ struct http_socket *http_socket_new_handoff(struct http_context *ctx,int fd) {
   sock->fd=fd;
   sock->ctx=ctx;
   sock->activity_time=http_now();
+  sock->pollfd=-1;
+  sock->sendfd=-1;
   return sock;
 }
 
@@ -81,6 +94,25 @@ static int http_socket_newfd_local(struct http_socket *sock,int local_only,int p
   return -1;
 }
 
+/* "HOST:PORT" for a URL.
+ * Port may be a service name, eg "http", and that's fine. Reuse only needs it consistent.
+ */
+ 
+int http_socket_hoststr_for_url(char *dst,int dsta,const char *url,int urlc) {
+  struct http_url surl={0};
+  if (http_url_split(&surl,url,urlc)<0) return -1;
+  const char *port="80";
+  int portc=2;
+  if (surl.portc>0) {
+    port=surl.port;
+    portc=surl.portc;
+  } else if (surl.schemec>0) {
+    port=surl.scheme;
+    portc=surl.schemec;
+  }
+  return snprintf(dst,dsta,"%.*s:%.*s",surl.hostc,surl.host,portc,port);
+}
+
 /* Populate (fd,saddr,hoststr) for remote hosts.
  * Do not connect.
  */
@@ -111,18 +143,15 @@ static int http_socket_newfd_remote(struct http_socket *sock,const char *url,int
   }
   
   { // Set hoststr.
-    int portstrc=0;
-    while (portstr[portstrc]) portstrc++;
-    int nc=surl.hostc+1+portstrc;
-    char *nv=malloc(nc+1);
+    char tmp[300];
+    int tmpc=http_socket_hoststr_for_url(tmp,sizeof(tmp),url,urlc);
+    if ((tmpc<1)||(tmpc>=sizeof(tmp))) return -1;
+    char *nv=malloc(tmpc+1);
     if (!nv) return -1;
-    memcpy(nv,hoststr,surl.hostc);
-    nv[surl.hostc]=':';
-    memcpy(nv+surl.hostc+1,portstr,portstrc);
-    nv[nc]=0;
+    memcpy(nv,tmp,tmpc+1);
     if (sock->hoststr) free(sock->hoststr);
     sock->hoststr=nv;
-    sock->hoststrc=nc;
+    sock->hoststrc=tmpc;
   }
   
   if (getaddrinfo(hoststr,portstr,&hints,&ai0)<0) return -1;
@@ -197,6 +226,47 @@ int http_socket_configure_client_stream(struct http_socket *sock,struct http_xfe
   return 0;
 }
 
+/* Another request on an idle client stream.
+ * If the remote has closed it, and we haven't noticed yet, fail and make it defunct.
+ */
+ 
+int http_socket_reuse_client_stream(struct http_socket *sock,struct http_xfer *req) {
+  if (sock->fd<0) return -1;
+  if (sock->role!=HTTP_SOCKET_ROLE_CLIENT_STREAM) return -1;
+  if (sock->state!=HTTP_STREAM_STATE_IDLE) return -1;
+  if (sock->req||sock->rsp) return -1;
+  char dummy;
+  int err=recv(sock->fd,&dummy,1,MSG_PEEK|MSG_DONTWAIT);
+  if ((err>=0)||((errno!=EAGAIN)&&(errno!=EWOULDBLOCK))) { // EOF, or the remote is talking out of turn.
+    http_socket_force_defunct(sock);
+    return -1;
+  }
+  sock->req=req;
+  sock->state=HTTP_STREAM_STATE_GATHER;
+  sock->chunked=0;
+  sock->expectc=0;
+  sock->activity_time=http_now();
+  return 0;
+}
+
+/* Queue a request behind the one in flight.
+ */
+ 
+int http_socket_pipeline_request(struct http_socket *sock,struct http_xfer *req) {
+  if (sock->fd<0) return -1;
+  if (sock->role!=HTTP_SOCKET_ROLE_CLIENT_STREAM) return -1;
+  if (sock->pipec>=sock->pipea) {
+    int na=sock->pipea+4;
+    if (na>INT_MAX/sizeof(void*)) return -1;
+    void *nv=realloc(sock->pipev,sizeof(void*)*na);
+    if (!nv) return -1;
+    sock->pipev=nv;
+    sock->pipea=na;
+  }
+  sock->pipev[sock->pipec++]=req;
+  return 0;
+}
+
 /* Begin client-side WebSocket.
  */
  
@@ -208,6 +278,7 @@ int http_socket_configure_websocket_client(struct http_socket *sock,const char *
   if (http_socket_newfd_remote(sock,url,urlc)<0) return -1;
   if (connect(sock->fd,(struct sockaddr*)sock->saddr,sock->saddrc)<0) return -1;
   if (!(sock->ws=http_websocket_new(sock->ctx))) return -1;
+  sock->ws->sock=sock;
   if (http_websocket_encode_upgrade_request(&sock->wbuf,sock->ws,url,urlc)<0) return -1;
   sock->role=HTTP_SOCKET_ROLE_WEBSOCKET;
   sock->awaiting_upgrade=1;
@@ -249,6 +320,26 @@ void http_socket_force_defunct(struct http_socket *sock) {
     close(sock->fd);
     sock->fd=-1;
   }
+  if (sock->sendfd>=0) {
+    close(sock->sendfd);
+    sock->sendfd=-1;
+  }
+  sock->producer=0;
+}
+
+/* Make the socket non-blocking, before we start sending a file body.
+ * sendfile() has no MSG_DONTWAIT, so this is the only way to keep a slow remote from stalling the context.
+ * The socket stays non-blocking after; reads tolerate EAGAIN.
+ */
+ 
+static int http_socket_set_nonblocking(struct http_socket *sock) {
+  #if HTTP_SENDFILE
+    int flags=fcntl(sock->fd,F_GETFL);
+    if (flags<0) return -1;
+    if (flags&O_NONBLOCK) return 0;
+    if (fcntl(sock->fd,F_SETFL,flags|O_NONBLOCK)<0) return -1;
+  #endif
+  return 0;
 }
 
 /* React to I/O error.
@@ -275,6 +366,7 @@ static int http_socket_http_error(struct http_socket *sock) {
  */
  
 static int http_socket_end_transaction(struct http_socket *sock) {
+  sock->producer=0;
   http_xfer_del(sock->req);
   http_xfer_del(sock->rsp);
   sock->req=0;
@@ -283,13 +375,44 @@ static int http_socket_end_transaction(struct http_socket *sock) {
   return 0;
 }
 
+/* Client got its response, and the caller has taken (req,rsp) off our hands.
+ * Stay connected for the next request unless somebody said not to.
+ * If there's a request pipelined behind this one, it's in flight now.
+ */
+ 
+static int http_socket_client_transaction_complete(struct http_socket *sock) {
+  sock->state=HTTP_STREAM_STATE_IDLE;
+  sock->producer=0;
+  sock->transactionc++;
+  sock->ctx->stats.completec++;
+  if (sock->close_after) {
+    http_socket_force_defunct(sock);
+    return 0;
+  }
+  if (sock->pipec>0) {
+    sock->req=sock->pipev[0];
+    sock->pipec--;
+    memmove(sock->pipev,sock->pipev+1,sizeof(void*)*sock->pipec);
+    if (sock->pipeencc>0) {
+      sock->pipeencc--;
+      sock->state=HTTP_STREAM_STATE_RCVSTATUS;
+    } else {
+      sock->state=HTTP_STREAM_STATE_GATHER;
+    }
+  }
+  return 0;
+}
+
 /* React to clearing the write buffer.
  */
  
 static int http_socket_write_complete(struct http_socket *sock) {
+  if (sock->sendfd>=0) return 0; // Still have the file body to send.
+  if (sock->producer) return 0; // Still producing the body.
   if (sock->role==HTTP_SOCKET_ROLE_SERVER_STREAM) {
     if (sock->state==HTTP_STREAM_STATE_SEND) {
       http_socket_end_transaction(sock);
+      if (sock->close_after) http_socket_force_defunct(sock);
     }
   }
   if (sock->role==HTTP_SOCKET_ROLE_CLIENT_STREAM) {
@@ -344,7 +467,10 @@ static int http_socket_deliver_HTTP_RCVSTATUS(struct http_socket *sock,const cha
 }
 
 static int http_socket_deliver_HTTP_IDLE(struct http_socket *sock,const char *src,int srcc) {
-  if ((unsigned char)src[0]>0x20) sock->state=HTTP_STREAM_STATE_RCVSTATUS;
+  if ((unsigned char)src[0]>0x20) {
+    if (sock->role==HTTP_SOCKET_ROLE_CLIENT_STREAM) return -1; // Response without a request?
+    sock->state=HTTP_STREAM_STATE_RCVSTATUS;
+  }
   return http_socket_deliver_HTTP_RCVSTATUS(sock,src,srcc);
 }
 
@@ -360,17 +486,47 @@ static int http_socket_finished_body(struct http_socket *sock) {
         if (http_socket_call_for_service(sock)<0) return -1;
       } break;
     case HTTP_SOCKET_ROLE_CLIENT_STREAM: {
-        if (sock->req->cb) {
-          int err=sock->req->cb(sock->req,sock->rsp);
-          if (err<0) return err;
-        }
-        http_socket_end_transaction(sock);
+        // Finish the transaction before calling back, so a new request from the callback can reuse this connection.
+        struct http_xfer *req=sock->req,*rsp=sock->rsp;
+        sock->req=0;
+        sock->rsp=0;
+        http_socket_client_transaction_complete(sock);
+        int err=0;
+        if (req->cb) err=req->cb(req,rsp);
+        http_xfer_del(req);
+        http_xfer_del(rsp);
+        if (err<0) return err;
       } break;
   }
   return 0;
 }
       
 
+/* Client only: Nonzero if the response can't have a body, regardless of its headers.
+ * HEAD responses in particular carry the Content-Length of the GET they stand in for.
+ * Waiting for that body stalls the connection, and once connections are reused, every request queued behind it.
+ */
+ 
+static int http_socket_response_has_no_body(const struct http_socket *sock) {
+  int status=http_xfer_get_status(sock->rsp);
+  if ((status>=100)&&(status<=199)) return 1;
+  if ((status==204)||(status==304)) return 1;
+  char method[8];
+  if ((http_xfer_get_method(method,sizeof(method),sock->req)==4)&&!memcmp(method,"HEAD",4)) return 1;
+  return 0;
+}
+
+/* Client only: Nonzero if the remote won't take another request on this connection.
+ */
+ 
+static int http_socket_response_forbids_reuse(const struct http_socket *sock) {
+  if (http_xfer_header_has_token(sock->rsp,"Connection",10,"close",5)) return 1;
+  if ((sock->rsp->toplinec>=8)&&!memcmp(sock->rsp->topline,"HTTP/1.0",8)) {
+    if (!http_xfer_header_has_token(sock->rsp,"Connection",10,"keep-alive",10)) return 1;
+  }
+  return 0;
+}
+
 /* End of headers.
  * Enter body state if necessary.
  */
@@ -379,11 +535,16 @@ static int http_socket_finished_headers(struct http_socket *sock) {
   struct http_xfer *xfer=0;
   switch (sock->role) {
     case HTTP_SOCKET_ROLE_SERVER_STREAM: xfer=sock->req; break;
-    case HTTP_SOCKET_ROLE_CLIENT_STREAM: xfer=sock->rsp; break;
+    case HTTP_SOCKET_ROLE_CLIENT_STREAM: {
+        xfer=sock->rsp;
+        if (!xfer||!sock->req) return -1;
+        if (http_socket_response_forbids_reuse(sock)) sock->close_after=1;
+        if (http_socket_response_has_no_body(sock)) return http_socket_finished_body(sock);
+      } break;
   }
   if (!xfer) return -1;
   int content_length=0;
-  http_xfer_get_header_int(&content_length,xfer,"Content-Length",14);
+  int has_length=(http_xfer_get_header_int(&content_length,xfer,"Content-Length",14)>=0);
   if (content_length>0) {
     sock->state=HTTP_STREAM_STATE_RCVBODY;
     sock->chunked=0;
@@ -398,6 +559,9 @@ static int http_socket_finished_headers(struct http_socket *sock) {
     sock->expectc=0;
     return 0;
   }
+  // No Content-Length, and not chunked, means the body runs until the remote closes.
+  // We don't read those bodies, but we do know not to reuse the connection.
+  if (!has_length&&(sock->role==HTTP_SOCKET_ROLE_CLIENT_STREAM)) sock->close_after=1;
   return http_socket_finished_body(sock);
 }
 
@@ -449,8 +613,12 @@ static int http_socket_deliver_HTTP_RCVBODY(struct http_socket *sock,const char
   if (sock->expectc) {
     int cpc=sock->expectc;
     if (cpc>srcc) cpc=srcc;
-    if (sr_encode_raw(&xfer->body,src,cpc)<0) return -1;
-    if (xfer->body.c>sock->ctx->limits.body_size) return -1;
+    if ((sock->role==HTTP_SOCKET_ROLE_CLIENT_STREAM)&&sock->req->consume) {
+      if (sock->req->consume(sock->req,src,cpc)<0) return -1;
+    } else {
+      if (sr_encode_raw(&xfer->body,src,cpc)<0) return -1;
+      if (xfer->body.c>sock->ctx->limits.body_size) return -1;
+    }
     sock->expectc-=cpc;
     if (!sock->expectc) {
       if (!sock->chunked) {
@@ -460,16 +628,20 @@ static int http_socket_deliver_HTTP_RCVBODY(struct http_socket *sock,const char
     return cpc;
   }
   if (!sock->chunked) return -1;
+  // Chunk-size line, or the empty line that ends each chunk's data.
+  // Only a size of zero ends the body; the empty line is skipped.
+  // Ending early would leave the rest of the body on the connection, to be taken for the next response.
   if ((srcc=http_measure_line(src,srcc))<1) return 0;
-  int srcp=0;
-  for (;srcp<srcc;srcp++) {
+  int srcp=0,digitc=0;
+  while ((srcp<srcc)&&((unsigned char)src[srcp]<=0x20)) srcp++;
+  for (;srcp<srcc;srcp++,digitc++) { // Stop at the first non-digit; there might be extensions after.
     int digit=sr_digit_eval(src[srcp]);
-    if ((digit>=0)&&(digit<0x10)) {
-      if (sock->expectc&0xf8000000) return -1;
-      sock->expectc<<=4;
-      sock->expectc|=digit;
-    }
+    if ((digit<0)||(digit>=0x10)) break;
+    if (sock->expectc&0xf8000000) return -1;
+    sock->expectc<<=4;
+    sock->expectc|=digit;
   }
+  if (!digitc) return srcc; // The CRLF after a chunk's data. Not a size.
   if (!sock->expectc) {
     if (http_socket_finished_body(sock)<0) return -1;
   }
@@ -565,6 +737,46 @@ static int http_socket_deliver(struct http_socket *sock,const char *src,int srcc
   return 0;
 }
 
+/* Deliver whatever's in the read buffer, as far as the current state allows.
+ */
+ 
+static int http_socket_deliver_buffered(struct http_socket *sock) {
+  while ((sock->fd>=0)&&(sock->rbufp<sock->rbuf.c)) {
+    int err=http_socket_deliver(sock,(char*)sock->rbuf.v+sock->rbufp,sock->rbuf.c-sock->rbufp);
+    if (err<0) return http_socket_delivery_error(sock);
+    if (!err) break;
+    if ((sock->rbufp+=err)>=sock->rbuf.c) {
+      sock->rbufp=0;
+      sock->rbuf.c=0;
+    }
+  }
+  return 0;
+}
+
+/* Server only: Nonzero if the request we're answering allows chunked encoding, ie it's HTTP/1.1.
+ * HTTP/1.0 clients don't know chunked, and would take the chunk headers as part of the body.
+ */
+ 
+static int http_socket_request_allows_chunked(const struct http_socket *sock) {
+  if (!sock->req) return 0;
+  if (sock->req->toplinec<8) return 0;
+  return !memcmp(sock->req->topline+sock->req->toplinec-8,"HTTP/1.1",8);
+}
+
+/* Encode an outgoing request into (wbuf).
+ */
+ 
+static int http_socket_encode_request(struct http_socket *sock,struct http_xfer *req) {
+  if (http_xfer_set_header(req,"Host",4,sock->hoststr,sock->hoststrc)<0) return -1;
+  if (http_xfer_header_has_token(req,"Connection",10,"close",5)) sock->close_after=1;
+  if (http_xfer_encode(&sock->wbuf,req)<0) return -1;
+  if (req->produce) {
+    sock->producer=req;
+    sock->produceremain=req->producec;
+  }
+  return 0;
+}
+
 /* Preupdate.
  */
  
@@ -573,9 +785,31 @@ int http_socket_preupdate(struct http_socket *sock) {
   switch (sock->role) {
   
     case HTTP_SOCKET_ROLE_SERVER_STREAM: {
+        if ((sock->state==HTTP_STREAM_STATE_IDLE)&&(sock->rbufp<sock->rbuf.c)) {
+          // Client pipelined its next request behind the one we just answered.
+          // It arrived in the same read, so there won't be another poll event to deliver it.
+          if (http_socket_deliver_buffered(sock)<0) return -1;
+        }
         if (sock->state==HTTP_STREAM_STATE_SERVE) {
           if (http_xfer_is_decoded(sock->rsp)) {
+            if (sock->rsp->produce&&(sock->rsp->producec<0)&&!http_socket_request_allows_chunked(sock)) {
+              // No length and no chunking: The body ends when we close, which every version understands.
+              sock->rsp->unframed=1;
+              if (http_xfer_set_header(sock->rsp,"Connection",10,"close",5)<0) return -1;
+              sock->close_after=1;
+            }
             if (http_xfer_encode(&sock->wbuf,sock->rsp)<0) return -1;
+            if (sock->rsp->bodyfd>=0) {
+              if (http_socket_set_nonblocking(sock)<0) return -1;
+              if (sock->sendfd>=0) close(sock->sendfd);
+              sock->sendfd=sock->rsp->bodyfd;
+              sock->sendp=0;
+              sock->sendc=sock->rsp->bodyfdc;
+              sock->rsp->bodyfd=-1;
+            } else if (sock->rsp->produce) {
+              sock->producer=sock->rsp;
+              sock->produceremain=sock->rsp->producec;
+            }
             sock->state=HTTP_STREAM_STATE_SEND;
           }
         }
@@ -583,11 +817,13 @@ int http_socket_preupdate(struct http_socket *sock) {
       
     case HTTP_SOCKET_ROLE_CLIENT_STREAM: {
         if (sock->state==HTTP_STREAM_STATE_GATHER) {
-          if (http_xfer_is_decoded(sock->req)) {
-            if (http_xfer_set_header(sock->req,"Host",4,sock->hoststr,sock->hoststrc)<0) return -1;
-            if (http_xfer_encode(&sock->wbuf,sock->req)<0) return -1;
-            sock->state=HTTP_STREAM_STATE_SEND;
-          }
+          if (!http_xfer_is_decoded(sock->req)) break;
+          if (http_socket_encode_request(sock,sock->req)<0) return -1;
+          sock->state=HTTP_STREAM_STATE_SEND;
+        }
+        while (!sock->producer&&(sock->pipeencc<sock->pipec)&&http_xfer_is_decoded(sock->pipev[sock->pipeencc])) {
+          if (http_socket_encode_request(sock,sock->pipev[sock->pipeencc])<0) return -1;
+          sock->pipeencc++;
         }
       } break;
       
@@ -595,21 +831,119 @@ int http_socket_preupdate(struct http_socket *sock) {
   return 0;
 }
 
+/* Want to write?
+ */
+ 
+int http_socket_wants_write(const struct http_socket *sock) {
+  if (sock->wbufp<sock->wbuf.c) return 1;
+  if (sock->sendfd>=0) return 1;
+  if (sock->producer) return 1;
+  return 0;
+}
+
+/* Refill (wbuf) from the body producer. Caller must drain (wbuf) first.
+ * For chunked encoding, we reserve the chunk header before producing and fill it in after.
+ */
+ 
+static int http_socket_update_producer(struct http_socket *sock) {
+  struct http_xfer *xfer=sock->producer;
+  int chunked=(sock->produceremain<0)&&!xfer->unframed;
+  int headerp=sock->wbuf.c;
+  if (chunked) {
+    if (sr_encode_raw(&sock->wbuf,"00000000\r\n",HTTP_CHUNK_HEADER_SIZE)<0) return -1;
+  }
+  int bodyp=sock->wbuf.c;
+  int err=xfer->produce(&sock->wbuf,xfer->produce_userdata);
+  if (err<0) return http_socket_io_error(sock);
+  int c=sock->wbuf.c-bodyp;
+  if (chunked) {
+    if (c>0) {
+      char tmp[HTTP_CHUNK_HEADER_SIZE+1];
+      snprintf(tmp,sizeof(tmp),"%08x\r\n",c);
+      memcpy((char*)sock->wbuf.v+headerp,tmp,HTTP_CHUNK_HEADER_SIZE);
+      if (sr_encode_raw(&sock->wbuf,"\r\n",2)<0) return -1;
+    } else {
+      sock->wbuf.c=headerp;
+    }
+    if (!err) {
+      if (sr_encode_raw(&sock->wbuf,"0\r\n\r\n",5)<0) return -1;
+    }
+  } else if (sock->produceremain>=0) {
+    if ((sock->produceremain-=c)<0) return http_socket_io_error(sock); // Produced more than it promised.
+    if (!err&&sock->produceremain) return http_socket_io_error(sock); // ...or less.
+  }
+  if (!err) {
+    sock->producer=0;
+    if (sock->wbufp>=sock->wbuf.c) return http_socket_write_complete(sock);
+  }
+  return 0;
+}
+
+/* Send some of the file body. Caller must drain (wbuf) first.
+ */
+ 
+static int http_socket_update_sendfile(struct http_socket *sock) {
+  #if HTTP_SENDFILE
+    int c=sock->sendc-sock->sendp;
+    if (c>HTTP_SENDFILE_CHUNK) c=HTTP_SENDFILE_CHUNK;
+    if (c>0) {
+      off_t offset=sock->sendp;
+      ssize_t err=sendfile(sock->fd,sock->sendfd,&offset,c);
+      if (err<0) {
+        if ((errno==EAGAIN)||(errno==EWOULDBLOCK)||(errno==EINTR)) return 0; // Kernel buffer full; finish on a later update.
+        return http_socket_io_error(sock);
+      }
+      if (!err) return http_socket_io_error(sock); // File ended before (sendc).
+      sock->activity_time=http_now();
+      sock->sendp+=err;
+    }
+    if (sock->sendp<sock->sendc) return 0;
+  #endif
+  close(sock->sendfd);
+  sock->sendfd=-1;
+  return http_socket_write_complete(sock);
+}
+
+/* Write without blocking, outside the poll cycle.
+ */
+ 
+int http_socket_try_write(struct http_socket *sock) {
+  if (sock->fd<0) return -1;
+  if (sock->wbufp>=sock->wbuf.c) return 0; // Don't run producers here; only when poll says the socket is writeable.
+  int err=send(sock->fd,(char*)sock->wbuf.v+sock->wbufp,sock->wbuf.c-sock->wbufp,MSG_DONTWAIT|HTTP_SEND_FLAGS);
+  if (err<0) {
+    if ((errno==EAGAIN)||(errno==EWOULDBLOCK)||(errno==EINTR)) return 0;
+    return http_socket_io_error(sock);
+  }
+  if (!err) return http_socket_io_error(sock);
+  sock->activity_time=http_now();
+  if ((sock->wbufp+=err)>=sock->wbuf.c) {
+    sock->wbufp=0;
+    sock->wbuf.c=0;
+    return http_socket_write_complete(sock);
+  }
+  return 0;
+}
+
 /* Update.
  */
  
 int http_socket_update(struct http_socket *sock) {
   if (sock->fd<0) return -1;
   
+  // Produce the next piece of a streaming body, and fall through to write it right away.
+  if ((sock->wbufp>=sock->wbuf.c)&&(sock->sendfd<0)&&sock->producer) {
+    if (http_socket_update_producer(sock)<0) return -1;
+    if (sock->fd<0) return 0;
+    if (sock->wbufp>=sock->wbuf.c) return 0;
+  }
+  
   if (sock->wbufp<sock->wbuf.c) {
-    int err=write(sock->fd,(char*)sock->wbuf.v+sock->wbufp,sock->wbuf.c-sock->wbufp);
-    if (err<=0) return http_socket_io_error(sock);
-    sock->activity_time=http_now();
-    if ((sock->wbufp+=err)>=sock->wbuf.c) {
-      sock->wbufp=0;
-      sock->wbuf.c=0;
-      return http_socket_write_complete(sock);
-    }
+    // Poll says writeable, but a big buffer can still fill the kernel's. Don't let one socket stall the context.
+    return http_socket_try_write(sock);
+    
+  } else if (sock->sendfd>=0) {
+    return http_socket_update_sendfile(sock);
     
   } else if (sock->role==HTTP_SOCKET_ROLE_SERVER) {
     char raddr[256];
@@ -619,25 +953,23 @@ int http_socket_update(struct http_socket *sock) {
     sock->activity_time=http_now();
     struct http_socket *stream=http_context_add_server_stream(sock->ctx,rfd,raddr,raddrc,sock);
     if (!stream) {
+      // Probably over the request limit. Turn this one away, but keep listening.
+      // Returning an error here would delete the listener, and one busy moment would take the server down.
       close(rfd);
-      return -1;
+      return 0;
     }
     
   } else {
     if (sr_encoder_require(&sock->rbuf,1024)<0) return -1;
     int err=read(sock->fd,(char*)sock->rbuf.v+sock->rbuf.c,sock->rbuf.a-sock->rbuf.c);
-    if (err<=0) return http_socket_io_error(sock);
+    if (err<0) {
+      if ((errno==EAGAIN)||(errno==EWOULDBLOCK)||(errno==EINTR)) return 0;
+      return http_socket_io_error(sock);
+    }
+    if (!err) return http_socket_io_error(sock);
     sock->activity_time=http_now();
     sock->rbuf.c+=err;
-    while (sock->rbufp<sock->rbuf.c) {
-      err=http_socket_deliver(sock,(char*)sock->rbuf.v+sock->rbufp,sock->rbuf.c-sock->rbufp);
-      if (err<0) return http_socket_delivery_error(sock);
-      if (!err) break;
-      if ((sock->rbufp+=err)>=sock->rbuf.c) {
-        sock->rbufp=0;
-        sock->rbuf.c=0;
-      }
-    }
+    return http_socket_deliver_buffered(sock);
   }
   return 0;
 }
@@ -30,15 +30,22 @@ void http_websocket_disconnect(struct http_websocket *ws) {
 }
 
 /* Send.
+ * Frames go straight onto the socket's write buffer, which is reused for the socket's life.
+ * So there's no allocation per frame, and every frame queued between polls goes out in one send.
+ * That's why there's no pooled frame allocator on this side, unlike curlwrap's outgoing queue.
+ * We own the socket: A partial write just leaves (wbufp) mid-frame, and the next write resumes at that byte.
+ * curl hands us no such buffer, so curlwrap has to keep each frame, and how much curl took of it, on its own.
  */
 
 int http_websocket_send(struct http_websocket *ws,int opcode,const void *v,int c) {
   if (c<0) return -1;
   struct http_socket *sock=http_context_socket_for_websocket(ws->ctx,ws);
   if (!sock) return -1;
+  if (c>INT_MAX-10) return -1;
+  if (sr_encoder_require(&sock->wbuf,10+c)<0) return -1;
   
   // Preamble can go up to 10 bytes.
-  char preamble[10];
+  char *preamble=(char*)sock->wbuf.v+sock->wbuf.c;
   int preamblec=0;
   preamble[preamblec++]=0x80|(opcode&0x0f); // 0x80=terminator, we don't allow continued packets.
   if (c<0x7e) { // short
@@ -58,8 +65,8 @@ int http_websocket_send(struct http_websocket *ws,int opcode,const void *v,int c
     preamble[preamblec++]=c>>8;
     preamble[preamblec++]=c;
   }
-  if (sr_encode_raw(&sock->wbuf,preamble,preamblec)<0) return -1;
-  if (sr_encode_raw(&sock->wbuf,v,c)<0) return -1;
+  if (c) memcpy(preamble+preamblec,v,c);
+  sock->wbuf.c+=preamblec+c;
 
   return 0;
 }
@@ -147,6 +154,7 @@ struct http_websocket *http_websocket_check_upgrade(struct http_xfer *req,struct
       http_socket_force_defunct(sock);
       return 0;
     }
+    sock->ws->sock=sock;
     // Probably we ought to capture some things from the request and store on sock->ws.
   }
   
@@ -10,6 +10,9 @@ static void http_header_cleanup(struct http_header *header) {
 void http_xfer_del(struct http_xfer *xfer) {
   if (!xfer) return;
   sr_encoder_cleanup(&xfer->body);
+  if (xfer->bodyfd>=0) close(xfer->bodyfd);
+  if (xfer->produce_cleanup) xfer->produce_cleanup(xfer->produce_userdata);
+  if (xfer->url) free(xfer->url);
   if (xfer->topline) free(xfer->topline);
   if (xfer->headerv) {
     while (xfer->headerc-->0) http_header_cleanup(xfer->headerv+xfer->headerc);
@@ -25,6 +28,7 @@ struct http_xfer *http_xfer_new(struct http_context *ctx) {
   struct http_xfer *xfer=calloc(1,sizeof(struct http_xfer));
   if (!xfer) return 0;
   xfer->ctx=ctx;
+  xfer->bodyfd=-1;
   return xfer;
 }
 
@@ -39,11 +43,16 @@ int http_xfer_configure_client_request(
   void *userdata
 ) {
   struct http_url surl={0};
+  if (!url) urlc=0; else if (urlc<0) { urlc=0; while (url[urlc]) urlc++; }
   if (http_url_split(&surl,url,urlc)<0) return -1;
   char tmp[1024];
   int tmpc=snprintf(tmp,sizeof(tmp),"%s %.*s HTTP/1.1",method,surl.pathc+surl.queryc,surl.path);
   if ((tmpc<1)||(tmpc>=sizeof(tmp))) return -1;
   if (http_xfer_set_topline(xfer,tmp,tmpc)<0) return -1;
+  if (!(xfer->url=malloc(urlc+1))) return -1;
+  memcpy(xfer->url,url,urlc);
+  xfer->url[urlc]=0;
+  xfer->urlc=urlc;
   xfer->cb=cb;
   xfer->userdata=userdata;
   return 0;
@@ -53,9 +62,8 @@ int http_xfer_configure_client_request(
  */
 
 void http_request_cancel(struct http_xfer *req) {
-  struct http_socket *sock=http_context_socket_for_request(req->ctx,req);
-  if (!sock) return;
-  http_socket_force_defunct(sock);
+  if (!req) return;
+  http_context_cancel_request(req->ctx,req);
 }
 
 /* Trivial accessors.
@@ -95,6 +103,70 @@ struct sr_encoder *http_xfer_get_body(struct http_xfer *xfer) {
   return &xfer->body;
 }
 
+/* Body from file.
+ */
+ 
+int http_xfer_set_body_file(struct http_xfer *xfer,int fd,int c) {
+  if (fd<0) return -1;
+  if (xfer->bodyfd>=0) close(xfer->bodyfd);
+  xfer->bodyfd=-1;
+  xfer->bodyfdc=0;
+  xfer->body.c=0;
+  if (c<0) {
+    close(fd);
+    return -1;
+  }
+  #if HTTP_SENDFILE
+    xfer->bodyfd=fd;
+    xfer->bodyfdc=c;
+    return 0;
+  #else
+    if (sr_encoder_require(&xfer->body,c)<0) {
+      close(fd);
+      return -1;
+    }
+    while (xfer->body.c<c) {
+      int err=read(fd,(char*)xfer->body.v+xfer->body.c,c-xfer->body.c);
+      if (err<=0) {
+        close(fd);
+        xfer->body.c=0;
+        return -1;
+      }
+      xfer->body.c+=err;
+    }
+    close(fd);
+    return 0;
+  #endif
+}
+
+/* Streaming bodies.
+ */
+ 
+int http_xfer_set_body_producer(
+  struct http_xfer *xfer,
+  int c,
+  int (*produce)(struct sr_encoder *dst,void *userdata),
+  void (*cleanup)(void *userdata),
+  void *userdata
+) {
+  if (!produce) return -1;
+  if (xfer->produce_cleanup) xfer->produce_cleanup(xfer->produce_userdata);
+  if (xfer->bodyfd>=0) close(xfer->bodyfd);
+  xfer->bodyfd=-1;
+  xfer->bodyfdc=0;
+  xfer->body.c=0;
+  xfer->produce=produce;
+  xfer->produce_cleanup=cleanup;
+  xfer->produce_userdata=userdata;
+  xfer->producec=(c<0)?-1:c;
+  return 0;
+}
+
+int http_xfer_set_body_consumer(struct http_xfer *req,int (*consume)(struct http_xfer *req,const void *v,int c)) {
+  req->consume=consume;
+  return 0;
+}
+
 /* Topline conveniences.
  */
  
@@ -112,6 +184,18 @@ int http_xfer_get_method(char *dst,int dsta,const struct http_xfer *xfer) {
   return srcc;
 }
 
+int http_xfer_is_idempotent(const struct http_xfer *xfer) {
+  char method[8];
+  int methodc=http_xfer_get_method(method,sizeof(method),xfer);
+  switch (methodc) {
+    case 3: return !memcmp(method,"GET",3)||!memcmp(method,"PUT",3);
+    case 4: return !memcmp(method,"HEAD",4);
+    case 6: return !memcmp(method,"DELETE",6);
+    case 7: return !memcmp(method,"OPTIONS",7);
+  }
+  return 0;
+}
+
 int http_xfer_get_path(void *dstpp,const struct http_xfer *xfer) {
   const char *src=xfer->topline;
   int srcc=xfer->toplinec;
@@ -285,6 +369,21 @@ int http_xfer_get_header_int(int *v,const struct http_xfer *xfer,const char *k,i
   return 0;
 }
 
+int http_xfer_header_has_token(const struct http_xfer *xfer,const char *k,int kc,const char *token,int tokenc) {
+  const char *src=0;
+  int srcc=http_xfer_get_header(&src,xfer,k,kc);
+  int srcp=0;
+  while (srcp<srcc) {
+    if (((unsigned char)src[srcp]<=0x20)||(src[srcp]==',')) { srcp++; continue; }
+    const char *q=src+srcp;
+    int qc=0;
+    while ((srcp<srcc)&&(src[srcp]!=',')) { srcp++; qc++; }
+    while (qc&&((unsigned char)q[qc-1]<=0x20)) qc--;
+    if ((qc==tokenc)&&!sr_memcasecmp(q,token,tokenc)) return 1;
+  }
+  return 0;
+}
+
 /* Iterate query params.
  */
  
@@ -393,6 +492,20 @@ int http_xfer_encode(struct sr_encoder *dst,const struct http_xfer *xfer) {
     if (sr_encode_raw(dst,header->v,header->c)<0) return -1;
     if (sr_encode_raw(dst,"\r\n",2)<0) return -1;
   }
+  if (xfer->bodyfd>=0) { // Caller is responsible for sending the file.
+    if (sr_encode_fmt(dst,"Content-Length: %d\r\n\r\n",xfer->bodyfdc)<0) return -1;
+    return 0;
+  }
+  if (xfer->produce) { // Caller is responsible for running the producer.
+    if (xfer->unframed) {
+      if (sr_encode_raw(dst,"\r\n",2)<0) return -1;
+    } else if (xfer->producec<0) {
+      if (sr_encode_raw(dst,"Transfer-Encoding: chunked\r\n\r\n",-1)<0) return -1;
+    } else {
+      if (sr_encode_fmt(dst,"Content-Length: %d\r\n\r\n",xfer->producec)<0) return -1;
+    }
+    return 0;
+  }
   if (sr_encode_fmt(dst,"Content-Length: %d\r\n",xfer->body.c)<0) return -1;
   if (sr_encode_raw(dst,"\r\n",2)<0) return -1;
   if (sr_encode_raw(dst,xfer->body.v,xfer->body.c)<0) return -1;
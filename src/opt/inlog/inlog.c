@@ -0,0 +1,188 @@
+#include "inlog.h"
+#include "egg/egg.h"
+#include <string.h>
+
+#define INLOG_FRAME_SAME 0x01
+#define INLOG_FRAME      0x02
+#define INLOG_EVENTS     0x03
+#define INLOG_END        0x04
+
+#define INLOG_EVENT_SIZE 17
+#define INLOG_END_SIZE 9
+
+/* Primitives.
+ */
+
+static double inlog_decode_f64(const uint8_t *src) {
+  uint64_t bits=0;
+  int i=8; while (i-->0) bits=(bits<<8)|src[i];
+  double v;
+  memcpy(&v,&bits,8);
+  return v;
+}
+
+static int inlog_encode_f64(struct sr_encoder *dst,double v) {
+  uint64_t bits;
+  memcpy(&bits,&v,8);
+  uint8_t tmp[8];
+  int i=0; for (;i<8;i++,bits>>=8) tmp[i]=bits;
+  return sr_encode_raw(dst,tmp,8);
+}
+
+static int inlog_decode_s32(const uint8_t *src) {
+  return (int32_t)(src[0]|(src[1]<<8)|(src[2]<<16)|((uint32_t)src[3]<<24));
+}
+
+/* Writer.
+ */
+
+void inlog_writer_cleanup(struct inlog_writer *writer) {
+  sr_encoder_cleanup(&writer->dst);
+}
+
+int inlog_writer_init(struct inlog_writer *writer) {
+  memset(writer,0,sizeof(struct inlog_writer));
+  writer->prevelapsed=-1.0;
+  return sr_encode_raw(&writer->dst,"\0EIR",4);
+}
+
+int inlog_write_frame(struct inlog_writer *writer,double elapsed) {
+  if (writer->framec&&(elapsed==writer->prevelapsed)) {
+    if (sr_encode_u8(&writer->dst,INLOG_FRAME_SAME)<0) return -1;
+  } else {
+    if (sr_encode_u8(&writer->dst,INLOG_FRAME)<0) return -1;
+    if (inlog_encode_f64(&writer->dst,elapsed)<0) return -1;
+    writer->prevelapsed=elapsed;
+  }
+  writer->framec++;
+  return 0;
+}
+
+int inlog_write_events(struct inlog_writer *writer,const struct egg_event *eventv,int eventc) {
+  while (eventc>0) {
+    int c=(eventc>0xff)?0xff:eventc;
+    if (sr_encode_u8(&writer->dst,INLOG_EVENTS)<0) return -1;
+    if (sr_encode_u8(&writer->dst,c)<0) return -1;
+    int i=c;
+    for (;i-->0;eventv++) {
+      if (sr_encode_u8(&writer->dst,eventv->type)<0) return -1;
+      if (sr_encode_intle(&writer->dst,eventv->v[0],4)<0) return -1;
+      if (sr_encode_intle(&writer->dst,eventv->v[1],4)<0) return -1;
+      if (sr_encode_intle(&writer->dst,eventv->v[2],4)<0) return -1;
+      if (sr_encode_intle(&writer->dst,eventv->v[3],4)<0) return -1;
+    }
+    eventc-=c;
+    writer->eventc+=c;
+  }
+  return 0;
+}
+
+int inlog_writer_finish(struct inlog_writer *writer) {
+  if (sr_encode_u8(&writer->dst,INLOG_END)<0) return -1;
+  if (sr_encode_intle(&writer->dst,writer->framec,4)<0) return -1;
+  if (sr_encode_intle(&writer->dst,writer->eventc,4)<0) return -1;
+  return 0;
+}
+
+/* Reader init: Walk the whole log once. After this, reads can't fail.
+ */
+
+int inlog_reader_init(struct inlog_reader *reader,const void *src,int srcc) {
+  memset(reader,0,sizeof(struct inlog_reader));
+  if (!src||(srcc<4)||memcmp(src,"\0EIR",4)) return -1;
+  const uint8_t *SRC=src;
+  int srcp=4,framec=0,eventc=0;
+  for (;;) {
+    if (srcp>=srcc) return -1; // No END: truncated.
+    uint8_t opcode=SRC[srcp++];
+    switch (opcode) {
+      case INLOG_FRAME_SAME: {
+          if (!framec) return -1;
+          framec++;
+        } break;
+      case INLOG_FRAME: {
+          if (srcp>srcc-8) return -1;
+          srcp+=8;
+          framec++;
+        } break;
+      case INLOG_EVENTS: {
+          if (srcp>=srcc) return -1;
+          int c=SRC[srcp++];
+          if (srcp>srcc-c*INLOG_EVENT_SIZE) return -1;
+          srcp+=c*INLOG_EVENT_SIZE;
+          eventc+=c;
+        } break;
+      case INLOG_END: {
+          if (srcp!=srcc-8) return -1; // END must be last.
+          if (inlog_decode_s32(SRC+srcp)!=framec) return -1;
+          if (inlog_decode_s32(SRC+srcp+4)!=eventc) return -1;
+          reader->src=SRC;
+          reader->srcc=srcc-INLOG_END_SIZE; // Readers stop at END.
+          reader->srcp=4;
+          reader->framelimit=framec;
+          reader->eventlimit=eventc;
+          return framec;
+        }
+      default: return -1;
+    }
+  }
+}
+
+/* Advance to next frame.
+ */
+
+int inlog_read_frame(double *elapsed,struct inlog_reader *reader) {
+  reader->srcp+=reader->eventc*INLOG_EVENT_SIZE;
+  reader->eventc=0;
+  while (reader->srcp<reader->srcc) {
+    uint8_t opcode=reader->src[reader->srcp++];
+    switch (opcode) {
+      case INLOG_FRAME_SAME: {
+          reader->framec++;
+          *elapsed=reader->elapsed;
+          return 1;
+        }
+      case INLOG_FRAME: {
+          reader->elapsed=inlog_decode_f64(reader->src+reader->srcp);
+          reader->srcp+=8;
+          reader->framec++;
+          *elapsed=reader->elapsed;
+          return 1;
+        }
+      case INLOG_EVENTS: {
+          int c=reader->src[reader->srcp++];
+          reader->srcp+=c*INLOG_EVENT_SIZE;
+        } break;
+    }
+  }
+  return 0;
+}
+
+/* Read events.
+ */
+
+int inlog_read_events(struct egg_event *eventv,int eventa,struct inlog_reader *reader) {
+  int eventc=0;
+  while (eventc<eventa) {
+    if (!reader->eventc) {
+      // Enter the next EVENTS command if there is one before the next frame.
+      if (reader->srcp>=reader->srcc) break;
+      if (reader->src[reader->srcp]!=INLOG_EVENTS) break;
+      reader->eventc=reader->src[reader->srcp+1];
+      reader->srcp+=2;
+      continue;
+    }
+    const uint8_t *src=reader->src+reader->srcp;
+    eventv->type=src[0];
+    eventv->v[0]=inlog_decode_s32(src+1);
+    eventv->v[1]=inlog_decode_s32(src+5);
+    eventv->v[2]=inlog_decode_s32(src+9);
+    eventv->v[3]=inlog_decode_s32(src+13);
+    eventv++;
+    eventc++;
+    reader->srcp+=INLOG_EVENT_SIZE;
+    reader->eventc--;
+  }
+  reader->eventtotal+=eventc;
+  return eventc;
+}
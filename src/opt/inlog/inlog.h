@@ -0,0 +1,68 @@
+/* inlog.h
+ * Required: serial
+ *
+ * Input log, for the native runtime's --record and --replay.
+ * Events delivered to the client, and the (elapsed) passed to each egg_client_update.
+ *
+ * File format:
+ *   4 Signature: "\0EIR"
+ *   ... Commands, distinguished by leading byte:
+ *     0x01 FRAME_SAME: New frame, same elapsed time as the previous one.
+ *     0x02 FRAME: f64 elapsed (raw, little-endian). New frame.
+ *     0x03 EVENTS: u8 count, then (count) of: u8 type, s32le v[4]
+ *     0x04 END: u32le frame count, u32le event count. Must be the last thing in the file.
+ * Events belong to the most recent frame, or to init if there isn't one yet.
+ * FRAME_SAME may not precede the first FRAME.
+ * The END command is how we know the log is complete: A truncated log is rejected, even if it breaks between commands.
+ */
+
+#ifndef INLOG_H
+#define INLOG_H
+
+#include <stdint.h>
+#include "opt/serial/serial.h"
+
+struct egg_event;
+
+/* Writer.
+ * Encodes into memory as we go; (dst) is the complete log after inlog_writer_finish.
+ */
+struct inlog_writer {
+  struct sr_encoder dst;
+  double prevelapsed;
+  int framec,eventc;
+};
+
+void inlog_writer_cleanup(struct inlog_writer *writer);
+int inlog_writer_init(struct inlog_writer *writer);
+int inlog_write_frame(struct inlog_writer *writer,double elapsed);
+int inlog_write_events(struct inlog_writer *writer,const struct egg_event *eventv,int eventc);
+int inlog_writer_finish(struct inlog_writer *writer);
+
+/* Reader.
+ * We borrow (src), caller must keep it alive.
+ */
+struct inlog_reader {
+  const uint8_t *src;
+  int srcc,srcp;
+  int eventc; // Remaining in the current EVENTS command, which (srcp) points into.
+  double elapsed;
+  int framec,eventtotal; // Read so far.
+  int framelimit,eventlimit; // Totals, from END.
+};
+
+/* Validate the entire log and prepare to read from the start.
+ * Returns the frame count, or <0 if it's not an input log, malformed, or truncated.
+ */
+int inlog_reader_init(struct inlog_reader *reader,const void *src,int srcc);
+
+/* Advance to the next frame, skipping any events of the current one that weren't read.
+ * Returns 1 and sets (*elapsed), or 0 at the end of the log.
+ */
+int inlog_read_frame(double *elapsed,struct inlog_reader *reader);
+
+/* Read up to (eventa) events from the current frame.
+ */
+int inlog_read_events(struct egg_event *eventv,int eventa,struct inlog_reader *reader);
+
+#endif
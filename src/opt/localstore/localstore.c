@@ -1,110 +1,227 @@
-#include "localstore.h"
-#include "opt/fs/fs.h"
-#include "opt/serial/serial.h"
-#include <stdlib.h>
-#include <string.h>
-#include <limits.h>
-#include <stdio.h>
+#include "localstore_internal.h"
+#include <zlib.h>
 
 /* Cleanup.
  */
  
-static void localstore_entry_cleanup(struct localstore_entry *entry) {
-  if (entry->k) free(entry->k);
-  if (entry->v) free(entry->v);
-}
- 
 void localstore_cleanup(struct localstore *localstore) {
   if (!localstore) return;
-  if (localstore->entryv) {
-    while (localstore->entryc-->0) {
-      localstore_entry_cleanup(localstore->entryv+localstore->entryc);
-    }
-    free(localstore->entryv);
-  }
+  localstore_journal_del(localstore->journal);
+  if (localstore->entryv) free(localstore->entryv);
+  if (localstore->hashv) free(localstore->hashv);
+  if (localstore->arena) free(localstore->arena);
+  if (localstore->orderv) free(localstore->orderv);
   memset(localstore,0,sizeof(struct localstore));
 }
 
-/* Search.
+/* Drop all content, keep allocations.
  */
  
-static int localstore_search(const struct localstore *localstore,const char *k,int kc) {
-  int lo=0,hi=localstore->entryc;
-  while (lo<hi) {
-    int ck=(lo+hi)>>1;
-    const struct localstore_entry *entry=localstore->entryv+ck;
-         if (kc<entry->kc) hi=ck;
-    else if (kc>entry->kc) lo=ck+1;
-    else {
-      int cmp=memcmp(k,entry->k,kc);
-           if (cmp<0) hi=ck;
-      else if (cmp>0) lo=ck+1;
-      else return ck;
+static void localstore_clear(struct localstore *localstore) {
+  localstore->entryc=0;
+  localstore->arenac=0;
+  localstore->arenagarbage=0;
+  localstore->order_dirty=1;
+  if (localstore->hashv) memset(localstore->hashv,0,sizeof(int)*localstore->hasha);
+}
+
+/* Hash index.
+ * Open addressing with linear probing. Each slot is an index in (entryv) plus one, or zero if vacant.
+ * We keep the load factor at or below 1/2, and delete by shifting back, so there are no tombstones.
+ */
+ 
+static uint32_t localstore_hash(const char *k,int kc) {
+  uint32_t h=0x811c9dc5;
+  for (;kc-->0;k++) {
+    h^=(uint8_t)*k;
+    h*=0x01000193;
+  }
+  return h;
+}
+
+// Slot holding (k), or the vacant slot where it would go.
+static int localstore_hash_slot(const struct localstore *localstore,const char *k,int kc) {
+  int mask=localstore->hasha-1;
+  int slot=localstore_hash(k,kc)&mask;
+  for (;;slot=(slot+1)&mask) {
+    int p=localstore->hashv[slot];
+    if (!p) return slot;
+    const struct localstore_entry *entry=localstore->entryv+p-1;
+    if ((entry->kc==kc)&&!memcmp(localstore->arena+entry->kp,k,kc)) return slot;
+  }
+}
+
+static int localstore_hash_slot_for_entry(const struct localstore *localstore,int p) {
+  const struct localstore_entry *entry=localstore->entryv+p;
+  return localstore_hash_slot(localstore,localstore->arena+entry->kp,entry->kc);
+}
+
+static int localstore_hash_require(struct localstore *localstore) {
+  if (localstore->entryc<localstore->hasha>>1) return 0;
+  int na=localstore->hasha?(localstore->hasha<<1):64;
+  if (na>INT_MAX/sizeof(int)) return -1;
+  int *nv=calloc(na,sizeof(int));
+  if (!nv) return -1;
+  if (localstore->hashv) free(localstore->hashv);
+  localstore->hashv=nv;
+  localstore->hasha=na;
+  int p=0; for (;p<localstore->entryc;p++) {
+    localstore->hashv[localstore_hash_slot_for_entry(localstore,p)]=p+1;
+  }
+  return 0;
+}
+
+static void localstore_hash_vacate(struct localstore *localstore,int slot) {
+  int mask=localstore->hasha-1;
+  localstore->hashv[slot]=0;
+  int next=(slot+1)&mask;
+  for (;localstore->hashv[next];next=(next+1)&mask) {
+    // Move back anything whose probe would now stop short at the hole.
+    int p=localstore->hashv[next]-1;
+    const struct localstore_entry *entry=localstore->entryv+p;
+    int home=localstore_hash(localstore->arena+entry->kp,entry->kc)&mask;
+    int hole_before_next=(next-slot)&mask;
+    int home_before_next=(next-home)&mask;
+    if (home_before_next>=hole_before_next) {
+      localstore->hashv[slot]=p+1;
+      localstore->hashv[next]=0;
+      slot=next;
     }
   }
-  return -lo-1;
+}
+
+/* Arena.
+ * Keys and values live here, each followed by a NUL.
+ * Replacing a value with a longer one abandons the old bytes; we reclaim them at compaction.
+ * Callers may hand us keys and values that point into the arena, eg set(k2,get(k1)).
+ * So set reserves everything it might append up front, and re-points (k,v) if that moved the arena.
+ * After that, nothing moves until the set is done.
+ */
+ 
+static int localstore_arena_require(struct localstore *localstore,int addc) {
+  if (localstore->arenac>INT_MAX-addc) return -1;
+  if (localstore->arenac+addc<=localstore->arenaa) return 0;
+  int na=localstore->arenac+addc;
+  if (na<INT_MAX-4096) na=(na+4096)&~4095;
+  void *nv=realloc(localstore->arena,na);
+  if (!nv) return -1;
+  localstore->arena=nv;
+  localstore->arenaa=na;
+  return 0;
+}
+ 
+// Offset of (src) in the arena, or -1 if it's from somewhere else.
+static int localstore_arena_offset(const struct localstore *localstore,const char *src) {
+  if (!src||!localstore->arena) return -1;
+  if ((src<localstore->arena)||(src>=localstore->arena+localstore->arenac)) return -1;
+  return src-localstore->arena;
+}
+ 
+static int localstore_arena_append(struct localstore *localstore,const char *src,int srcc) {
+  if (localstore_arena_require(localstore,srcc+1)<0) return -1;
+  int p=localstore->arenac;
+  memcpy(localstore->arena+p,src,srcc);
+  localstore->arena[p+srcc]=0;
+  localstore->arenac+=srcc+1;
+  return p;
+}
+
+/* Rewrite the arena with only live content, if it's at least half garbage.
+ */
+ 
+void localstore_compact_arena(struct localstore *localstore) {
+  if (localstore->arenagarbage<LOCALSTORE_ARENA_GARBAGE_MIN) return;
+  if (localstore->arenagarbage<localstore->arenac>>1) return;
+  int na=localstore->arenac-localstore->arenagarbage;
+  if (na<1) na=1;
+  char *nv=malloc(na);
+  if (!nv) return;
+  int nc=0;
+  struct localstore_entry *entry=localstore->entryv;
+  int i=localstore->entryc;
+  for (;i-->0;entry++) {
+    memcpy(nv+nc,localstore->arena+entry->kp,entry->kc+1);
+    entry->kp=nc;
+    nc+=entry->kc+1;
+    memcpy(nv+nc,localstore->arena+entry->vp,entry->vc+1);
+    entry->vp=nc;
+    nc+=entry->vc+1;
+  }
+  free(localstore->arena);
+  localstore->arena=nv;
+  localstore->arenac=nc;
+  localstore->arenaa=na;
+  localstore->arenagarbage=0;
 }
 
 /* Insert.
+ * Caller has already made room in the hash, and found the vacant (slot).
  */
  
-static int localstore_insert(struct localstore *localstore,int p,const char *k,int kc,const char *v,int vc) {
+static int localstore_insert(struct localstore *localstore,int slot,const char *k,int kc,const char *v,int vc) {
   if ((kc<1)||(kc>0xff)) return -1;
   if ((vc<1)||(vc>0xffff)) return -1;
-  if ((p<0)||(p>localstore->entryc)) return -1;
   if (localstore->entryc>=localstore->entrya) {
-    int na=localstore->entrya+16;
+    int na=localstore->entrya+64;
     if (na>INT_MAX/sizeof(struct localstore_entry)) return -1;
     void *nv=realloc(localstore->entryv,sizeof(struct localstore_entry)*na);
     if (!nv) return -1;
     localstore->entryv=nv;
     localstore->entrya=na;
   }
-  char *nk=malloc(kc+1);
-  if (!nk) return -1;
-  memcpy(nk,k,kc);
-  nk[kc]=0;
-  char *nv=malloc(vc+1);
-  if (!nv) { free(nk); return -1; }
-  memcpy(nv,v,vc);
-  nv[vc]=0;
+  int kp=localstore_arena_append(localstore,k,kc);
+  if (kp<0) return -1;
+  int vp=localstore_arena_append(localstore,v,vc);
+  if (vp<0) return -1;
+  int p=localstore->entryc++;
   struct localstore_entry *entry=localstore->entryv+p;
-  memmove(entry+1,entry,sizeof(struct localstore_entry)*(localstore->entryc-p));
-  localstore->entryc++;
-  entry->k=nk;
+  entry->kp=kp;
   entry->kc=kc;
-  entry->v=nv;
+  entry->vp=vp;
   entry->vc=vc;
-  localstore->dirty=1;
+  localstore->hashv[slot]=p+1;
+  localstore->order_dirty=1;
   return 0;
 }
 
 /* Replace value.
  */
  
-static int localstore_entry_replace(struct localstore_entry *entry,const char *v,int vc) {
+static int localstore_entry_replace(struct localstore *localstore,int p,const char *v,int vc) {
   if ((vc<1)||(vc>0xffff)) return -1;
-  if (vc>entry->vc) {
-    char *nv=realloc(entry->v,vc+1);
-    if (!nv) return -1;
-    entry->v=nv;
+  struct localstore_entry *entry=localstore->entryv+p;
+  if (vc<=entry->vc) {
+    memmove(localstore->arena+entry->vp,v,vc); // (v) might be this same value, or overlap it.
+    localstore->arena[entry->vp+vc]=0;
+    localstore->arenagarbage+=entry->vc-vc;
+  } else {
+    int vp=localstore_arena_append(localstore,v,vc);
+    if (vp<0) return -1;
+    entry=localstore->entryv+p;
+    localstore->arenagarbage+=entry->vc+1;
+    entry->vp=vp;
   }
-  memcpy(entry->v,v,vc);
-  entry->v[vc]=0;
   entry->vc=vc;
   return 0;
 }
 
 /* Remove entry.
+ * The last entry moves into its place, so (entryv) stays dense.
  */
  
-static void localstore_remove(struct localstore *localstore,int p) {
-  if ((p<0)||(p>=localstore->entryc)) return;
+static void localstore_remove(struct localstore *localstore,int slot) {
+  int p=localstore->hashv[slot]-1;
   struct localstore_entry *entry=localstore->entryv+p;
-  localstore_entry_cleanup(entry);
+  localstore->arenagarbage+=entry->kc+1+entry->vc+1;
+  localstore_hash_vacate(localstore,slot);
+  int lastp=localstore->entryc-1;
+  if (p<lastp) {
+    int lastslot=localstore_hash_slot_for_entry(localstore,lastp);
+    *entry=localstore->entryv[lastp];
+    localstore->hashv[lastslot]=p+1;
+  }
   localstore->entryc--;
-  memmove(entry,entry+1,sizeof(struct localstore_entry)*(localstore->entryc-p));
-  localstore->dirty=1;
+  localstore->order_dirty=1;
 }
 
 /* Get.
@@ -113,13 +230,73 @@ static void localstore_remove(struct localstore *localstore,int p) {
 int localstore_get(const char **dstpp,const struct localstore *localstore,const char *k,int kc) {
   if (!k) return 0;
   if (kc<0) { kc=0; while (k[kc]) kc++; }
-  int p=localstore_search(localstore,k,kc);
+  if (!localstore->entryc) return 0;
+  int p=localstore->hashv[localstore_hash_slot(localstore,k,kc)]-1;
   if (p<0) return 0;
   const struct localstore_entry *entry=localstore->entryv+p;
-  if (dstpp) *dstpp=entry->v;
+  if (dstpp) *dstpp=localstore->arena+entry->vp;
   return entry->vc;
 }
 
+/* Keys in order.
+ * Same order as when we kept (entryv) sorted: By length, then bytewise.
+ * Rebuilt only on demand, so iterating keys costs one sort per change, not one per key.
+ */
+ 
+static int localstore_keycmp(const struct localstore *localstore,int a,int b) {
+  const struct localstore_entry *A=localstore->entryv+a;
+  const struct localstore_entry *B=localstore->entryv+b;
+  if (A->kc<B->kc) return -1;
+  if (A->kc>B->kc) return 1;
+  return memcmp(localstore->arena+A->kp,localstore->arena+B->kp,A->kc);
+}
+
+// Bottom-up merge sort of (orderv), using (tmp) as scratch. Returns the one of those containing the result.
+static int *localstore_sort_order(const struct localstore *localstore,int *orderv,int *tmp,int c) {
+  int *src=orderv,*dst=tmp;
+  int w=1; for (;w<c;w<<=1) {
+    int lo=0; for (;lo<c;lo+=w<<1) {
+      int mid=lo+w; if (mid>c) mid=c;
+      int hi=mid+w; if (hi>c) hi=c;
+      int a=lo,b=mid,d=lo;
+      while ((a<mid)&&(b<hi)) {
+        if (localstore_keycmp(localstore,src[b],src[a])<0) dst[d++]=src[b++];
+        else dst[d++]=src[a++];
+      }
+      while (a<mid) dst[d++]=src[a++];
+      while (b<hi) dst[d++]=src[b++];
+    }
+    int *swap=src; src=dst; dst=swap;
+  }
+  return src;
+}
+
+static int localstore_require_order(struct localstore *localstore) {
+  if (!localstore->order_dirty) return 0;
+  int c=localstore->entryc;
+  if (c>localstore->ordera) {
+    if (c>INT_MAX/(sizeof(int)*2)) return -1;
+    int *nv=realloc(localstore->orderv,sizeof(int)*2*c);
+    if (!nv) return -1;
+    localstore->orderv=nv;
+    localstore->ordera=c;
+  }
+  int *orderv=localstore->orderv,*tmp=orderv+localstore->ordera;
+  int i=0; for (;i<c;i++) orderv[i]=i;
+  int *sorted=localstore_sort_order(localstore,orderv,tmp,c);
+  if (sorted!=orderv) memcpy(orderv,sorted,sizeof(int)*c);
+  localstore->order_dirty=0;
+  return 0;
+}
+
+int localstore_key_by_index(const char **dstpp,struct localstore *localstore,int index) {
+  if ((index<0)||(index>=localstore->entryc)) return 0;
+  if (localstore_require_order(localstore)<0) return 0;
+  const struct localstore_entry *entry=localstore->entryv+localstore->orderv[index];
+  if (dstpp) *dstpp=localstore->arena+entry->kp;
+  return entry->kc;
+}
+
 /* Set.
  */
  
@@ -127,19 +304,118 @@ int localstore_set(struct localstore *localstore,const char *k,int kc,const char
   if (!k) return -1;
   if (kc<0) { kc=0; while (k[kc]) kc++; }
   if (!v) vc=0; else if (vc<0) { vc=0; while (v[vc]) vc++; }
-  int p=localstore_search(localstore,k,kc);
+  if (!kc) return vc?-1:0;
+  if ((kc>0xff)||(vc>0xffff)) return -1;
+  if (localstore_hash_require(localstore)<0) return -1;
+  int kfrom=localstore_arena_offset(localstore,k);
+  int vfrom=localstore_arena_offset(localstore,v);
+  if (localstore_arena_require(localstore,kc+1+vc+1)<0) return -1;
+  if (kfrom>=0) k=localstore->arena+kfrom;
+  if (vfrom>=0) v=localstore->arena+vfrom;
+  int slot=localstore_hash_slot(localstore,k,kc);
+  int p=localstore->hashv[slot]-1;
+  int prevvc=0;
   if (p<0) {
     if (!vc) return 0;
-    p=-p-1;
-    if (localstore_insert(localstore,p,k,kc,v,vc)<0) return -1;
+    if (localstore_insert(localstore,slot,k,kc,v,vc)<0) return -1;
+    p=localstore->entryc-1;
   } else {
+    prevvc=localstore->entryv[p].vc;
     if (!vc) {
-      localstore_remove(localstore,p);
+      localstore_remove(localstore,slot);
     } else {
-      if (localstore_entry_replace(localstore->entryv+p,v,vc)<0) return -1;
+      if (localstore_entry_replace(localstore,p,v,vc)<0) return -1;
     }
   }
   localstore->dirty=1;
+  
+  /* Journal only what actually changed, so a failed set can never reach the file.
+   * Record from the arena's copy: (k,v) might have pointed into the arena, at bytes the change just overwrote.
+   * Removal doesn't touch the arena, so there (k) is still good.
+   * If the record fails, the next flush rewrites the whole file instead. The change is made either way.
+   */
+  if (localstore->journal) {
+    const char *storedk=k,*storedv=0;
+    if (vc) {
+      storedk=localstore->arena+localstore->entryv[p].kp;
+      storedv=localstore->arena+localstore->entryv[p].vp;
+    }
+    if (localstore_journal_record(localstore->journal,storedk,kc,storedv,vc,prevvc)<0) {
+      localstore->journal->compact=1;
+    }
+  }
+  return 0;
+}
+
+/* Frames.
+ */
+ 
+int localstore_frame_begin(struct sr_encoder *dst) {
+  int p=dst->c;
+  if (sr_encoder_require(dst,LOCALSTORE_FRAME_HEADER_SIZE)<0) return -1;
+  dst->c+=LOCALSTORE_FRAME_HEADER_SIZE;
+  return p;
+}
+
+void localstore_frame_end(struct sr_encoder *dst,int p) {
+  uint8_t *hdr=(uint8_t*)dst->v+p;
+  const uint8_t *payload=hdr+LOCALSTORE_FRAME_HEADER_SIZE;
+  int len=dst->c-p-LOCALSTORE_FRAME_HEADER_SIZE;
+  uint32_t crc=crc32(crc32(0,0,0),payload,len);
+  hdr[0]=len>>24;
+  hdr[1]=len>>16;
+  hdr[2]=len>>8;
+  hdr[3]=len;
+  hdr[4]=crc>>24;
+  hdr[5]=crc>>16;
+  hdr[6]=crc>>8;
+  hdr[7]=crc;
+}
+
+/* Decode records, from one frame or a legacy file.
+ */
+ 
+static int localstore_decode_records(struct localstore *localstore,const uint8_t *src,int srcc) {
+  int srcp=0;
+  while (srcp<srcc) {
+    int kc=src[srcp++];
+    if (kc>srcc-srcp) return -1;
+    const char *k=(char*)src+srcp;
+    srcp+=kc;
+    if (srcp>srcc-2) return -1;
+    int vc=(src[srcp]<<8)|src[srcp+1];
+    srcp+=2;
+    if (srcp>srcc-vc) return -1;
+    const char *v=(char*)src+srcp;
+    srcp+=vc;
+    if (localstore_set(localstore,k,kc,v,vc)<0) return -1;
+  }
+  return 0;
+}
+
+/* Decode file.
+ * Returns >0 if it's valid but should be rewritten: Legacy format, or a torn write at the end.
+ */
+ 
+static int localstore_decode(struct localstore *localstore,const uint8_t *src,int srcc) {
+  if ((srcc<4)&&!memcmp(src,LOCALSTORE_SIGNATURE,srcc)) return srcc?1:0; // Torn signature. Legacy keys can't be empty, so it's not that.
+  if ((srcc<4)||memcmp(src,LOCALSTORE_SIGNATURE,4)) {
+    if (localstore_decode_records(localstore,src,srcc)<0) return -1;
+    return srcc?1:0;
+  }
+  int srcp=4;
+  while (srcp<srcc) {
+    if (srcp>srcc-LOCALSTORE_FRAME_HEADER_SIZE) return 1;
+    const uint8_t *hdr=src+srcp;
+    uint32_t len=((uint32_t)hdr[0]<<24)|(hdr[1]<<16)|(hdr[2]<<8)|hdr[3];
+    uint32_t crc=((uint32_t)hdr[4]<<24)|(hdr[5]<<16)|(hdr[6]<<8)|hdr[7];
+    srcp+=LOCALSTORE_FRAME_HEADER_SIZE;
+    if (len>(uint32_t)(srcc-srcp)) return 1;
+    if (crc32(crc32(0,0,0),src+srcp,len)!=crc) return 1;
+    // Well-formed frames are committed whole, even if they turn out to contain something we can't apply.
+    if (localstore_decode_records(localstore,src+srcp,len)<0) return -1;
+    srcp+=len;
+  }
   return 0;
 }
 
@@ -147,55 +423,64 @@ int localstore_set(struct localstore *localstore,const char *k,int kc,const char
  */
 
 int localstore_load(struct localstore *localstore,const char *path) {
-  while (localstore->entryc>0) {
-    localstore->entryc--;
-    localstore_entry_cleanup(localstore->entryv+localstore->entryc);
-  }
-  unsigned char *serial=0;
+  localstore_clear(localstore);
+  uint8_t *serial=0;
   int serialc=file_read(&serial,path);
   if (serialc<0) return -1;
-  int serialp=0,err=0;
-  while (serialp<serialc) {
-  
-    int kc=serial[serialp++];
-    if (kc>serialc-serialp) { err=-1; break; }
-    const char *k=(char*)serial+serialp;
-    serialp+=kc;
-    if (serialp>serialc-2) { err=-1; break; }
-    int vc=(serial[serialp]<<8)|serial[serialp+1];
-    serialp+=2;
-    if (serialp>serialc-vc) { err=-1; break; }
-    const char *v=(char*)serial+serialp;
-    serialp+=vc;
-    
-    // We could insert instead of set here, if we're willing to assume that the file was written in our sort order.
-    // Realistically that should always be true. But I don't like betting on it.
-    if ((err=localstore_set(localstore,k,kc,v,vc))<0) break;
-  }
+  // Decode with the journal detached, we're not changing anything.
+  struct localstore_journal *journal=localstore->journal;
+  localstore->journal=0;
+  int err=localstore_decode(localstore,serial,serialc);
+  localstore->journal=journal;
   free(serial);
   if (err<0) return -1;
-  localstore->dirty=0;
+  if (journal) {
+    // The file no longer necessarily matches what's been flushed. Start over.
+    localstore_journal_reset(journal,localstore);
+    localstore->dirty=1;
+  } else if (err>0) {
+    localstore->dirty=1;
+  } else {
+    localstore->dirty=0;
+  }
   return 0;
 }
 
-/* Encode and write file.
+/* Encode everything.
  */
  
-int localstore_save(struct localstore *localstore,const char *path) {
-  if (!localstore->save_permit) return -1;
-  struct sr_encoder encoder={0};
+int localstore_encode(struct sr_encoder *dst,const struct localstore *localstore) {
+  if (sr_encode_raw(dst,LOCALSTORE_SIGNATURE,4)<0) return -1;
+  int framep=localstore_frame_begin(dst);
+  if (framep<0) return -1;
   const struct localstore_entry *entry=localstore->entryv;
   int i=localstore->entryc;
   for (;i-->0;entry++) {
     if (
-      (sr_encode_u8(&encoder,entry->kc)<0)||
-      (sr_encode_raw(&encoder,entry->k,entry->kc)<0)||
-      (sr_encode_intbe(&encoder,entry->vc,2)<0)||
-      (sr_encode_raw(&encoder,entry->v,entry->vc)<0)
-    ) {
-      sr_encoder_cleanup(&encoder);
-      return -1;
-    }
+      (sr_encode_u8(dst,entry->kc)<0)||
+      (sr_encode_raw(dst,localstore->arena+entry->kp,entry->kc)<0)||
+      (sr_encode_intbe(dst,entry->vc,2)<0)||
+      (sr_encode_raw(dst,localstore->arena+entry->vp,entry->vc)<0)
+    ) return -1;
+  }
+  localstore_frame_end(dst,framep);
+  return 0;
+}
+
+/* Encode and write file.
+ */
+ 
+int localstore_save(struct localstore *localstore,const char *path) {
+  if (!localstore->save_permit) return -1;
+  if (localstore->journal) {
+    if (localstore_flush(localstore)<0) return -1;
+    return localstore_sync(localstore);
+  }
+  localstore_compact_arena(localstore);
+  struct sr_encoder encoder={0};
+  if (localstore_encode(&encoder,localstore)<0) {
+    sr_encoder_cleanup(&encoder);
+    return -1;
   }
   int err=file_write(path,encoder.v,encoder.c);
   sr_encoder_cleanup(&encoder);
@@ -3,36 +3,85 @@
  * Aiming to make this a fairly painless substitute for browser localStorage.
  *
  * Encoded format:
- *   u8 keyc, ... key, u16 valuec, ... value, ...
+ *   4 Signature: "\0ELS"
+ *   ... Frames:
+ *     u32 Payload length.
+ *     u32 CRC32 of payload.
+ *     ... Payload: Records:
+ *       u8 keyc, ... key, u16 valuec, ... value
+ *       Zero valuec deletes the key.
+ * Integers are big-endian.
+ * Frames apply in order. A freshly compacted file has just one frame.
+ * When journalling, each flush appends one frame.
+ * Loading stops at the first frame that's short or fails its CRC: That's a write that didn't finish.
+ *
+ * Legacy format, no signature: Records only, no deletes. We read it, and rewrite in the new format at the first flush.
  */
- 
+
 #ifndef LOCALSTORE_H
 #define LOCALSTORE_H
 
+struct localstore_journal;
+
+/* Entries are in no particular order. Use localstore_key_by_index to iterate in key order.
+ * Keys and values live in (arena), each terminated.
+ * (hashv) is the index, see localstore.c.
+ */
 struct localstore {
   struct localstore_entry {
-    int kc,vc;
-    char *k;
-    char *v;
+    int kp,kc; // Key position and length in (arena).
+    int vp,vc; // Value position and length in (arena).
   } *entryv;
   int entryc,entrya;
+  int *hashv;
+  int hasha; // Power of two, or zero.
+  char *arena;
+  int arenac,arenaa;
+  int arenagarbage; // Bytes in (arena) no longer referenced.
+  int *orderv; // Indices in (entryv) sorted by key, then scratch space. Valid if !order_dirty.
+  int ordera;
+  int order_dirty;
   int dirty;
   int save_permit; // Set zero to forbid writing. Reading can still happen.
+  struct localstore_journal *journal; // Present after localstore_open.
 };
 
+/* If journalling, waits for the writer thread to finish whatever was flushed, then stops it.
+ * Changes since the last flush are lost.
+ */
 void localstore_cleanup(struct localstore *localstore);
 
 /* Values from 'get' are always terminated if not null.
  * If we return zero from get, generally we do not populate (*dstpp).
+ * Pointers we return are only valid until the next set, flush, or save.
  */
 int localstore_get(const char **dstpp,const struct localstore *localstore,const char *k,int kc);
 int localstore_set(struct localstore *localstore,const char *k,int kc,const char *v,int vc);
 
+/* Keys in order of length, then bytewise. Same order every time, until the next set.
+ * Returns zero if (index) out of range.
+ */
+int localstore_key_by_index(const char **dstpp,struct localstore *localstore,int index);
+
 /* Loading drops any existing content first.
  * Saving writes the file whether dirty or not, then clears the dirty flag.
  * Caller should check dirty flag before saving.
+ * If journalling, save is the same as flush then sync.
  */
 int localstore_load(struct localstore *localstore,const char *path);
 int localstore_save(struct localstore *localstore,const char *path);
 
+/* Load from (path), and start a background thread to keep it up to date.
+ * A missing file is not an error; we create it at the first flush.
+ * A file we can't read is an error, but we still start journalling, and the first flush replaces it.
+ * If (save_permit) is zero, we only load.
+ * After opening, each set is recorded, and flush hands the changes so far to the writer thread, which appends and syncs.
+ * Flush never waits for I/O. Every so often it copies the whole store, for the writer to replace the file, compacted.
+ * Flush returns <0 if the writer failed since the last flush. It will rewrite the whole file next time, and carry on.
+ * Sync blocks until everything flushed so far is on disk.
+ */
+int localstore_open(struct localstore *localstore,const char *path);
+int localstore_flush(struct localstore *localstore);
+int localstore_sync(struct localstore *localstore);
+
 #endif
@@ -0,0 +1,81 @@
+#ifndef LOCALSTORE_INTERNAL_H
+#define LOCALSTORE_INTERNAL_H
+
+#include "localstore.h"
+#include "opt/fs/fs.h"
+#include "opt/serial/serial.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define LOCALSTORE_SIGNATURE "\0ELS"
+#define LOCALSTORE_FRAME_HEADER_SIZE 8
+
+/* Don't compact until the file is at least so big, and at least twice the size of its live content.
+ */
+#define LOCALSTORE_COMPACT_MIN 65536
+
+/* Don't compact the arena until it has at least so much garbage, and garbage is at least half of it.
+ */
+#define LOCALSTORE_ARENA_GARBAGE_MIN 4096
+
+struct localstore_journal {
+  char *path;
+
+  // Game thread only.
+  struct sr_encoder pending; // Records since the last flush, no frame header.
+  int filec; // Size the file will have once everything handed off lands.
+  int livec; // Size a compacted file would have.
+  int compact; // Rewrite the whole file at the next flush.
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int thread_running;
+
+  // Guarded by (mutex).
+  struct sr_encoder queue; // Frames to append.
+  struct sr_encoder snapshot; // Whole file, to replace the existing one before appending (queue).
+  int snapshot_ready;
+  int busy; // Writer is working outside the lock.
+  int quit;
+  int errorc; // Cleared by flush.
+
+  // Writer thread only.
+  int fd;
+};
+
+void localstore_journal_del(struct localstore_journal *journal);
+struct localstore_journal *localstore_journal_new(const char *path);
+
+/* Forget what's pending and recalculate sizes. Next flush will rewrite the whole file.
+ */
+void localstore_journal_reset(struct localstore_journal *journal,const struct localstore *localstore);
+
+/* Record one change, to go out at the next flush.
+ * Call after the change is made in memory, so failed changes never reach the file.
+ * (prevvc) is the value's length before this change, zero if it didn't exist.
+ * Zero (vc) to delete.
+ * On failure nothing is recorded, and the store should compact at the next flush.
+ */
+int localstore_journal_record(struct localstore_journal *journal,const char *k,int kc,const char *v,int vc,int prevvc);
+
+/* Begin reserves space for a frame header and returns its position.
+ * Append records, then end fills in the header.
+ */
+int localstore_frame_begin(struct sr_encoder *dst);
+void localstore_frame_end(struct sr_encoder *dst,int p);
+
+/* Rewrite (arena) with only the live keys and values, if it's worth doing.
+ * Invalidates all pointers from localstore_get and localstore_key_by_index.
+ */
+void localstore_compact_arena(struct localstore *localstore);
+
+/* Encode the whole store, as a compacted file.
+ */
+int localstore_encode(struct sr_encoder *dst,const struct localstore *localstore);
+
+#endif
@@ -0,0 +1,327 @@
+/* localstore_journal.c
+ * Append-only store file, written by a background thread.
+ * The game thread records each change as it happens, and at flush wraps them in one frame and hands it off.
+ * The writer thread appends and syncs, and never touches the store itself.
+ * Compaction is the game thread encoding the whole store, and the writer replacing the file with it.
+ */
+
+#include "localstore_internal.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#ifndef O_BINARY
+  #define O_BINARY 0
+#endif
+
+#if USE_mswin
+  #define fsync(fd) _commit(fd)
+#endif
+
+/* Writer thread: Write all of a buffer to an open file.
+ */
+
+static int localstore_write_all(int fd,const void *src,int srcc) {
+  int srcp=0;
+  while (srcp<srcc) {
+    int err=write(fd,(char*)src+srcp,srcc-srcp);
+    if (err<=0) {
+      if ((err<0)&&(errno==EINTR)) continue;
+      return -1;
+    }
+    srcp+=err;
+  }
+  return 0;
+}
+
+/* Writer thread: Replace the file with a snapshot.
+ * Write to a temporary file then rename, so there's always one valid file on disk.
+ */
+
+static int localstore_write_snapshot(struct localstore_journal *journal,const void *src,int srcc) {
+  char tmppath[1024];
+  int tmppathc=snprintf(tmppath,sizeof(tmppath),"%s.tmp",journal->path);
+  if ((tmppathc<1)||(tmppathc>=sizeof(tmppath))) return -1;
+  int fd=open(tmppath,O_WRONLY|O_CREAT|O_TRUNC|O_BINARY,0666);
+  if (fd<0) return -1;
+  if ((localstore_write_all(fd,src,srcc)<0)||fsync(fd)) {
+    close(fd);
+    unlink(tmppath);
+    return -1;
+  }
+  close(fd);
+  if (journal->fd>=0) {
+    close(journal->fd);
+    journal->fd=-1;
+  }
+  #if USE_mswin
+    unlink(journal->path); // Windows won't rename over an existing file.
+  #endif
+  if (rename(tmppath,journal->path)<0) {
+    unlink(tmppath);
+    return -1;
+  }
+  #if !USE_mswin
+    // Sync the directory too, or the rename itself might not survive a crash.
+    char dirpath[1024];
+    int dirpathc=tmppathc-4;
+    while (dirpathc&&(journal->path[dirpathc-1]!='/')) dirpathc--;
+    if (dirpathc>1) dirpathc--;
+    if (!dirpathc) { dirpath[0]='.'; dirpathc=1; }
+    else memcpy(dirpath,journal->path,dirpathc);
+    dirpath[dirpathc]=0;
+    int dirfd=open(dirpath,O_RDONLY);
+    if (dirfd>=0) {
+      fsync(dirfd);
+      close(dirfd);
+    }
+  #endif
+  return 0;
+}
+
+/* Writer thread: Append frames.
+ */
+
+static int localstore_write_frames(struct localstore_journal *journal,const void *src,int srcc) {
+  if (journal->fd<0) {
+    if ((journal->fd=open(journal->path,O_WRONLY|O_APPEND|O_CREAT|O_BINARY,0666))<0) return -1;
+  }
+  if (localstore_write_all(journal->fd,src,srcc)<0) return -1;
+  if (fsync(journal->fd)) return -1;
+  return 0;
+}
+
+/* Writer thread.
+ * Take everything queued, write it outside the lock, repeat.
+ * On quit, we finish whatever's queued first.
+ */
+
+static void *localstore_journal_thread(void *arg) {
+  struct localstore_journal *journal=arg;
+  struct sr_encoder snapshot={0},queue={0};
+  pthread_mutex_lock(&journal->mutex);
+  for (;;) {
+    while (!journal->quit&&!journal->snapshot_ready&&!journal->queue.c) {
+      pthread_cond_wait(&journal->cond,&journal->mutex);
+    }
+    if (!journal->snapshot_ready&&!journal->queue.c) break;
+
+    // Swap buffers with the shared ones, so both sides keep their allocations.
+    int write_snapshot=journal->snapshot_ready;
+    struct sr_encoder tmp;
+    if (write_snapshot) {
+      tmp=snapshot; snapshot=journal->snapshot; journal->snapshot=tmp;
+      journal->snapshot.c=0;
+      journal->snapshot_ready=0;
+    }
+    tmp=queue; queue=journal->queue; journal->queue=tmp;
+    journal->queue.c=0;
+    journal->busy=1;
+    pthread_mutex_unlock(&journal->mutex);
+
+    int err=0;
+    if (write_snapshot) err=localstore_write_snapshot(journal,snapshot.v,snapshot.c);
+    if ((err>=0)&&queue.c) err=localstore_write_frames(journal,queue.v,queue.c);
+    if (err<0) {
+      // Anything we append now might land after a partial frame, unreachable. Game thread will compact next flush.
+      if (journal->fd>=0) {
+        close(journal->fd);
+        journal->fd=-1;
+      }
+    }
+    snapshot.c=0;
+    queue.c=0;
+
+    pthread_mutex_lock(&journal->mutex);
+    if (err<0) journal->errorc++;
+    journal->busy=0;
+    pthread_cond_broadcast(&journal->cond);
+  }
+  pthread_mutex_unlock(&journal->mutex);
+  sr_encoder_cleanup(&snapshot);
+  sr_encoder_cleanup(&queue);
+  return 0;
+}
+
+/* Delete.
+ */
+
+void localstore_journal_del(struct localstore_journal *journal) {
+  if (!journal) return;
+  if (journal->thread_running) {
+    pthread_mutex_lock(&journal->mutex);
+    journal->quit=1;
+    pthread_cond_broadcast(&journal->cond);
+    pthread_mutex_unlock(&journal->mutex);
+    pthread_join(journal->thread,0);
+    pthread_cond_destroy(&journal->cond);
+    pthread_mutex_destroy(&journal->mutex);
+  }
+  if (journal->fd>=0) close(journal->fd);
+  if (journal->path) free(journal->path);
+  sr_encoder_cleanup(&journal->pending);
+  sr_encoder_cleanup(&journal->queue);
+  sr_encoder_cleanup(&journal->snapshot);
+  free(journal);
+}
+
+/* New.
+ */
+
+struct localstore_journal *localstore_journal_new(const char *path) {
+  if (!path||!path[0]) return 0;
+  struct localstore_journal *journal=calloc(1,sizeof(struct localstore_journal));
+  if (!journal) return 0;
+  journal->fd=-1;
+  if (!(journal->path=strdup(path))) {
+    free(journal);
+    return 0;
+  }
+  if (pthread_mutex_init(&journal->mutex,0)) {
+    localstore_journal_del(journal);
+    return 0;
+  }
+  if (pthread_cond_init(&journal->cond,0)) {
+    pthread_mutex_destroy(&journal->mutex);
+    localstore_journal_del(journal);
+    return 0;
+  }
+  if (pthread_create(&journal->thread,0,localstore_journal_thread,journal)) {
+    pthread_cond_destroy(&journal->cond);
+    pthread_mutex_destroy(&journal->mutex);
+    localstore_journal_del(journal);
+    return 0;
+  }
+  journal->thread_running=1;
+  return journal;
+}
+
+/* Record change.
+ */
+
+int localstore_journal_record(struct localstore_journal *journal,const char *k,int kc,const char *v,int vc,int prevvc) {
+  int pendingc=journal->pending.c;
+  if (
+    (sr_encode_u8(&journal->pending,kc)<0)||
+    (sr_encode_raw(&journal->pending,k,kc)<0)||
+    (sr_encode_intbe(&journal->pending,vc,2)<0)||
+    (sr_encode_raw(&journal->pending,v,vc)<0)
+  ) {
+    journal->pending.c=pendingc; // No partial records.
+    return -1;
+  }
+  if (prevvc) journal->livec-=3+kc+prevvc;
+  if (vc) journal->livec+=3+kc+vc;
+  return 0;
+}
+
+/* Reset to the store's current content, with nothing known about the file.
+ */
+ 
+void localstore_journal_reset(struct localstore_journal *journal,const struct localstore *localstore) {
+  journal->pending.c=0;
+  journal->compact=1;
+  journal->filec=0;
+  journal->livec=4+LOCALSTORE_FRAME_HEADER_SIZE;
+  const struct localstore_entry *entry=localstore->entryv;
+  int i=localstore->entryc;
+  for (;i-->0;entry++) journal->livec+=3+entry->kc+entry->vc;
+}
+
+/* Open.
+ */
+
+int localstore_open(struct localstore *localstore,const char *path) {
+  if (!path||!path[0]) return -1;
+  if (localstore->journal) return -1;
+  int err=localstore_load(localstore,path),result=0;
+  if ((err<0)&&file_get_type(path)) {
+    // Exists but we can't read it. Report the error, but carry on; the first flush will replace it.
+    result=-1;
+  }
+  if (!localstore->save_permit) return result;
+  if (!(localstore->journal=localstore_journal_new(path))) return -1;
+  struct localstore_journal *journal=localstore->journal;
+  localstore_journal_reset(journal,localstore);
+  struct stat st={0};
+  if ((err>=0)&&!localstore->dirty&&!stat(path,&st)&&(st.st_size<INT_MAX)) {
+    // File is good as is, we'll append to it.
+    journal->compact=0;
+    journal->filec=st.st_size;
+  }
+  return result;
+}
+
+/* Flush.
+ */
+
+int localstore_flush(struct localstore *localstore) {
+  struct localstore_journal *journal=localstore->journal;
+  if (!journal) return 0;
+  localstore->dirty=0;
+  localstore_compact_arena(localstore);
+
+  // Collect errors from the writer, and if there's anything to do, decide between appending and compacting.
+  pthread_mutex_lock(&journal->mutex);
+  int errorc=journal->errorc;
+  journal->errorc=0;
+  pthread_mutex_unlock(&journal->mutex);
+  if (errorc) journal->compact=1;
+  if (!journal->compact&&!journal->pending.c) return errorc?-1:0;
+  if (!journal->compact) {
+    int nextc=journal->filec+LOCALSTORE_FRAME_HEADER_SIZE+journal->pending.c;
+    if ((nextc>=LOCALSTORE_COMPACT_MIN)&&(nextc>journal->livec*2)) journal->compact=1;
+  }
+
+  int err=0;
+  pthread_mutex_lock(&journal->mutex);
+  if (journal->compact) {
+    // Snapshot contains everything, including frames queued but not yet written. Drop those.
+    journal->snapshot.c=0;
+    journal->queue.c=0;
+    if (localstore_encode(&journal->snapshot,localstore)<0) {
+      journal->snapshot.c=0;
+      err=-1;
+    } else {
+      journal->snapshot_ready=1;
+      journal->filec=journal->snapshot.c;
+      journal->compact=0;
+    }
+  } else {
+    int framep=localstore_frame_begin(&journal->queue);
+    if ((framep<0)||(sr_encode_raw(&journal->queue,journal->pending.v,journal->pending.c)<0)) {
+      // Don't leave a partial frame for the writer. Compact next time; the snapshot will have these changes.
+      if (framep>=0) journal->queue.c=framep;
+      journal->compact=1;
+      err=-1;
+    } else {
+      localstore_frame_end(&journal->queue,framep);
+      journal->filec+=journal->queue.c-framep;
+    }
+  }
+  pthread_cond_broadcast(&journal->cond);
+  pthread_mutex_unlock(&journal->mutex);
+  journal->pending.c=0;
+
+  if (err<0) {
+    localstore->dirty=1;
+    return -1;
+  }
+  return errorc?-1:0;
+}
+
+/* Sync.
+ */
+
+int localstore_sync(struct localstore *localstore) {
+  struct localstore_journal *journal=localstore->journal;
+  if (!journal) return 0;
+  pthread_mutex_lock(&journal->mutex);
+  while (journal->snapshot_ready||journal->queue.c||journal->busy) {
+    pthread_cond_wait(&journal->cond,&journal->mutex);
+  }
+  int errorc=journal->errorc;
+  pthread_mutex_unlock(&journal->mutex);
+  return errorc?-1:0;
+}
@@ -1,6 +1,6 @@
 /* png.h
  * Required: serial (encode only)
- * Link: -lz
+ * Link: -lz -lpthread
  *
  * Simple PNG decoder and encoder.
  * Deviations from spec:
@@ -54,14 +54,33 @@ int png_image_reformat(struct png_image *image,int depth,int colortype);
 /* Produce a complete PNG file in (dst).
  * Stride does not need to be minimized first.
  * Chunks are encoded just as is, and all before the IDAT chunk.
+ * (effort) in 1..9 trades speed for size, like zlib's level. Anything else means 9, which is what png_encode does.
+ * Effort 3 and below only tries the cheap filters.
+ * Large images are split into row stripes and compressed in parallel. Output is still one ordinary IDAT chunk.
+ * The worker threads start at the first large image and stay alive, idle, for the rest of the process.
  */
 int png_encode(struct sr_encoder *dst,const struct png_image *image);
+int png_encode_effort(struct sr_encoder *dst,const struct png_image *image,int effort);
 
 /* Decode PNG file in one shot.
  * All chunks except IHDR,IDAT,IEND are preserved blindly.
  */
 struct png_image *png_decode(const void *src,int srcc);
 
+/* Decode PNG file incrementally, delivering (bandh) rows at a time to (cb) as soon as they're ready.
+ * We only hold one band of pixels at a time. (bandh) is at least 2.
+ * (band) has the image's full width, (band->h) rows starting at row (y), and (h) is the full height.
+ * Chunks before IDAT (eg PLTE, tRNS) are present in (band).
+ * Rows missing from a short IDAT are delivered as zeroes, same as png_decode.
+ * (cb) may overwrite the band's pixels; we keep our own copy of the row we still need.
+ * If (cb) returns nonzero, we stop and return it.
+ */
+int png_decode_bands(
+  const void *src,int srcc,int bandh,
+  int (*cb)(const struct png_image *band,int y,int h,void *userdata),
+  void *userdata
+);
+
 int png_calculate_pixel_size(int depth,int colortype);
 int png_minimum_stride(int w,int pixelsize);
 
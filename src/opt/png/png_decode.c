@@ -16,7 +16,14 @@ struct png_decoder {
   uint8_t *rowbuf;
   int xstride; // bytes column to column for filter purposes, min 1
   int y; // Next output row.
-  uint8_t *dstrow,*prvrow; // points into image->v
+  int h; // Full image height. Not necessarily (image->h), if we're decoding in bands.
+  uint8_t *dstrow,*prvrow; // points into image->v, or (prvbuf) for the first row of a band after the first
+  uint8_t *prvbuf; // Band mode: Private copy of the last row delivered. The callback may overwrite the band.
+  // Band mode, if (cb) set. (image) holds just (bandh) rows, and we deliver each band as it fills.
+  int bandh;
+  int bandy; // Row in the full image where the current band starts.
+  int (*cb)(const struct png_image *band,int y,int h,void *userdata);
+  void *userdata;
 };
 
 static void png_decoder_cleanup(struct png_decoder *ctx) {
@@ -26,6 +33,7 @@ static void png_decoder_cleanup(struct png_decoder *ctx) {
     free(ctx->z);
   }
   if (ctx->rowbuf) free(ctx->rowbuf);
+  if (ctx->prvbuf) free(ctx->prvbuf);
 }
 
 /* Undo filter, into the real output.
@@ -108,6 +116,28 @@ static void png_unfilter_PAETH(uint8_t *dst,const uint8_t *src,const uint8_t *pr
   }
 }
 
+/* Band mode: Deliver the band so far and start the next one at the top of the buffer.
+ * Callers are allowed to convert the band in place, so first copy the last row aside, to unfilter the next one against.
+ */
+ 
+static int png_decoder_deliver_band(struct png_decoder *ctx) {
+  int c=ctx->y-ctx->bandy;
+  if (c<1) return 0;
+  if (ctx->prvrow&&(ctx->y<ctx->h)) {
+    if (!ctx->prvbuf&&!(ctx->prvbuf=malloc(ctx->image->stride))) return -1;
+    memcpy(ctx->prvbuf,ctx->prvrow,ctx->image->stride);
+    ctx->prvrow=ctx->prvbuf;
+  }
+  int bandh=ctx->image->h;
+  ctx->image->h=c;
+  int err=ctx->cb(ctx->image,ctx->bandy,ctx->h,ctx->userdata);
+  ctx->image->h=bandh;
+  if (err) return err;
+  ctx->bandy=ctx->y;
+  ctx->dstrow=ctx->image->v;
+  return 0;
+}
+
 /* If zlib has finished a row, unfilter it and add to the image.
  */
  
@@ -115,7 +145,7 @@ static int png_decode_row_if_ready(struct png_decoder *ctx) {
   if (ctx->z->avail_out) return 0; // Not ready.
   ctx->z->next_out=(Bytef*)ctx->rowbuf;
   ctx->z->avail_out=ctx->rowbufc;
-  if (ctx->y>=ctx->image->h) return 0; // Discard extra trailing data.
+  if (ctx->y>=ctx->h) return 0; // Discard extra trailing data.
   switch (ctx->rowbuf[0]) {
     case 0: png_unfilter_NONE(ctx->dstrow,ctx->rowbuf+1,ctx->prvrow,ctx->image->stride,ctx->xstride); break;
     case 1: png_unfilter_SUB(ctx->dstrow,ctx->rowbuf+1,ctx->prvrow,ctx->image->stride,ctx->xstride); break;
@@ -123,13 +153,16 @@ static int png_decode_row_if_ready(struct png_decoder *ctx) {
     case 3: png_unfilter_AVG(ctx->dstrow,ctx->rowbuf+1,ctx->prvrow,ctx->image->stride,ctx->xstride); break;
     case 4: png_unfilter_PAETH(ctx->dstrow,ctx->rowbuf+1,ctx->prvrow,ctx->image->stride,ctx->xstride); break;
     default: {
-        fprintf(stderr,"%s: Unexpected filter byte 0x%02x at row %d/%d\n",__func__,ctx->rowbuf[0],ctx->y,ctx->image->h);
+        fprintf(stderr,"%s: Unexpected filter byte 0x%02x at row %d/%d\n",__func__,ctx->rowbuf[0],ctx->y,ctx->h);
         return -1;
       }
   }
   ctx->y++;
   ctx->prvrow=ctx->dstrow;
   ctx->dstrow+=ctx->image->stride;
+  if (ctx->cb&&((ctx->y-ctx->bandy>=ctx->bandh)||(ctx->y>=ctx->h))) {
+    return png_decoder_deliver_band(ctx);
+  }
   return 0;
 }
 
@@ -140,13 +173,13 @@ static int png_decode_IDAT(struct png_decoder *ctx,const uint8_t *src,int srcc)
   if (!ctx->image) return -1; // IDAT before IHDR
   ctx->z->next_in=(Bytef*)src;
   ctx->z->avail_in=srcc;
-  while ((ctx->z->avail_in)&&(ctx->y<ctx->image->h)) {
+  while ((ctx->z->avail_in)&&(ctx->y<ctx->h)) {
     int err=inflate(ctx->z,Z_NO_FLUSH);
     if (err<0) {
       fprintf(stderr,"%s:inflate:%d\n",__func__,err);
       return -1;
     }
-    if (png_decode_row_if_ready(ctx)<0) return -1;
+    if (err=png_decode_row_if_ready(ctx)) return err;
   }
   return 0;
 }
@@ -155,15 +188,29 @@ static int png_decode_IDAT(struct png_decoder *ctx,const uint8_t *src,int srcc)
  */
  
 static int png_decoder_flush(struct png_decoder *ctx) {
-  while (ctx->y<ctx->image->h) {
+  while (ctx->y<ctx->h) {
     int err=inflate(ctx->z,Z_FINISH);
     if (err<0) {
       fprintf(stderr,"%s:inflate(Z_FINISH):%d\n",__func__,err);
       return -1;
     }
-    if (png_decode_row_if_ready(ctx)<0) return -1;
+    int cberr=png_decode_row_if_ready(ctx);
+    if (cberr) return cberr;
     if (err==Z_STREAM_END) break;
   }
+  /* In band mode, rows missing from a short IDAT must still be delivered, as zeroes.
+   */
+  if (ctx->cb) {
+    while (ctx->y<ctx->h) {
+      memset(ctx->dstrow,0,ctx->image->stride);
+      ctx->y++;
+      ctx->dstrow+=ctx->image->stride;
+      if ((ctx->y-ctx->bandy>=ctx->bandh)||(ctx->y>=ctx->h)) {
+        int err=png_decoder_deliver_band(ctx);
+        if (err) return err;
+      }
+    }
+  }
   return 0;
 }
 
@@ -186,7 +233,15 @@ static int png_decode_IHDR(struct png_decoder *ctx,const uint8_t *src,int srcc)
   if (interlace) return -1; // Spec requires 1=adam7, but we're not doing that.
   
   // Let our image ctor validate (w,h,depth,colortype).
-  if (!(ctx->image=png_image_new(w,h,depth,colortype))) return -1;
+  // In band mode, validate the full height first, then allocate just one band.
+  if (ctx->cb) {
+    if ((h<1)||(h>0x7fff)) return -1;
+    if (ctx->bandh>h) ctx->bandh=h;
+    if (!(ctx->image=png_image_new(w,ctx->bandh,depth,colortype))) return -1;
+  } else {
+    if (!(ctx->image=png_image_new(w,h,depth,colortype))) return -1;
+  }
+  ctx->h=h;
   
   ctx->xstride=(ctx->image->pixelsize+7)>>3;
   ctx->rowbufc=1+ctx->image->stride;
@@ -218,6 +273,7 @@ static int png_decode_other(struct png_decoder *ctx,const char *type,const void
  */
  
 static int png_decode_inner(struct png_decoder *ctx,const uint8_t *src,int srcc) {
+  int err;
   if ((srcc<8)||!src||memcmp(src,"\x89PNG\r\n\x1a\n",8)) return -1;
   int srcp=8;
   while (srcp<srcc) {
@@ -236,13 +292,13 @@ static int png_decode_inner(struct png_decoder *ctx,const uint8_t *src,int srcc)
     } else if (!memcmp(chunktypestr,"IHDR",4)) {
       if (png_decode_IHDR(ctx,chunk,chunklen)<0) return -1;
     } else if (!memcmp(chunktypestr,"IDAT",4)) {
-      if (png_decode_IDAT(ctx,chunk,chunklen)<0) return -1;
+      if (err=png_decode_IDAT(ctx,chunk,chunklen)) return err;
     } else {
       if (png_decode_other(ctx,chunktypestr,chunk,chunklen)<0) return -1;
     }
   }
   if (!ctx->image) return -1; // No IHDR.
-  if (png_decoder_flush(ctx)<0) return -1;
+  if (err=png_decoder_flush(ctx)) return err;
   // Could validate here that all the image data was received, but whatever.
   return 0;
 }
@@ -262,3 +318,23 @@ struct png_image *png_decode(const void *src,int srcc) {
   png_decoder_cleanup(&ctx);
   return 0;
 }
+
+/* Decode in bands.
+ */
+ 
+int png_decode_bands(
+  const void *src,int srcc,int bandh,
+  int (*cb)(const struct png_image *band,int y,int h,void *userdata),
+  void *userdata
+) {
+  if (!cb) return -1;
+  if (bandh<2) bandh=2;
+  struct png_decoder ctx={
+    .bandh=bandh,
+    .cb=cb,
+    .userdata=userdata,
+  };
+  int err=png_decode_inner(&ctx,src,srcc);
+  png_decoder_cleanup(&ctx);
+  return err;
+}
@@ -6,25 +6,46 @@
 #include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
 
 /* Encoder context.
  */
  
+#define PNG_STRIPE_MIN (128<<10) /* Filtered bytes per stripe, below which we don't bother splitting. */
+#define PNG_THREAD_LIMIT 16
+ 
 struct png_encoder {
   struct sr_encoder *dst; // WEAK
   const struct png_image *image; // WEAK
-  uint8_t *rowbuf;
-  int rowbufc; // including filter byte, ie 1+stride
+  int effort; // 1..9
+  int filterc; // How many filters to try per row: 3 (NONE,SUB,UP) or 5.
   int xstride; // bytes column to column for filter purposes (min 1)
   int stride; // May be less than input.
-  z_stream *z; // Initialized if not null.
+  uint8_t *fbuf; // Entire filtered image, each row (1+stride) bytes.
+  int fbufc;
+  struct png_stripe {
+    const struct png_encoder *ctx; // WEAK
+    int y,h; // Rows covered by this stripe.
+    const uint8_t *src; // Filtered input, in (ctx->fbuf).
+    int srcc;
+    uint8_t *dst; // Compressed output, raw deflate.
+    int dstc;
+    uint32_t adler;
+    int err;
+  } *stripev;
+  int stripec;
 };
 
 static void png_encoder_cleanup(struct png_encoder *ctx) {
-  if (ctx->rowbuf) free(ctx->rowbuf);
-  if (ctx->z) {
-    deflateEnd(ctx->z);
-    free(ctx->z);
+  if (ctx->fbuf) free(ctx->fbuf);
+  if (ctx->stripev) {
+    struct png_stripe *stripe=ctx->stripev;
+    int i=ctx->stripec;
+    for (;i-->0;stripe++) {
+      if (stripe->dst) free(stripe->dst);
+    }
+    free(ctx->stripev);
   }
 }
 
@@ -76,18 +97,23 @@ static int png_encode_chunks(struct png_encoder *ctx) {
 /* Filters.
  * NONE and SUB accept null (prv), the others require it.
  * (they do declare a prv parameter, just for consistency).
- * Each returns the count of zeroes after filtering.
+ * Each returns a score for the filtered row, lower is better:
+ * Sum of absolute values, reading each output byte as signed.
+ * That's the usual heuristic and it beats counting zeroes handily; small residuals deflate well even when they aren't zero.
  */
  
-static inline int png_count_zeroes(const uint8_t *v,int c) {
-  int zeroc=0;
-  for (;c-->0;v++) if (!*v) zeroc++;
-  return zeroc;
+static inline int png_score_row(const uint8_t *v,int c) {
+  int score=0;
+  for (;c-->0;v++) {
+    int8_t sv=*v;
+    score+=(sv<0)?-sv:sv;
+  }
+  return score;
 }
  
 static int png_filter_row_NONE(uint8_t *dst,const uint8_t *src,const uint8_t *prv,int c,int xstride) {
   memcpy(dst,src,c);
-  return png_count_zeroes(dst,c);
+  return png_score_row(dst,c);
 }
  
 static int png_filter_row_SUB(uint8_t *dst,const uint8_t *src,const uint8_t *prv,int c,int xstride) {
@@ -101,7 +127,7 @@ static int png_filter_row_SUB(uint8_t *dst,const uint8_t *src,const uint8_t *prv
   for (;c-->0;dst++,src++,tail++) {
     *dst=(*src)-(*tail);
   }
-  return png_count_zeroes(dst0,c0);
+  return png_score_row(dst0,c0);
 }
 
 static int png_filter_row_UP(uint8_t *dst,const uint8_t *src,const uint8_t *prv,int c,int xstride) {
@@ -110,7 +136,7 @@ static int png_filter_row_UP(uint8_t *dst,const uint8_t *src,const uint8_t *prv,
   for (;c-->0;dst++,src++,prv++) {
     *dst=(*src)-(*prv);
   }
-  return png_count_zeroes(dst0,c0);
+  return png_score_row(dst0,c0);
 }
 
 static int png_filter_row_AVG(uint8_t *dst,const uint8_t *src,const uint8_t *prv,int c,int xstride) {
@@ -124,7 +150,7 @@ static int png_filter_row_AVG(uint8_t *dst,const uint8_t *src,const uint8_t *prv
   for (;c-->0;dst++,src++,prv++,tail++) {
     *dst=(*src)-(((*tail)+(*prv))>>1);
   }
-  return png_count_zeroes(dst0,c0);
+  return png_score_row(dst0,c0);
 }
 
 static inline uint8_t png_paeth(uint8_t a,uint8_t b,uint8_t c) {
@@ -148,44 +174,53 @@ static int png_filter_row_PAETH(uint8_t *dst,const uint8_t *src,const uint8_t *p
   for (;c-->0;dst++,src++,prv++,srctail++,prvtail++) {
     *dst=(*src)-png_paeth(*srctail,*prv,*prvtail);
   }
-  return png_count_zeroes(dst0,c0);
+  return png_score_row(dst0,c0);
 }
 
 /* Apply filter to one row.
  * Return the chosen filter byte and overwrite (dst) completely.
+ * (filterc) is 3 to consider only NONE, SUB, and UP, or 5 for all.
  */
  
-static uint8_t png_filter_row(uint8_t *dst,const uint8_t *src,const uint8_t *prv,int c,int xstride) {
+static uint8_t png_filter_row(uint8_t *dst,const uint8_t *src,const uint8_t *prv,int c,int xstride,int filterc) {
   if (!prv) {
     // All filters are legal for the first row, but only NONE and SUB make sense.
     // (PAETH turns into SUB, UP turns into NONE, and AVG I'm not sure).
     int nonescore=png_filter_row_NONE(dst,src,0,c,xstride);
     int subscore=png_filter_row_SUB(dst,src,0,c,xstride);
-    if (subscore>=nonescore) { // SUB wins ties, since it's the last one and already present in buffer.
+    if (subscore<=nonescore) { // SUB wins ties, since it's the last one and already present in buffer.
       return 1;
     }
     memcpy(dst,src,c);
     return 0;
   }
-  // Normal case: Try all five filters, and keep whichever produces the most zeroes.
+  // Normal case: Try each filter, and keep whichever scores lowest.
   int nonescore=png_filter_row_NONE(dst,src,prv,c,xstride);
   int subscore=png_filter_row_SUB(dst,src,prv,c,xstride);
   int upscore=png_filter_row_UP(dst,src,prv,c,xstride);
-  int avgscore=png_filter_row_AVG(dst,src,prv,c,xstride);
-  int paethscore=png_filter_row_PAETH(dst,src,prv,c,xstride);
-  // Ties break in order of convenience: PAETH, NONE, SUB, UP, AVG
-  if ((paethscore>=avgscore)&&(paethscore>=upscore)&&(paethscore>=subscore)&&(paethscore>=nonescore)) {
-    return 4;
+  int avgscore=INT_MAX,paethscore=INT_MAX;
+  if (filterc>=5) {
+    avgscore=png_filter_row_AVG(dst,src,prv,c,xstride);
+    paethscore=png_filter_row_PAETH(dst,src,prv,c,xstride);
+    // Ties break in order of convenience: PAETH, NONE, SUB, UP, AVG
+    if ((paethscore<=avgscore)&&(paethscore<=upscore)&&(paethscore<=subscore)&&(paethscore<=nonescore)) {
+      return 4;
+    }
+  } else {
+    // Short list: UP is in the buffer, so it wins ties.
+    if ((upscore<=subscore)&&(upscore<=nonescore)) {
+      return 2;
+    }
   }
-  if ((nonescore>=avgscore)&&(nonescore>=upscore)&&(nonescore>=subscore)) {
+  if ((nonescore<=avgscore)&&(nonescore<=upscore)&&(nonescore<=subscore)) {
     memcpy(dst,src,c);
     return 0;
   }
-  if ((subscore>=avgscore)&&(subscore>=upscore)) {
+  if ((subscore<=avgscore)&&(subscore<=upscore)) {
     png_filter_row_SUB(dst,src,prv,c,xstride);
     return 1;
   }
-  if (upscore>=avgscore) {
+  if (upscore<=avgscore) {
     png_filter_row_UP(dst,src,prv,c,xstride);
     return 2;
   }
@@ -193,51 +228,181 @@ static uint8_t png_filter_row(uint8_t *dst,const uint8_t *src,const uint8_t *prv
   return 3;
 }
 
-/* Allocate more space in master output if needed, and point zlib to it.
+/* Filter all rows of one stripe into (ctx->fbuf).
+ * Rows filter independently of each other, since the previous row is read from the unfiltered source.
  */
  
-static int png_encoder_require_zlib_output(struct png_encoder *ctx) {
-  if (sr_encoder_require(ctx->dst,8192)<0) return -1;
-  ctx->z->next_out=(Bytef*)ctx->dst->v+ctx->dst->c;
-  ctx->z->avail_out=ctx->dst->a-ctx->dst->c;
-  return 0;
+static void png_stripe_filter(struct png_stripe *stripe) {
+  const struct png_encoder *ctx=stripe->ctx;
+  int rowbufc=1+ctx->stride;
+  const uint8_t *srcrow=(uint8_t*)ctx->image->v+stripe->y*ctx->image->stride;
+  const uint8_t *pvrow=stripe->y?(srcrow-ctx->image->stride):0;
+  uint8_t *dstrow=ctx->fbuf+stripe->y*rowbufc;
+  int yi=stripe->h;
+  for (;yi-->0;srcrow+=ctx->image->stride,dstrow+=rowbufc) {
+    dstrow[0]=png_filter_row(dstrow+1,srcrow,pvrow,ctx->stride,ctx->xstride,ctx->filterc);
+    pvrow=srcrow;
+  }
+  stripe->src=ctx->fbuf+stripe->y*rowbufc;
+  stripe->srcc=stripe->h*rowbufc;
 }
 
-/* Feed (rowbuf) into zlib, and advance output as needed.
+/* Deflate one stripe independently.
+ * Output is raw deflate, ending on a byte boundary.
+ * All but the last stripe end with a sync flush, and only the last one sets BFINAL.
+ * Each stripe after the first is primed with the preceding 32 kB of input, so compression barely suffers from the split.
+ * Then the stripes can be concatenated into one valid zlib stream.
  */
  
-static int png_encode_row(struct png_encoder *ctx) {
-  ctx->z->next_in=(Bytef*)ctx->rowbuf;
-  ctx->z->avail_in=ctx->rowbufc;
-  while (ctx->z->avail_in) {
-    if (png_encoder_require_zlib_output(ctx)<0) return -1;
-    int out0=ctx->z->total_out;
-    int err=deflate(ctx->z,Z_NO_FLUSH);
-    if (err<0) {
-      fprintf(stderr,"%s: deflate: %d\n",__func__,err);
-      return -1;
+static void png_stripe_deflate(struct png_stripe *stripe) {
+  const struct png_encoder *ctx=stripe->ctx;
+  stripe->err=-1;
+  stripe->adler=adler32(adler32(0,0,0),stripe->src,stripe->srcc);
+  z_stream z={0};
+  if (deflateInit2(&z,ctx->effort,Z_DEFLATED,-15,8,Z_DEFAULT_STRATEGY)<0) return;
+  int dictc=stripe->src-ctx->fbuf;
+  if (dictc>32768) dictc=32768;
+  if (dictc>0) {
+    if (deflateSetDictionary(&z,stripe->src-dictc,dictc)<0) {
+      deflateEnd(&z);
+      return;
     }
-    int outadd=ctx->z->total_out-out0;
-    ctx->dst->c+=outadd;
   }
-  return 0;
+  int final=(stripe->src+stripe->srcc>=ctx->fbuf+ctx->fbufc);
+  int dsta=deflateBound(&z,stripe->srcc)+16; // +16 for the sync flush marker, with room to spare.
+  if (!(stripe->dst=malloc(dsta))) {
+    deflateEnd(&z);
+    return;
+  }
+  z.next_in=(Bytef*)stripe->src;
+  z.avail_in=stripe->srcc;
+  z.next_out=stripe->dst;
+  z.avail_out=dsta;
+  int err=deflate(&z,final?Z_FINISH:Z_SYNC_FLUSH);
+  if (final?(err!=Z_STREAM_END):((err<0)||z.avail_in)) {
+    fprintf(stderr,"%s: deflate: %d\n",__func__,err);
+    deflateEnd(&z);
+    return;
+  }
+  stripe->dstc=dsta-z.avail_out;
+  deflateEnd(&z);
+  stripe->err=0;
 }
 
-/* Flush zlib out.
+/* Worker pool, shared by every encode in the process.
+ * Threads start the first time an image is big enough to split, and stay parked on (cond) after.
+ * One batch at a time: The calling thread posts its stripes, works on them alongside the pool, and waits for the stragglers.
+ * If another encode already has the pool, we just do our stripes on the calling thread.
  */
  
-static int png_encode_end_of_image(struct png_encoder *ctx) {
-  while (1) {
-    if (png_encoder_require_zlib_output(ctx)<0) return -1;
-    int out0=ctx->z->total_out;
-    int err=deflate(ctx->z,Z_FINISH);
-    if (err<0) {
-      fprintf(stderr,"%s: deflate(Z_FINISH): %d\n",__func__,err);
-      return -1;
+static struct png_pool {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond; // Work posted.
+  pthread_cond_t donecond; // (pendingc) reached zero.
+  pthread_once_t once;
+  int threadc;
+  int busy;
+  struct png_stripe *stripev; // WEAK. Null when idle.
+  int stripec;
+  int stripep; // Next stripe to take.
+  int pendingc; // Stripes taken or not, that haven't finished yet.
+  void (*fn)(struct png_stripe *stripe);
+} png_pool={
+  .mutex=PTHREAD_MUTEX_INITIALIZER,
+  .cond=PTHREAD_COND_INITIALIZER,
+  .donecond=PTHREAD_COND_INITIALIZER,
+  .once=PTHREAD_ONCE_INIT,
+};
+
+/* Take and run stripes until there's none left to take.
+ * Call with the mutex locked; it's locked again when we return.
+ */
+ 
+static void png_pool_work(void) {
+  while (png_pool.stripev&&(png_pool.stripep<png_pool.stripec)) {
+    struct png_stripe *stripe=png_pool.stripev+png_pool.stripep++;
+    void (*fn)(struct png_stripe*)=png_pool.fn;
+    pthread_mutex_unlock(&png_pool.mutex);
+    fn(stripe);
+    pthread_mutex_lock(&png_pool.mutex);
+    if (!--(png_pool.pendingc)) pthread_cond_broadcast(&png_pool.donecond);
+  }
+}
+
+static void *png_pool_thread(void *arg) {
+  pthread_mutex_lock(&png_pool.mutex);
+  for (;;) {
+    while (!png_pool.stripev||(png_pool.stripep>=png_pool.stripec)) {
+      pthread_cond_wait(&png_pool.cond,&png_pool.mutex);
     }
-    int outadd=ctx->z->total_out-out0;
-    ctx->dst->c+=outadd;
-    if (err=Z_STREAM_END) break;
+    png_pool_work();
+  }
+  return 0;
+}
+
+static void png_pool_init(void) {
+  long cpuc=sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpuc>PNG_THREAD_LIMIT) cpuc=PNG_THREAD_LIMIT;
+  // The calling thread is a worker too, so one fewer than the CPU count.
+  int i=(int)cpuc-1;
+  for (;i-->0;) {
+    pthread_t thread;
+    if (pthread_create(&thread,0,png_pool_thread,0)) break;
+    pthread_detach(thread);
+    png_pool.threadc++;
+  }
+}
+
+/* Run a function against every stripe, in parallel if there's more than one.
+ */
+ 
+static void png_stripes_run(struct png_encoder *ctx,void (*fn)(struct png_stripe *stripe)) {
+  if (ctx->stripec<2) {
+    if (ctx->stripec==1) fn(ctx->stripev);
+    return;
+  }
+  pthread_once(&png_pool.once,png_pool_init);
+  pthread_mutex_lock(&png_pool.mutex);
+  if (png_pool.busy||!png_pool.threadc) {
+    pthread_mutex_unlock(&png_pool.mutex);
+    int i=0; for (;i<ctx->stripec;i++) fn(ctx->stripev+i);
+    return;
+  }
+  png_pool.busy=1;
+  png_pool.stripev=ctx->stripev;
+  png_pool.stripec=ctx->stripec;
+  png_pool.stripep=0;
+  png_pool.pendingc=ctx->stripec;
+  png_pool.fn=fn;
+  pthread_cond_broadcast(&png_pool.cond);
+  png_pool_work();
+  while (png_pool.pendingc) pthread_cond_wait(&png_pool.donecond,&png_pool.mutex);
+  png_pool.stripev=0;
+  png_pool.fn=0;
+  png_pool.busy=0;
+  pthread_mutex_unlock(&png_pool.mutex);
+}
+
+/* Decide how many stripes to use, and lay them out.
+ */
+ 
+static int png_encoder_plan_stripes(struct png_encoder *ctx) {
+  int stripec=ctx->fbufc/PNG_STRIPE_MIN;
+  long cpuc=sysconf(_SC_NPROCESSORS_ONLN);
+  if (cpuc<1) cpuc=1;
+  if (stripec>cpuc) stripec=cpuc;
+  if (stripec>PNG_THREAD_LIMIT) stripec=PNG_THREAD_LIMIT;
+  if (stripec>ctx->image->h) stripec=ctx->image->h;
+  if (stripec<1) stripec=1;
+  if (!(ctx->stripev=calloc(stripec,sizeof(struct png_stripe)))) return -1;
+  ctx->stripec=stripec;
+  int y=0,i=0;
+  for (;i<stripec;i++) {
+    struct png_stripe *stripe=ctx->stripev+i;
+    stripe->ctx=ctx;
+    stripe->y=y;
+    stripe->h=(ctx->image->h-y)/(stripec-i);
+    y+=stripe->h;
   }
   return 0;
 }
@@ -247,29 +412,37 @@ static int png_encode_end_of_image(struct png_encoder *ctx) {
  */
  
 static int png_encode_IDAT(struct png_encoder *ctx) {
+  ctx->xstride=(ctx->image->pixelsize+7)>>3;
+  int rowbufc=1+ctx->stride;
+  if (rowbufc>INT_MAX/ctx->image->h) return -1;
+  ctx->fbufc=rowbufc*ctx->image->h;
+  if (!(ctx->fbuf=malloc(ctx->fbufc))) return -1;
+  if (png_encoder_plan_stripes(ctx)<0) return -1;
+  
+  png_stripes_run(ctx,png_stripe_filter);
+  png_stripes_run(ctx,png_stripe_deflate);
+  
   int lenp=ctx->dst->c;
   if (sr_encode_raw(ctx->dst,"\0\0\0\0IDAT",8)<0) return -1;
   
-  ctx->rowbufc=1+ctx->stride;
-  if (!(ctx->rowbuf=malloc(ctx->rowbufc))) return -1;
-  ctx->xstride=(ctx->image->pixelsize+7)>>3;
-  
-  if (!(ctx->z=calloc(1,sizeof(z_stream)))) return -1;
-  if (deflateInit(ctx->z,Z_BEST_COMPRESSION)<0) {
-    free(ctx->z);
-    ctx->z=0;
-    return -1;
-  }
+  // zlib header, with FLEVEL chosen to match what deflateInit would have said.
+  uint8_t flg;
+       if (ctx->effort<2) flg=0x01;
+  else if (ctx->effort<6) flg=0x5e;
+  else if (ctx->effort==6) flg=0x9c;
+  else flg=0xda;
+  if (sr_encode_u8(ctx->dst,0x78)<0) return -1;
+  if (sr_encode_u8(ctx->dst,flg)<0) return -1;
   
-  const uint8_t *pvrow=0;
-  const uint8_t *srcrow=ctx->image->v;
-  int y=0;
-  for (;y<ctx->image->h;y++,srcrow+=ctx->image->stride) {
-    ctx->rowbuf[0]=png_filter_row(ctx->rowbuf+1,srcrow,pvrow,ctx->stride,ctx->xstride);
-    if (png_encode_row(ctx)<0) return -1;
-    pvrow=srcrow;
+  uLong adler=adler32(0,0,0);
+  const struct png_stripe *stripe=ctx->stripev;
+  int i=ctx->stripec;
+  for (;i-->0;stripe++) {
+    if (stripe->err<0) return -1;
+    if (sr_encode_raw(ctx->dst,stripe->dst,stripe->dstc)<0) return -1;
+    adler=adler32_combine(adler,stripe->adler,stripe->srcc);
   }
-  if (png_encode_end_of_image(ctx)<0) return -1;
+  if (sr_encode_intbe(ctx->dst,adler,4)<0) return -1;
   
   int len=ctx->dst->c-lenp-8;
   int crc=crc32(crc32(0,0,0),((Bytef*)ctx->dst->v)+lenp+4,ctx->dst->c-lenp-4);
@@ -287,6 +460,7 @@ static int png_encode_IDAT(struct png_encoder *ctx) {
  
 static int png_encode_inner(struct png_encoder *ctx) {
 
+  if ((ctx->image->w<1)||(ctx->image->h<1)) return -1;
   if ((ctx->stride=png_minimum_stride(ctx->image->w,ctx->image->pixelsize))<1) return -1;
   if (ctx->stride>ctx->image->stride) return -1;
 
@@ -302,10 +476,17 @@ static int png_encode_inner(struct png_encoder *ctx) {
  */
 
 int png_encode(struct sr_encoder *dst,const struct png_image *image) {
+  return png_encode_effort(dst,image,0);
+}
+
+int png_encode_effort(struct sr_encoder *dst,const struct png_image *image,int effort) {
   if (!dst||!image) return -1;
+  if ((effort<1)||(effort>9)) effort=9;
   struct png_encoder ctx={
     .dst=dst,
     .image=image,
+    .effort=effort,
+    .filterc=(effort>=4)?5:3,
   };
   int err=png_encode_inner(&ctx);
   png_encoder_cleanup(&ctx);
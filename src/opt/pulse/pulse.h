@@ -41,6 +41,11 @@ int pulse_get_rate(const struct pulse *pulse);
 int pulse_get_chanc(const struct pulse *pulse);
 int pulse_get_running(const struct pulse *pulse);
 
+/* Frames generated by pcm_out that haven't been played yet, from any thread, without locking.
+ * We ask the server after each write, and estimate from there.
+ */
+int pulse_get_latency(struct pulse *pulse);
+
 void pulse_set_running(struct pulse *pulse,int running);
 
 int pulse_update(struct pulse *pulse);
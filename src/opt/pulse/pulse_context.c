@@ -1,5 +1,11 @@
 #include "pulse_internal.h"
 
+static int64_t pulse_now_us() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (int64_t)ts.tv_sec*1000000+ts.tv_nsec/1000;
+}
+
 /* I/O thread.
  */
  
@@ -12,6 +18,8 @@ static void *pulse_iothd(void *arg) {
       usleep(1000);
       continue;
     }
+    // Set before pcm_out advances the synth's frame count, so latency never misses this buffer.
+    __atomic_store_n(&pulse->unwrittenc,pulse->bufa/pulse->chanc,__ATOMIC_RELAXED);
     if (pulse->running) {
       pulse->delegate.pcm_out(pulse->buf,pulse->bufa,pulse->delegate.userdata);
     } else {
@@ -29,6 +37,11 @@ static void *pulse_iothd(void *arg) {
       pulse->ioerror=-1;
       return 0;
     }
+    pa_usec_t latency=pa_simple_get_latency(pulse->pa,&err);
+    if (latency!=(pa_usec_t)-1) {
+      __atomic_store_n(&pulse->drain_us,pulse_now_us()+(int64_t)latency,__ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&pulse->unwrittenc,0,__ATOMIC_RELAXED);
   }
 }
 
@@ -194,6 +207,14 @@ int pulse_get_running(const struct pulse *pulse) {
   return pulse->running;
 }
 
+int pulse_get_latency(struct pulse *pulse) {
+  if (!pulse) return -1;
+  int64_t remaining=__atomic_load_n(&pulse->drain_us,__ATOMIC_RELAXED)-pulse_now_us();
+  int framec=__atomic_load_n(&pulse->unwrittenc,__ATOMIC_RELAXED);
+  if (remaining>0) framec+=(int)((remaining*pulse->rate)/1000000);
+  return framec;
+}
+
 void pulse_set_running(struct pulse *pulse,int running) {
   if (!pulse) return;
   pulse->running=running?1:0;
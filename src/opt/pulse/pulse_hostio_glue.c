@@ -56,6 +56,10 @@ static void _pulse_unlock(struct hostio_audio *driver) {
   pulse_unlock(DRIVER->pulse);
 }
 
+static int _pulse_get_latency(struct hostio_audio *driver) {
+  return pulse_get_latency(DRIVER->pulse);
+}
+
 /* Type definition.
  */
  
@@ -69,4 +73,5 @@ const struct hostio_audio_type hostio_audio_type_pulse={
   .play=_pulse_play,
   .lock=_pulse_lock,
   .unlock=_pulse_unlock,
+  .get_latency=_pulse_get_latency,
 };
@@ -7,6 +7,7 @@
 #include <endian.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <time.h>
 #include <pulse/pulseaudio.h>
 #include <pulse/simple.h>
 
@@ -19,6 +20,8 @@ struct pulse {
   int16_t *buf;
   int bufa; // samples
   pa_simple *pa;
+  int unwrittenc; // frames; Generated but not yet accepted by the server. Atomic.
+  int64_t drain_us; // CLOCK_MONOTONIC microseconds when the server will have played all we've written. Atomic.
 };
 
 #endif
@@ -7,6 +7,7 @@
 #define QJS_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 struct qjs;
 
@@ -24,7 +25,16 @@ int qjs_update(struct qjs *qjs);
  */
 int qjs_set_exports(struct qjs *qjs,const char *modname,const void *entryv,int entryc);
 
+/* (v) is either Javascript source, or the output of qjs_compile_bytecode.
+ * By default, we always compile the source that travels with bytecode.
+ * After qjs_set_allow_bytecode(qjs,1), we use the bytecode if it came from a QuickJS build just like ours.
+ */
 int qjs_add_module(struct qjs *qjs,int modid,const void *v,int c,const char *refname);
+
+/* QuickJS does not validate bytecode: A malicious or corrupt module can do anything to the host process.
+ * So bytecode is ignored unless you opt in here. Only do that for modules you trust as much as the host itself.
+ */
+int qjs_set_allow_bytecode(struct qjs *qjs,int allow);
 int qjs_link_function(struct qjs *qjs,int modid,int fnid,const char *name);
 
 /* Return value goes in (argv[0]).
@@ -44,4 +54,52 @@ int qjs_callf(struct qjs *qjs,int modid,int fnid,const char *fmt,...);
 
 void *qjs_get_context(struct qjs *qjs); // => JSContext*
 
+/* Point (*dstpp) at the content of an Int32Array and return its length in elements.
+ * (jsctx) is JSContext*, and (jsvaluep) is JSValue*.
+ * For host functions that fill a client's buffer without allocating anything.
+ * Anything but an Int32Array fails, even other typed arrays with 4-byte elements.
+ * The pointer is valid until control returns to Javascript.
+ */
+int qjs_borrow_int32_array(int32_t **dstpp,void *jsctx,const void *jsvaluep);
+
+/* Garbage collection.
+ * Reference counting frees most things immediately. The collector is only for cycles, but a full pass can take milliseconds.
+ * QJS_GC_AUTO: QuickJS decides, whenever allocation crosses its threshold. Could be in the middle of an update.
+ * QJS_GC_IDLE: Default. No automatic collection; host must call qjs_gc_idle() with its spare time each frame.
+ * QJS_GC_OFF: Never collect cycles. For measurement, not for real use.
+ * (limit_bytes) zero for no limit. Allocations beyond it fail, and the client sees an exception.
+ */
+#define QJS_GC_AUTO 0
+#define QJS_GC_IDLE 1
+#define QJS_GC_OFF  2
+int qjs_set_gc_policy(struct qjs *qjs,int policy);
+int qjs_set_memory_limit(struct qjs *qjs,size_t limit_bytes);
+
+/* Host has (budget) seconds of nothing to do.
+ * Under QJS_GC_IDLE, we collect if it's been a while and the last collection took less than (budget).
+ * If it's been a long while, we collect regardless of budget.
+ * Returns 1 if we collected, 0 if not.
+ */
+int qjs_gc_idle(struct qjs *qjs,double budget);
+
+/* Stats for reporting, not cheap: We walk the whole heap.
+ */
+struct qjs_stats {
+  int gcc; // Collections run by qjs_gc_idle. QuickJS's own automatic ones aren't counted.
+  double gctime,gcmax; // Seconds, total and longest.
+  int64_t heap_size; // Bytes we have from malloc.
+  int64_t used_size; // Bytes QuickJS is using.
+  int64_t objc; // Live objects.
+  int64_t limit; // Memory limit, or zero.
+};
+void qjs_get_stats(struct qjs_stats *stats,struct qjs *qjs);
+
+/* Compile Javascript source to a module that qjs_add_module can load without parsing.
+ * On success, (*dstpp) is a new buffer that caller must free, and we return its length.
+ * Output is: "\0EJB", u32 fingerprint, u32 bytecode length, bytecode, and the original source.
+ * Bytecode is only usable by the same QuickJS build, the fingerprint is how we tell.
+ * It is only used at all by a qjs with qjs_set_allow_bytecode.
+ */
+int qjs_compile_bytecode(void *dstpp,const void *src,int srcc,const char *refname);
+
 #endif
@@ -141,6 +141,7 @@ struct qjs *qjs_new() {
   }
   JS_SetContextOpaque(qjs->jsctx,qjs);
   JS_SetModuleLoaderFunc(qjs->jsrt,0,qjs_module_loader,0);
+  qjs_set_gc_policy(qjs,QJS_GC_IDLE);
   
   JSValue globals=JS_GetGlobalObject(qjs->jsctx);
   JSValue exportModule=JS_NewCFunction(qjs->jsctx,qjs_exportModule,"exportModule",1);
@@ -198,12 +199,140 @@ int qjs_set_exports(struct qjs *qjs,const char *modname,const void *entryv,int e
   return 0;
 }
 
+/* Bytecode fingerprint.
+ * QuickJS bytecode is only valid for the exact build that wrote it, and its own version byte is not a reliable check.
+ * So we compile a fixed probe and hash the result. Different opcodes or atom tables yield a different hash.
+ */
+ 
+static uint32_t qjs_bytecode_fingerprint(JSContext *ctx) {
+  const char probe[]="function a(b,c){return [b+1,'d',{e:c*2.5},typeof b,b?.f??null];}";
+  JSValue fn=JS_Eval(ctx,probe,sizeof(probe)-1,"probe",JS_EVAL_TYPE_GLOBAL|JS_EVAL_FLAG_STRICT|JS_EVAL_FLAG_COMPILE_ONLY);
+  if (JS_IsException(fn)) {
+    JS_FreeValue(ctx,JS_GetException(ctx));
+    return 0;
+  }
+  size_t bcc=0;
+  uint8_t *bc=JS_WriteObject(ctx,&bcc,fn,JS_WRITE_OBJ_BYTECODE);
+  JS_FreeValue(ctx,fn);
+  if (!bc) return 0;
+  uint32_t hash=0x811c9dc5; // FNV-1a
+  size_t i=0;
+  for (;i<bcc;i++) hash=(hash^bc[i])*0x01000193;
+  js_free(ctx,bc);
+  return hash?hash:1;
+}
+
+/* Compile module to bytecode.
+ */
+ 
+int qjs_compile_bytecode(void *dstpp,const void *src,int srcc,const char *refname) {
+  if (!dstpp||(srcc<0)||(srcc&&!src)) return -1;
+  struct qjs *qjs=qjs_new();
+  if (!qjs) return -1;
+  char *ztext=malloc(srcc+1);
+  if (!ztext) {
+    qjs_del(qjs);
+    return -1;
+  }
+  memcpy(ztext,src,srcc);
+  ztext[srcc]=0;
+  JSValue fn=JS_Eval(qjs->jsctx,ztext,srcc,refname,JS_EVAL_TYPE_MODULE|JS_EVAL_FLAG_STRICT|JS_EVAL_FLAG_COMPILE_ONLY);
+  free(ztext);
+  int err;
+  if ((err=qjs_check_js_exception(qjs,fn))<0) {
+    qjs_del(qjs);
+    return err;
+  }
+  size_t bcc=0;
+  uint8_t *bc=JS_WriteObject(qjs->jsctx,&bcc,fn,JS_WRITE_OBJ_BYTECODE);
+  JS_FreeValue(qjs->jsctx,fn);
+  if (!bc||(bcc>INT_MAX-QJS_BYTECODE_HEADER_SIZE-srcc)) {
+    if (bc) js_free(qjs->jsctx,bc);
+    qjs_del(qjs);
+    return -1;
+  }
+  int dstc=QJS_BYTECODE_HEADER_SIZE+bcc+srcc;
+  uint8_t *dst=malloc(dstc);
+  if (!dst) {
+    js_free(qjs->jsctx,bc);
+    qjs_del(qjs);
+    return -1;
+  }
+  uint32_t fingerprint=qjs_bytecode_fingerprint(qjs->jsctx);
+  memcpy(dst,QJS_BYTECODE_MAGIC,4);
+  dst[4]=fingerprint>>24;
+  dst[5]=fingerprint>>16;
+  dst[6]=fingerprint>>8;
+  dst[7]=fingerprint;
+  dst[8]=bcc>>24;
+  dst[9]=bcc>>16;
+  dst[10]=bcc>>8;
+  dst[11]=bcc;
+  memcpy(dst+QJS_BYTECODE_HEADER_SIZE,bc,bcc);
+  memcpy(dst+QJS_BYTECODE_HEADER_SIZE+bcc,src,srcc);
+  js_free(qjs->jsctx,bc);
+  qjs_del(qjs);
+  *(void**)dstpp=dst;
+  return dstc;
+}
+
+/* Permit bytecode.
+ */
+ 
+int qjs_set_allow_bytecode(struct qjs *qjs,int allow) {
+  if (!qjs) return -1;
+  qjs->allow_bytecode=allow?1:0;
+  return 0;
+}
+
+/* Evaluate precompiled module.
+ * Returns JS_UNINITIALIZED if the bytecode is unusable, and caller should fall back to source.
+ */
+ 
+static JSValue qjs_eval_bytecode(struct qjs *qjs,const uint8_t *bc,int bcc,const char *refname) {
+  JSValue fn=JS_ReadObject(qjs->jsctx,bc,bcc,JS_READ_OBJ_BYTECODE);
+  if (JS_IsException(fn)) {
+    JS_FreeValue(qjs->jsctx,JS_GetException(qjs->jsctx));
+    fprintf(stderr,"%s: Failed to read bytecode. Compiling from source instead.\n",refname);
+    return JS_UNINITIALIZED;
+  }
+  if (JS_ResolveModule(qjs->jsctx,fn)<0) {
+    JS_FreeValue(qjs->jsctx,fn);
+    return JS_EXCEPTION;
+  }
+  return JS_EvalFunction(qjs->jsctx,fn);
+}
+
 /* Add module.
  */
 
 int qjs_add_module(struct qjs *qjs,int modid,const void *v,int c,const char *refname) {
   int err;
   if (qjs->module_loading) return -1;
+  
+  // Precompiled bytecode is followed by the original source, which we use if bytecode isn't allowed or doesn't match our build.
+  const uint8_t *bc=0;
+  int bcc=0;
+  if ((c>=QJS_BYTECODE_HEADER_SIZE)&&!memcmp(v,QJS_BYTECODE_MAGIC,4)) {
+    const uint8_t *V=v;
+    uint32_t fingerprint=((uint32_t)V[4]<<24)|(V[5]<<16)|(V[6]<<8)|V[7];
+    uint32_t bclen=((uint32_t)V[8]<<24)|(V[9]<<16)|(V[10]<<8)|V[11];
+    if (bclen>(uint32_t)(c-QJS_BYTECODE_HEADER_SIZE)) return -1;
+    bcc=bclen;
+    bc=V+QJS_BYTECODE_HEADER_SIZE;
+    v=bc+bcc;
+    c-=QJS_BYTECODE_HEADER_SIZE+bcc;
+    if (!qjs->allow_bytecode) {
+      bc=0;
+    } else {
+      if (!qjs->bytecode_fingerprint) qjs->bytecode_fingerprint=qjs_bytecode_fingerprint(qjs->jsctx);
+      if (!qjs->bytecode_fingerprint||(fingerprint!=qjs->bytecode_fingerprint)) {
+        fprintf(stderr,"%s: Bytecode is from a different QuickJS build. Compiling from source instead.\n",refname);
+        bc=0;
+      }
+    }
+  }
+  
   if (qjs->modulec>=qjs->modulea) {
     int na=qjs->modulea+8;
     if (na>INT_MAX/sizeof(struct qjs_module)) return -1;
@@ -216,24 +345,33 @@ int qjs_add_module(struct qjs *qjs,int modid,const void *v,int c,const char *ref
   memset(module,0,sizeof(struct qjs_module));
   module->modid=modid;
   
-  // quickjs requires input text to be nul-terminated, and we will not pass that daffy requirement to our consumers.
-  char *ztext=malloc(c+1);
-  if (!ztext) {
-    qjs->modulec--;
-    return -1;
-  }
-  memcpy(ztext,v,c);
-  ztext[c]=0;
-  
   /* The result when loading with JS_EVAL_TYPE_MODULE is undefined,
    * and any 'exports' in that module are mysteriously unavailable to us.
    * We could use the default JS_EVAL_TYPE_GLOBAL, but then we can't import other Javascript!
    * So we're going to invent our own export function and expose it to clients.
    */
-  qjs->module_loading=module;
-  JSValue result=JS_Eval(qjs->jsctx,ztext,c,refname,JS_EVAL_TYPE_MODULE|JS_EVAL_FLAG_STRICT);
-  qjs->module_loading=0;
-  free(ztext);
+  JSValue result=JS_UNINITIALIZED;
+  if (bc) {
+    qjs->module_loading=module;
+    result=qjs_eval_bytecode(qjs,bc,bcc,refname);
+    qjs->module_loading=0;
+  }
+  if (JS_VALUE_GET_TAG(result)==JS_TAG_UNINITIALIZED) {
+  
+    // quickjs requires input text to be nul-terminated, and we will not pass that daffy requirement to our consumers.
+    char *ztext=malloc(c+1);
+    if (!ztext) {
+      qjs->modulec--;
+      return -1;
+    }
+    memcpy(ztext,v,c);
+    ztext[c]=0;
+  
+    qjs->module_loading=module;
+    result=JS_Eval(qjs->jsctx,ztext,c,refname,JS_EVAL_TYPE_MODULE|JS_EVAL_FLAG_STRICT);
+    qjs->module_loading=0;
+    free(ztext);
+  }
   if ((err=qjs_check_js_exception(qjs,result))<0) {
     qjs->modulec--;
     return err;
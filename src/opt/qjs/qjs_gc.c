@@ -0,0 +1,73 @@
+#include "qjs_internal.h"
+#include <time.h>
+
+/* Clock.
+ */
+ 
+static double qjs_now() {
+  struct timespec tv={0};
+  clock_gettime(CLOCK_MONOTONIC,&tv);
+  return (double)tv.tv_sec+(double)tv.tv_nsec/1000000000.0;
+}
+
+/* Policy.
+ */
+ 
+int qjs_set_gc_policy(struct qjs *qjs,int policy) {
+  if (!qjs||!qjs->jsrt) return -1;
+  switch (policy) {
+    case QJS_GC_AUTO: JS_SetGCThreshold(qjs->jsrt,QJS_AUTO_GC_THRESHOLD); break;
+    case QJS_GC_IDLE:
+    case QJS_GC_OFF: JS_SetGCThreshold(qjs->jsrt,(size_t)-1); break;
+    default: return -1;
+  }
+  qjs->gc_policy=policy;
+  qjs->gc_lasttime=qjs_now();
+  return 0;
+}
+
+int qjs_set_memory_limit(struct qjs *qjs,size_t limit_bytes) {
+  if (!qjs||!qjs->jsrt) return -1;
+  // QuickJS takes zero to mean zero, and (size_t)-1 to mean unlimited.
+  JS_SetMemoryLimit(qjs->jsrt,limit_bytes?limit_bytes:(size_t)-1);
+  qjs->memory_limit=limit_bytes;
+  return 0;
+}
+
+/* Collect in idle time.
+ */
+ 
+int qjs_gc_idle(struct qjs *qjs,double budget) {
+  if (!qjs||!qjs->jsrt) return 0;
+  if (qjs->gc_policy!=QJS_GC_IDLE) return 0;
+  double now=qjs_now();
+  double since=now-qjs->gc_lasttime;
+  if (since<QJS_GC_INTERVAL) return 0;
+  if ((since<QJS_GC_DEADLINE)&&(qjs->gc_estimate>budget)) return 0;
+  JS_RunGC(qjs->jsrt);
+  double after=qjs_now();
+  double elapsed=after-now;
+  qjs->gc_lasttime=after;
+  qjs->gc_estimate=elapsed;
+  qjs->gcc++;
+  qjs->gctime+=elapsed;
+  if (elapsed>qjs->gcmax) qjs->gcmax=elapsed;
+  return 1;
+}
+
+/* Stats.
+ */
+ 
+void qjs_get_stats(struct qjs_stats *stats,struct qjs *qjs) {
+  memset(stats,0,sizeof(struct qjs_stats));
+  if (!qjs||!qjs->jsrt) return;
+  stats->gcc=qjs->gcc;
+  stats->gctime=qjs->gctime;
+  stats->gcmax=qjs->gcmax;
+  stats->limit=qjs->memory_limit;
+  JSMemoryUsage usage={0};
+  JS_ComputeMemoryUsage(qjs->jsrt,&usage);
+  stats->heap_size=usage.malloc_size;
+  stats->used_size=usage.memory_used_size;
+  stats->objc=usage.obj_count;
+}
@@ -10,6 +10,9 @@
 #include <stdarg.h>
 #include "quickjs.h"
 
+#define QJS_BYTECODE_MAGIC "\0EJB"
+#define QJS_BYTECODE_HEADER_SIZE 12
+
 struct qjs_function {
   int fnid;
   JSValue jsfn;
@@ -38,6 +41,18 @@ struct qjs {
   int tmpa;
   struct qjs_hostmod *hostmodv;
   int hostmodc,hostmoda;
+  int gc_policy;
+  size_t memory_limit;
+  int allow_bytecode; // Zero (default) to ignore precompiled bytecode and always compile the source.
+  uint32_t bytecode_fingerprint; // Our own, computed at the first bytecode module. Zero if not yet.
+  double gc_lasttime; // Real time of the last collection, or creation.
+  double gc_estimate; // Duration of the last collection, our guess for the next one.
+  int gcc;
+  double gctime,gcmax;
 };
 
+#define QJS_GC_INTERVAL 1.0 /* Collect at most so often, in idle time. */
+#define QJS_GC_DEADLINE 5.0 /* Collect anyway if it's been so long, even with no budget. */
+#define QJS_AUTO_GC_THRESHOLD (256*1024) /* QuickJS's own default. */
+
 #endif
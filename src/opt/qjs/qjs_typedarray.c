@@ -0,0 +1,38 @@
+#include "qjs_internal.h"
+
+/* Borrow Int32Array.
+ */
+ 
+int qjs_borrow_int32_array(int32_t **dstpp,void *jsctx,const void *jsvaluep) {
+  if (!dstpp||!jsctx||!jsvaluep) return -1;
+  JSContext *ctx=jsctx;
+  JSValueConst v=*(const JSValue*)jsvaluep;
+  
+  // JS_GetTypedArrayBuffer takes any typed array, and only tells us the element size.
+  // Float32Array and Uint32Array would pass that, so check the class first.
+  JSValue global=JS_GetGlobalObject(ctx);
+  JSValue ctor=JS_GetPropertyStr(ctx,global,"Int32Array");
+  JS_FreeValue(ctx,global);
+  int isint32=JS_IsInstanceOf(ctx,v,ctor);
+  JS_FreeValue(ctx,ctor);
+  if (isint32<=0) {
+    if (isint32<0) JS_FreeValue(ctx,JS_GetException(ctx));
+    return -1;
+  }
+  
+  size_t offset=0,len=0,elemsize=0,abufc=0;
+  JSValue abuf=JS_GetTypedArrayBuffer(ctx,v,&offset,&len,&elemsize);
+  if (JS_IsException(abuf)) { // eg Object.create(Int32Array.prototype)
+    JS_FreeValue(ctx,JS_GetException(ctx));
+    return -1;
+  }
+  uint8_t *abufv=JS_GetArrayBuffer(ctx,&abufc,abuf);
+  JS_FreeValue(ctx,abuf);
+  if (!abufv) { // Detached.
+    JS_FreeValue(ctx,JS_GetException(ctx));
+    return -1;
+  }
+  if ((elemsize!=4)||(offset&3)||(offset>abufc)||(len>abufc-offset)||(len>INT_MAX)) return -1;
+  *dstpp=(int32_t*)(abufv+offset);
+  return len>>2;
+}
@@ -19,6 +19,8 @@ void qoi_image_del(struct qoi_image *image) {
 }
 
 /* Encode.
+ * We reserve output space a row at a time and write ops directly, rather than sr_encode_u8 per byte.
+ * Runs are measured all at once, comparing two pixels per step.
  */
 
 int qoi_encode(struct sr_encoder *dst,const struct qoi_image *src) {
@@ -31,88 +33,107 @@ int qoi_encode(struct sr_encoder *dst,const struct qoi_image *src) {
   if (sr_encode_u8(dst,1)<0) return -1; // linear, as opposed to sRGB
   
   // Payload.
-  const uint8_t *srcp=(uint8_t*)src->v;
-  int srcc=src->w*src->h; // remaining input pixel count
+  const uint8_t *srcv=(uint8_t*)src->v;
+  int pxc=src->w*src->h;
   uint8_t prev[]={0,0,0,0xff};
-  uint8_t buf[256]={0};
+  uint32_t prevpx;
+  memcpy(&prevpx,prev,4);
+  uint32_t buf[64]={0};
   int runlen=0;
-  while (srcc-->0) {
+  int srcp=0; // pixels
+  while (srcp<pxc) {
   
-    // Pop the next pixel.
-    uint8_t r=*srcp++;
-    uint8_t g=*srcp++;
-    uint8_t b=*srcp++;
-    uint8_t a=*srcp++;
+    // One row at a time, no op is longer than 5 bytes, and a row can end at most one run.
+    int rowend=srcp+src->w;
+    if (rowend>pxc) rowend=pxc;
+    if (sr_encoder_require(dst,(rowend-srcp)*5+1)<0) return -1;
+    uint8_t *dstv=(uint8_t*)dst->v+dst->c;
+    int dstp=0;
     
-    // Continue or terminate run.
-    if ((r==prev[0])&&(g==prev[1])&&(b==prev[2])&&(a==prev[3])) {
-      runlen++;
-      if (runlen>=62) {
-        if (sr_encode_u8(dst,0xfd)<0) return -1;
+    while (srcp<rowend) {
+      const uint8_t *px=srcv+(srcp<<2);
+      uint32_t pxv;
+      memcpy(&pxv,px,4);
+    
+      // Continue run, consuming as much of it as we can in one pass.
+      if (pxv==prevpx) {
+        uint64_t pair=((uint64_t)pxv<<32)|pxv;
+        int runend=srcp+1;
+        while (runend<=rowend-2) {
+          uint64_t next;
+          memcpy(&next,srcv+(runend<<2),8);
+          if (next!=pair) break;
+          runend+=2;
+        }
+        if (runend<rowend) {
+          uint32_t next;
+          memcpy(&next,srcv+(runend<<2),4);
+          if (next==pxv) runend++;
+        }
+        runlen+=runend-srcp;
+        srcp=runend;
+        while (runlen>=62) {
+          dstv[dstp++]=0xfd;
+          runlen-=62;
+        }
+        continue;
+      }
+      if (runlen) {
+        dstv[dstp++]=0xc0|(runlen-1);
         runlen=0;
       }
-      continue;
-    }
-    if (runlen) {
-      if (sr_encode_u8(dst,0xc0|(runlen-1))<0) return -1;
-      runlen=0;
-    }
-    
-    // QOI_OP_INDEX if it matches the buffer, otherwise update buffer.
-    int bufp=((r*3+g*5+b*7+a*11)&0x3f)<<2;
-    if ((r==buf[bufp])&&(g==buf[bufp+1])&&(b==buf[bufp+2])&&(a==buf[bufp+3])) {
-      if (sr_encode_u8(dst,bufp>>2)<0) return -1;
-      prev[0]=r;
-      prev[1]=g;
-      prev[2]=b;
-      prev[3]=a;
-      continue;
-    }
-    buf[bufp++]=r;
-    buf[bufp++]=g;
-    buf[bufp++]=b;
-    buf[bufp++]=a;
-    
-    // Check difference per channel from previous, and update previous.
-    int dr=r-prev[0];
-    int dg=g-prev[1];
-    int db=b-prev[2];
-    int da=a-prev[3];
-    prev[0]=r;
-    prev[1]=g;
-    prev[2]=b;
-    prev[3]=a;
-    
-    // If alpha didn't change, check for QOI_OP_DIFF and QOI_OP_LUMA.
-    if (!da) {
-      if ((dr>=-2)&&(dr<=1)&&(dg>=-2)&&(dg<=1)&&(db>=-2)&&(db<=1)) {
-        if (sr_encode_u8(dst,0x40|((dr+2)<<4)|((dg+2)<<2)|(db+2))<0) return -1;
+      srcp++;
+      
+      // QOI_OP_INDEX if it matches the buffer, otherwise update buffer.
+      uint8_t r=px[0],g=px[1],b=px[2],a=px[3];
+      int bufp=(r*3+g*5+b*7+a*11)&0x3f;
+      if (buf[bufp]==pxv) {
+        dstv[dstp++]=bufp;
+        prevpx=pxv;
+        memcpy(prev,px,4);
         continue;
       }
-      if ((dg>=-32)&&(dg<=31)) {
-        dr-=dg;
-        db-=dg;
-        if ((dr>=-8)&&(dr<=7)&&(db>=-8)&&(db<=7)) {
-          if (sr_encode_u8(dst,0x80|(dg+32))<0) return -1;
-          if (sr_encode_u8(dst,((dr+8)<<4)|(db+8))<0) return -1;
+      buf[bufp]=pxv;
+      
+      // Check difference per channel from previous, and update previous.
+      int dr=r-prev[0];
+      int dg=g-prev[1];
+      int db=b-prev[2];
+      int da=a-prev[3];
+      prevpx=pxv;
+      memcpy(prev,px,4);
+      
+      // If alpha didn't change, check for QOI_OP_DIFF and QOI_OP_LUMA.
+      if (!da) {
+        if ((dr>=-2)&&(dr<=1)&&(dg>=-2)&&(dg<=1)&&(db>=-2)&&(db<=1)) {
+          dstv[dstp++]=0x40|((dr+2)<<4)|((dg+2)<<2)|(db+2);
           continue;
         }
+        if ((dg>=-32)&&(dg<=31)) {
+          dr-=dg;
+          db-=dg;
+          if ((dr>=-8)&&(dr<=7)&&(db>=-8)&&(db<=7)) {
+            dstv[dstp++]=0x80|(dg+32);
+            dstv[dstp++]=((dr+8)<<4)|(db+8);
+            continue;
+          }
+        }
+        // QOI_OP_RGB
+        dstv[dstp++]=0xfe;
+        dstv[dstp++]=r;
+        dstv[dstp++]=g;
+        dstv[dstp++]=b;
+        continue;
       }
-      // QOI_OP_RGB
-      if (sr_encode_u8(dst,0xfe)<0) return -1;
-      if (sr_encode_u8(dst,r)<0) return -1;
-      if (sr_encode_u8(dst,g)<0) return -1;
-      if (sr_encode_u8(dst,b)<0) return -1;
-      continue;
-    }
     
-    // Finally, QOI_OP_RGBA
-    if (sr_encode_u8(dst,0xff)<0) return -1;
-    if (sr_encode_u8(dst,r)<0) return -1;
-    if (sr_encode_u8(dst,g)<0) return -1;
-    if (sr_encode_u8(dst,b)<0) return -1;
-    if (sr_encode_u8(dst,a)<0) return -1;
-  
+      // Finally, QOI_OP_RGBA
+      dstv[dstp++]=0xff;
+      dstv[dstp++]=r;
+      dstv[dstp++]=g;
+      dstv[dstp++]=b;
+      dstv[dstp++]=a;
+    }
+    dst->c+=dstp;
   }
   if (runlen) {
     if (sr_encode_u8(dst,0xc0|(runlen-1))<0) return -1;
@@ -124,91 +145,143 @@ int qoi_encode(struct sr_encoder *dst,const struct qoi_image *src) {
   return 0;
 }
 
-/* Decode into existing image.
+/* Decoder context.
+ * Resumable at any pixel, so we can decode the whole image or one band at a time.
  */
  
-static int qoi_decode_inner(struct qoi_image *image,const uint8_t *src,int srcc) {
-  uint8_t *dst=(uint8_t*)image->v;
-  int srcp=14,dstp=0;
-  int pxc=image->w*image->h;
-  int dstend=pxc*4-4;
-  uint8_t prev[4]={0,0,0,0xff};
-  uint8_t buf[256]={0};
-  
-  #define PREVTOBUF { \
-    int bufp=((prev[0]*3+prev[1]*5+prev[2]*7+prev[3]*11)&0x3f)<<2; \
-    buf[bufp++]=prev[0]; \
-    buf[bufp++]=prev[1]; \
-    buf[bufp++]=prev[2]; \
-    buf[bufp]=prev[3]; \
-  }
-  
-  while (srcp<srcc) {
-    if (dstp>dstend) break;
+struct qoi_decoder {
+  const uint8_t *src;
+  int srcc,srcp;
+  uint8_t prev[4];
+  uint32_t buf[64]; // Pixels in memory order, same as output.
+  int runc; // Pixels remaining in a QOI_OP_RUN that overran the last output.
+};
+
+static void qoi_decoder_init(struct qoi_decoder *ctx,const uint8_t *src,int srcc) {
+  memset(ctx,0,sizeof(struct qoi_decoder));
+  ctx->src=src;
+  ctx->srcc=srcc;
+  ctx->srcp=14;
+  ctx->prev[3]=0xff;
+}
+
+/* Decode ops from (src) until we reach (srcc) or (dst) fills up.
+ * Caller guarantees 4 readable bytes beyond (srcc), so ops don't check bounds individually.
+ * Advances (*srcpp) and returns the new output position in bytes.
+ * Ops are tested roughly in order of frequency: INDEX, DIFF and LUMA are the bulk of most images.
+ */
+ 
+static int qoi_decode_ops(
+  struct qoi_decoder *ctx,
+  const uint8_t *src,int *srcpp,int srcc,
+  uint8_t *dst,int dstp,int dstc
+) {
+  int srcp=*srcpp;
+  uint32_t *buf=ctx->buf;
+  uint8_t px[4];
+  memcpy(px,ctx->prev,4);
+  while ((srcp<srcc)&&(dstp<dstc)) {
     uint8_t lead=src[srcp++];
     
-    if (lead==0xfe) { // QOI_OP_RGB
-      memcpy(prev,src+srcp,3);
-      srcp+=3;
-      memcpy(dst+dstp,prev,4);
+    if (lead<0x40) { // QOI_OP_INDEX. Already in the buffer, by definition.
+      memcpy(px,buf+lead,4);
+      memcpy(dst+dstp,px,4);
       dstp+=4;
-      PREVTOBUF
       continue;
     }
     
-    if (lead==0xff) { // QOI_OP_RGBA
-      memcpy(prev,src+srcp,4);
+    if (lead<0x80) { // QOI_OP_DIFF
+      px[0]+=((lead>>4)&3)-2;
+      px[1]+=((lead>>2)&3)-2;
+      px[2]+=(lead&3)-2;
+      
+    } else if (lead<0xc0) { // QOI_OP_LUMA
+      int dg=(lead&0x3f)-32;
+      uint8_t rb=src[srcp++];
+      px[0]+=dg+(rb>>4)-8;
+      px[1]+=dg;
+      px[2]+=dg+(rb&0x0f)-8;
+      
+    } else if (lead==0xfe) { // QOI_OP_RGB
+      memcpy(px,src+srcp,3);
+      srcp+=3;
+      
+    } else if (lead==0xff) { // QOI_OP_RGBA
+      memcpy(px,src+srcp,4);
       srcp+=4;
-      memcpy(dst+dstp,prev,4);
-      dstp+=4;
-      PREVTOBUF
+      
+    } else { // QOI_OP_RUN. Pixel is already in the buffer, since it's the previous one.
+      uint32_t pxv;
+      memcpy(&pxv,px,4);
+      int c=(lead&0x3f)+1;
+      int avail=(dstc-dstp)>>2;
+      if (c>avail) {
+        ctx->runc=c-avail;
+        c=avail;
+      }
+      for (;c-->0;dstp+=4) memcpy(dst+dstp,&pxv,4);
       continue;
     }
-      
-    switch (lead&0xc0) {
-      case 0x00: { // QOI_OP_INDEX
-          int bufp=(lead&0x3f)<<2;
-          memcpy(prev,buf+bufp,4);
-          memcpy(dst+dstp,prev,4);
-          dstp+=4;
-        } break;
-        
-      case 0x40: { // QOI_OP_DIFF
-          int dr=((lead>>4)&3)-2;
-          int dg=((lead>>2)&3)-2;
-          int db=(lead&3)-2;
-          prev[0]+=dr;
-          prev[1]+=dg;
-          prev[2]+=db;
-          memcpy(dst+dstp,prev,4);
-          dstp+=4;
-          PREVTOBUF
-        } break;
-        
-      case 0x80: { // QOI_OP_LUMA
-          int dg=(lead&0x3f)-32;
-          int dr=dg+(src[srcp]>>4)-8;
-          int db=dg+(src[srcp]&0x0f)-8;
-          srcp++;
-          prev[0]+=dr;
-          prev[1]+=dg;
-          prev[2]+=db;
-          memcpy(dst+dstp,prev,4);
-          dstp+=4;
-          PREVTOBUF
-        } break;
-        
-      case 0xc0: { // QOI_OP_RUN
-          int c=(lead&0x3f)+1;
-          while (c-->0) {
-            if (dstp>dstend) break;
-            memcpy(dst+dstp,prev,4);
-            dstp+=4;
-          }
-        } break;
+    
+    memcpy(dst+dstp,px,4);
+    dstp+=4;
+    memcpy(buf+((px[0]*3+px[1]*5+px[2]*7+px[3]*11)&0x3f),px,4);
+  }
+  memcpy(ctx->prev,px,4);
+  *srcpp=srcp;
+  return dstp;
+}
+
+/* Decode up to (pxc) pixels into (dst).
+ * Returns the count of pixels written.
+ * If input runs short, the remainder of (dst) is untouched.
+ */
+ 
+static int qoi_decode_pixels(struct qoi_decoder *ctx,uint8_t *dst,int pxc) {
+  int dstc=pxc<<2;
+  int dstp=0;
+  
+  if (ctx->runc) {
+    uint32_t pxv;
+    memcpy(&pxv,ctx->prev,4);
+    while (ctx->runc&&(dstp<dstc)) {
+      memcpy(dst+dstp,&pxv,4);
+      dstp+=4;
+      ctx->runc--;
     }
   }
-  #undef PREVTOBUF
+  
+  // Most of the input, we can read past the op in hand without checking.
+  int fastc=ctx->srcc-4;
+  if (ctx->srcp<fastc) {
+    dstp=qoi_decode_ops(ctx,ctx->src,&ctx->srcp,fastc,dst,dstp,dstc);
+  }
+  
+  // The last few bytes, copy into a zero-padded buffer so the same loop can run safely.
+  // Normally that's just the trailer. A truncated op at the end reads zeroes instead of overrunning.
+  if ((dstp<dstc)&&(ctx->srcp<ctx->srcc)) {
+    uint8_t tail[8]={0};
+    int tailc=ctx->srcc-ctx->srcp;
+    memcpy(tail,ctx->src+ctx->srcp,tailc);
+    int tailp=0;
+    dstp=qoi_decode_ops(ctx,tail,&tailp,tailc,dst,dstp,dstc);
+    if ((ctx->srcp+=tailp)>ctx->srcc) ctx->srcp=ctx->srcc;
+  }
+  
+  return dstp>>2;
+}
+
+/* Decode header.
+ */
+ 
+static int qoi_decode_header(int *w,int *h,const uint8_t *src,int srcc) {
+  if (srcc<22) return -1; // 14 header + 8 EOF
+  if (memcmp(src,"qoif",4)) return -1;
+  *w=(src[4]<<24)|(src[5]<<16)|(src[6]<<8)|src[7];
+  *h=(src[8]<<24)|(src[9]<<16)|(src[10]<<8)|src[11];
+  // [12]=channels, [13]=colorspace, don't care.
+  if ((*w<1)||(*w>0x7fff)) return -1;
+  if ((*h<1)||(*h>0x7fff)) return -1;
   return 0;
 }
 
@@ -216,27 +289,49 @@ static int qoi_decode_inner(struct qoi_image *image,const uint8_t *src,int srcc)
  */
 
 struct qoi_image *qoi_decode(const void *src,int srcc) {
-  
-  const uint8_t *SRC=src;
-  if (srcc<22) return 0; // 14 header + 8 EOF
-  if (memcmp(src,"qoif",4)) return 0;
-  int w=(SRC[4]<<24)|(SRC[5]<<16)|(SRC[6]<<8)|SRC[7];
-  int h=(SRC[8]<<24)|(SRC[9]<<16)|(SRC[10]<<8)|SRC[11];
-  // [12]=channels, [13]=colorspace, don't care.
-  if ((w<1)||(w>0x7fff)) return 0;
-  if ((h<1)||(h>0x7fff)) return 0;
-  
+  int w,h;
+  if (qoi_decode_header(&w,&h,src,srcc)<0) return 0;
   struct qoi_image *image=calloc(1,sizeof(struct qoi_image));
   if (!image) return 0;
   image->w=w;
   image->h=h;
-  if (!(image->v=calloc(image->w<<2,image->h))) {
-    qoi_image_del(image);
-    return 0;
-  }
-  if (qoi_decode_inner(image,src,srcc)<0) {
+  if (!(image->v=malloc((image->w<<2)*image->h))) {
     qoi_image_del(image);
     return 0;
   }
+  struct qoi_decoder ctx;
+  qoi_decoder_init(&ctx,src,srcc);
+  int pxc=qoi_decode_pixels(&ctx,image->v,w*h);
+  if (pxc<w*h) memset((uint8_t*)image->v+(pxc<<2),0,(w*h-pxc)<<2);
   return image;
 }
+
+/* Decode in bands.
+ */
+ 
+int qoi_decode_bands(
+  const void *src,int srcc,int bandh,
+  int (*cb)(const struct qoi_image *band,int y,int h,void *userdata),
+  void *userdata
+) {
+  if (!cb) return -1;
+  int w,h;
+  if (qoi_decode_header(&w,&h,src,srcc)<0) return -1;
+  if (bandh<1) bandh=1;
+  else if (bandh>h) bandh=h;
+  struct qoi_image band={.w=w,.h=bandh};
+  int stride=w<<2;
+  if (!(band.v=malloc(stride*bandh))) return -1;
+  struct qoi_decoder ctx;
+  qoi_decoder_init(&ctx,src,srcc);
+  int y=0,err=0;
+  while (y<h) {
+    if ((band.h=h-y)>bandh) band.h=bandh;
+    int pxc=qoi_decode_pixels(&ctx,band.v,w*band.h);
+    if (pxc<w*band.h) memset((uint8_t*)band.v+(pxc<<2),0,(w*band.h-pxc)<<2);
+    if (err=cb(&band,y,h,userdata)) break;
+    y+=band.h;
+  }
+  free(band.v);
+  return err;
+}
@@ -19,4 +19,15 @@ int qoi_encode(struct sr_encoder *dst,const struct qoi_image *image);
 
 struct qoi_image *qoi_decode(const void *src,int srcc);
 
+/* Decode incrementally, delivering up to (bandh) rows at a time to (cb).
+ * We only hold one band of pixels at a time.
+ * (band->h) rows starting at row (y), and (h) is the full height.
+ * If (cb) returns nonzero, we stop and return it.
+ */
+int qoi_decode_bands(
+  const void *src,int srcc,int bandh,
+  int (*cb)(const struct qoi_image *band,int y,int h,void *userdata),
+  void *userdata
+);
+
 #endif
@@ -72,6 +72,11 @@ struct rawimg {
    * Null or empty, we default to "rawimg", our own format.
    */
   const char *encfmt;
+  
+  /* Encoder's speed/size tradeoff, 1 (fastest) to 9 (smallest), or zero for the format's default.
+   * Only some formats care (png).
+   */
+  int enceffort;
 };
 
 /* Image object.
@@ -134,10 +139,25 @@ int rawimg_require_ctab(struct rawimg *rawimg,int colorc);
  *
  * Encoding not so much: The rawimg must be in a pixel format amenable to the requested encoding.
  * We won't do that heavy conversion here.
+ * (rawimg->enceffort) is passed along to encoders that can use it.
  */
 int rawimg_encode(struct sr_encoder *encoder,const struct rawimg *rawimg);
 struct rawimg *rawimg_decode(const void *src,int srcc);
 
+/* Streaming decode, for large images.
+ * We deliver the image to (cb) top to bottom, in bands of up to (bandh) rows.
+ * (band) has the full width, and (band->h) rows starting at row (y). (h) is the full height.
+ * Format fields are set as rawimg_decode would. You may convert (band) in place (eg rawimg_force_rgba); we clean up after.
+ * PNG, QOI, rlead, and BMP decode incrementally, holding just one band at a time.
+ * Other formats decode in full first, then deliver bands of that.
+ * If (cb) returns nonzero, we stop and return it.
+ */
+int rawimg_decode_bands(
+  const void *src,int srcc,int bandh,
+  int (*cb)(struct rawimg *band,int y,int h,void *userdata),
+  void *userdata
+);
+
 /* Happens automatically as needed. But maybe you have other uses for this.
  * Format units do not need to be enabled for format detection to work.
  */
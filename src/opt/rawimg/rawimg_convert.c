@@ -39,6 +39,263 @@
   };
 #endif
 
+/* Row kernels.
+ * Dedicated fast paths for the conversions we hit at load time, chosen by inspecting masks and chorder.
+ * Every kernel must produce exactly what the iterator path would; we fall back to the iterator for anything unusual.
+ * These are plain loops with constant channel offsets. The compiler vectorizes them on its own,
+ * and we don't need to maintain separate SSE/NEON/wasm-simd versions.
+ */
+ 
+/* Unpack 1, 2, or 4-bit pixels to one byte each.
+ */
+ 
+static void rawimg_unpack_row(uint8_t *dst,const uint8_t *src,int w,int pixelsize,char bitorder) {
+  int perbyte=8/pixelsize;
+  int mask=(1<<pixelsize)-1;
+  if (bitorder=='<') {
+    for (;w>=perbyte;w-=perbyte,src++) {
+      uint8_t b=*src;
+      int i=perbyte; for (;i-->0;b>>=pixelsize) *(dst++)=b&mask;
+    }
+    if (w>0) {
+      uint8_t b=*src;
+      for (;w-->0;b>>=pixelsize) *(dst++)=b&mask;
+    }
+  } else {
+    int shift0=8-pixelsize;
+    for (;w>=perbyte;w-=perbyte,src++) {
+      uint8_t b=*src;
+      int shift=shift0;
+      for (;shift>=0;shift-=pixelsize) *(dst++)=(b>>shift)&mask;
+    }
+    if (w>0) {
+      uint8_t b=*src;
+      int shift=shift0;
+      for (;w-->0;shift-=pixelsize) *(dst++)=(b>>shift)&mask;
+    }
+  }
+}
+
+/* 32-bit lookup table, from one-byte indices.
+ * Also handles 8-bit sources directly.
+ */
+ 
+static void rawimg_lut32_row(uint32_t *dst,const uint8_t *src,int w,const uint32_t *lut) {
+  for (;w-->0;dst++,src++) *dst=lut[*src];
+}
+
+/* Run a 32-bit LUT over a whole image of 1, 2, 4, or 8-bit pixels, into a tightly-packed buffer.
+ */
+ 
+static int rawimg_lut32_image(uint32_t *dst,const struct rawimg *rawimg,const uint32_t *lut) {
+  uint8_t *scratch=0;
+  if (rawimg->pixelsize<8) {
+    if (!(scratch=malloc(rawimg->w))) return -1;
+  }
+  const uint8_t *srcrow=rawimg->v;
+  uint32_t *dstrow=dst;
+  int yi=rawimg->h;
+  for (;yi-->0;srcrow+=rawimg->stride,dstrow+=rawimg->w) {
+    if (scratch) {
+      rawimg_unpack_row(scratch,srcrow,rawimg->w,rawimg->pixelsize,rawimg->bitorder);
+      rawimg_lut32_row(dstrow,scratch,rawimg->w,lut);
+    } else {
+      rawimg_lut32_row(dstrow,srcrow,rawimg->w,lut);
+    }
+  }
+  if (scratch) free(scratch);
+  return 0;
+}
+
+/* Same idea, 8-bit output.
+ */
+ 
+static void rawimg_lut8_image(uint8_t *dst,const struct rawimg *rawimg,const uint8_t *lut) {
+  const uint8_t *srcrow=rawimg->v;
+  uint8_t *dstrow=dst;
+  int yi=rawimg->h;
+  for (;yi-->0;srcrow+=rawimg->stride,dstrow+=rawimg->w) {
+    if (rawimg->pixelsize<8) {
+      rawimg_unpack_row(dstrow,srcrow,rawimg->w,rawimg->pixelsize,rawimg->bitorder);
+      uint8_t *p=dstrow;
+      int xi=rawimg->w;
+      for (;xi-->0;p++) *p=lut[*p];
+    } else {
+      const uint8_t *srcp=srcrow;
+      uint8_t *dstp=dstrow;
+      int xi=rawimg->w;
+      for (;xi-->0;srcp++,dstp++) *dstp=lut[*srcp];
+    }
+  }
+}
+
+/* Bytewise channels to RGBA.
+ * (rp,gp,bp,ap) are byte offsets within the source pixel, or <0 if absent.
+ * Absent chroma channels are zero, and absent alpha is opaque.
+ */
+ 
+struct rawimg_bytewise_plan {
+  int xstride;
+  int rp,gp,bp,ap;
+};
+
+static void rawimg_rgba_from_rgb_row(uint8_t *dst,const uint8_t *src,int w) {
+  for (;w-->0;dst+=4,src+=3) {
+    dst[0]=src[0];
+    dst[1]=src[1];
+    dst[2]=src[2];
+    dst[3]=0xff;
+  }
+}
+
+static void rawimg_rgba_from_ya_row(uint8_t *dst,const uint8_t *src,int w) {
+  for (;w-->0;dst+=4,src+=2) {
+    dst[0]=dst[1]=dst[2]=src[0];
+    dst[3]=src[1];
+  }
+}
+
+static void rawimg_rgba_from_y_row(uint8_t *dst,const uint8_t *src,int w) {
+  for (;w-->0;dst+=4,src++) {
+    dst[0]=dst[1]=dst[2]=*src;
+    dst[3]=0xff;
+  }
+}
+
+static void rawimg_rgba_from_bytewise_row(uint8_t *dst,const uint8_t *src,int w,const struct rawimg_bytewise_plan *plan) {
+  for (;w-->0;dst+=4,src+=plan->xstride) {
+    dst[0]=(plan->rp>=0)?src[plan->rp]:0x00;
+    dst[1]=(plan->gp>=0)?src[plan->gp]:0x00;
+    dst[2]=(plan->bp>=0)?src[plan->bp]:0x00;
+    dst[3]=(plan->ap>=0)?src[plan->ap]:0xff;
+  }
+}
+
+/* Byte offset of an 8-bit mask within a pixel, as the iterator would read it.
+ * <0 if the mask is not a single whole byte.
+ */
+ 
+static int rawimg_byte_offset_for_mask(uint32_t mask,int xstride) {
+  int shift=0;
+  for (;shift<32;shift+=8) {
+    if (mask==(0xffu<<shift)) break;
+  }
+  if (shift>=32) return -1;
+  int p=shift>>3;
+  if (p>=xstride) return -1;
+  if (xstride==3) return p; // rawimg_pxr_24 reads little-endian regardless of host.
+  #if BYTE_ORDER==BIG_ENDIAN
+    return xstride-1-p;
+  #else
+    return p;
+  #endif
+}
+
+/* Determine whether rawimg_force_to_rgba could be done bytewise, and how.
+ * This must take the same branches that rawimg_force_to_rgba does.
+ */
+ 
+static int rawimg_bytewise_plan_rgba(struct rawimg_bytewise_plan *plan,const struct rawimg *rawimg) {
+  switch (rawimg->pixelsize) {
+    case 8: case 16: case 24: case 32: break;
+    default: return -1;
+  }
+  plan->xstride=rawimg->pixelsize>>3;
+  plan->rp=plan->gp=plan->bp=plan->ap=-1;
+  
+  if (rawimg->rmask) {
+    #define MASK(ch) if (rawimg->ch##mask) { \
+      if ((plan->ch##p=rawimg_byte_offset_for_mask(rawimg->ch##mask,plan->xstride))<0) return -1; \
+    }
+    MASK(r)
+    MASK(g)
+    MASK(b)
+    MASK(a)
+    #undef MASK
+    return 0;
+  }
+  
+  if (rawimg->chorder[0]) {
+    int chanc=1;
+    while ((chanc<4)&&rawimg->chorder[chanc]) chanc++;
+    if (chanc!=plan->xstride) return -1; // Channels not 8 bits. The iterator path handles those, or fails.
+    int i=0; for (;i<chanc;i++) {
+      switch (rawimg->chorder[i]) {
+        case 'R': case 'r': plan->rp=i; break;
+        case 'G': case 'g': plan->gp=i; break;
+        case 'B': case 'b': plan->bp=i; break;
+        case 'A': case 'a': plan->ap=i; break;
+        case 'Y': case 'y': plan->rp=plan->gp=plan->bp=i; break;
+      }
+    }
+    return 0;
+  }
+  
+  if (rawimg->pixelsize==8) {
+    plan->rp=plan->gp=plan->bp=0;
+    return 0;
+  }
+  return -1;
+}
+
+static void rawimg_rgba_from_bytewise(uint8_t *dst,const struct rawimg *rawimg,const struct rawimg_bytewise_plan *plan) {
+  const uint8_t *srcrow=rawimg->v;
+  int dststride=rawimg->w<<2;
+  int yi=rawimg->h;
+  #define PLAN(x,r,g,b,a) ((plan->xstride==x)&&(plan->rp==r)&&(plan->gp==g)&&(plan->bp==b)&&(plan->ap==a))
+  if (PLAN(3,0,1,2,-1)) {
+    for (;yi-->0;srcrow+=rawimg->stride,dst+=dststride) rawimg_rgba_from_rgb_row(dst,srcrow,rawimg->w);
+  } else if (PLAN(2,0,0,0,1)) {
+    for (;yi-->0;srcrow+=rawimg->stride,dst+=dststride) rawimg_rgba_from_ya_row(dst,srcrow,rawimg->w);
+  } else if (PLAN(1,0,0,0,-1)) {
+    for (;yi-->0;srcrow+=rawimg->stride,dst+=dststride) rawimg_rgba_from_y_row(dst,srcrow,rawimg->w);
+  } else {
+    for (;yi-->0;srcrow+=rawimg->stride,dst+=dststride) rawimg_rgba_from_bytewise_row(dst,srcrow,rawimg->w,plan);
+  }
+  #undef PLAN
+}
+
+/* Reorder 32-bit pixels in place.
+ * Call with constant arguments and let the compiler specialize it.
+ */
+ 
+static inline void rawimg_swizzle32_row(uint8_t *p,int w,int rp,int gp,int bp,int ap) {
+  for (;w-->0;p+=4) {
+    uint8_t r=p[rp],g=p[gp],b=p[bp],a=p[ap];
+    p[0]=r;
+    p[1]=g;
+    p[2]=b;
+    p[3]=a;
+  }
+}
+
+/* Copy bytewise pixels with an optional XREV or YREV, no SWAP.
+ * Caller validates bounds.
+ */
+ 
+static void rawimg_copy_rows(struct rawimg *dst,const struct rawimg *src,int x,int y,int w,int h,uint8_t xform) {
+  int xstride=src->pixelsize>>3;
+  int rowlen=w*xstride;
+  const uint8_t *srcrow=((uint8_t*)src->v)+y*src->stride+x*xstride;
+  int srcstride=src->stride;
+  if (xform&RAWIMG_XFORM_YREV) {
+    srcrow+=(h-1)*srcstride;
+    srcstride=-srcstride;
+  }
+  uint8_t *dstrow=dst->v;
+  int yi=h;
+  for (;yi-->0;srcrow+=srcstride,dstrow+=dst->stride) {
+    if (xform&RAWIMG_XFORM_XREV) {
+      const uint8_t *srcp=srcrow+rowlen-xstride;
+      uint8_t *dstp=dstrow;
+      int xi=w;
+      for (;xi-->0;srcp-=xstride,dstp+=xstride) memcpy(dstp,srcp,xstride);
+    } else {
+      memcpy(dstrow,srcrow,rowlen);
+    }
+  }
+}
+
 /* Convert, with xform and per-pixel callback.
  * TODO Do we anticipate any use for this? I'm not sure it's helpful.
  */
@@ -76,11 +333,18 @@ struct rawimg *rawimg_new_convert(
   }
   
   dst->encfmt=src->encfmt;
+  dst->enceffort=src->enceffort;
   if (rawimg_set_ctab(dst,src->ctab,src->ctabc)<0) {
     rawimg_del(dst);
     return 0;
   }
   
+  // Plain crop or flip of bytewise pixels up to 32 bits, no need to iterate.
+  if (!cvt&&(pixelsize==src->pixelsize)&&!(pixelsize&7)&&(pixelsize<=32)&&!(xform&RAWIMG_XFORM_SWAP)) {
+    rawimg_copy_rows(dst,src,x,y,w,h,xform);
+    return dst;
+  }
+  
   struct rawimg_iterator dstiter;
   if (rawimg_iterate(&dstiter,dst,0,0,dstw,dsth,xform&RAWIMG_XFORM_SWAP)<0) {
     rawimg_del(dst);
@@ -199,19 +463,21 @@ static int rawimg_swizzle_to_rgba(struct rawimg *rawimg) {
   #undef position_for_mask
   uint8_t *row=rawimg->v;
   int yi=rawimg->h;
-  for (;yi-->0;row+=rawimg->stride) {
-    uint8_t *p=row;
-    int xi=rawimg->w;
-    for (;xi-->0;p+=4) {
-      uint8_t tmp[4]={
-        p[srcp_by_dstp[0]],
-        p[srcp_by_dstp[1]],
-        p[srcp_by_dstp[2]],
-        p[srcp_by_dstp[3]],
-      };
-      memcpy(p,tmp,4);
+  #define ORDER(r,g,b,a) ((srcp_by_dstp[0]==r)&&(srcp_by_dstp[1]==g)&&(srcp_by_dstp[2]==b)&&(srcp_by_dstp[3]==a))
+  if (ORDER(0,1,2,3)) {
+    // Already in order, only the labels were wrong.
+  } else if (ORDER(2,1,0,3)) {
+    for (;yi-->0;row+=rawimg->stride) rawimg_swizzle32_row(row,rawimg->w,2,1,0,3);
+  } else if (ORDER(1,2,3,0)) {
+    for (;yi-->0;row+=rawimg->stride) rawimg_swizzle32_row(row,rawimg->w,1,2,3,0);
+  } else if (ORDER(3,2,1,0)) {
+    for (;yi-->0;row+=rawimg->stride) rawimg_swizzle32_row(row,rawimg->w,3,2,1,0);
+  } else {
+    for (;yi-->0;row+=rawimg->stride) {
+      rawimg_swizzle32_row(row,rawimg->w,srcp_by_dstp[0],srcp_by_dstp[1],srcp_by_dstp[2],srcp_by_dstp[3]);
     }
   }
+  #undef ORDER
   memcpy(rawimg->chorder,"rgba",4);
   rawimg->rmask=cr;
   rawimg->gmask=cg;
@@ -230,9 +496,29 @@ static int rawimg_force_to_rgba(struct rawimg *rawimg) {
   if (!nv) return -1;
   uint32_t *dstp=nv;
   int i=rawimg->w*rawimg->h;
+  struct rawimg_bytewise_plan plan;
+  
+  // Bytewise channels, whether described by masks or chorder, get a row kernel.
+  if (rawimg_bytewise_plan_rgba(&plan,rawimg)>=0) {
+    rawimg_rgba_from_bytewise((uint8_t*)nv,rawimg,&plan);
+    
+  // Small gray pixels, expand through a lookup table.
+  } else if (!rawimg->rmask&&(rawimg->pixelsize<8)) {
+    uint32_t lut[16];
+    int max=(1<<rawimg->pixelsize)-1;
+    int v=0; for (;v<=max;v++) {
+      uint8_t *dst=(uint8_t*)(lut+v);
+      dst[0]=dst[1]=dst[2]=(v*0xff)/max;
+      dst[3]=0xff;
+    }
+    if (rawimg_lut32_image(nv,rawimg,lut)<0) {
+      free(nv);
+      return -1;
+    }
   
+  // Everything else goes through the iterator.
   // Use masks if present, and pixelsize 32 or smaller.
-  if ((rawimg->pixelsize<=32)&&rawimg->rmask) {
+  } else if ((rawimg->pixelsize<=32)&&rawimg->rmask) {
     uint32_t tmp;
     int rp=0,rc=0,gp=0,gc=0,bp=0,bc=0,ap=0,ac=0;
     #define MEASURECHANNEL(ch) if (tmp=rawimg->ch##mask) { \
@@ -466,37 +752,16 @@ static int rawimg_force_to_rgb(struct rawimg *rawimg) {
  */
  
 static int rawimg_expand_to_y8(struct rawimg *rawimg) {
-  struct rawimg_iterator iter;
-  if (rawimg_iterate(&iter,rawimg,0,0,rawimg->w,rawimg->h,0)<0) return -1;
+  if ((rawimg->pixelsize!=1)&&(rawimg->pixelsize!=2)&&(rawimg->pixelsize!=4)) return -1;
   uint8_t *nv=malloc(rawimg->w*rawimg->h);
   if (!nv) return -1;
-  uint8_t *dstp=nv;
-  int i=rawimg->w*rawimg->h;
-  switch (rawimg->pixelsize) {
-    case 1: {
-        for (;i-->0;dstp++) {
-          int pixel=rawimg_iterator_read(&iter);
-          *dstp=pixel?0xff:0x00;
-          if (!rawimg_iterator_next(&iter)) break;
-        }
-      } break;
-    case 2: {
-        for (;i-->0;dstp++) {
-          int pixel=rawimg_iterator_read(&iter);
-          *dstp=pixel|(pixel<<2)|(pixel<<4)|(pixel<<6);
-          if (!rawimg_iterator_next(&iter)) break;
-        }
-      } break;
-    case 4: {
-        for (;i-->0;dstp++) {
-          int pixel=rawimg_iterator_read(&iter);
-          *dstp=pixel|(pixel<<4);
-          if (!rawimg_iterator_next(&iter)) break;
-        }
-      } break;
-  }
-  free(rawimg->v);
+  uint8_t lut[16];
+  int max=(1<<rawimg->pixelsize)-1;
+  int v=0; for (;v<=max;v++) lut[v]=(v*0xff)/max;
+  rawimg_lut8_image(nv,rawimg,lut);
+  if (rawimg->ownv) free(rawimg->v);
   rawimg->v=nv;
+  rawimg->ownv=1;
   rawimg->stride=rawimg->w;
   rawimg->pixelsize=8;
   memcpy(rawimg->chorder,"y\0\0\0",4);
@@ -514,17 +779,27 @@ static int rawimg_expand_ctab(struct rawimg *rawimg) {
   if (rawimg_iterate(&iter,rawimg,0,0,rawimg->w,rawimg->h,0)<0) return -1;
   uint32_t *nv=malloc(rawimg->w*rawimg->h*4);
   if (!nv) return -1;
-  uint32_t *dstp=nv;
-  int i=rawimg->w*rawimg->h;
-  while (i-->0) {
-    int ix=rawimg_iterator_read(&iter);
-    if ((ix>=0)&&(ix<rawimg->ctabc)) *dstp=((uint32_t*)rawimg->ctab)[ix];
-    else *dstp=0;
-    if (!rawimg_iterator_next(&iter)) break;
-    dstp++;
+  if (rawimg->pixelsize<=8) {
+    uint32_t lut[256]={0};
+    memcpy(lut,rawimg->ctab,((rawimg->ctabc<256)?rawimg->ctabc:256)<<2);
+    if (rawimg_lut32_image(nv,rawimg,lut)<0) {
+      free(nv);
+      return -1;
+    }
+  } else {
+    uint32_t *dstp=nv;
+    int i=rawimg->w*rawimg->h;
+    while (i-->0) {
+      int ix=rawimg_iterator_read(&iter);
+      if ((ix>=0)&&(ix<rawimg->ctabc)) *dstp=((uint32_t*)rawimg->ctab)[ix];
+      else *dstp=0;
+      if (!rawimg_iterator_next(&iter)) break;
+      dstp++;
+    }
   }
-  free(rawimg->v);
+  if (rawimg->ownv) free(rawimg->v);
   rawimg->v=nv;
+  rawimg->ownv=1;
   rawimg->stride=rawimg->w<<2;
   rawimg->pixelsize=32;
   memcpy(rawimg->chorder,"rgba",4);
@@ -567,8 +842,9 @@ static int rawimg_expand_ctab_rgb(struct rawimg *rawimg) {
     if (!rawimg_iterator_next(&iter)) break;
     dstp+=3;
   }
-  free(rawimg->v);
+  if (rawimg->ownv) free(rawimg->v);
   rawimg->v=nv;
+  rawimg->ownv=1;
   rawimg->stride=rawimg->w*3;
   rawimg->pixelsize=24;
   memcpy(rawimg->chorder,"rgb\0",4);
@@ -588,19 +864,27 @@ static int rawimg_expand_ctab_y8(struct rawimg *rawimg) {
   if (rawimg_iterate(&iter,rawimg,0,0,rawimg->w,rawimg->h,0)<0) return -1;
   uint8_t *nv=malloc(rawimg->w*rawimg->h);
   if (!nv) return -1;
-  uint8_t *dstp=nv;
-  int i=rawimg->w*rawimg->h;
-  while (i-->0) {
-    int ix=rawimg_iterator_read(&iter);
-    if ((ix>=0)&&(ix<rawimg->ctabc)) {
-      const uint8_t *src=rawimg->ctab+ix*4;
-      *dstp=(src[0]+src[1]+src[2])/3;
-    } else *dstp=0;
-    if (!rawimg_iterator_next(&iter)) break;
-    dstp++;
+  if (rawimg->pixelsize<=8) {
+    uint8_t lut[256]={0};
+    const uint8_t *src=rawimg->ctab;
+    int i=0; for (;(i<rawimg->ctabc)&&(i<256);i++,src+=4) lut[i]=(src[0]+src[1]+src[2])/3;
+    rawimg_lut8_image(nv,rawimg,lut);
+  } else {
+    uint8_t *dstp=nv;
+    int i=rawimg->w*rawimg->h;
+    while (i-->0) {
+      int ix=rawimg_iterator_read(&iter);
+      if ((ix>=0)&&(ix<rawimg->ctabc)) {
+        const uint8_t *src=rawimg->ctab+ix*4;
+        *dstp=(src[0]+src[1]+src[2])/3;
+      } else *dstp=0;
+      if (!rawimg_iterator_next(&iter)) break;
+      dstp++;
+    }
   }
-  free(rawimg->v);
+  if (rawimg->ownv) free(rawimg->v);
   rawimg->v=nv;
+  rawimg->ownv=1;
   rawimg->stride=rawimg->w;
   rawimg->pixelsize=8;
   memcpy(rawimg->chorder,"y\0\0\0",4);
@@ -636,8 +920,9 @@ static int rawimg_expand_ctab_y1(struct rawimg *rawimg) {
       if (!rawimg_iterator_next(&iter)) break;
     }
   }
-  free(rawimg->v);
+  if (rawimg->ownv) free(rawimg->v);
   rawimg->v=nv;
+  rawimg->ownv=1;
   rawimg->stride=nstride;
   rawimg->pixelsize=1;
   memcpy(rawimg->chorder,"y\0\0\0",4);
@@ -652,20 +937,22 @@ static int rawimg_expand_ctab_y1(struct rawimg *rawimg) {
  */
  
 static int rawimg_reverse_bits_1(struct rawimg *rawimg) {
-  uint8_t *p=rawimg->v;
-  int i=rawimg->stride*rawimg->h;
-  for (;i-->0;p++) {
-    *p=(
-      (((*p)&0x80)>>7)|
-      (((*p)&0x40)>>5)|
-      (((*p)&0x20)>>3)|
-      (((*p)&0x10)>>1)|
-      (((*p)&0x08)<<1)|
-      (((*p)&0x04)<<3)|
-      (((*p)&0x02)<<5)|
-      (((*p)&0x01)<<7)
+  uint8_t lut[256];
+  int i=0; for (;i<256;i++) {
+    lut[i]=(
+      ((i&0x80)>>7)|
+      ((i&0x40)>>5)|
+      ((i&0x20)>>3)|
+      ((i&0x10)>>1)|
+      ((i&0x08)<<1)|
+      ((i&0x04)<<3)|
+      ((i&0x02)<<5)|
+      ((i&0x01)<<7)
     );
   }
+  uint8_t *p=rawimg->v;
+  i=rawimg->stride*rawimg->h;
+  for (;i-->0;p++) *p=lut[*p];
   switch (rawimg->bitorder) {
     case '>': rawimg->bitorder='<'; break;
     case '<': rawimg->bitorder='>'; break;
@@ -717,9 +1004,11 @@ static int rawimg_y8_from_large(struct rawimg *rawimg) {
     int pixel=rawimg_iterator_read(&iter);
     *dstp=rawimg_luma_from_pixel(rawimg,pixel);
     dstp++;
+    if (!rawimg_iterator_next(&iter)) break;
   }
-  free(rawimg->v);
+  if (rawimg->ownv) free(rawimg->v);
   rawimg->v=nv;
+  rawimg->ownv=1;
   rawimg->stride=rawimg->w;
   rawimg->pixelsize=8;
   memcpy(rawimg->chorder,"y\0\0\0",4);
@@ -749,8 +1038,9 @@ static int rawimg_y1_from_large(struct rawimg *rawimg) {
       if (!rawimg_iterator_next(&iter)) break;
     }
   }
-  free(rawimg->v);
+  if (rawimg->ownv) free(rawimg->v);
   rawimg->v=nv;
+  rawimg->ownv=1;
   rawimg->stride=nstride;
   rawimg->pixelsize=1;
   memcpy(rawimg->chorder,"y\0\0\0",4);
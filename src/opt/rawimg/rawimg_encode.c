@@ -14,6 +14,23 @@
   #include <endian.h>
 #endif
 
+/* Streaming decode context, shared by the format sections.
+ * Each format wraps its band in a borrowed rawimg and passes it through here.
+ */
+ 
+struct rawimg_bands_context {
+  int (*cb)(struct rawimg *band,int y,int h,void *userdata);
+  void *userdata;
+  const char *encfmt;
+};
+
+static int rawimg_deliver_band(struct rawimg_bands_context *ctx,struct rawimg *band,int y,int h) {
+  band->encfmt=ctx->encfmt;
+  int err=ctx->cb(band,y,h,ctx->userdata);
+  rawimg_cleanup(band); // Borrowed pixels stay put; frees ctab, or pixels if the callback converted in place.
+  return err;
+}
+
 /* rawimg, our private format.
  * The codec is trivial, that's expected since it's meant to be like the shortest serial path to our live object.
  ************************************************************************************/
@@ -269,7 +286,7 @@ static int rawimg_encode_png(struct sr_encoder *encoder,const struct rawimg *raw
   struct png_image pngimage={0};
   int err=-1;
   if (png_image_from_rawimg(&pngimage,rawimg)>=0) {
-    err=png_encode(encoder,&pngimage);
+    err=png_encode_effort(encoder,&pngimage,rawimg->enceffort);
   }
   if (pngimage.v==rawimg->v) pngimage.v=0;
   png_image_cleanup(&pngimage);
@@ -309,16 +326,7 @@ static int rawimg_acquire_png_ctab(struct rawimg *rawimg,const struct png_image
   return rawimg_set_ctab(rawimg,tmp,ctabc);
 }
 
-static struct rawimg *rawimg_decode_png(const uint8_t *src,int srcc) {
-  struct png_image *pngimage=png_decode(src,srcc);
-  if (!pngimage) return 0;
-  
-  struct rawimg *rawimg=rawimg_new_handoff(pngimage->v,pngimage->w,pngimage->h,pngimage->stride,pngimage->pixelsize);
-  if (!rawimg) {
-    png_image_del(pngimage);
-    return 0;
-  }
-  pngimage->v=0; // handed off
+static void rawimg_describe_png(struct rawimg *rawimg,const struct png_image *pngimage) {
   if (pngimage->colortype==3) {
     rawimg_acquire_png_ctab(rawimg,pngimage);
   }
@@ -347,11 +355,36 @@ static struct rawimg *rawimg_decode_png(const uint8_t *src,int srcc) {
         }
       } break;
   }
+}
+
+static struct rawimg *rawimg_decode_png(const uint8_t *src,int srcc) {
+  struct png_image *pngimage=png_decode(src,srcc);
+  if (!pngimage) return 0;
+  
+  struct rawimg *rawimg=rawimg_new_handoff(pngimage->v,pngimage->w,pngimage->h,pngimage->stride,pngimage->pixelsize);
+  if (!rawimg) {
+    png_image_del(pngimage);
+    return 0;
+  }
+  pngimage->v=0; // handed off
+  rawimg_describe_png(rawimg,pngimage);
   
   png_image_del(pngimage);
   return rawimg;
 }
 
+static int rawimg_decode_bands_png_cb(const struct png_image *pngimage,int y,int h,void *userdata) {
+  struct rawimg band={
+    .v=pngimage->v,
+    .w=pngimage->w,
+    .h=pngimage->h,
+    .stride=pngimage->stride,
+    .pixelsize=pngimage->pixelsize,
+  };
+  rawimg_describe_png(&band,pngimage);
+  return rawimg_deliver_band(userdata,&band,y,h);
+}
+
 static const char *rawimg_decode_header_png(int *w,int *h,int *stride,int *pixelsize,const uint8_t *src,int srcc) {
   // Require the image to start with a 13-byte IHDR.
   // Spec says it must. Our decoder is not strict about it, but whatever.
@@ -516,6 +549,15 @@ static int rawimg_encode_qoi(struct sr_encoder *encoder,const struct rawimg *raw
   return err;
 }
 
+static void rawimg_describe_qoi(struct rawimg *rawimg) {
+  memcpy(rawimg->chorder,"RGBA",4);
+  uint8_t __attribute__((aligned(4))) layout[4]={0xff,0x00,0x00,0x00};
+  rawimg->rmask=*(uint32_t*)layout;
+  rawimg->gmask=(rawimg->rmask>>8)|(rawimg->rmask<<8); // one of those will be zero, get it?
+  rawimg->bmask=(rawimg->rmask>>16)|(rawimg->rmask<<16);
+  rawimg->amask=(rawimg->rmask>>24)|(rawimg->rmask<<24);
+}
+
 static struct rawimg *rawimg_decode_qoi(const uint8_t *src,int srcc) {
   struct qoi_image *qoi=qoi_decode(src,srcc);
   if (!qoi) return 0;
@@ -526,17 +568,22 @@ static struct rawimg *rawimg_decode_qoi(const uint8_t *src,int srcc) {
   }
   qoi->v=0; // handed off
   qoi_image_del(qoi);
-  
-  memcpy(rawimg->chorder,"RGBA",4);
-  uint8_t __attribute__((aligned(4))) layout[4]={0xff,0x00,0x00,0x00};
-  rawimg->rmask=*(uint32_t*)layout;
-  rawimg->gmask=(rawimg->rmask>>8)|(rawimg->rmask<<8); // one of those will be zero, get it?
-  rawimg->bmask=(rawimg->rmask>>16)|(rawimg->rmask<<16);
-  rawimg->amask=(rawimg->rmask>>24)|(rawimg->rmask<<24);
-  
+  rawimg_describe_qoi(rawimg);
   return rawimg;
 }
 
+static int rawimg_decode_bands_qoi_cb(const struct qoi_image *qoi,int y,int h,void *userdata) {
+  struct rawimg band={
+    .v=qoi->v,
+    .w=qoi->w,
+    .h=qoi->h,
+    .stride=qoi->w<<2,
+    .pixelsize=32,
+  };
+  rawimg_describe_qoi(&band);
+  return rawimg_deliver_band(userdata,&band,y,h);
+}
+
 static const char *rawimg_decode_header_qoi(int *w,int *h,int *stride,int *pixelsize,const uint8_t *src,int srcc) {
   if (srcc<12) return 0;
   if (memcmp(src,"qoif",4)) return 0;
@@ -581,6 +628,15 @@ static int rawimg_encode_rlead(struct sr_encoder *encoder,const struct rawimg *r
   return err;
 }
 
+static void rawimg_describe_rlead(struct rawimg *rawimg,const struct rlead_image *rlead) {
+  if (rlead->alpha) {
+    rawimg->rmask=rawimg->gmask=rawimg->bmask=0;
+    rawimg->amask=1;
+    rawimg->chorder[0]='A';
+  }
+  rawimg->bitorder='>';
+}
+
 static struct rawimg *rawimg_decode_rlead(const uint8_t *src,int srcc) {
   struct rlead_image *rlead=rlead_decode(src,srcc);
   if (!rlead) return 0;
@@ -590,18 +646,23 @@ static struct rawimg *rawimg_decode_rlead(const uint8_t *src,int srcc) {
     return 0;
   }
   rlead->v=0; // handed off
-  if (rlead->alpha) {
-    rawimg->rmask=rawimg->gmask=rawimg->bmask=0;
-    rawimg->amask=1;
-    rawimg->chorder[0]='A';
-  }
+  rawimg_describe_rlead(rawimg,rlead);
   rlead_image_del(rlead);
-  
-  rawimg->bitorder='>';
-  
   return rawimg;
 }
 
+static int rawimg_decode_bands_rlead_cb(const struct rlead_image *rlead,int y,int h,void *userdata) {
+  struct rawimg band={
+    .v=rlead->v,
+    .w=rlead->w,
+    .h=rlead->h,
+    .stride=rlead->stride,
+    .pixelsize=1,
+  };
+  rawimg_describe_rlead(&band,rlead);
+  return rawimg_deliver_band(userdata,&band,y,h);
+}
+
 static const char *rawimg_decode_header_rlead(int *w,int *h,int *stride,int *pixelsize,const uint8_t *src,int srcc) {
   if (srcc<6) return 0;
   if ((src[0]!=0xbb)||(src[1]!=0xad)) return 0;
@@ -744,6 +805,17 @@ static int rawimg_encode_bmp(struct sr_encoder *encoder,const struct rawimg *raw
   return err;
 }
 
+static void rawimg_describe_bmp(struct rawimg *rawimg,const struct bmp_image *bmp) {
+  rawimg->rmask=bmp->rmask;
+  rawimg->gmask=bmp->gmask;
+  rawimg->bmask=bmp->bmask;
+  rawimg->amask=bmp->amask;
+  rawimg->bitorder='>';
+  if (rawimg->pixelsize==24) {
+    memcpy(rawimg->chorder,"BGR\0",4);
+  }
+}
+
 static struct rawimg *rawimg_decode_bmp(const uint8_t *src,int srcc) {
   struct bmp_image *bmp=bmp_decode(src,srcc);
   if (!bmp) return 0;
@@ -759,20 +831,24 @@ static struct rawimg *rawimg_decode_bmp(const uint8_t *src,int srcc) {
     bmp->ctab=0;
     bmp->ctabc=0;
   }
-  
-  rawimg->rmask=bmp->rmask;
-  rawimg->gmask=bmp->gmask;
-  rawimg->bmask=bmp->bmask;
-  rawimg->amask=bmp->amask;
-  rawimg->bitorder='>';
-  if (rawimg->pixelsize==24) {
-    memcpy(rawimg->chorder,"BGR\0",4);
-  }
-  
+  rawimg_describe_bmp(rawimg,bmp);
   bmp_image_del(bmp);
   return rawimg;
 }
 
+static int rawimg_decode_bands_bmp_cb(const struct bmp_image *bmp,int y,int h,void *userdata) {
+  struct rawimg band={
+    .v=bmp->v,
+    .w=bmp->w,
+    .h=bmp->h,
+    .stride=bmp->stride,
+    .pixelsize=bmp->pixelsize,
+  };
+  if (bmp->ctab&&(rawimg_set_ctab(&band,bmp->ctab,bmp->ctabc)<0)) return -1;
+  rawimg_describe_bmp(&band,bmp);
+  return rawimg_deliver_band(userdata,&band,y,h);
+}
+
 static const char *rawimg_decode_header_bmp(int *w,int *h,int *stride,int *pixelsize,const uint8_t *src,int srcc) {
   // BMP is much more complex than most formats, so we won't fake it here.
   // Actually decode the whole thing.
@@ -915,6 +991,62 @@ struct rawimg *rawimg_decode(const void *src,int srcc) {
   return 0;
 }
 
+/* Streaming decode, for formats that don't support it natively.
+ * Decode the whole thing, then deliver bands of it.
+ */
+ 
+static int rawimg_decode_bands_fallback(struct rawimg_bands_context *ctx,const void *src,int srcc,int bandh) {
+  struct rawimg *rawimg=rawimg_decode(src,srcc);
+  if (!rawimg) return -1;
+  if (bandh>rawimg->h) bandh=rawimg->h;
+  int y=0,err=0;
+  while (y<rawimg->h) {
+    struct rawimg band=*rawimg;
+    band.v=(uint8_t*)rawimg->v+rawimg->stride*y;
+    band.ownv=0;
+    if ((band.h=rawimg->h-y)>bandh) band.h=bandh;
+    band.ctab=0;
+    band.ctabc=0;
+    if (rawimg->ctab&&(rawimg_set_ctab(&band,rawimg->ctab,rawimg->ctabc)<0)) {
+      err=-1;
+      break;
+    }
+    if (err=rawimg_deliver_band(ctx,&band,y,rawimg->h)) break;
+    y+=band.h;
+  }
+  rawimg_del(rawimg);
+  return err;
+}
+ 
+int rawimg_decode_bands(
+  const void *src,int srcc,int bandh,
+  int (*cb)(struct rawimg *band,int y,int h,void *userdata),
+  void *userdata
+) {
+  if (!src||!cb) return -1;
+  if (bandh<1) bandh=1;
+  const char *encfmt=rawimg_detect_format(src,srcc);
+  if (!encfmt) return -1;
+  struct rawimg_bands_context ctx={
+    .cb=cb,
+    .userdata=userdata,
+    .encfmt=encfmt,
+  };
+  #if USE_png
+    if (!strcmp(encfmt,"png")) return png_decode_bands(src,srcc,bandh,rawimg_decode_bands_png_cb,&ctx);
+  #endif
+  #if USE_qoi
+    if (!strcmp(encfmt,"qoi")) return qoi_decode_bands(src,srcc,bandh,rawimg_decode_bands_qoi_cb,&ctx);
+  #endif
+  #if USE_rlead
+    if (!strcmp(encfmt,"rlead")) return rlead_decode_bands(src,srcc,bandh,rawimg_decode_bands_rlead_cb,&ctx);
+  #endif
+  #if USE_bmp
+    if (!strcmp(encfmt,"bmp")) return bmp_decode_bands(src,srcc,bandh,rawimg_decode_bands_bmp_cb,&ctx);
+  #endif
+  return rawimg_decode_bands_fallback(&ctx,src,srcc,bandh);
+}
+
 const char *rawimg_decode_header(int *w,int *h,int *stride,int *pixelsize,const void *src,int srcc) {
   if (!src) return 0;
   const char *encfmt=rawimg_detect_format(src,srcc);
@@ -48,6 +48,26 @@ void render_texture_del(struct render *render,int texid) {
   memset(texture,0,sizeof(struct render_texture));
 }
 
+/* Create the GL texture object for a zeroed texture.
+ */
+ 
+static int render_texture_init(struct render_texture *texture) {
+  glGenTextures(1,&texture->texid);
+  if (!texture->texid) {
+    glGenTextures(1,&texture->texid);
+    if (!texture->texid) {
+      return -1;
+    }
+  }
+  
+  glBindTexture(GL_TEXTURE_2D,texture->texid);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+  return 0;
+}
+
 /* New texture.
  */
  
@@ -74,21 +94,7 @@ int render_texture_new(struct render *render) {
     }
   }
   memset(texture,0,sizeof(struct render_texture));
-  
-  glGenTextures(1,&texture->texid);
-  if (!texture->texid) {
-    glGenTextures(1,&texture->texid);
-    if (!texture->texid) {
-      return 0;
-    }
-  }
-  
-  glBindTexture(GL_TEXTURE_2D,texture->texid);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-  
+  if (render_texture_init(texture)<0) return 0;
   return (texture-render->texturev)+1;
 }
 
@@ -144,44 +150,61 @@ static void render_expand_1bit(uint32_t *dst,const uint8_t *src,int w,int h,int
   }
 }
 
+/* GL format for an Egg texture format.
+ * A1 and Y1 report as RGBA; caller must expand them with render_texture_expand_1bit first.
+ */
+ 
+static int render_texture_gl_format(int *ifmt,int *glfmt,int *type,int *chanc,int fmt) {
+  switch (fmt) {
+    case EGG_TEX_FMT_RGBA: *chanc=4; *ifmt=GL_RGBA; *glfmt=GL_RGBA; *type=GL_UNSIGNED_BYTE; return 0;
+    case EGG_TEX_FMT_A8: *chanc=1; *ifmt=GL_ALPHA; *glfmt=GL_LUMINANCE; *type=GL_UNSIGNED_BYTE; return 0;
+    case EGG_TEX_FMT_Y8: *chanc=1; *ifmt=GL_LUMINANCE; *glfmt=GL_LUMINANCE; *type=GL_UNSIGNED_BYTE; return 0;
+    case EGG_TEX_FMT_A1:
+    case EGG_TEX_FMT_Y1: *chanc=4; *ifmt=GL_RGBA; *glfmt=GL_RGBA; *type=GL_UNSIGNED_BYTE; return 0;
+  }
+  return -1;
+}
+
+/* Expand 1-bit pixels to RGBA in our temporary buffer, and point (*v,*stride) at it.
+ */
+ 
+static int render_texture_expand_1bit(struct render *render,const void **v,int *stride,int w,int h,int fmt) {
+  int expstride=w<<2;
+  int explen=expstride*h;
+  if (explen>render->textmpa) {
+    void *nv=realloc(render->textmp,explen);
+    if (!nv) return -1;
+    render->textmp=nv;
+    render->textmpa=explen;
+  }
+  uint32_t zero,one;
+  uint8_t alphabytes[4]={0,0,0,0xff};
+  uint32_t alpha=*(uint32_t*)alphabytes;
+  if (fmt==EGG_TEX_FMT_A1) {
+    zero=0x00000000;
+    one=alpha;
+  } else {
+    zero=alpha;
+    one=0xffffffff;
+  }
+  render_expand_1bit(render->textmp,*v,w,h,*stride,zero,one);
+  *v=render->textmp;
+  *stride=expstride;
+  return 0;
+}
+
 /* Upload pixels to a texture. Null is legal.
  */
  
 static int render_texture_upload(struct render *render,struct render_texture *texture,int w,int h,int stride,int fmt,const void *v) {
   int ifmt,glfmt,type,chanc;
-  switch (fmt) {
-    case EGG_TEX_FMT_RGBA: chanc=4; ifmt=GL_RGBA; glfmt=GL_RGBA; type=GL_UNSIGNED_BYTE; break;
-    case EGG_TEX_FMT_A8: chanc=1; ifmt=GL_ALPHA; glfmt=GL_LUMINANCE; type=GL_UNSIGNED_BYTE; break;
-    case EGG_TEX_FMT_Y8: chanc=1; ifmt=GL_LUMINANCE; glfmt=GL_LUMINANCE; type=GL_UNSIGNED_BYTE; break;
-    case EGG_TEX_FMT_A1: 
-    case EGG_TEX_FMT_Y1: {
-        int expstride=w<<2;
-        int explen=expstride*h;
-        if (explen>render->textmpa) {
-          void *nv=realloc(render->textmp,explen);
-          if (!nv) return -1;
-          render->textmp=nv;
-          render->textmpa=explen;
-        }
-        uint32_t zero,one;
-        uint8_t alphabytes[4]={0,0,0,0xff};
-        uint32_t alpha=*(uint32_t*)alphabytes;
-        if (fmt==EGG_TEX_FMT_A1) {
-          zero=0x00000000;
-          one=alpha;
-        } else {
-          zero=alpha;
-          one=0xffffffff;
-        }
-        render_expand_1bit(render->textmp,v,w,h,stride,zero,one);
-        v=render->textmp;
-        stride=expstride;
-        chanc=4;
-        ifmt=GL_RGBA;
-        glfmt=GL_RGBA;
-        type=GL_UNSIGNED_BYTE;
-      } break;
-    default: return -1;
+  if (render_texture_gl_format(&ifmt,&glfmt,&type,&chanc,fmt)<0) return -1;
+  if ((fmt==EGG_TEX_FMT_A1)||(fmt==EGG_TEX_FMT_Y1)) {
+    if (v) {
+      if (render_texture_expand_1bit(render,&v,&stride,w,h,fmt)<0) return -1;
+    } else {
+      stride=w<<2;
+    }
   }
   if (stride!=w*chanc) return -1;
   glBindTexture(GL_TEXTURE_2D,texture->texid);
@@ -192,6 +215,49 @@ static int render_texture_upload(struct render *render,struct render_texture *te
   return 0;
 }
 
+/* Upload a band of rows to a texture, whose geometry is already established.
+ */
+ 
+static int render_texture_upload_rows(struct render *render,struct render_texture *texture,int y,int h,int stride,const void *v) {
+  int w=texture->w,fmt=texture->fmt;
+  if ((y<0)||(h<1)||(y>texture->h-h)) return -1;
+  int ifmt,glfmt,type,chanc;
+  if (render_texture_gl_format(&ifmt,&glfmt,&type,&chanc,fmt)<0) return -1;
+  if ((fmt==EGG_TEX_FMT_A1)||(fmt==EGG_TEX_FMT_Y1)) {
+    if (render_texture_expand_1bit(render,&v,&stride,w,h,fmt)<0) return -1;
+  }
+  if (stride!=w*chanc) return -1;
+  glBindTexture(GL_TEXTURE_2D,texture->texid);
+  // (ifmt) not (glfmt): TexSubImage2D must match the texture's internal format.
+  glTexSubImage2D(GL_TEXTURE_2D,0,0,y,w,h,ifmt,type,v);
+  return 0;
+}
+
+/* Decode an encoded image straight into a texture, one band at a time.
+ * The first band establishes the format and full size, then each band goes up as it's decoded.
+ * So we never hold more than one band in memory, besides the texture itself.
+ * The target is a new GL texture, which render_texture_load swaps in only when the whole image is there.
+ */
+ 
+struct render_decode_context {
+  struct render *render;
+  struct render_texture *texture;
+  int fmt; // Zero until the first band.
+};
+
+static int render_texture_decode_band(struct rawimg *band,int y,int h,void *userdata) {
+  struct render_decode_context *ctx=userdata;
+  int fmt=render_texture_fmt_from_rawimg(band);
+  if (!fmt) return -1;
+  if (!ctx->fmt) {
+    if (render_texture_upload(ctx->render,ctx->texture,band->w,h,band->stride,fmt,0)<0) return -1;
+    ctx->fmt=fmt;
+  } else if (fmt!=ctx->fmt) {
+    return -1;
+  }
+  return render_texture_upload_rows(ctx->render,ctx->texture,y,band->h,band->stride,band->v);
+}
+
 /* Load texture.
  */
 
@@ -204,17 +270,19 @@ int render_texture_load(struct render *render,int texid,int w,int h,int stride,i
    */
   if (!w&&!h&&!stride&&!fmt) {
     if (texid==1) return -1;
-    struct rawimg *rawimg=rawimg_decode(src,srcc);
-    if (!rawimg) return -1;
-    if (!(fmt=render_texture_fmt_from_rawimg(rawimg))) {
-      rawimg_del(rawimg);
-      return -1;
-    }
-    if (render_texture_upload(render,texture,rawimg->w,rawimg->h,rawimg->stride,fmt,rawimg->v)<0) {
-      rawimg_del(rawimg);
+    struct render_texture decoded={0};
+    if (render_texture_init(&decoded)<0) return -1;
+    struct render_decode_context ctx={
+      .render=render,
+      .texture=&decoded,
+    };
+    if (rawimg_decode_bands(src,srcc,RENDER_DECODE_BAND_ROWS,render_texture_decode_band,&ctx)||!ctx.fmt) {
+      render_texture_cleanup(&decoded);
       return -1;
     }
-    rawimg_del(rawimg);
+    // Framebuffer goes with the old texture. render_texture_require_fb makes a new one if it's needed again.
+    render_texture_cleanup(texture);
+    *texture=decoded;
     return 0;
   }
   
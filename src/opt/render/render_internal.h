@@ -11,6 +11,9 @@
 #include "opt/rawimg/rawimg.h"
 #include "GLES2/gl2.h"
 
+// Encoded images decode and upload in bands of this many rows.
+#define RENDER_DECODE_BAND_ROWS 64
+
 struct render_vertex_raw {
   GLshort x,y;
   GLubyte r,g,b,a;
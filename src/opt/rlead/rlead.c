@@ -198,77 +198,136 @@ int rlead_encode(struct sr_encoder *dst,const struct rlead_image *image) {
   return 0;
 }
 
-/* Decode into image.
- * Caller strips the 7-byte header.
+/* Decoder context.
+ * Runs can span rows, so we keep the current run's remainder between calls, and can resume at any row.
  */
  
-static int rlead_decode_inner(struct rlead_image *image,const uint8_t *SRC,int srcc,uint8_t flags) {
-  int srcp=0;
-  uint8_t srcmask=0x80;
-  int dstx=0,dsty=0; // TODO use an iterator on (dst). Keeping it simple for now, at some compute cost.
-  uint8_t *dst=image->v;
-  int color=flags&1;
-  
-  while (dsty<image->h) {
-  
-    /* Read the next run length.
-     */
-    int runlen=0;
-    int wordsize=1;
-    while (1) {
-      int word=0;
-      int wordmask=1<<(wordsize-1);
-      while (wordmask) {
-        if (srcp>=srcc) return -1;
-        int srcbit=SRC[srcp]&srcmask;
-        if (srcmask==1) { srcp++; srcmask=0x80; }
-        else srcmask>>=1;
-        if (srcbit) word|=wordmask;
-        wordmask>>=1;
-      }
-      runlen+=word;
-      if (word!=(1<<wordsize)-1) break; // unsaturated, end of sequence
-      if (wordsize>=30) return -1;
-      wordsize++;
+struct rlead_decoder {
+  const uint8_t *src;
+  int srcc,srcp;
+  uint8_t srcmask;
+  int w,stride,flags;
+  int color; // Of the current run.
+  int runc; // Pixels remaining in the current run.
+  uint8_t *prvrow; // Last row emitted, for undoing the XOR filter. Null before the first row.
+};
+
+static void rlead_decoder_cleanup(struct rlead_decoder *ctx) {
+  if (ctx->prvrow) free(ctx->prvrow);
+}
+
+/* Caller strips the 7-byte header.
+ */
+
+static void rlead_decoder_init(struct rlead_decoder *ctx,const uint8_t *src,int srcc,int w,int flags) {
+  memset(ctx,0,sizeof(struct rlead_decoder));
+  ctx->src=src;
+  ctx->srcc=srcc;
+  ctx->srcmask=0x80;
+  ctx->w=w;
+  ctx->stride=(w+7)>>3;
+  ctx->flags=flags;
+  ctx->color=(flags&1)^1; // Reading the first run toggles it.
+}
+
+/* Read the next run length.
+ */
+ 
+static int rlead_decode_run(struct rlead_decoder *ctx) {
+  int runlen=0;
+  int wordsize=1;
+  while (1) {
+    int word=0;
+    int wordmask=1<<(wordsize-1);
+    while (wordmask) {
+      if (ctx->srcp>=ctx->srcc) return -1;
+      int srcbit=ctx->src[ctx->srcp]&ctx->srcmask;
+      if (ctx->srcmask==1) { ctx->srcp++; ctx->srcmask=0x80; }
+      else ctx->srcmask>>=1;
+      if (srcbit) word|=wordmask;
+      wordmask>>=1;
     }
-    runlen++;
-    
-    /* When the color is zero, we don't have to write anything.
-     * Just advance the write head.
-     */
-    if (!color) {
-      dstx+=runlen;
-      if (dstx>=image->w) {
-        dsty+=dstx/image->w;
-        dstx%=image->w;
-      }
-      
-    } else {
-      // Emit individual bits. TODO This is wildly inefficient. Use an iterator on dst.
-      while (runlen) {
-        dst[dsty*image->stride+(dstx>>3)]|=0x80>>(dstx&7);
-        runlen--;
-        if (++dstx>=image->w) {
-          dstx=0;
-          dsty++;
-          if (dsty>=image->h) break; // this is an error but whatever, just stop reading
-        }
-      }
+    runlen+=word;
+    if (word!=(1<<wordsize)-1) break; // unsaturated, end of sequence
+    if (wordsize>=30) return -1;
+    wordsize++;
+  }
+  return runlen+1;
+}
+
+/* Set bits (x..x+c-1) in one row, big-endian.
+ */
+ 
+static void rlead_set_bits(uint8_t *row,int x,int c) {
+  uint8_t *p=row+(x>>3);
+  int bit=x&7;
+  if (bit) {
+    int n=8-bit;
+    if (n>c) n=c;
+    (*p++)|=(0xff>>bit)&(0xff<<(8-bit-n));
+    c-=n;
+  }
+  if (c>=8) {
+    memset(p,0xff,c>>3);
+    p+=c>>3;
+    c&=7;
+  }
+  if (c) (*p)|=0xff<<(8-c);
+}
+
+/* Decode (rowc) rows into (dst), which the caller must zero first.
+ */
+ 
+static int rlead_decode_rows(struct rlead_decoder *ctx,uint8_t *dst,int stride,int rowc) {
+  uint8_t *row=dst;
+  int y=0,x=0;
+  while (y<rowc) {
+    if (!ctx->runc) {
+      if ((ctx->runc=rlead_decode_run(ctx))<0) return -1;
+      ctx->color^=1;
+    }
+    int c=ctx->w-x;
+    if (c>ctx->runc) c=ctx->runc;
+    if (ctx->color) rlead_set_bits(row,x,c);
+    ctx->runc-=c;
+    if ((x+=c)>=ctx->w) {
+      x=0;
+      y++;
+      row+=stride;
     }
-    color^=1;
   }
   
-  /* With the image now complete, undo the XOR row filter.
+  /* Undo the XOR row filter, continuing from the last row of the previous call.
    */
-  if (flags&2) {
-    uint8_t *rp=dst;
-    uint8_t *wp=dst+image->stride;
-    int c=image->stride*(image->h-1);
-    for (;c-->0;rp++,wp++) (*wp)^=(*rp);
+  if (ctx->flags&2) {
+    if (!ctx->prvrow) {
+      if (!(ctx->prvrow=calloc(1,ctx->stride))) return -1;
+      memcpy(ctx->prvrow,dst,ctx->stride);
+      dst+=stride;
+      rowc--;
+    }
+    for (;rowc-->0;dst+=stride) {
+      uint8_t *rp=ctx->prvrow,*wp=dst;
+      int i=ctx->stride;
+      for (;i-->0;rp++,wp++) (*wp)^=(*rp);
+      memcpy(ctx->prvrow,dst,ctx->stride);
+    }
   }
   
-  if (flags&4) image->alpha=1;
-  
+  return 0;
+}
+
+/* Decode header.
+ */
+ 
+static int rlead_decode_header(int *w,int *h,int *flags,const uint8_t *src,int srcc) {
+  if (!src||(srcc<7)) return -1;
+  if (memcmp(src,"\xbb\xad",2)) return -1;
+  *w=(src[2]<<8)|src[3];
+  *h=(src[4]<<8)|src[5];
+  *flags=src[6];
+  if ((*w<1)||(*w>0x7fff)) return -1;
+  if ((*h<1)||(*h>0x7fff)) return -1;
   return 0;
 }
 
@@ -276,14 +335,8 @@ static int rlead_decode_inner(struct rlead_image *image,const uint8_t *SRC,int s
  */
  
 struct rlead_image *rlead_decode(const void *src,int srcc) {
-  if (!src||(srcc<7)) return 0;
-  if (memcmp(src,"\xbb\xad",2)) return 0;
-  const uint8_t *SRC=src;
-  int w=(SRC[2]<<8)|SRC[3];
-  int h=(SRC[4]<<8)|SRC[5];
-  int flags=SRC[6];
-  if ((w<1)||(w>0x7fff)) return 0;
-  if ((h<1)||(h>0x7fff)) return 0;
+  int w,h,flags;
+  if (rlead_decode_header(&w,&h,&flags,src,srcc)<0) return 0;
   
   int stride=(w+7)>>3;
   struct rlead_image *image=calloc(1,sizeof(struct rlead_image));
@@ -295,10 +348,53 @@ struct rlead_image *rlead_decode(const void *src,int srcc) {
   image->w=w;
   image->h=h;
   image->stride=stride;
+  if (flags&4) image->alpha=1;
   
-  if (rlead_decode_inner(image,SRC+7,srcc-7,flags)<0) {
+  struct rlead_decoder ctx;
+  rlead_decoder_init(&ctx,(uint8_t*)src+7,srcc-7,w,flags);
+  if (rlead_decode_rows(&ctx,image->v,stride,h)<0) {
+    rlead_decoder_cleanup(&ctx);
     rlead_image_del(image);
     return 0;
   }
+  rlead_decoder_cleanup(&ctx);
   return image;
 }
+
+/* Decode in bands.
+ */
+ 
+int rlead_decode_bands(
+  const void *src,int srcc,int bandh,
+  int (*cb)(const struct rlead_image *band,int y,int h,void *userdata),
+  void *userdata
+) {
+  if (!cb) return -1;
+  int w,h,flags;
+  if (rlead_decode_header(&w,&h,&flags,src,srcc)<0) return -1;
+  if (bandh<1) bandh=1;
+  else if (bandh>h) bandh=h;
+  struct rlead_image band={
+    .w=w,
+    .h=bandh,
+    .stride=(w+7)>>3,
+    .alpha=(flags&4)?1:0,
+  };
+  if (!(band.v=malloc(band.stride*bandh))) return -1;
+  struct rlead_decoder ctx;
+  rlead_decoder_init(&ctx,(uint8_t*)src+7,srcc-7,w,flags);
+  int y=0,err=0;
+  while (y<h) {
+    if ((band.h=h-y)>bandh) band.h=bandh;
+    memset(band.v,0,band.stride*band.h);
+    if (rlead_decode_rows(&ctx,band.v,band.stride,band.h)<0) {
+      err=-1;
+      break;
+    }
+    if (err=cb(&band,y,h,userdata)) break;
+    y+=band.h;
+  }
+  rlead_decoder_cleanup(&ctx);
+  free(band.v);
+  return err;
+}
@@ -31,6 +31,25 @@
   _(sound) \
   _(map)
 
+/* wasm resources with a nonzero qualifier are WAMR AOT modules, compiled by wamrc for one host architecture.
+ * Names are wamrc's "--target".
+ */
+ 
+#define EGG_WASM_QUAL_x86_64 1
+#define EGG_WASM_QUAL_aarch64 2
+#define EGG_WASM_QUAL_armv7 3
+#define EGG_WASM_QUAL_thumbv7 4
+#define EGG_WASM_QUAL_i386 5
+#define EGG_WASM_QUAL_riscv64 6
+
+#define EGG_WASM_QUAL_FOR_EACH \
+  _(x86_64) \
+  _(aarch64) \
+  _(armv7) \
+  _(thumbv7) \
+  _(i386) \
+  _(riscv64)
+
 /* Stateless one-time decode.
  * Call (cb) until we finish the file or you return nonzero.
  * (v) points into (src), it's safe to retain as long as (src) is.
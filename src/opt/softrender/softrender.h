@@ -10,6 +10,7 @@
 struct softrender;
 struct egg_draw_tile;
 struct hostio_video_fb_description;
+struct rawimg;
 
 void softrender_del(struct softrender *softrender);
 struct softrender *softrender_new();
@@ -21,6 +22,12 @@ int softrender_texture_load(struct softrender *softrender,int texid,int w,int h,
 
 void softrender_texture_get_header(int *w,int *h,int *fmt,const struct softrender *softrender,int texid);
 
+/* Rewrite (rawimg) in place to the format we'd store it as, and return that EGG_TEX_FMT_*.
+ * Stride is not necessarily minimal after. <0 if it can't be converted.
+ * Doesn't touch any softrender context; it's safe from any thread.
+ */
+int softrender_force_valid_format(struct rawimg *rawimg);
+
 void softrender_texture_clear(struct softrender *softrender,int texid);
 
 void softrender_draw_mode(struct softrender *softrender,int xfermode,uint32_t replacement,uint8_t alpha);
@@ -16,6 +16,9 @@
 
 #define SOFTRENDER_SIZE_LIMIT 4096
 
+// Encoded images decode in bands of this many rows.
+#define SOFTRENDER_DECODE_BAND_ROWS 64
+
 /* Textures' (encfmt) may be replaced by one of these constants, as a usage hint.
  * Compare by identity, content is undefined.
  */
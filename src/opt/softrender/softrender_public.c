@@ -176,27 +176,73 @@ static void softrender_texture_replace(struct rawimg *rawimg,int srcstride,const
   }
 }
 
+/* Egg texture format of an image already in one of our formats.
+ */
+ 
+static int softrender_fmt_from_rawimg(const struct rawimg *rawimg) {
+  switch (rawimg->pixelsize) {
+    case 1: return (rawimg->amask==1)?EGG_TEX_FMT_A1:EGG_TEX_FMT_Y1;
+    case 8: return (rawimg->amask==0xff)?EGG_TEX_FMT_A8:EGG_TEX_FMT_Y8;
+    case 32: return EGG_TEX_FMT_RGBA;
+  }
+  return 0;
+}
+
 /* Rewrite image in place with an egg-legal format, if it's not already.
  */
  
-static int softrender_force_valid_format(struct rawimg *rawimg) {
+int softrender_force_valid_format(struct rawimg *rawimg) {
+  int err;
   switch (rawimg->pixelsize) {
     case 1: { // A1,Y1
-        if (rawimg->amask==1) return 0;
-        return rawimg_force_y1(rawimg);
+        if (rawimg->amask==1) err=0;
+        else err=rawimg_force_y1(rawimg);
       } break;
     case 8: { // A8,Y8
-        if (rawimg->amask==0xff) return 0;
-        return rawimg_force_y8(rawimg);
-      } break;
-    case 32: { // RGBA
-        return rawimg_force_rgba(rawimg);
+        if (rawimg->amask==0xff) err=0;
+        else err=rawimg_force_y8(rawimg);
       } break;
-    default: { // Anything else, promote to RGBA.
-        return rawimg_force_rgba(rawimg);
+    default: { // RGBA, or anything else promotes to RGBA.
+        err=rawimg_force_rgba(rawimg);
       }
   }
-  return -1;
+  if (err<0) return -1;
+  int fmt=softrender_fmt_from_rawimg(rawimg);
+  if (!fmt) return -1;
+  return fmt;
+}
+
+/* Decode an encoded image into a new rawimg, one band at a time.
+ * Each band is converted to an Egg format as it arrives, and copied into the destination.
+ * So we never hold more than one band in memory, besides the destination.
+ */
+ 
+struct softrender_decode_context {
+  struct rawimg *dst; // Null until the first band.
+};
+
+static int softrender_decode_band(struct rawimg *band,int y,int h,void *userdata) {
+  struct softrender_decode_context *ctx=userdata;
+  if (softrender_force_valid_format(band)<0) return -1;
+  if (!ctx->dst) {
+    if (!(ctx->dst=rawimg_new_alloc(band->w,h,band->pixelsize))) return -1;
+    ctx->dst->rmask=band->rmask;
+    ctx->dst->gmask=band->gmask;
+    ctx->dst->bmask=band->bmask;
+    ctx->dst->amask=band->amask;
+    memcpy(ctx->dst->chorder,band->chorder,4);
+    ctx->dst->bitorder=band->bitorder;
+  } else if ((band->pixelsize!=ctx->dst->pixelsize)||(band->w!=ctx->dst->w)) {
+    return -1;
+  }
+  if ((y<0)||(y>ctx->dst->h-band->h)) return -1;
+  uint8_t *dstrow=(uint8_t*)ctx->dst->v+y*ctx->dst->stride;
+  const uint8_t *srcrow=band->v;
+  int yi=band->h;
+  for (;yi-->0;dstrow+=ctx->dst->stride,srcrow+=band->stride) {
+    memcpy(dstrow,srcrow,ctx->dst->stride);
+  }
+  return 0;
 }
 
 /* Load pixels or encoded image to texture.
@@ -209,18 +255,17 @@ int softrender_texture_load(struct softrender *softrender,int texid,int w,int h,
   
   /* (w,h,stride,fmt) zero means (src) is an encoded image.
    * This is not allowed against texture 1.
-   * rawimg_decode() produces a new object, so we'll trash the old one on success.
+   * Decoding produces a new object, so we'll trash the old one on success.
    */
   if (!w&&!h&&!stride&&!fmt) {
     if (texid==1) return -1;
-    struct rawimg *newimg=rawimg_decode(src,srcc);
-    if (!newimg) return -1;
-    if (softrender_force_valid_format(newimg)<0) {
-      rawimg_del(newimg);
+    struct softrender_decode_context ctx={0};
+    if (rawimg_decode_bands(src,srcc,SOFTRENDER_DECODE_BAND_ROWS,softrender_decode_band,&ctx)||!ctx.dst) {
+      rawimg_del(ctx.dst);
       return -1;
     }
     rawimg_del(rawimg);
-    softrender->texturev[texid-1]=newimg;
+    softrender->texturev[texid-1]=ctx.dst;
     return 0;
   }
   
@@ -298,19 +343,7 @@ void softrender_texture_get_header(int *w,int *h,int *fmt,const struct softrende
   if (!rawimg) return;
   *w=rawimg->w;
   *h=rawimg->h;
-  switch (rawimg->pixelsize) {
-    case 1: {
-        if (rawimg->amask==1) *fmt=EGG_TEX_FMT_A1;
-        else *fmt=EGG_TEX_FMT_Y1;
-      } break;
-    case 8: {
-        if (rawimg->amask==0xff) *fmt=EGG_TEX_FMT_A8;
-        else *fmt=EGG_TEX_FMT_Y8;
-      } break;
-    case 32: {
-        *fmt=EGG_TEX_FMT_RGBA;
-      }
-  }
+  *fmt=softrender_fmt_from_rawimg(rawimg);
 }
 
 /* Clear texture.
@@ -57,12 +57,18 @@ void synth_play_sound_serial(
 );
 
 /* Current song time in beats, or -1 if no song.
- * This counter does return to zero when the song repeats.
- * Beware that this is not the whole picture, for reporting to the game: 
- * You should try to estimate how far into its last buffer the PCM driver is.
+ * This counter returns to the loop point when the song repeats.
+ * Beware that this is not the whole picture, for reporting to the game: It's the song time we're generating, not what's audible.
  */
 double synth_get_playhead(struct synth *synth);
 
+/* Song time in beats, as of (latency) frames before the end of everything we've generated.
+ * Give the driver's output latency, and this is the song time audible right now.
+ * Accounts for loops and song changes within the latency window.
+ * Safe to call without locking the driver.
+ */
+double synth_get_audible_playhead(struct synth *synth,int latency);
+
 /* You may push events into the system at any time.
  * Beware that this is the same event bus the song is using.
  * Songs can only address channels 0..7. You can use 8..15 and be confident you fully control them.
@@ -74,6 +74,7 @@ void synth_end_song(struct synth *synth) {
   
   synth_song_del(synth->song);
   synth->song=0;
+  synth_stamp(synth,-1.0,0.0);
   
   int i;
   struct synth_voice *voice=synth->voicev;
@@ -110,6 +111,7 @@ void synth_welcome_song(struct synth *synth) {
   }
   if (!synth->song) return;
   synth_song_init_channels(synth,synth->song);
+  synth_stamp(synth,0.0,0.0);
 }
 
 /* Play song from resource.
@@ -263,6 +265,74 @@ double synth_get_playhead(struct synth *synth) {
   return -1.0;
 }
 
+/* Playhead stamps.
+ * A seqlock: Readers copy what they need, and start over if (stampseq) changed meanwhile or was odd.
+ */
+ 
+static void synth_stamp_begin(struct synth *synth) {
+  __atomic_store_n(&synth->stampseq,synth->stampseq+1,__ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void synth_stamp_end(struct synth *synth) {
+  __atomic_store_n(&synth->stampseq,synth->stampseq+1,__ATOMIC_RELEASE);
+}
+ 
+void synth_stamp(struct synth *synth,double beat,double beats_per_frame) {
+  synth_stamp_begin(synth);
+  struct synth_stamp *stamp=synth->stampv+(synth->stampc&(SYNTH_STAMP_COUNT-1));
+  stamp->framep=synth->playframe;
+  stamp->beat=beat;
+  stamp->beats_per_frame=beats_per_frame;
+  synth->stampc++;
+  synth_stamp_end(synth);
+}
+
+void synth_stamp_framec(struct synth *synth) {
+  synth_stamp_begin(synth);
+  synth->stamp_framec=synth->framec;
+  synth_stamp_end(synth);
+}
+
+/* Playhead as of (latency) frames before the end of output.
+ */
+ 
+static int synth_read_stamp(struct synth_stamp *dst,const struct synth *synth,int latency) {
+  if (!synth->stampc) return -1;
+  int64_t framep=synth->stamp_framec-latency;
+  uint32_t stampc=synth->stampc;
+  uint32_t oldest=(stampc>SYNTH_STAMP_COUNT)?(stampc-SYNTH_STAMP_COUNT):0;
+  uint32_t i=stampc;
+  while (i-->oldest) {
+    const struct synth_stamp *stamp=synth->stampv+(i&(SYNTH_STAMP_COUNT-1));
+    if ((stamp->framep<=framep)||(i==oldest)) {
+      *dst=*stamp;
+      if (framep>dst->framep) dst->beat+=(framep-dst->framep)*dst->beats_per_frame;
+      return 0;
+    }
+  }
+  return -1;
+}
+ 
+double synth_get_audible_playhead(struct synth *synth,int latency) {
+  // "next" song is still the answer, as soon as the user asks for it. Audible or not.
+  if (synth->song_next) return synth_song_get_playhead(synth,synth->song_next);
+  if (latency<0) latency=0;
+  struct synth_stamp stamp;
+  int attempt=0,err;
+  for (;;attempt++) {
+    if (attempt>=8) return synth_get_playhead(synth); // Writer is very busy. Don't wait for it.
+    uint32_t seq=__atomic_load_n(&synth->stampseq,__ATOMIC_ACQUIRE);
+    if (seq&1) continue;
+    err=synth_read_stamp(&stamp,synth,latency);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&synth->stampseq,__ATOMIC_RELAXED)==seq) break;
+  }
+  // Song was requested but isn't audible yet: Zero, same as the unstamped playhead.
+  if ((err<0)||(stamp.beat<0.0)) return synth->song?0.0:-1.0;
+  return stamp.beat;
+}
+
 /* Drop any voice or proc that might refer to the given channel.
  */
  
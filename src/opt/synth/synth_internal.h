@@ -17,6 +17,7 @@
 #include "synth_playback.h"
 #include "opt/midi/midi.h"
 #include "opt/romr/romr.h"
+#include "opt/trace/trace.h"
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
@@ -46,6 +47,11 @@
 #define SYNTH_CHANNEL_COUNT 16
 #define SYNTH_SONG_CHANNEL_COUNT 8
 
+/* Song time is stamped at each change of tempo or position, so we can say where it was some frames ago.
+ * Must cover the longest driver latency, in song events. Power of two.
+ */
+#define SYNTH_STAMP_COUNT 256
+
 /* Signal-generating objects live in fixed-size lists.
  * When a new one gets created, it might evict some older one.
  * Safe to raise or lower these limits arbitrarily.
@@ -63,6 +69,7 @@ struct synth {
   uint32_t ifreqv[0x80]; // Note frequencies in 0..0xffffffff, for wave runners.
   int update_in_progress; // Duration of running update in frames, for new pcm printers.
   int64_t framec; // Total count generated since construction.
+  int64_t playframe; // Frame being generated, during update. Same as (framec) otherwise.
   struct romr *romr; // WEAK, OPTIONAL
   struct synth_cache *cache;
   
@@ -84,9 +91,25 @@ struct synth {
   int playbackc;
   struct sfg_printer **printerv;
   int printerc,printera;
+  
+  // Playhead history, see synth_get_audible_playhead. Readers don't lock; (stampseq) is odd while we're writing.
+  struct synth_stamp {
+    int64_t framep; // Output frame where this segment begins.
+    double beat; // Song time at (framep), or <0 for no song.
+    double beats_per_frame; // Zero to hold at (beat) until the next stamp.
+  } stampv[SYNTH_STAMP_COUNT];
+  uint32_t stampc; // Total ever written. Newest is at (stampc-1)&(SYNTH_STAMP_COUNT-1).
+  int64_t stamp_framec; // (framec) as of the last complete update.
+  uint32_t stampseq;
 };
 
 void synth_end_song(struct synth *synth);
+
+/* Record song time at the current output frame (synth->playframe).
+ * Finish updates with synth_stamp_framec, to publish the new end of output.
+ */
+void synth_stamp(struct synth *synth,double beat,double beats_per_frame);
+void synth_stamp_framec(struct synth *synth);
 int synth_has_song_voices(const struct synth *synth);
 void synth_welcome_song(struct synth *synth);
 
@@ -43,6 +43,8 @@ struct synth_song *synth_song_new(
   struct synth_song *song=calloc(1,sizeof(struct synth_song));
   if (!song) return 0;
   song->frames_per_ms=(float)synth->rate/1000.0f;
+  song->playhead_ms_next=-1;
+  song->loop_ms=-1;
   song->tempo=tempo;
   song->startp=startp;
   song->loopp=loopp;
@@ -93,12 +95,15 @@ int synth_song_update(struct synth *synth,struct synth_song *song) {
   
     // Finished?
     if (song->delay>0) return song->delay;
+    if ((song->loop_ms<0)&&(song->srcp==song->loopp)) song->loop_ms=song->playhead_ms;
     if ((song->srcp>=song->srcc)||!song->src[song->srcp]) {
       if (!song->repeat) return 0;
       // Looping. Force a tiny delay, just in case the song is invalid and has no delays of its own.
+      // Playhead returns to the loop point, after that delay.
       song->srcp=song->loopp;
       song->delay=1;
-      song->playhead_ms_next=song->playhead_ms;
+      song->playhead_ms_next=(song->loop_ms>0)?song->loop_ms:0;
+      synth_stamp(synth,(double)song->playhead_ms_next/(double)song->tempo,0.0);
       return 1;
     }
     
@@ -109,6 +114,8 @@ int synth_song_update(struct synth *synth,struct synth_song *song) {
     if (!(lead&0x80)) {
       if ((song->delay=lroundf(lead*song->frames_per_ms))<1) song->delay=1;
       song->playhead_ms_next=song->playhead_ms+lead;
+      // Stamp with the exact rate, so this segment lands right on the next one.
+      synth_stamp(synth,(double)song->playhead_ms/(double)song->tempo,(double)lead/((double)song->tempo*song->delay));
       return song->delay;
     }
   
@@ -162,9 +169,9 @@ void synth_song_advance(struct synth_song *song,int framec) {
   song->playhead_ms+=framec/song->frames_per_ms;
   if ((song->delay-=framec)<=0) {
     song->delay=0;
-    if (song->playhead_ms_next) {
+    if (song->playhead_ms_next>=0) {
       song->playhead_ms=song->playhead_ms_next;
-      song->playhead_ms_next=0;
+      song->playhead_ms_next=-1;
     }
   }
 }
@@ -16,7 +16,8 @@ struct synth_song {
   int qual,songid;
   int startp,loopp;
   int playhead_ms; // We make an effort to keep current at each advance.
-  int playhead_ms_next; // Force (playhead_ms) here when delay depletes. Avoids some rounding error.
+  int playhead_ms_next; // Force (playhead_ms) here when delay depletes, if >=0. Avoids some rounding error.
+  int loop_ms; // Song time at (loopp), once we've been there. <0 until then.
 };
 
 void synth_song_del(struct synth_song *song);
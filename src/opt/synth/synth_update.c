@@ -46,6 +46,7 @@ static void synth_updatef_mono(float *v,int c,struct synth *synth) {
   while (c>0) {
     
     int updc=c;
+    TRACE_BEGIN(song)
     if (synth->song) {
       int err=synth_song_update(synth,synth->song);
       if (err<=0) {
@@ -60,7 +61,9 @@ static void synth_updatef_mono(float *v,int c,struct synth *synth) {
       synth_welcome_song(synth);
       // Don't bother updating it this time around, we'll start on the next pass.
     }
+    TRACE_END(song)
     
+    TRACE_BEGIN(voices)
     int i;
     struct synth_voice *voice=synth->voicev;
     for (i=synth->voicec;i-->0;voice++) synth_voice_update(v,updc,synth,voice);
@@ -68,9 +71,11 @@ static void synth_updatef_mono(float *v,int c,struct synth *synth) {
     for (i=synth->procc;i-->0;proc++) synth_proc_update(v,updc,synth,proc);
     struct synth_playback *playback=synth->playbackv;
     for (i=synth->playbackc;i-->0;playback++) synth_playback_update(v,updc,synth,playback);
+    TRACE_END(voices)
     
     v+=updc;
     c-=updc;
+    synth->playframe+=updc;
   }
 }
 
@@ -142,6 +147,8 @@ void synth_updatef(float *v,int c,struct synth *synth) {
   }
   
   synth->update_in_progress=0;
+  synth->playframe=synth->framec;
+  synth_stamp_framec(synth);
   synth_reap_defunct_objects(synth);
 }
 
@@ -69,6 +69,66 @@ double timer_tick(struct timer *timer) {
   return elapsed;
 }
 
+/* Fixed-step update.
+ */
+ 
+void timer_set_fixed(struct timer *timer,int catchup) {
+  if (catchup<1) catchup=1;
+  timer->catchup=catchup;
+  timer->accumulator=timer->interval;
+  timer->prevtime=timer_now();
+}
+ 
+int timer_tick_fixed(struct timer *timer) {
+  timer->vframec++;
+  double now=timer_now();
+  double elapsed=now-timer->prevtime;
+  if (elapsed<0.0) {
+    timer->faultc++;
+    timer->prevtime=now;
+    elapsed=0.0;
+  }
+  while (timer->accumulator+elapsed<timer->interval) {
+    usleep((timer->interval-timer->accumulator-elapsed)*1000000.0);
+    now=timer_now();
+    elapsed=now-timer->prevtime;
+  }
+  timer->prevtime=now;
+  timer->accumulator+=elapsed;
+  int updatec=(int)(timer->accumulator/timer->interval);
+  if (updatec>timer->catchup) {
+    double lag=timer->accumulator-timer->interval*timer->catchup;
+    timer->lagc++;
+    timer->lagtotal+=lag;
+    if (lag>timer->lagmax) timer->lagmax=lag;
+    timer->accumulator-=lag;
+    updatec=timer->catchup;
+  }
+  timer->accumulator-=updatec*timer->interval;
+  timer->updatec+=updatec;
+  timer->skipc+=updatec-1;
+  return updatec;
+}
+
+/* Remaining time in the current frame.
+ */
+ 
+double timer_remaining(const struct timer *timer) {
+  if (timer->catchup) return timer->prevtime+timer->interval-timer->accumulator-timer_now();
+  return timer->prevtime+timer->min_update-timer_now();
+}
+
+/* Render interpolation.
+ */
+ 
+double timer_alpha(const struct timer *timer) {
+  if (!timer->catchup||(timer->interval<=0.0)) return 1.0;
+  double alpha=timer->accumulator/timer->interval;
+  if (alpha<0.0) return 0.0;
+  if (alpha>1.0) return 1.0;
+  return alpha;
+}
+
 /* Report.
  */
 
@@ -84,5 +144,11 @@ void timer_report(struct timer *timer) {
       "%d frames in %.03f s, average rate %.03f Hz, CPU load %.03f, faultc=%d, longc=%d\n",
       timer->vframec,elapsed_real,framerate,cpuload,timer->faultc,timer->longc
     );
+    if (timer->catchup) {
+      fprintf(stderr,
+        "Fixed step: %d updates, %d renders dropped. Fell behind %d times, lost %.03f s, worst %.03f ms.\n",
+        timer->updatec,timer->skipc,timer->lagc,timer->lagtotal,timer->lagmax*1000.0
+      );
+    }
   }
 }
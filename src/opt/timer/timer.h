@@ -18,6 +18,13 @@ struct timer {
   int vframec;
   int faultc;
   int longc;
+  // Fixed-step mode only:
+  int catchup; // Nonzero if fixed-step. Most updates we'll run per tick.
+  double accumulator; // Real time not yet consumed by updates.
+  int updatec;
+  int skipc; // Renders dropped, ie updates beyond the first in a tick.
+  int lagc; // Ticks where we hit the (catchup) limit and discarded time.
+  double lagtotal,lagmax; // Real time discarded, that the game never saw.
 };
 
 /* (tolerance) is 0..1, how far is the result of timer_tick allowed to deviate from (rate_hz).
@@ -31,6 +38,26 @@ void timer_init(struct timer *timer,int rate_hz,double tolerance);
  */
 double timer_tick(struct timer *timer);
 
+/* Switch to fixed-step timing, after timer_init.
+ * Use timer_tick_fixed instead of timer_tick: It sleeps until at least one interval is due,
+ * and returns how many updates to run, each advancing the game by exactly (interval).
+ * When we fall behind, the caller renders only once for all of those updates.
+ * (catchup) is the most updates per tick. Beyond that, we drop time instead, so the game slows down.
+ * (catchup) of 1 means never skip renders.
+ */
+void timer_set_fixed(struct timer *timer,int catchup);
+int timer_tick_fixed(struct timer *timer);
+
+/* Seconds until timer_tick would return without sleeping, or <=0 if it already would.
+ * Spare time, for anything that can be done opportunistically.
+ */
+double timer_remaining(const struct timer *timer);
+
+/* How far between the last update and the next one, 0..1, in fixed-step mode: Leftover accumulator over the interval.
+ * Always 1 in variable mode, since the last update consumed all the real time.
+ */
+double timer_alpha(const struct timer *timer);
+
 /* Dump a one-line report to stderr, whatever detail we have since startup.
  */
 void timer_report(struct timer *timer);
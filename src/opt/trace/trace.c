@@ -0,0 +1,176 @@
+#include "trace.h"
+#include "opt/serial/serial.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#define TRACE_RING_SIZE 0x10000 /* Zones per thread. Must be a power of two. */
+
+struct trace_zone {
+  const char *name; // WEAK, constant.
+  int64_t start,dur; // ns
+};
+
+struct trace_ring {
+  struct trace_ring *next;
+  const char *name;
+  int tid;
+  uint32_t head; // Count of zones ever written. Only the owner thread writes it, anyone can read.
+  struct trace_zone zonev[TRACE_RING_SIZE];
+};
+
+volatile int trace_enabled=0;
+
+static struct {
+  pthread_mutex_t mutex;
+  struct trace_ring *ringv; // Linked list, guarded by (mutex).
+  int tidnext;
+  int gen; // Increments at each init, so threads can tell their ring is stale.
+  int64_t starttime;
+  pthread_t mainthread;
+} trace={
+  .mutex=PTHREAD_MUTEX_INITIALIZER,
+};
+
+static __thread struct trace_ring *trace_self=0;
+static __thread int trace_self_gen=0;
+
+/* Clock.
+ */
+ 
+int64_t trace_now() {
+  struct timespec tv={0};
+  clock_gettime(CLOCK_MONOTONIC,&tv);
+  return (int64_t)tv.tv_sec*1000000000ll+tv.tv_nsec;
+}
+
+/* Cleanup.
+ */
+ 
+void trace_cleanup() {
+  trace_enabled=0;
+  pthread_mutex_lock(&trace.mutex);
+  while (trace.ringv) {
+    struct trace_ring *ring=trace.ringv;
+    trace.ringv=ring->next;
+    free(ring);
+  }
+  trace.tidnext=0;
+  pthread_mutex_unlock(&trace.mutex);
+}
+
+/* Init.
+ */
+ 
+int trace_init() {
+  trace_cleanup();
+  pthread_mutex_lock(&trace.mutex);
+  trace.gen++;
+  trace.starttime=trace_now();
+  trace.mainthread=pthread_self();
+  pthread_mutex_unlock(&trace.mutex);
+  trace_enabled=1;
+  return 0;
+}
+
+/* Get the calling thread's ring, creating if needed.
+ */
+ 
+static struct trace_ring *trace_get_ring() {
+  if (trace_self&&(trace_self_gen==trace.gen)) return trace_self;
+  struct trace_ring *ring=calloc(1,sizeof(struct trace_ring));
+  if (!ring) return 0;
+  pthread_mutex_lock(&trace.mutex);
+  ring->tid=++(trace.tidnext);
+  if (pthread_equal(pthread_self(),trace.mainthread)) ring->name="main";
+  ring->next=trace.ringv;
+  trace.ringv=ring;
+  trace_self_gen=trace.gen;
+  pthread_mutex_unlock(&trace.mutex);
+  trace_self=ring;
+  return ring;
+}
+
+void trace_thread_name(const char *name) {
+  if (!trace_enabled) return;
+  struct trace_ring *ring=trace_get_ring();
+  if (ring) ring->name=name;
+}
+
+/* Record one zone.
+ */
+ 
+void trace_record(const char *name,int64_t start) {
+  int64_t now=trace_now();
+  if (!trace_enabled) return;
+  struct trace_ring *ring=trace_get_ring();
+  if (!ring) return;
+  uint32_t head=ring->head;
+  struct trace_zone *zone=ring->zonev+(head&(TRACE_RING_SIZE-1));
+  zone->name=name;
+  zone->start=start;
+  zone->dur=now-start;
+  __atomic_store_n(&ring->head,head+1,__ATOMIC_RELEASE);
+}
+
+/* Encode.
+ */
+ 
+static int trace_encode_us(struct sr_encoder *dst,const char *k,int64_t ns) {
+  char tmp[32];
+  int tmpc=snprintf(tmp,sizeof(tmp),"%lld.%03d",(long long)(ns/1000),(int)(ns%1000));
+  if ((tmpc<1)||(tmpc>=sizeof(tmp))) return -1;
+  return sr_encode_json_preencoded(dst,k,-1,tmp,tmpc);
+}
+
+static int trace_encode_ring(struct sr_encoder *dst,const struct trace_ring *ring) {
+  char tmp[32];
+  const char *name=ring->name;
+  if (!name) {
+    snprintf(tmp,sizeof(tmp),"thread %d",ring->tid);
+    name=tmp;
+  }
+  int jsonctx=sr_encode_json_object_start(dst,0,0);
+  sr_encode_json_string(dst,"name",4,"thread_name",11);
+  sr_encode_json_string(dst,"ph",2,"M",1);
+  sr_encode_json_int(dst,"pid",3,1);
+  sr_encode_json_int(dst,"tid",3,ring->tid);
+  int argsctx=sr_encode_json_object_start(dst,"args",4);
+  sr_encode_json_string(dst,"name",4,name,-1);
+  sr_encode_json_end(dst,argsctx);
+  if (sr_encode_json_end(dst,jsonctx)<0) return -1;
+  
+  uint32_t head=__atomic_load_n(&ring->head,__ATOMIC_ACQUIRE);
+  uint32_t p=(head>TRACE_RING_SIZE)?(head-TRACE_RING_SIZE):0;
+  for (;p<head;p++) {
+    const struct trace_zone *zone=ring->zonev+(p&(TRACE_RING_SIZE-1));
+    jsonctx=sr_encode_json_object_start(dst,0,0);
+    sr_encode_json_string(dst,"name",4,zone->name,-1);
+    sr_encode_json_string(dst,"ph",2,"X",1);
+    trace_encode_us(dst,"ts",zone->start-trace.starttime);
+    trace_encode_us(dst,"dur",zone->dur);
+    sr_encode_json_int(dst,"pid",3,1);
+    sr_encode_json_int(dst,"tid",3,ring->tid);
+    if (sr_encode_json_end(dst,jsonctx)<0) return -1;
+  }
+  return 0;
+}
+ 
+int trace_encode(struct sr_encoder *dst) {
+  int jsonctx=sr_encode_json_object_start(dst,0,0);
+  int arrayctx=sr_encode_json_array_start(dst,"traceEvents",11);
+  pthread_mutex_lock(&trace.mutex);
+  const struct trace_ring *ring=trace.ringv;
+  for (;ring;ring=ring->next) {
+    if (trace_encode_ring(dst,ring)<0) {
+      pthread_mutex_unlock(&trace.mutex);
+      return -1;
+    }
+  }
+  pthread_mutex_unlock(&trace.mutex);
+  sr_encode_json_end(dst,arrayctx);
+  sr_encode_json_string(dst,"displayTimeUnit",15,"ms",2);
+  return sr_encode_json_end(dst,jsonctx);
+}
@@ -0,0 +1,77 @@
+/* trace.h
+ * Required: serial
+ * Link: -lpthread
+ *
+ * Frame profiler. Records timed zones from any thread, and dumps them as Chrome trace JSON.
+ * Load the output in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Each thread writes to its own ring buffer, no locks after its first zone.
+ * When a ring fills, we overwrite its oldest zones. So a long session keeps only the last few seconds per thread.
+ *
+ * Costs nothing when disabled:
+ * Without USE_trace, the macros are empty and the functions are no-op inlines.
+ * With USE_trace but no trace_init(), each zone costs one test of a global.
+ *
+ * Usage:
+ *   TRACE_BEGIN(update)
+ *   ...
+ *   TRACE_END(update)
+ * (tag) is a bare identifier, and also the zone's name in the output.
+ * BEGIN declares a local, so both must be in the same block.
+ */
+ 
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+struct sr_encoder;
+
+#if USE_trace
+
+extern volatile int trace_enabled;
+
+int64_t trace_now(); // ns, monotonic.
+
+/* Start recording. Call from the main thread; its zones will be labelled "main".
+ */
+int trace_init();
+
+/* Stop recording and drop everything. All other threads that recorded zones must have stopped by now.
+ */
+void trace_cleanup();
+
+/* Name the calling thread. (name) must be constant; we keep the pointer.
+ */
+void trace_thread_name(const char *name);
+
+/* Produce a complete Chrome trace JSON file.
+ * Other threads should be stopped first, or we might catch some zones in the middle of writing.
+ */
+int trace_encode(struct sr_encoder *dst);
+
+void trace_record(const char *name,int64_t start);
+
+static inline int64_t trace_begin() {
+  return trace_enabled?trace_now():0;
+}
+
+static inline void trace_end(const char *name,int64_t start) {
+  if (start) trace_record(name,start);
+}
+
+#define TRACE_BEGIN(tag) int64_t trace_start_##tag=trace_begin();
+#define TRACE_END(tag) trace_end(#tag,trace_start_##tag);
+
+#else
+
+static inline int trace_init() { return -1; }
+static inline void trace_cleanup() {}
+static inline void trace_thread_name(const char *name) {}
+static inline int trace_encode(struct sr_encoder *dst) { return -1; }
+
+#define TRACE_BEGIN(tag)
+#define TRACE_END(tag)
+
+#endif
+#endif
@@ -19,6 +19,30 @@ struct wamr *wamr_new();
  */
 int wamr_set_exports(struct wamr *wamr,void *symbolv,int symbolc);
 
+/* Execution tiers.
+ * AUTO means JIT if this WAMR build supports it, otherwise the interpreter. Never AOT.
+ * AOT isn't something we choose: If wamr_add_module gets an AOT file (from wamrc), that's the tier.
+ * AOT files are native code, nothing sandboxes them. wamr_add_module refuses them unless the tier is AOT.
+ * Setting AOT here permits them, and tells the caller to go looking for one. Plain Wasm modules still run as AUTO.
+ */
+#define WAMR_TIER_AUTO   0
+#define WAMR_TIER_INTERP 1
+#define WAMR_TIER_JIT    2
+#define WAMR_TIER_AOT    3
+
+/* Set tier before adding modules. Returns the tier, which might not be what you asked for.
+ */
+int wamr_set_tier(struct wamr *wamr,int tier);
+
+/* Tier that a loaded module actually runs in, never AUTO.
+ */
+int wamr_get_tier(const struct wamr *wamr,int modid);
+
+const char *wamr_tier_repr(int tier);
+
+/* (src) may be a Wasm module or a WAMR AOT module, we check its signature. AOT only at WAMR_TIER_AOT.
+ * Caller must keep (src) alive until the module is deleted.
+ */
 int wamr_add_module(struct wamr *wamr,int modid,void *src,int srcc,const char *refname);
 int wamr_link_function(struct wamr *wamr,int modid,int fnid,const char *name);
 
@@ -31,4 +55,11 @@ int wamr_call(struct wamr *wamr,int modid,int fnid,uint32_t *argv,int argc);
  */
 void *wamr_validate_pointer(struct wamr *wamr,int modid,uint32_t waddr,int reqc);
 
+/* Allocate (c) bytes in the module's heap, and return its wasm address.
+ * Zero on errors. Put its native address in (*dstpp) if not null.
+ * This may grow the module's memory, which invalidates any native pointers you got from wamr_validate_pointer.
+ */
+uint32_t wamr_module_malloc(struct wamr *wamr,int modid,int c,void **dstpp);
+void wamr_module_free(struct wamr *wamr,int modid,uint32_t waddr);
+
 #endif
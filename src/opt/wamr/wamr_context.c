@@ -47,6 +47,61 @@ int wamr_set_exports(struct wamr *wamr,void *symbolv,int symbolc) {
   return 0;
 }
 
+/* Tiers.
+ */
+ 
+static int wamr_jit_supported() {
+  return wasm_runtime_is_running_mode_supported(Mode_Fast_JIT)?1:0;
+}
+ 
+int wamr_set_tier(struct wamr *wamr,int tier) {
+  switch (tier) {
+    case WAMR_TIER_AUTO:
+    case WAMR_TIER_INTERP:
+    case WAMR_TIER_AOT:
+      break;
+    case WAMR_TIER_JIT: if (!wamr_jit_supported()) tier=WAMR_TIER_INTERP; break;
+    default: return -1;
+  }
+  return wamr->tier=tier;
+}
+
+int wamr_get_tier(const struct wamr *wamr,int modid) {
+  const struct wamr_module *module=wamr->modulev;
+  int i=wamr->modulec;
+  for (;i-->0;module++) {
+    if (module->modid==modid) return module->tier;
+  }
+  return -1;
+}
+
+const char *wamr_tier_repr(int tier) {
+  switch (tier) {
+    case WAMR_TIER_AUTO: return "auto";
+    case WAMR_TIER_INTERP: return "interp";
+    case WAMR_TIER_JIT: return "jit";
+    case WAMR_TIER_AOT: return "aot";
+  }
+  return "?";
+}
+
+/* Choose running mode for a new bytecode module instance, and return its tier.
+ */
+ 
+static int wamr_apply_tier(struct wamr *wamr,struct wamr_module *module) {
+  if (wamr->tier==WAMR_TIER_INTERP) {
+    if (wasm_runtime_is_running_mode_supported(Mode_Interp)) {
+      wasm_runtime_set_running_mode(module->instance,Mode_Interp);
+    }
+  } else if (wamr_jit_supported()) { // AUTO, JIT, and AOT when we didn't get an AOT module.
+    wasm_runtime_set_running_mode(module->instance,Mode_Fast_JIT);
+  }
+  switch (wasm_runtime_get_running_mode(module->instance)) {
+    case Mode_Interp: return WAMR_TIER_INTERP;
+    default: return WAMR_TIER_JIT;
+  }
+}
+
 /* Add module.
  */
 
@@ -67,6 +122,12 @@ int wamr_add_module(struct wamr *wamr,int modid,void *src,int srcc,const char *r
   int stack_size=0x01000000;
   int heap_size=0x01000000;
   char msg[1024]={0};
+  int aot=(get_package_type(src,srcc)==Wasm_Module_AoT); // Check before loading; the loader may modify (src).
+  if (aot&&(wamr->tier!=WAMR_TIER_AOT)) {
+    if (refname) fprintf(stderr,"%s: AOT module refused, tier is '%s'.\n",refname,wamr_tier_repr(wamr->tier));
+    wamr->modulec--;
+    return -1;
+  }
   if (!(module->module=wasm_runtime_load(src,srcc,msg,sizeof(msg)))) {
     if (refname) fprintf(stderr,"%s:wasm_runtime_load: %s\n",refname,msg);
     wamr->modulec--;
@@ -79,6 +140,11 @@ int wamr_add_module(struct wamr *wamr,int modid,void *src,int srcc,const char *r
     wamr_module_cleanup(module);
     return -1;
   }
+  if (aot) {
+    module->tier=WAMR_TIER_AOT;
+  } else {
+    module->tier=wamr_apply_tier(wamr,module);
+  }
   if (!(module->ee=wasm_runtime_create_exec_env(module->instance,stack_size))) {
     if (refname) fprintf(stderr,"%s:wasm_runtime_create_exec_env\n",refname);
     wamr->modulec--;
@@ -161,3 +227,32 @@ void *wamr_validate_pointer(struct wamr *wamr,int modid,uint32_t waddr,int reqc)
   }
   return 0;
 }
+
+/* Allocate in module heap.
+ */
+ 
+uint32_t wamr_module_malloc(struct wamr *wamr,int modid,int c,void **dstpp) {
+  if (c<1) return 0;
+  struct wamr_module *module=wamr->modulev;
+  int modulei=wamr->modulec;
+  for (;modulei-->0;module++) {
+    if (module->modid!=modid) continue;
+    void *dst=0;
+    uint64_t waddr=wasm_runtime_module_malloc(module->instance,c,&dst);
+    if (!waddr||(waddr>UINT32_MAX)||!dst) return 0;
+    if (dstpp) *dstpp=dst;
+    return waddr;
+  }
+  return 0;
+}
+
+void wamr_module_free(struct wamr *wamr,int modid,uint32_t waddr) {
+  if (!waddr) return;
+  struct wamr_module *module=wamr->modulev;
+  int modulei=wamr->modulec;
+  for (;modulei-->0;module++) {
+    if (module->modid!=modid) continue;
+    wasm_runtime_module_free(module->instance,waddr);
+    return;
+  }
+}
@@ -19,11 +19,13 @@ struct wamr_module {
   wasm_module_t module;
   wasm_module_inst_t instance;
   wasm_exec_env_t ee;
+  int tier;
   struct wamr_function *functionv;
   int functionc,functiona;
 };
 
 struct wamr {
+  int tier;
   struct wamr_module *modulev;
   int modulec,modulea;
 };
@@ -0,0 +1,277 @@
+/* http_test.c
+ * Streaming bodies over loopback, with server and client in one context.
+ */
+
+#include "test/test.h"
+#include "opt/http/http_internal.h"
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define HTTP_TEST_PIECE 65536
+#define HTTP_TEST_BIG (100<<20)
+#define HTTP_TEST_TIMEOUT 30.0
+
+/* Shared state for one session.
+ * Bodies are a predictable byte pattern, so both ends can check every byte without holding the whole thing.
+ */
+
+static struct http_test {
+  int port;
+  int producep,producec; // Server.
+  int consumep,consume_error; // Client.
+  int complete,status;
+  int wbufmax,rbufmax; // Largest buffer any socket grew to.
+  int bodyfd; // Serve this file instead of producing, if >=0.
+} http_test;
+
+static uint8_t http_test_byte(int p) {
+  return (p*7+(p>>16))&0xff;
+}
+
+static int http_test_produce(struct sr_encoder *dst,void *userdata) {
+  int c=http_test.producec-http_test.producep;
+  if (c>HTTP_TEST_PIECE) c=HTTP_TEST_PIECE;
+  if (sr_encoder_require(dst,c)<0) return -1;
+  uint8_t *v=(uint8_t*)dst->v+dst->c;
+  int i=0; for (;i<c;i++) v[i]=http_test_byte(http_test.producep+i);
+  dst->c+=c;
+  http_test.producep+=c;
+  return (http_test.producep<http_test.producec)?1:0;
+}
+
+static int http_test_serve(struct http_xfer *req,struct http_xfer *rsp,void *userdata) {
+  http_test.producep=0;
+  http_xfer_set_status(rsp,200,"OK");
+  if (http_test.bodyfd>=0) {
+    int fd=http_test.bodyfd;
+    http_test.bodyfd=-1;
+    return http_xfer_set_body_file(rsp,fd,http_test.producec);
+  }
+  return http_xfer_set_body_producer(rsp,-1,http_test_produce,0,0);
+}
+
+static int http_test_consume(struct http_xfer *req,const void *v,int c) {
+  const uint8_t *V=v;
+  int i=0; for (;i<c;i++) {
+    if (V[i]!=http_test_byte(http_test.consumep+i)) {
+      http_test.consume_error=1;
+      return -1;
+    }
+  }
+  http_test.consumep+=c;
+  return 0;
+}
+
+static int http_test_response(struct http_xfer *req,struct http_xfer *rsp) {
+  http_test.complete=1;
+  http_test.status=http_xfer_get_status(rsp);
+  return 0;
+}
+
+/* New context, listening on some free port near 28400.
+ */
+
+static struct http_context *http_test_begin(int producec) {
+  memset(&http_test,0,sizeof(http_test));
+  http_test.producec=producec;
+  http_test.bodyfd=-1;
+  struct http_context_delegate delegate={.cb_serve=http_test_serve};
+  struct http_context *ctx=http_context_new(&delegate);
+  if (!ctx) return 0;
+  int port=28400; for (;port<28420;port++) {
+    if (http_listen(ctx,1,port)>=0) {
+      http_test.port=port;
+      return ctx;
+    }
+  }
+  http_context_del(ctx);
+  return 0;
+}
+
+static void http_test_measure(const struct http_context *ctx) {
+  int i=ctx->socketc;
+  while (i-->0) {
+    const struct http_socket *sock=ctx->socketv[i];
+    if (sock->wbuf.a>http_test.wbufmax) http_test.wbufmax=sock->wbuf.a;
+    if (sock->rbuf.a>http_test.rbufmax) http_test.rbufmax=sock->rbuf.a;
+  }
+}
+
+/* 100 MB chunked body, produced and consumed piecewise.
+ * No socket buffer may grow past a few pieces, and the process's peak memory mustn't grow by anything like the body.
+ */
+
+ITEST(http_stream_100mb_in_bounded_memory) {
+  struct rusage usage={0};
+  getrusage(RUSAGE_SELF,&usage);
+  long maxrss0=usage.ru_maxrss;
+
+  struct http_context *ctx=http_test_begin(HTTP_TEST_BIG);
+  ASSERT(ctx,"listen")
+  char url[64];
+  int urlc=snprintf(url,sizeof(url),"http://127.0.0.1:%d/big",http_test.port);
+  struct http_xfer *req=http_request(ctx,"GET",url,urlc,http_test_response,0);
+  ASSERT(req)
+  ASSERT_CALL(http_xfer_set_body_consumer(req,http_test_consume))
+
+  double deadline=http_now()+HTTP_TEST_TIMEOUT;
+  while (!http_test.complete) {
+    ASSERT(http_now()<deadline,"timed out at %d/%d bytes",http_test.consumep,HTTP_TEST_BIG)
+    ASSERT_CALL(http_update(ctx,10))
+    http_test_measure(ctx);
+  }
+  ASSERT_NOT(http_test.consume_error,"at byte %d",http_test.consumep)
+  ASSERT_INTS(http_test.status,200)
+  ASSERT_INTS(http_test.producep,HTTP_TEST_BIG)
+  ASSERT_INTS(http_test.consumep,HTTP_TEST_BIG)
+  ASSERT_INTS_OP(http_test.wbufmax,<=,HTTP_TEST_PIECE*4)
+  ASSERT_INTS_OP(http_test.rbufmax,<=,HTTP_TEST_PIECE*4)
+  http_context_del(ctx);
+
+  getrusage(RUSAGE_SELF,&usage);
+  long growth=usage.ru_maxrss-maxrss0; // kB on Linux.
+  ASSERT_INTS_OP(growth,<,16*1024,"peak RSS grew by %ld kB",growth)
+  return 0;
+}
+
+/* A chunked producer answering HTTP/1.0 must send the body bare, and close to end it.
+ * Our own client only speaks 1.1, so play the 1.0 client over a plain socket.
+ */
+
+ITEST(http_stream_to_http10_client_is_unchunked) {
+  const int bodyc=200000;
+  struct http_context *ctx=http_test_begin(bodyc);
+  ASSERT(ctx,"listen")
+  int fd=socket(AF_INET,SOCK_STREAM,0);
+  ASSERT_INTS_OP(fd,>=,0)
+  struct sockaddr_in saddr={.sin_family=AF_INET,.sin_port=htons(http_test.port)};
+  saddr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+  ASSERT_CALL(connect(fd,(struct sockaddr*)&saddr,sizeof(saddr)))
+  const char request[]="GET /small HTTP/1.0\r\n\r\n";
+  ASSERT_INTS(send(fd,request,sizeof(request)-1,0),sizeof(request)-1)
+
+  struct sr_encoder rsp={0};
+  double deadline=http_now()+HTTP_TEST_TIMEOUT;
+  for (;;) {
+    ASSERT(http_now()<deadline,"timed out with %d bytes",rsp.c)
+    ASSERT_CALL(http_update(ctx,10))
+    ASSERT_CALL(sr_encoder_require(&rsp,65536))
+    int err=recv(fd,(char*)rsp.v+rsp.c,rsp.a-rsp.c,MSG_DONTWAIT);
+    if (!err) break; // Server closed: End of body.
+    if (err<0) {
+      ASSERT((errno==EAGAIN)||(errno==EWOULDBLOCK),"recv: %m")
+      continue;
+    }
+    rsp.c+=err;
+  }
+  close(fd);
+  http_context_del(ctx);
+
+  const char *src=rsp.v;
+  int headerc=0;
+  while ((headerc<=rsp.c-4)&&memcmp(src+headerc,"\r\n\r\n",4)) headerc++;
+  ASSERT_INTS_OP(headerc,<=,rsp.c-4,"end of headers")
+  headerc+=4;
+  ASSERT(!memcmp(src,"HTTP/1.",7),"status line")
+  int i=0,closec=0;
+  for (;i<headerc;i++) {
+    ASSERT(sr_memcasecmp(src+i,"Transfer-Encoding",17),"Sent chunked to an HTTP/1.0 client")
+    if (!sr_memcasecmp(src+i,"Connection: close",17)) closec++;
+  }
+  ASSERT_INTS(closec,1,"Connection: close")
+  ASSERT_INTS(rsp.c-headerc,bodyc)
+  for (i=0;i<bodyc;i++) {
+    if ((uint8_t)src[headerc+i]!=http_test_byte(i)) FAIL("body byte %d",i)
+  }
+  sr_encoder_cleanup(&rsp);
+  return 0;
+}
+
+/* File body to a client that reads it slowly.
+ * Each time the client drains a little, poll reports the server writeable, but there's much less room than a sendfile chunk.
+ * The server must take what fits and move on, not wait for the client to read the rest.
+ * We give the server's socket a send timeout, so if it does block, this fails instead of hanging.
+ */
+
+ITEST(http_sendfile_to_slow_client_does_not_block) {
+  const int bodyc=16<<20;
+  struct http_context *ctx=http_test_begin(bodyc);
+  ASSERT(ctx,"listen")
+  char path[]="/tmp/http_test_XXXXXX";
+  int bodyfd=mkstemp(path);
+  ASSERT_INTS_OP(bodyfd,>=,0)
+  unlink(path);
+  uint8_t *body=malloc(bodyc);
+  ASSERT(body)
+  int i=0; for (;i<bodyc;i++) body[i]=http_test_byte(i);
+  ASSERT_INTS(write(bodyfd,body,bodyc),bodyc)
+  free(body);
+  lseek(bodyfd,0,SEEK_SET);
+  http_test.bodyfd=bodyfd;
+
+  int fd=socket(AF_INET,SOCK_STREAM,0);
+  ASSERT_INTS_OP(fd,>=,0)
+  int rcvbuf=16384;
+  ASSERT_CALL(setsockopt(fd,SOL_SOCKET,SO_RCVBUF,&rcvbuf,sizeof(rcvbuf)))
+  struct sockaddr_in saddr={.sin_family=AF_INET,.sin_port=htons(http_test.port)};
+  saddr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+  ASSERT_CALL(connect(fd,(struct sockaddr*)&saddr,sizeof(saddr)))
+
+  struct http_socket *stream=0;
+  double deadline=http_now()+HTTP_TEST_TIMEOUT;
+  while (!stream) {
+    ASSERT(http_now()<deadline,"timed out waiting for accept")
+    ASSERT_CALL(http_update(ctx,10))
+    for (i=ctx->socketc;i-->0;) {
+      if (ctx->socketv[i]->role==HTTP_SOCKET_ROLE_SERVER_STREAM) stream=ctx->socketv[i];
+    }
+  }
+  int sndbuf=16384;
+  ASSERT_CALL(setsockopt(stream->fd,SOL_SOCKET,SO_SNDBUF,&sndbuf,sizeof(sndbuf)))
+  struct timeval sndtimeo={.tv_sec=1};
+  ASSERT_CALL(setsockopt(stream->fd,SOL_SOCKET,SO_SNDTIMEO,&sndtimeo,sizeof(sndtimeo)))
+  const char request[]="GET /file HTTP/1.1\r\nConnection: close\r\n\r\n";
+  ASSERT_INTS(send(fd,request,sizeof(request)-1,0),sizeof(request)-1)
+
+  // Read a little at a time. Every update must come back promptly.
+  struct sr_encoder rsp={0};
+  for (i=0;i<200;i++) {
+    double before=http_now();
+    ASSERT_CALL(http_update(ctx,1))
+    double elapsed=http_now()-before;
+    ASSERT(elapsed<0.5,"http_update blocked for %.03f s on a slow client, after %d bytes",elapsed,rsp.c)
+    ASSERT_CALL(sr_encoder_require(&rsp,4096))
+    int err=recv(fd,(char*)rsp.v+rsp.c,4096,MSG_DONTWAIT);
+    if (err>0) rsp.c+=err;
+  }
+
+  // Now drain it all, and check every byte.
+  deadline=http_now()+HTTP_TEST_TIMEOUT;
+  for (;;) {
+    ASSERT(http_now()<deadline,"timed out with %d bytes",rsp.c)
+    ASSERT_CALL(http_update(ctx,1))
+    ASSERT_CALL(sr_encoder_require(&rsp,1<<20))
+    int err=recv(fd,(char*)rsp.v+rsp.c,rsp.a-rsp.c,MSG_DONTWAIT);
+    if (!err) break;
+    if (err<0) {
+      ASSERT((errno==EAGAIN)||(errno==EWOULDBLOCK),"recv: %m")
+      continue;
+    }
+    rsp.c+=err;
+  }
+  close(fd);
+  http_context_del(ctx);
+
+  const char *src=rsp.v;
+  int headerc=0;
+  while ((headerc<=rsp.c-4)&&memcmp(src+headerc,"\r\n\r\n",4)) headerc++;
+  ASSERT_INTS_OP(headerc,<=,rsp.c-4,"end of headers")
+  headerc+=4;
+  ASSERT_INTS(rsp.c-headerc,bodyc)
+  for (i=0;i<bodyc;i++) {
+    if ((uint8_t)src[headerc+i]!=http_test_byte(i)) FAIL("body byte %d",i)
+  }
+  sr_encoder_cleanup(&rsp);
+  return 0;
+}
@@ -0,0 +1,165 @@
+/* inlog_test.c
+ * Round trip through writer and reader, and rejection of anything short of a complete log.
+ */
+
+#include "test/test.h"
+#include "opt/inlog/inlog.h"
+#include "egg/egg.h"
+
+/* A session to record: Per frame, an elapsed time and some events.
+ * Frame -1 is init, events before the first frame.
+ */
+
+#define INLOG_TEST_FRAMEC 40
+
+static double inlog_test_elapsed(int framei) {
+  if (framei%7==3) return 0.0333; // Some hitches, otherwise a steady 60 Hz, so both FRAME and FRAME_SAME get used.
+  return 1.0/60.0;
+}
+
+static int inlog_test_eventc(int framei) {
+  if (framei==-1) return 2;
+  if (framei==5) return 300; // More than one EVENTS command.
+  if (framei==6) return 255;
+  return (framei*5)%4;
+}
+
+static void inlog_test_event(struct egg_event *event,int framei,int eventi) {
+  event->type=1+(framei+eventi)%20;
+  event->v[0]=framei;
+  event->v[1]=eventi;
+  event->v[2]=-eventi*1000;
+  event->v[3]=(eventi&1)?0x7fffffff:(int)0x80000000;
+}
+
+static int inlog_test_record(struct inlog_writer *writer) {
+  struct egg_event eventv[300];
+  ASSERT_CALL(inlog_writer_init(writer))
+  int framei=-1; for (;framei<INLOG_TEST_FRAMEC;framei++) {
+    if (framei>=0) ASSERT_CALL(inlog_write_frame(writer,inlog_test_elapsed(framei)))
+    int eventc=inlog_test_eventc(framei);
+    int i=0; for (;i<eventc;i++) inlog_test_event(eventv+i,framei,i);
+    // Deliver the way egg_event_next does, in whatever chunks the client asks for.
+    int p=0; while (p<eventc) {
+      int c=eventc-p;
+      if (c>16) c=16;
+      ASSERT_CALL(inlog_write_events(writer,eventv+p,c))
+      p+=c;
+    }
+  }
+  ASSERT_CALL(inlog_writer_finish(writer))
+  return 0;
+}
+
+ITEST(inlog_round_trip) {
+  struct inlog_writer writer={0};
+  ASSERT_CALL(inlog_test_record(&writer))
+  ASSERT_INTS(writer.framec,INLOG_TEST_FRAMEC)
+
+  struct inlog_reader reader;
+  ASSERT_INTS(inlog_reader_init(&reader,writer.dst.v,writer.dst.c),INLOG_TEST_FRAMEC)
+  struct egg_event eventv[300];
+  int eventtotal=0;
+  int framei=-1; for (;framei<INLOG_TEST_FRAMEC;framei++) {
+    if (framei>=0) {
+      double elapsed=-1.0;
+      ASSERT_INTS(inlog_read_frame(&elapsed,&reader),1,"frame %d",framei)
+      ASSERT(elapsed==inlog_test_elapsed(framei),"frame %d: elapsed %f",framei,elapsed)
+    }
+    // Read in chunks of 7, deliberately out of step with how they were written.
+    int expectc=inlog_test_eventc(framei);
+    int eventc=0;
+    for (;;) {
+      int c=inlog_read_events(eventv+eventc,7,&reader);
+      ASSERT_INTS_OP(c,>=,0)
+      ASSERT_INTS_OP(c,<=,7)
+      eventc+=c;
+      if (c<7) break;
+    }
+    ASSERT_INTS(eventc,expectc,"frame %d",framei)
+    int i=0; for (;i<eventc;i++) {
+      struct egg_event expect;
+      inlog_test_event(&expect,framei,i);
+      ASSERT_INTS(eventv[i].type,expect.type,"frame %d event %d",framei,i)
+      ASSERT(!memcmp(eventv[i].v,expect.v,sizeof(expect.v)),"frame %d event %d",framei,i)
+    }
+    eventtotal+=eventc;
+  }
+  double elapsed=0.0;
+  ASSERT_INTS(inlog_read_frame(&elapsed,&reader),0)
+  ASSERT_INTS(inlog_read_events(eventv,10,&reader),0)
+  ASSERT_INTS(reader.framec,INLOG_TEST_FRAMEC)
+  ASSERT_INTS(reader.eventtotal,eventtotal)
+  inlog_writer_cleanup(&writer);
+  return 0;
+}
+
+/* A client that doesn't read all of its events still gets the next frame's, not the leftovers.
+ */
+
+ITEST(inlog_unread_events_are_skipped) {
+  struct inlog_writer writer={0};
+  ASSERT_CALL(inlog_test_record(&writer))
+  struct inlog_reader reader;
+  ASSERT_INTS(inlog_reader_init(&reader,writer.dst.v,writer.dst.c),INLOG_TEST_FRAMEC)
+  struct egg_event event;
+  double elapsed;
+  int framei=0; for (;framei<INLOG_TEST_FRAMEC;framei++) {
+    ASSERT_INTS(inlog_read_frame(&elapsed,&reader),1)
+    if (inlog_test_eventc(framei)>0) {
+      ASSERT_INTS(inlog_read_events(&event,1,&reader),1)
+      ASSERT_INTS(event.v[0],framei)
+      ASSERT_INTS(event.v[1],0)
+    } else {
+      ASSERT_INTS(inlog_read_events(&event,1,&reader),0)
+    }
+  }
+  ASSERT_INTS(inlog_read_frame(&elapsed,&reader),0)
+  inlog_writer_cleanup(&writer);
+  return 0;
+}
+
+/* Every truncation must fail, even those that fall between commands.
+ * Also bad signature, trailing garbage, unknown commands, counts that don't match, and FRAME_SAME first.
+ */
+
+ITEST(inlog_reject_malformed) {
+  struct inlog_writer writer={0};
+  ASSERT_CALL(inlog_test_record(&writer))
+  struct inlog_reader reader;
+  int srcc=0; for (;srcc<writer.dst.c;srcc++) {
+    // Exact-size copy, so a sanitizer would catch reads past the end.
+    uint8_t *src=malloc(srcc?srcc:1);
+    ASSERT(src)
+    memcpy(src,writer.dst.v,srcc);
+    ASSERT_INTS_OP(inlog_reader_init(&reader,src,srcc),<,0,"srcc=%d/%d",srcc,writer.dst.c)
+    free(src);
+  }
+  ASSERT_INTS(inlog_reader_init(&reader,writer.dst.v,writer.dst.c),INLOG_TEST_FRAMEC)
+
+  uint8_t *src=malloc(writer.dst.c+1);
+  ASSERT(src)
+  memcpy(src,writer.dst.v,writer.dst.c);
+  src[writer.dst.c]=0x01;
+  ASSERT_INTS_OP(inlog_reader_init(&reader,src,writer.dst.c+1),<,0,"trailing FRAME_SAME")
+  src[1]='X';
+  ASSERT_INTS_OP(inlog_reader_init(&reader,src,writer.dst.c),<,0,"signature")
+  src[1]='E';
+  src[writer.dst.c-8]++;
+  ASSERT_INTS_OP(inlog_reader_init(&reader,src,writer.dst.c),<,0,"frame count")
+  src[writer.dst.c-8]--;
+  src[writer.dst.c-4]++;
+  ASSERT_INTS_OP(inlog_reader_init(&reader,src,writer.dst.c),<,0,"event count")
+  src[writer.dst.c-4]--;
+  ASSERT_INTS(inlog_reader_init(&reader,src,writer.dst.c),INLOG_TEST_FRAMEC)
+  free(src);
+  inlog_writer_cleanup(&writer);
+
+  const uint8_t unknown[]={0,'E','I','R',0x02,0,0,0,0,0,0,0,0,0x09,0x04,1,0,0,0,0,0,0,0};
+  ASSERT_INTS_OP(inlog_reader_init(&reader,unknown,sizeof(unknown)),<,0,"unknown command")
+  const uint8_t samefirst[]={0,'E','I','R',0x01,0x04,1,0,0,0,0,0,0,0};
+  ASSERT_INTS_OP(inlog_reader_init(&reader,samefirst,sizeof(samefirst)),<,0,"FRAME_SAME first")
+  const uint8_t empty[]={0,'E','I','R',0x04,0,0,0,0,0,0,0,0};
+  ASSERT_INTS(inlog_reader_init(&reader,empty,sizeof(empty)),0,"empty session")
+  return 0;
+}
@@ -9,8 +9,11 @@ int main(int argc,char **argv) {
   int i=sizeof(itestv)/sizeof(itestv[0]);
   for (;i-->0;itest++) {
     if (test_filter(itest->name,itest->tags,itest->if_unspecified)) {
-      if (itest->fn()<0) {
+      int result=itest->fn();
+      if (result<0) {
         fprintf(stderr,"TEST FAIL %s [%s:%d%s]\n",itest->name,itest->file,itest->line,itest->tags);
+      } else if (result>0) {
+        fprintf(stderr,"TEST SKIP %s [%s:%d%s]\n",itest->name,itest->file,itest->line,itest->tags);
       } else {
         fprintf(stderr,"TEST PASS %s [%s:%d%s]\n",itest->name,itest->file,itest->line,itest->tags);
       }
@@ -0,0 +1,432 @@
+/* localstore_test.c
+ * Crash safety of the journalled file: Torn writes, corrupt frames, and upgrading the legacy format.
+ * Then a randomized check against a plain model, and a benchmark.
+ */
+
+#include "test/test.h"
+#include "opt/localstore/localstore_internal.h"
+#include <unistd.h>
+#include <time.h>
+
+#define LOCALSTORE_TEST_PATH "mid/tests/localstore_test.els"
+#define LOCALSTORE_TEST_TORN_PATH "mid/tests/localstore_test_torn.els"
+#define LOCALSTORE_TEST_STATE_SIZE 1024
+
+/* A session of five flushes. Null value deletes.
+ */
+
+static const struct localstore_test_change {
+  int framei;
+  const char *k,*v;
+} localstore_test_changev[]={
+  {0,"a","apple"},
+  {0,"b","banana"},
+  {0,"c","cherry"},
+  {1,"b","blueberry"},
+  {1,"d","date"},
+  {2,"a",0},
+  {2,"c","cranberry-cranberry"},
+  {3,"e","elderberry"},
+  {3,"d",0},
+  {4,"a","apricot"},
+};
+#define LOCALSTORE_TEST_FRAMEC 5
+
+/* Whole content as "k=v;" in key order, for comparing.
+ */
+
+static void localstore_test_dump(char *dst,struct localstore *store) {
+  int dstc=0,i=0;
+  dst[0]=0;
+  for (;;i++) {
+    const char *k=0,*v=0;
+    int kc=localstore_key_by_index(&k,store,i);
+    if (kc<1) break;
+    int vc=localstore_get(&v,store,k,kc);
+    int err=snprintf(dst+dstc,LOCALSTORE_TEST_STATE_SIZE-dstc,"%.*s=%.*s;",kc,k,vc,v);
+    if ((err<0)||(dstc+err>=LOCALSTORE_TEST_STATE_SIZE)) break;
+    dstc+=err;
+  }
+}
+
+/* Run the session through a journal, recording the file's size and the store's content after each flush lands.
+ */
+
+static struct localstore_test_session {
+  uint8_t *file;
+  int filec;
+  int boundaryv[LOCALSTORE_TEST_FRAMEC];
+  char statev[LOCALSTORE_TEST_FRAMEC][LOCALSTORE_TEST_STATE_SIZE];
+} session;
+
+static int localstore_test_record_session() {
+  unlink(LOCALSTORE_TEST_PATH);
+  struct localstore store={.save_permit=1};
+  ASSERT_CALL(localstore_open(&store,LOCALSTORE_TEST_PATH))
+  const struct localstore_test_change *change=localstore_test_changev;
+  int i=sizeof(localstore_test_changev)/sizeof(localstore_test_changev[0]);
+  int framei=0;
+  for (;framei<LOCALSTORE_TEST_FRAMEC;framei++) {
+    for (;(i>0)&&(change->framei==framei);i--,change++) {
+      ASSERT_CALL(localstore_set(&store,change->k,-1,change->v,-1))
+    }
+    ASSERT_CALL(localstore_flush(&store))
+    ASSERT_CALL(localstore_sync(&store))
+    uint8_t *tmp=0;
+    int tmpc=file_read(&tmp,LOCALSTORE_TEST_PATH);
+    ASSERT_INTS_OP(tmpc,>,0)
+    free(tmp);
+    session.boundaryv[framei]=tmpc;
+    localstore_test_dump(session.statev[framei],&store);
+  }
+  localstore_cleanup(&store);
+  if (session.file) free(session.file);
+  ASSERT_INTS((session.filec=file_read(&session.file,LOCALSTORE_TEST_PATH)),session.boundaryv[LOCALSTORE_TEST_FRAMEC-1])
+  // Every flush after the first must have appended, or the truncation test isn't testing much.
+  for (framei=1;framei<LOCALSTORE_TEST_FRAMEC;framei++) {
+    ASSERT_INTS_OP(session.boundaryv[framei],>,session.boundaryv[framei-1])
+  }
+  return 0;
+}
+
+// Content expected from a file of (c) bytes: Whatever frames it has complete.
+static const char *localstore_test_state_at(int c) {
+  const char *state="";
+  int framei=0;
+  for (;framei<LOCALSTORE_TEST_FRAMEC;framei++) {
+    if (session.boundaryv[framei]<=c) state=session.statev[framei];
+  }
+  return state;
+}
+
+static int localstore_test_is_boundary(int c) {
+  if (!c||(c==4)) return 1; // Empty, or signature only: Valid empty stores.
+  int framei=0;
+  for (;framei<LOCALSTORE_TEST_FRAMEC;framei++) {
+    if (session.boundaryv[framei]==c) return 1;
+  }
+  return 0;
+}
+
+/* A crash can leave the file cut off anywhere. Every cut must load the frames before it, and ask to be rewritten.
+ */
+
+ITEST(localstore_truncate_at_every_byte) {
+  ASSERT_CALL(localstore_test_record_session())
+  char actual[LOCALSTORE_TEST_STATE_SIZE];
+  int c=0; for (;c<=session.filec;c++) {
+    ASSERT_CALL(file_write(LOCALSTORE_TEST_TORN_PATH,session.file,c))
+    struct localstore store={0};
+    ASSERT_CALL(localstore_load(&store,LOCALSTORE_TEST_TORN_PATH),"c=%d/%d",c,session.filec)
+    localstore_test_dump(actual,&store);
+    const char *expect=localstore_test_state_at(c);
+    ASSERT_STRINGS(actual,-1,expect,-1,"c=%d/%d",c,session.filec)
+    ASSERT_INTS(store.dirty,localstore_test_is_boundary(c)?0:1,"c=%d/%d",c,session.filec)
+    localstore_cleanup(&store);
+  }
+  unlink(LOCALSTORE_TEST_TORN_PATH);
+  unlink(LOCALSTORE_TEST_PATH);
+  return 0;
+}
+
+/* Open a torn file, keep going, and the next flush leaves a clean file with everything.
+ */
+
+ITEST(localstore_recover_from_torn_write) {
+  ASSERT_CALL(localstore_test_record_session())
+  int c=session.boundaryv[LOCALSTORE_TEST_FRAMEC-1]-3;
+  ASSERT_CALL(file_write(LOCALSTORE_TEST_TORN_PATH,session.file,c))
+  struct localstore store={.save_permit=1};
+  ASSERT_CALL(localstore_open(&store,LOCALSTORE_TEST_TORN_PATH))
+  char actual[LOCALSTORE_TEST_STATE_SIZE],expect[LOCALSTORE_TEST_STATE_SIZE];
+  localstore_test_dump(actual,&store);
+  ASSERT_STRINGS(actual,-1,session.statev[LOCALSTORE_TEST_FRAMEC-2],-1)
+  ASSERT_CALL(localstore_set(&store,"f",-1,"fig",-1))
+  localstore_test_dump(expect,&store);
+  ASSERT_CALL(localstore_flush(&store))
+  ASSERT_CALL(localstore_sync(&store))
+  localstore_cleanup(&store);
+
+  struct localstore reload={0};
+  ASSERT_CALL(localstore_load(&reload,LOCALSTORE_TEST_TORN_PATH))
+  localstore_test_dump(actual,&reload);
+  ASSERT_STRINGS(actual,-1,expect,-1)
+  ASSERT_INTS(reload.dirty,0,"Torn tail should have been rewritten")
+  localstore_cleanup(&reload);
+  unlink(LOCALSTORE_TEST_TORN_PATH);
+  unlink(LOCALSTORE_TEST_PATH);
+  return 0;
+}
+
+/* A bad CRC, in the header or by damage to the payload, ends the file at the frame before.
+ */
+
+ITEST(localstore_flipped_crc) {
+  ASSERT_CALL(localstore_test_record_session())
+  uint8_t *copy=malloc(session.filec);
+  ASSERT(copy)
+  char actual[LOCALSTORE_TEST_STATE_SIZE];
+  int framei=0; for (;framei<LOCALSTORE_TEST_FRAMEC;framei++) {
+    int framep=framei?session.boundaryv[framei-1]:4;
+    const char *expect=framei?session.statev[framei-1]:"";
+    const int damagev[]={framep+4,framep+7,framep+LOCALSTORE_FRAME_HEADER_SIZE,session.boundaryv[framei]-1};
+    int damagei=0; for (;damagei<sizeof(damagev)/sizeof(damagev[0]);damagei++) {
+      memcpy(copy,session.file,session.filec);
+      copy[damagev[damagei]]^=0x10;
+      ASSERT_CALL(file_write(LOCALSTORE_TEST_TORN_PATH,copy,session.filec))
+      struct localstore store={0};
+      ASSERT_CALL(localstore_load(&store,LOCALSTORE_TEST_TORN_PATH),"frame %d, byte %d",framei,damagev[damagei])
+      localstore_test_dump(actual,&store);
+      ASSERT_STRINGS(actual,-1,expect,-1,"frame %d, byte %d",framei,damagev[damagei])
+      ASSERT_INTS(store.dirty,1,"frame %d, byte %d",framei,damagev[damagei])
+      localstore_cleanup(&store);
+    }
+  }
+  free(copy);
+  unlink(LOCALSTORE_TEST_TORN_PATH);
+  unlink(LOCALSTORE_TEST_PATH);
+  return 0;
+}
+
+/* A frame length with the high bit set is garbage, same as any other length past the end of the file.
+ */
+
+ITEST(localstore_huge_frame_length) {
+  ASSERT_CALL(localstore_test_record_session())
+  uint8_t *copy=malloc(session.filec);
+  ASSERT(copy)
+  char actual[LOCALSTORE_TEST_STATE_SIZE];
+  const uint8_t highv[]={0x80,0xff};
+  int highi=0; for (;highi<sizeof(highv);highi++) {
+    memcpy(copy,session.file,session.filec);
+    copy[session.boundaryv[0]]=highv[highi];
+    ASSERT_CALL(file_write(LOCALSTORE_TEST_TORN_PATH,copy,session.filec))
+    struct localstore store={0};
+    ASSERT_CALL(localstore_load(&store,LOCALSTORE_TEST_TORN_PATH),"high byte 0x%02x",highv[highi])
+    localstore_test_dump(actual,&store);
+    ASSERT_STRINGS(actual,-1,session.statev[0],-1,"high byte 0x%02x",highv[highi])
+    ASSERT_INTS(store.dirty,1,"high byte 0x%02x",highv[highi])
+    localstore_cleanup(&store);
+  }
+  free(copy);
+  unlink(LOCALSTORE_TEST_TORN_PATH);
+  unlink(LOCALSTORE_TEST_PATH);
+  return 0;
+}
+
+/* Legacy files, bare records with no signature, load as is and get rewritten in the new format at the first flush.
+ * After that, flushes append.
+ */
+
+ITEST(localstore_legacy_upgrade) {
+  const uint8_t legacy[]={
+    1,'a',0,5,'a','p','p','l','e',
+    2,'b','b',0,6,'b','a','n','a','n','a',
+    1,'c',0,1,'3',
+  };
+  const char *expect="a=apple;c=3;bb=banana;";
+  ASSERT_CALL(file_write(LOCALSTORE_TEST_PATH,legacy,sizeof(legacy)))
+  struct localstore store={.save_permit=1};
+  ASSERT_CALL(localstore_open(&store,LOCALSTORE_TEST_PATH))
+  char actual[LOCALSTORE_TEST_STATE_SIZE];
+  localstore_test_dump(actual,&store);
+  ASSERT_STRINGS(actual,-1,expect,-1)
+  ASSERT_INTS(store.dirty,1,"Legacy file should be marked for rewrite")
+  ASSERT_CALL(localstore_flush(&store))
+  ASSERT_CALL(localstore_sync(&store))
+  localstore_cleanup(&store);
+
+  uint8_t *serial=0;
+  int serialc=file_read(&serial,LOCALSTORE_TEST_PATH);
+  ASSERT_INTS_OP(serialc,>=,4)
+  ASSERT(!memcmp(serial,LOCALSTORE_SIGNATURE,4),"Not rewritten in the new format")
+  free(serial);
+  struct localstore reload={.save_permit=1};
+  ASSERT_CALL(localstore_open(&reload,LOCALSTORE_TEST_PATH))
+  localstore_test_dump(actual,&reload);
+  ASSERT_STRINGS(actual,-1,expect,-1)
+  ASSERT_INTS(reload.dirty,0)
+  ASSERT_CALL(localstore_set(&reload,"bb",2,0,0))
+  ASSERT_CALL(localstore_flush(&reload))
+  ASSERT_CALL(localstore_sync(&reload))
+  localstore_cleanup(&reload);
+
+  int appendedc=file_read(&serial,LOCALSTORE_TEST_PATH);
+  ASSERT_INTS(appendedc,serialc+LOCALSTORE_FRAME_HEADER_SIZE+5,"Expected one frame appended: Delete of 'bb'")
+  free(serial);
+  struct localstore final={0};
+  ASSERT_CALL(localstore_load(&final,LOCALSTORE_TEST_PATH))
+  localstore_test_dump(actual,&final);
+  ASSERT_STRINGS(actual,-1,"a=apple;c=3;",-1)
+  localstore_cleanup(&final);
+  unlink(LOCALSTORE_TEST_PATH);
+  return 0;
+}
+
+/* Random sets and deletes against a plain model, through a journal, then reload and compare.
+ * Many values come straight out of the store: set(k2,get(k1)), set(k,get(k)), a suffix of its own value, keys from key_by_index.
+ * The arena grows as we go, so some of those land just as it reallocates. Run under a sanitizer to see that bite.
+ */
+
+#define LOCALSTORE_MODEL_KEYC 40
+#define LOCALSTORE_MODEL_OPC 20000
+
+static struct localstore_model {
+  char k[LOCALSTORE_MODEL_KEYC][8];
+  int kc[LOCALSTORE_MODEL_KEYC];
+  char v[LOCALSTORE_MODEL_KEYC][256];
+  int vc[LOCALSTORE_MODEL_KEYC]; // Zero if absent.
+  unsigned int seed;
+} model;
+
+static int localstore_model_rand(int limit) {
+  model.seed=model.seed*1103515245+12345;
+  return (model.seed>>8)%limit;
+}
+
+static int localstore_model_keyp(const char *k,int kc) {
+  int i=0; for (;i<LOCALSTORE_MODEL_KEYC;i++) {
+    if ((model.kc[i]==kc)&&!memcmp(model.k[i],k,kc)) return i;
+  }
+  return -1;
+}
+
+static int localstore_model_compare(struct localstore *store,int opi) {
+  int presentc=0,i=0;
+  for (;i<LOCALSTORE_MODEL_KEYC;i++) {
+    const char *v=0;
+    int vc=localstore_get(&v,store,model.k[i],model.kc[i]);
+    ASSERT_INTS(vc,model.vc[i],"op %d, key '%s'",opi,model.k[i])
+    if (vc) {
+      ASSERT(!memcmp(v,model.v[i],vc),"op %d, key '%s'",opi,model.k[i])
+      ASSERT_INTS(v[vc],0,"op %d, key '%s' not terminated",opi,model.k[i])
+      presentc++;
+    }
+  }
+  ASSERT_INTS(store->entryc,presentc,"op %d",opi)
+  const char *pvk=0;
+  int pvkc=0;
+  for (i=0;;i++) {
+    const char *k=0;
+    int kc=localstore_key_by_index(&k,store,i);
+    if (kc<1) break;
+    ASSERT_INTS(k[kc],0,"op %d, key %d not terminated",opi,i)
+    int keyp=localstore_model_keyp(k,kc);
+    ASSERT_INTS_OP(keyp,>=,0,"op %d, unexpected key '%.*s'",opi,kc,k)
+    ASSERT(model.vc[keyp],"op %d, deleted key '%.*s' still listed",opi,kc,k)
+    if (pvk) ASSERT((pvkc<kc)||((pvkc==kc)&&(memcmp(pvk,k,kc)<0)),"op %d, '%.*s' before '%.*s'",opi,pvkc,pvk,kc,k)
+    pvk=k;
+    pvkc=kc;
+  }
+  ASSERT_INTS(i,presentc,"op %d",opi)
+  return 0;
+}
+
+ITEST(localstore_randomized_model_check) {
+  memset(&model,0,sizeof(model));
+  model.seed=0x1234;
+  int i=0; for (;i<LOCALSTORE_MODEL_KEYC;i++) {
+    model.kc[i]=snprintf(model.k[i],sizeof(model.k[i]),"%.*s%d",i%3,"kk",i);
+  }
+  unlink(LOCALSTORE_TEST_PATH);
+  struct localstore store={.save_permit=1};
+  ASSERT_CALL(localstore_open(&store,LOCALSTORE_TEST_PATH))
+  int opi=0; for (;opi<LOCALSTORE_MODEL_OPC;opi++) {
+    int a=localstore_model_rand(LOCALSTORE_MODEL_KEYC);
+    int b=localstore_model_rand(LOCALSTORE_MODEL_KEYC);
+    const char *k=model.k[a],*v=0;
+    int kc=model.kc[a],vc=0;
+    char tmp[256];
+    switch (localstore_model_rand(6)) {
+      case 0: case 1: { // Fresh value, any length.
+          vc=1+localstore_model_rand(sizeof(tmp)-1);
+          int j=0; for (;j<vc;j++) tmp[j]='a'+localstore_model_rand(26);
+          v=tmp;
+        } break;
+      case 2: vc=0; break; // Delete.
+      case 3: vc=localstore_get(&v,&store,model.k[b],model.kc[b]); break; // set(k2,get(k1)); absent deletes.
+      case 4: { // Tail of its own value, possibly all of it.
+          vc=localstore_get(&v,&store,k,kc);
+          if (vc>1) { int d=localstore_model_rand(vc); v+=d; vc-=d; }
+        } break;
+      case 5: { // Key from the arena too.
+          if (store.entryc) kc=localstore_key_by_index(&k,&store,localstore_model_rand(store.entryc));
+          vc=localstore_get(&v,&store,model.k[b],model.kc[b]);
+        } break;
+    }
+    int keyp=localstore_model_keyp(k,kc);
+    ASSERT_INTS_OP(keyp,>=,0)
+    if (vc) memcpy(model.v[keyp],v,vc); // Before the set, (v) might be about to change.
+    model.vc[keyp]=vc;
+    ASSERT_CALL(localstore_set(&store,k,kc,v,vc),"op %d",opi)
+    if (!(opi%97)) ASSERT_CALL(localstore_model_compare(&store,opi))
+    if (!(opi%500)) ASSERT_CALL(localstore_flush(&store),"op %d",opi)
+  }
+  ASSERT_CALL(localstore_model_compare(&store,opi))
+  ASSERT_CALL(localstore_flush(&store))
+  ASSERT_CALL(localstore_sync(&store))
+  localstore_cleanup(&store);
+
+  struct localstore reload={0};
+  ASSERT_CALL(localstore_load(&reload,LOCALSTORE_TEST_PATH))
+  ASSERT_CALL(localstore_model_compare(&reload,-1))
+  localstore_cleanup(&reload);
+  unlink(LOCALSTORE_TEST_PATH);
+  return 0;
+}
+
+/* 10k keys set, read, updated longer, and deleted, through a journal. Times are only reported, never asserted.
+ */
+
+#define LOCALSTORE_BENCH_KEYC 10000
+
+static double localstore_bench_now() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec+ts.tv_nsec/1000000000.0;
+}
+
+ITEST(localstore_benchmark_10k) {
+  unlink(LOCALSTORE_TEST_PATH);
+  struct localstore store={.save_permit=1};
+  ASSERT_CALL(localstore_open(&store,LOCALSTORE_TEST_PATH))
+  char k[32],v[32];
+  int kc,vc,i;
+  double t0=localstore_bench_now();
+  for (i=0;i<LOCALSTORE_BENCH_KEYC;i++) {
+    kc=snprintf(k,sizeof(k),"level%d.score",(i*7919)%LOCALSTORE_BENCH_KEYC);
+    vc=snprintf(v,sizeof(v),"%d",i);
+    ASSERT_CALL(localstore_set(&store,k,kc,v,vc))
+  }
+  double t1=localstore_bench_now();
+  for (i=0;i<LOCALSTORE_BENCH_KEYC;i++) {
+    kc=snprintf(k,sizeof(k),"level%d.score",(i*7919)%LOCALSTORE_BENCH_KEYC);
+    vc=snprintf(v,sizeof(v),"%d",i);
+    const char *actual=0;
+    int actualc=localstore_get(&actual,&store,k,kc);
+    ASSERT_STRINGS(actual,actualc,v,vc,"%s",k)
+  }
+  double t2=localstore_bench_now();
+  for (i=0;i<LOCALSTORE_BENCH_KEYC;i++) {
+    kc=snprintf(k,sizeof(k),"level%d.score",i);
+    vc=snprintf(v,sizeof(v),"updated-%d",i);
+    ASSERT_CALL(localstore_set(&store,k,kc,v,vc))
+  }
+  double t3=localstore_bench_now();
+  ASSERT_CALL(localstore_flush(&store))
+  ASSERT_CALL(localstore_sync(&store))
+  double t4=localstore_bench_now();
+  for (i=0;i<LOCALSTORE_BENCH_KEYC;i++) {
+    kc=snprintf(k,sizeof(k),"level%d.score",i);
+    ASSERT_CALL(localstore_set(&store,k,kc,0,0))
+  }
+  double t5=localstore_bench_now();
+  ASSERT_INTS(store.entryc,0)
+  localstore_cleanup(&store);
+  unlink(LOCALSTORE_TEST_PATH);
+  fprintf(stderr,
+    "localstore %d keys, ms: insert %.3f, get %.3f, update %.3f, flush+sync %.3f, delete %.3f\n",
+    LOCALSTORE_BENCH_KEYC,(t1-t0)*1000.0,(t2-t1)*1000.0,(t3-t2)*1000.0,(t4-t3)*1000.0,(t5-t4)*1000.0
+  );
+  return 0;
+}
@@ -0,0 +1,112 @@
+/* png_encode_test.c
+ * Striped encoder: Output must decode to the input, at every effort, and while other threads encode too.
+ */
+
+#include "test/test.h"
+#include "opt/png/png.h"
+#include "opt/serial/serial.h"
+#include <stdint.h>
+#include <pthread.h>
+
+/* RGBA image with some smooth areas and some noise, so every filter gets picked somewhere.
+ */
+
+static struct png_image *png_test_image(int w,int h,uint32_t seed) {
+  struct png_image *image=png_image_new(w,h,8,6);
+  if (!image) return 0;
+  uint8_t *row=image->v;
+  int y=0; for (;y<h;y++,row+=image->stride) {
+    uint8_t *p=row;
+    int x=0; for (;x<w;x++,p+=4) {
+      seed=seed*1103515245+12345;
+      if ((x>>6)&1) {
+        p[0]=x; p[1]=y; p[2]=x+y; p[3]=0xff;
+      } else {
+        p[0]=seed>>8; p[1]=seed>>16; p[2]=seed>>24; p[3]=(seed>>4)|0x80;
+      }
+    }
+  }
+  return image;
+}
+
+static int png_test_roundtrip(const struct png_image *image,int effort) {
+  struct sr_encoder dst={0};
+  ASSERT_CALL(png_encode_effort(&dst,image,effort),"effort=%d",effort)
+  struct png_image *decoded=png_decode(dst.v,dst.c);
+  ASSERT(decoded,"effort=%d, %d bytes",effort,dst.c)
+  ASSERT_INTS(decoded->w,image->w)
+  ASSERT_INTS(decoded->h,image->h)
+  ASSERT_INTS(decoded->depth,image->depth)
+  ASSERT_INTS(decoded->colortype,image->colortype)
+  const uint8_t *arow=decoded->v,*erow=image->v;
+  int y=0; for (;y<image->h;y++,arow+=decoded->stride,erow+=image->stride) {
+    if (memcmp(arow,erow,image->w*4)) FAIL("effort=%d, mismatch in row %d",effort,y)
+  }
+  png_image_del(decoded);
+  sr_encoder_cleanup(&dst);
+  return 0;
+}
+
+ITEST(png_encode_stripes_roundtrip) {
+  // 1024x768 RGBA is 3 MB filtered, plenty to split.
+  struct png_image *image=png_test_image(1024,768,1);
+  ASSERT(image)
+  int effort=1; for (;effort<=9;effort++) {
+    if (png_test_roundtrip(image,effort)<0) return -1;
+  }
+  png_image_del(image);
+  // And a few small ones, which stay on the calling thread.
+  if (!(image=png_test_image(3,2,2))) return -1;
+  if (png_test_roundtrip(image,9)<0) return -1;
+  png_image_del(image);
+  if (!(image=png_test_image(1,1000,3))) return -1;
+  if (png_test_roundtrip(image,9)<0) return -1;
+  png_image_del(image);
+  return 0;
+}
+
+ITEST(png_encode_rejects_empty) {
+  struct png_image image={
+    .w=16,.h=0,.stride=64,
+    .depth=8,.colortype=6,.pixelsize=32,
+  };
+  struct sr_encoder dst={0};
+  ASSERT_FAILURE(png_encode(&dst,&image))
+  image.w=0;
+  image.h=16;
+  ASSERT_FAILURE(png_encode(&dst,&image))
+  sr_encoder_cleanup(&dst);
+  return 0;
+}
+
+/* Several threads encoding at once. Whoever doesn't get the pool runs alone, and everyone's output must still be right.
+ */
+
+struct png_test_job {
+  struct png_image *image;
+  int result;
+};
+
+static void *png_test_job_thread(void *arg) {
+  struct png_test_job *job=arg;
+  job->result=0;
+  int i=4; while (i-->0) {
+    if (png_test_roundtrip(job->image,(i&1)?9:2)<0) job->result=-1;
+  }
+  return 0;
+}
+
+ITEST(png_encode_concurrent) {
+  struct png_test_job jobv[4]={0};
+  pthread_t threadv[4];
+  int i=0; for (;i<4;i++) {
+    ASSERT(jobv[i].image=png_test_image(512+i*64,512,10+i))
+    ASSERT_INTS(pthread_create(threadv+i,0,png_test_job_thread,jobv+i),0)
+  }
+  for (i=0;i<4;i++) {
+    pthread_join(threadv[i],0);
+    ASSERT_INTS(jobv[i].result,0,"job %d",i)
+    png_image_del(jobv[i].image);
+  }
+  return 0;
+}
@@ -0,0 +1,98 @@
+/* qjs_test.c
+ * qjs_borrow_int32_array, which backs the packed event call egg.event_next_packed(Int32Array).
+ */
+
+#include "test/test.h"
+#include "opt/qjs/qjs_internal.h"
+#include "egg/egg.h"
+#include <stddef.h>
+
+/* Evaluate a global expression and return its value. Caller frees.
+ */
+
+static JSValue qjs_test_eval(struct qjs *qjs,const char *src) {
+  return JS_Eval(qjs->jsctx,src,strlen(src),"qjs_test",JS_EVAL_TYPE_GLOBAL);
+}
+
+/* Only a real Int32Array is accepted, and subarrays report their own view of the buffer.
+ */
+
+ITEST(qjs_borrow_int32_array_types) {
+  struct qjs *qjs=qjs_new();
+  ASSERT(qjs)
+  const struct { const char *src; int expect; } casev[]={
+    {"new Int32Array(10)",10},
+    {"new Int32Array(0)",0},
+    {"new Int32Array(new ArrayBuffer(64),8,5)",5},
+    {"new Int32Array(20).subarray(15)",5},
+    {"new Float32Array(10)",-1},
+    {"new Uint32Array(10)",-1},
+    {"new Int16Array(10)",-1},
+    {"new Uint8Array(40)",-1},
+    {"new DataView(new ArrayBuffer(40))",-1},
+    {"new ArrayBuffer(40)",-1},
+    {"[1,2,3,4,5]",-1},
+    {"Object.create(Int32Array.prototype)",-1},
+    {"({length:10})",-1},
+    {"null",-1},
+    {"12",-1},
+  };
+  int i=0; for (;i<sizeof(casev)/sizeof(casev[0]);i++) {
+    JSValue v=qjs_test_eval(qjs,casev[i].src);
+    ASSERT_NOT(JS_IsException(v),"%s",casev[i].src)
+    int32_t *dst=0;
+    int dstc=qjs_borrow_int32_array(&dst,qjs->jsctx,&v);
+    if (casev[i].expect<0) {
+      ASSERT_INTS_OP(dstc,<,0,"%s",casev[i].src)
+    } else {
+      ASSERT_INTS(dstc,casev[i].expect,"%s",casev[i].src)
+      ASSERT(dst,"%s",casev[i].src)
+    }
+    JS_FreeValue(qjs->jsctx,v);
+  }
+  // A failed check must not leave an exception pending.
+  JSValue exception=JS_GetException(qjs->jsctx);
+  ASSERT(JS_IsNull(exception)||JS_IsUndefined(exception))
+  JS_FreeValue(qjs->jsctx,exception);
+  qjs_del(qjs);
+  return 0;
+}
+
+/* Host writes struct egg_event straight into the array, as egg.event_next_packed does,
+ * and Javascript sees [type,v0,v1,v2,v3] per event, starting at the subarray's own zero.
+ */
+
+ITEST(qjs_borrow_int32_array_packed_events) {
+  ASSERT_INTS(sizeof(struct egg_event),5*sizeof(int32_t))
+  ASSERT_INTS(offsetof(struct egg_event,type),0)
+  ASSERT_INTS(offsetof(struct egg_event,v),sizeof(int32_t))
+
+  struct qjs *qjs=qjs_new();
+  ASSERT(qjs)
+  JSValue v=qjs_test_eval(qjs,"globalThis.whole=new Int32Array(13); globalThis.events=whole.subarray(1,12)");
+  ASSERT_NOT(JS_IsException(v))
+  int32_t *dst=0;
+  int dstc=qjs_borrow_int32_array(&dst,qjs->jsctx,&v);
+  ASSERT_INTS(dstc,11)
+  JS_FreeValue(qjs->jsctx,v);
+
+  struct egg_event eventv[]={
+    {EGG_EVENT_KEY,{0x00070004,1,0,0}},
+    {EGG_EVENT_MMOTION,{-3,200,0,0x7fffffff}},
+  };
+  int eventa=dstc/5;
+  ASSERT_INTS(eventa,2)
+  memcpy(dst,eventv,sizeof(eventv));
+
+  v=qjs_test_eval(qjs,"whole.join(',')");
+  ASSERT_NOT(JS_IsException(v))
+  const char *actual=JS_ToCString(qjs->jsctx,v);
+  ASSERT(actual)
+  char expect[256];
+  int expectc=snprintf(expect,sizeof(expect),"0,%d,%d,1,0,0,%d,-3,200,0,2147483647,0,0",EGG_EVENT_KEY,0x00070004,EGG_EVENT_MMOTION);
+  ASSERT_STRINGS(actual,-1,expect,expectc)
+  JS_FreeCString(qjs->jsctx,actual);
+  JS_FreeValue(qjs->jsctx,v);
+  qjs_del(qjs);
+  return 0;
+}
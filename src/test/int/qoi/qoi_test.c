@@ -0,0 +1,254 @@
+/* qoi_test.c
+ * Decoder against a plain reading of the spec, round trips, truncated input,
+ * and decode throughput of QOI vs PNG on the same images via rawimg_decode.
+ */
+
+#include "test/test.h"
+#include "opt/qoi/qoi.h"
+#include "opt/serial/serial.h"
+#include "opt/rawimg/rawimg.h"
+#include <stdint.h>
+#include <time.h>
+
+static double qoi_test_now() {
+  struct timespec tv={0};
+  clock_gettime(CLOCK_MONOTONIC,&tv);
+  return (double)tv.tv_sec+(double)tv.tv_nsec/1000000000.0;
+}
+
+/* Test corpus: A few kinds of image that behave differently under both codecs.
+ *  0: Flat areas with hard edges, like UI art. Long runs.
+ *  1: Smooth gradients. Mostly DIFF and LUMA.
+ *  2: Sprite sheet: A few colors repeating, transparent background. Mostly INDEX.
+ *  3: Noise. Mostly RGBA, worst case for both.
+ */
+
+#define QOI_TEST_KINDC 4
+
+static const char *qoi_test_kind_name(int kind) {
+  switch (kind) {
+    case 0: return "flat";
+    case 1: return "gradient";
+    case 2: return "sprites";
+    case 3: return "noise";
+  }
+  return "?";
+}
+
+static struct qoi_image *qoi_test_image(int w,int h,int kind) {
+  struct qoi_image *image=calloc(1,sizeof(struct qoi_image));
+  if (!image) return 0;
+  image->w=w;
+  image->h=h;
+  if (!(image->v=malloc(w*h*4))) {
+    qoi_image_del(image);
+    return 0;
+  }
+  static const uint8_t palette[8][4]={
+    {0,0,0,0},{0x20,0x18,0x10,0xff},{0xc0,0x30,0x20,0xff},{0xf0,0xd0,0x40,0xff},
+    {0x30,0x80,0x30,0xff},{0x40,0x60,0xe0,0xff},{0xff,0xff,0xff,0xff},{0x80,0x80,0x80,0x80},
+  };
+  uint32_t seed=kind*7919+1;
+  uint8_t *p=image->v;
+  int y=0; for (;y<h;y++) {
+    int x=0; for (;x<w;x++,p+=4) {
+      seed=seed*1103515245+12345;
+      switch (kind) {
+        case 0: {
+            int i=((x/37)+(y/23)*3)&7;
+            memcpy(p,palette[i],4);
+          } break;
+        case 1: {
+            p[0]=(x*255)/w;
+            p[1]=(y*255)/h;
+            p[2]=((x+y)*127)/(w+h)+((seed>>20)&1);
+            p[3]=0xff;
+          } break;
+        case 2: {
+            int cx=x&15,cy=y&15;
+            int i=((cx*cx+cy*cy)<64)?(1+(((x>>4)+(y>>4)+(cx>>2))%6)):0;
+            memcpy(p,palette[i],4);
+          } break;
+        default: {
+            p[0]=seed>>8;
+            p[1]=seed>>16;
+            p[2]=seed>>24;
+            p[3]=0xff;
+          }
+      }
+    }
+  }
+  return image;
+}
+
+/* Reference decoder, straight from the spec. Slow and obvious.
+ * Returns RGBA pixels, caller frees. Pixels not covered by the stream are zero.
+ * (*pxc) is the count of pixels fully decoded, which is less than (w*h) if the stream is short.
+ */
+
+static uint8_t *qoi_test_reference_decode(int *w,int *h,int *pxcp,const uint8_t *src,int srcc) {
+  if ((srcc<14)||memcmp(src,"qoif",4)) return 0;
+  *w=(src[4]<<24)|(src[5]<<16)|(src[6]<<8)|src[7];
+  *h=(src[8]<<24)|(src[9]<<16)|(src[10]<<8)|src[11];
+  int pxc=(*w)*(*h);
+  uint8_t *dst=calloc(pxc,4);
+  if (!dst) return 0;
+  uint8_t index[64][4]={0};
+  uint8_t px[4]={0,0,0,0xff};
+  int srcp=14,run=0,dstp=0;
+  for (;dstp<pxc;dstp++) {
+    if (run) {
+      run--;
+    } else {
+      if (srcp>=srcc) break;
+      uint8_t lead=src[srcp++];
+      if (lead==0xfe) {
+        if (srcp>srcc-3) break;
+        memcpy(px,src+srcp,3);
+        srcp+=3;
+      } else if (lead==0xff) {
+        if (srcp>srcc-4) break;
+        memcpy(px,src+srcp,4);
+        srcp+=4;
+      } else switch (lead&0xc0) {
+        case 0x00: memcpy(px,index[lead],4); break;
+        case 0x40: {
+            px[0]+=((lead>>4)&3)-2;
+            px[1]+=((lead>>2)&3)-2;
+            px[2]+=(lead&3)-2;
+          } break;
+        case 0x80: {
+            if (srcp>=srcc) { srcp++; break; }
+            int dg=(lead&0x3f)-32;
+            uint8_t rb=src[srcp++];
+            px[0]+=dg+(rb>>4)-8;
+            px[1]+=dg;
+            px[2]+=dg+(rb&15)-8;
+          } break;
+        case 0xc0: run=lead&0x3f; break;
+      }
+      if (srcp>srcc) break;
+      memcpy(index[(px[0]*3+px[1]*5+px[2]*7+px[3]*11)&63],px,4);
+    }
+    memcpy(dst+dstp*4,px,4);
+  }
+  *pxcp=dstp;
+  return dst;
+}
+
+/* Encode, then decode with both decoders and compare to the original.
+ */
+
+ITEST(qoi_roundtrip_matches_reference) {
+  int kind=0; for (;kind<QOI_TEST_KINDC;kind++) {
+    struct qoi_image *image=qoi_test_image(301,157,kind);
+    ASSERT(image)
+    struct sr_encoder serial={0};
+    ASSERT_CALL(qoi_encode(&serial,image),"%s",qoi_test_kind_name(kind))
+    struct qoi_image *decoded=qoi_decode(serial.v,serial.c);
+    ASSERT(decoded,"%s",qoi_test_kind_name(kind))
+    ASSERT_INTS(decoded->w,image->w)
+    ASSERT_INTS(decoded->h,image->h)
+    ASSERT(!memcmp(decoded->v,image->v,image->w*image->h*4),"%s",qoi_test_kind_name(kind))
+    int refw=0,refh=0,refpxc=0;
+    uint8_t *ref=qoi_test_reference_decode(&refw,&refh,&refpxc,serial.v,serial.c);
+    ASSERT(ref)
+    ASSERT_INTS(refpxc,image->w*image->h)
+    ASSERT(!memcmp(ref,image->v,image->w*image->h*4),"%s: reference decoder disagrees",qoi_test_kind_name(kind))
+    free(ref);
+    qoi_image_del(decoded);
+    qoi_image_del(image);
+    sr_encoder_cleanup(&serial);
+  }
+  return 0;
+}
+
+/* Every truncation of a small file must decode without overrunning.
+ * Pixels before the cut must agree with the reference. The op that got cut, and everything after, can be anything.
+ */
+
+ITEST(qoi_decode_truncated) {
+  struct qoi_image *image=qoi_test_image(23,17,2);
+  ASSERT(image)
+  struct qoi_image *noise=qoi_test_image(23,17,3);
+  ASSERT(noise)
+  memcpy((uint8_t*)image->v+23*4*9,(uint8_t*)noise->v+23*4*9,23*4*8); // Bottom half noise, so RGB ops get cut too.
+  qoi_image_del(noise);
+  struct sr_encoder serial={0};
+  ASSERT_CALL(qoi_encode(&serial,image))
+  int srcc=22; for (;srcc<=serial.c;srcc++) {
+    // Copy to an exact-size buffer, so a sanitizer would see any read past the end.
+    uint8_t *src=malloc(srcc);
+    ASSERT(src)
+    memcpy(src,serial.v,srcc);
+    struct qoi_image *decoded=qoi_decode(src,srcc);
+    ASSERT(decoded,"srcc=%d/%d",srcc,serial.c)
+    int refw,refh,refpxc;
+    uint8_t *ref=qoi_test_reference_decode(&refw,&refh,&refpxc,src,srcc);
+    ASSERT(ref)
+    ASSERT(!memcmp(decoded->v,ref,refpxc*4),"srcc=%d/%d, refpxc=%d",srcc,serial.c,refpxc)
+    if (srcc==serial.c) {
+      ASSERT(!memcmp(decoded->v,image->v,23*17*4))
+    }
+    free(ref);
+    qoi_image_del(decoded);
+    free(src);
+  }
+  qoi_image_del(image);
+  sr_encoder_cleanup(&serial);
+  return 0;
+}
+
+/* Throughput: Same images as QOI and PNG, decoded through rawimg_decode as the runtime does.
+ */
+
+ITEST(qoi_png_decode_benchmark) {
+  #if !USE_png
+    SKIP("png not compiled in")
+  #endif
+  int w=1024,h=1024,repeat=4;
+  double qoitotal=0.0,pngtotal=0.0;
+  int kind=0; for (;kind<QOI_TEST_KINDC;kind++) {
+    struct qoi_image *image=qoi_test_image(w,h,kind);
+    ASSERT(image)
+    struct rawimg *rawimg=rawimg_new_borrow(image->v,w,h,w*4,32);
+    ASSERT(rawimg)
+    memcpy(rawimg->chorder,"RGBA",4);
+    struct sr_encoder qoiserial={0},pngserial={0};
+    rawimg->encfmt="qoi";
+    ASSERT_CALL(rawimg_encode(&qoiserial,rawimg))
+    rawimg->encfmt="png";
+    ASSERT_CALL(rawimg_encode(&pngserial,rawimg))
+    double qoielapsed=0.0,pngelapsed=0.0;
+    int i=repeat; while (i-->0) {
+      double start=qoi_test_now();
+      struct rawimg *decoded=rawimg_decode(qoiserial.v,qoiserial.c);
+      qoielapsed+=qoi_test_now()-start;
+      ASSERT(decoded)
+      ASSERT(!memcmp(decoded->v,image->v,w*h*4))
+      rawimg_del(decoded);
+      start=qoi_test_now();
+      decoded=rawimg_decode(pngserial.v,pngserial.c);
+      pngelapsed+=qoi_test_now()-start;
+      ASSERT(decoded)
+      ASSERT(!memcmp(decoded->v,image->v,w*h*4))
+      rawimg_del(decoded);
+    }
+    fprintf(stderr,
+      "qoi_png_decode: %-8s qoi %8d bytes %7.2f ms, png %8d bytes %7.2f ms, qoi %.1fx faster\n",
+      qoi_test_kind_name(kind),
+      qoiserial.c,(qoielapsed*1000.0)/repeat,
+      pngserial.c,(pngelapsed*1000.0)/repeat,
+      (qoielapsed>0.0)?(pngelapsed/qoielapsed):0.0
+    );
+    qoitotal+=qoielapsed;
+    pngtotal+=pngelapsed;
+    rawimg_del(rawimg);
+    qoi_image_del(image);
+    sr_encoder_cleanup(&qoiserial);
+    sr_encoder_cleanup(&pngserial);
+  }
+  double mpx=(double)w*h*repeat*QOI_TEST_KINDC/1000000.0;
+  fprintf(stderr,"qoi_png_decode: overall qoi %.1f Mpx/s, png %.1f Mpx/s\n",mpx/qoitotal,mpx/pngtotal);
+  return 0;
+}
@@ -0,0 +1,128 @@
+/* rawimg_bands_test.c
+ * rawimg_decode_bands must deliver the same pixels as rawimg_decode, even when the callback converts or scribbles on each band.
+ */
+
+#include "test/test.h"
+#include "opt/rawimg/rawimg.h"
+#include "opt/serial/serial.h"
+#include <stdint.h>
+
+/* Smooth gradient with a little noise, so PNG picks UP, AVG and PAETH, which read the previous row.
+ */
+
+static struct rawimg *rawimg_bands_test_image(int pixelsize) {
+  struct rawimg *image=rawimg_new_alloc(97,61,pixelsize);
+  if (!image) return 0;
+  uint32_t seed=99;
+  uint8_t *row=image->v;
+  int y=0; for (;y<image->h;y++,row+=image->stride) {
+    if (pixelsize==1) {
+      int x=0; for (;x<image->w;x++) {
+        seed=seed*1103515245+12345;
+        if (((x+y)%7<3)||!(seed&0x70000)) row[x>>3]|=0x80>>(x&7);
+      }
+    } else {
+      uint8_t *p=row;
+      int x=0; for (;x<image->w;x++,p+=4) {
+        seed=seed*1103515245+12345;
+        p[0]=x*2+y;
+        p[1]=y*3+((seed>>16)&3);
+        p[2]=x+y*2;
+        p[3]=0xff-y;
+      }
+    }
+  }
+  if (pixelsize==1) {
+    image->bitorder='>';
+  } else {
+    memcpy(image->chorder,"RGBA",4);
+  }
+  return image;
+}
+
+struct rawimg_bands_test_context {
+  const struct rawimg *expect;
+  int nexty;
+  int failc;
+};
+
+static int rawimg_bands_test_cb(struct rawimg *band,int y,int h,void *userdata) {
+  struct rawimg_bands_test_context *ctx=userdata;
+  if ((y!=ctx->nexty)||(h!=ctx->expect->h)||(band->w!=ctx->expect->w)) {
+    fprintf(stderr,"%s: y=%d h=%d w=%d, expected y=%d h=%d w=%d\n",__func__,y,h,band->w,ctx->nexty,ctx->expect->h,ctx->expect->w);
+    ctx->failc++;
+    return -1;
+  }
+  int rowc=rawimg_minimum_stride(band->w,band->pixelsize);
+  const uint8_t *erow=(uint8_t*)ctx->expect->v+y*ctx->expect->stride;
+  uint8_t *arow=band->v;
+  int i=band->h; for (;i-->0;erow+=ctx->expect->stride,arow+=band->stride) {
+    if (memcmp(arow,erow,rowc)) {
+      fprintf(stderr,"%s: Mismatch in row %d\n",__func__,ctx->nexty+band->h-1-i);
+      ctx->failc++;
+      return -1;
+    }
+    // Allowed: The callback owns these pixels until it returns. Leave garbage behind.
+    memset(arow,0x5a,rowc);
+  }
+  ctx->nexty+=band->h;
+  return 0;
+}
+
+static int rawimg_bands_test_format(const char *encfmt,int pixelsize) {
+  struct rawimg *image=rawimg_bands_test_image(pixelsize);
+  ASSERT(image)
+  image->encfmt=encfmt;
+  struct sr_encoder serial={0};
+  ASSERT_CALL(rawimg_encode(&serial,image),"%s",encfmt)
+  rawimg_del(image);
+  struct rawimg *expect=rawimg_decode(serial.v,serial.c);
+  ASSERT(expect,"%s",encfmt)
+  int bandhv[]={1,2,3,7,61,100};
+  int i=0; for (;i<sizeof(bandhv)/sizeof(int);i++) {
+    struct rawimg_bands_test_context ctx={.expect=expect};
+    int err=rawimg_decode_bands(serial.v,serial.c,bandhv[i],rawimg_bands_test_cb,&ctx);
+    ASSERT_INTS(err,0,"%s bandh=%d",encfmt,bandhv[i])
+    ASSERT_INTS(ctx.failc,0,"%s bandh=%d",encfmt,bandhv[i])
+    ASSERT_INTS(ctx.nexty,expect->h,"%s bandh=%d",encfmt,bandhv[i])
+  }
+  rawimg_del(expect);
+  sr_encoder_cleanup(&serial);
+  return 0;
+}
+
+ITEST(rawimg_decode_bands_png) {
+  #if USE_png
+    return rawimg_bands_test_format("png",32);
+  #else
+    SKIP("png not compiled in")
+  #endif
+}
+
+ITEST(rawimg_decode_bands_qoi) {
+  #if USE_qoi
+    return rawimg_bands_test_format("qoi",32);
+  #else
+    SKIP("qoi not compiled in")
+  #endif
+}
+
+ITEST(rawimg_decode_bands_bmp) {
+  #if USE_bmp
+    return rawimg_bands_test_format("bmp",32);
+  #else
+    SKIP("bmp not compiled in")
+  #endif
+}
+
+ITEST(rawimg_decode_bands_rlead) {
+  #if USE_rlead
+    return rawimg_bands_test_format("rlead",1);
+  #else
+    SKIP("rlead not compiled in")
+  #endif
+}
+
+ITEST(rawimg_decode_bands_fallback) {
+  return rawimg_bands_test_format("rawimg",32);
+}
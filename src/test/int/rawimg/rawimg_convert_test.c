@@ -0,0 +1,229 @@
+/* rawimg_convert_test.c
+ * Row kernels in rawimg_convert.c against a plain per-pixel reference through the iterator.
+ * Each case checks the output exactly, then reports time for both paths.
+ */
+
+#include "test/test.h"
+#include "opt/rawimg/rawimg.h"
+#include <stdint.h>
+#include <time.h>
+
+#define RAWIMG_TEST_W 512
+#define RAWIMG_TEST_H 512
+#define RAWIMG_TEST_REPEAT 8
+
+static double rawimg_test_now() {
+  struct timespec tv={0};
+  clock_gettime(CLOCK_MONOTONIC,&tv);
+  return (double)tv.tv_sec+(double)tv.tv_nsec/1000000000.0;
+}
+
+/* Source image with random content.
+ */
+
+static struct rawimg *rawimg_test_source(int pixelsize,const char *chorder,char bitorder,int ctabc) {
+  struct rawimg *image=rawimg_new_alloc(RAWIMG_TEST_W,RAWIMG_TEST_H,pixelsize);
+  if (!image) return 0;
+  if (chorder) memcpy(image->chorder,chorder,4);
+  image->bitorder=bitorder;
+  uint32_t seed=0x12345678;
+  uint8_t *p=image->v;
+  int i=image->stride*image->h;
+  for (;i-->0;p++) {
+    seed=seed*1103515245+12345;
+    *p=seed>>16;
+  }
+  if (ctabc) {
+    if (rawimg_require_ctab(image,ctabc)<0) {
+      rawimg_del(image);
+      return 0;
+    }
+    for (p=image->ctab,i=ctabc*4;i-->0;p++) {
+      seed=seed*1103515245+12345;
+      *p=seed>>16;
+    }
+  }
+  return image;
+}
+
+/* Reference conversion: Read each pixel through the iterator, and a trivial rule per format.
+ * This is how rawimg_force_rgba worked for everything before the row kernels.
+ */
+
+struct rawimg_test_ref {
+  const struct rawimg *src;
+  int mode;
+};
+
+#define RAWIMG_TEST_MODE_CTAB 1
+#define RAWIMG_TEST_MODE_GRAY 2
+#define RAWIMG_TEST_MODE_CHORDER 3
+
+static int rawimg_test_ref_cvt(int pixel,void *userdata) {
+  struct rawimg_test_ref *ref=userdata;
+  uint8_t rgba[4]={0,0,0,0xff};
+  switch (ref->mode) {
+    case RAWIMG_TEST_MODE_CTAB: {
+        if ((pixel>=0)&&(pixel<ref->src->ctabc)) memcpy(rgba,ref->src->ctab+pixel*4,4);
+      } break;
+    case RAWIMG_TEST_MODE_GRAY: {
+        int max=(1<<ref->src->pixelsize)-1;
+        rgba[0]=rgba[1]=rgba[2]=(pixel*0xff)/max;
+      } break;
+    case RAWIMG_TEST_MODE_CHORDER: {
+        // The iterator reads bytewise pixels as native words, except 24-bit which is always little-endian.
+        uint8_t bytes[4];
+        int xstride=ref->src->pixelsize>>3;
+        if (xstride==3) {
+          bytes[0]=pixel; bytes[1]=pixel>>8; bytes[2]=pixel>>16;
+        } else if (xstride==4) {
+          uint32_t word=pixel;
+          memcpy(bytes,&word,4);
+        } else if (xstride==2) {
+          uint16_t word=pixel;
+          memcpy(bytes,&word,2);
+        } else {
+          bytes[0]=pixel;
+        }
+        int i=0; for (;i<xstride;i++) switch (ref->src->chorder[i]) {
+          case 'R': case 'r': rgba[0]=bytes[i]; break;
+          case 'G': case 'g': rgba[1]=bytes[i]; break;
+          case 'B': case 'b': rgba[2]=bytes[i]; break;
+          case 'A': case 'a': rgba[3]=bytes[i]; break;
+          case 'Y': case 'y': rgba[0]=rgba[1]=rgba[2]=bytes[i]; break;
+        }
+      } break;
+  }
+  uint32_t word;
+  memcpy(&word,rgba,4);
+  return word;
+}
+
+/* Run one case: Reference and kernel, compare, report.
+ */
+
+static int rawimg_test_case(const char *name,struct rawimg *src,int mode) {
+  if (!src) FAIL("%s: Failed to create source image",name)
+  struct rawimg_test_ref ref={.src=src,.mode=mode};
+  double refelapsed=0.0,kelapsed=0.0;
+  int i=RAWIMG_TEST_REPEAT;
+  while (i-->0) {
+    double start=rawimg_test_now();
+    struct rawimg *expect=rawimg_new_convert(src,32,0,0,src->w,src->h,0,rawimg_test_ref_cvt,&ref);
+    refelapsed+=rawimg_test_now()-start;
+    ASSERT(expect,"%s: Reference conversion failed",name)
+
+    struct rawimg *actual=rawimg_new_copy(src);
+    ASSERT(actual,"%s: Copy failed",name)
+    start=rawimg_test_now();
+    int err=rawimg_force_rgba(actual);
+    kelapsed+=rawimg_test_now()-start;
+    ASSERT(err>=0,"%s: rawimg_force_rgba failed",name)
+    ASSERT_INTS(actual->pixelsize,32,"%s",name)
+    ASSERT_INTS(actual->w,src->w,"%s",name)
+    ASSERT_INTS(actual->h,src->h,"%s",name)
+    ASSERT_INTS(rawimg_is_rgba(actual),2,"%s",name)
+
+    const uint8_t *arow=actual->v,*erow=expect->v;
+    int y=0; for (;y<src->h;y++,arow+=actual->stride,erow+=expect->stride) {
+      if (memcmp(arow,erow,src->w*4)) {
+        int x=0; while (!memcmp(arow+x*4,erow+x*4,4)) x++;
+        FAIL(
+          "%s: Mismatch at (%d,%d): expected %02x%02x%02x%02x, got %02x%02x%02x%02x",name,x,y,
+          erow[x*4],erow[x*4+1],erow[x*4+2],erow[x*4+3],
+          arow[x*4],arow[x*4+1],arow[x*4+2],arow[x*4+3]
+        )
+      }
+    }
+    rawimg_del(actual);
+    rawimg_del(expect);
+  }
+  double mpx=(double)src->w*src->h*RAWIMG_TEST_REPEAT/1000000.0;
+  fprintf(stderr,
+    "rawimg_convert: %-12s iterator %8.3f ms/Mpx, kernel %8.3f ms/Mpx, %6.1fx\n",
+    name,(refelapsed*1000.0)/mpx,(kelapsed*1000.0)/mpx,(kelapsed>0.0)?(refelapsed/kelapsed):0.0
+  );
+  rawimg_del(src);
+  return 0;
+}
+
+/* One test per conversion with a row kernel.
+ */
+
+ITEST(rawimg_convert_palette8_rgba) {
+  return rawimg_test_case("palette8",rawimg_test_source(8,0,0,256),RAWIMG_TEST_MODE_CTAB);
+}
+
+ITEST(rawimg_convert_palette4_rgba) {
+  return rawimg_test_case("palette4",rawimg_test_source(4,0,'>',16),RAWIMG_TEST_MODE_CTAB);
+}
+
+ITEST(rawimg_convert_palette2_little_rgba) {
+  return rawimg_test_case("palette2le",rawimg_test_source(2,0,'<',4),RAWIMG_TEST_MODE_CTAB);
+}
+
+ITEST(rawimg_convert_y1_rgba) {
+  return rawimg_test_case("y1",rawimg_test_source(1,0,'>',0),RAWIMG_TEST_MODE_GRAY);
+}
+
+ITEST(rawimg_convert_y4_rgba) {
+  return rawimg_test_case("y4",rawimg_test_source(4,0,'>',0),RAWIMG_TEST_MODE_GRAY);
+}
+
+ITEST(rawimg_convert_y8_rgba) {
+  return rawimg_test_case("y8",rawimg_test_source(8,"Y\0\0\0",0,0),RAWIMG_TEST_MODE_CHORDER);
+}
+
+ITEST(rawimg_convert_ya8_rgba) {
+  return rawimg_test_case("ya8",rawimg_test_source(16,"YA\0\0",0,0),RAWIMG_TEST_MODE_CHORDER);
+}
+
+ITEST(rawimg_convert_rgb24_rgba) {
+  return rawimg_test_case("rgb24",rawimg_test_source(24,"RGB\0",0,0),RAWIMG_TEST_MODE_CHORDER);
+}
+
+ITEST(rawimg_convert_bgr24_rgba) {
+  return rawimg_test_case("bgr24",rawimg_test_source(24,"BGR\0",0,0),RAWIMG_TEST_MODE_CHORDER);
+}
+
+ITEST(rawimg_convert_bgra_rgba) {
+  return rawimg_test_case("bgra",rawimg_test_source(32,"BGRA",0,0),RAWIMG_TEST_MODE_CHORDER);
+}
+
+ITEST(rawimg_convert_argb_rgba) {
+  return rawimg_test_case("argb",rawimg_test_source(32,"ARGB",0,0),RAWIMG_TEST_MODE_CHORDER);
+}
+
+ITEST(rawimg_convert_abgr_rgba) {
+  return rawimg_test_case("abgr",rawimg_test_source(32,"ABGR",0,0),RAWIMG_TEST_MODE_CHORDER);
+}
+
+/* rawimg_new_convert with no callback: Crop and flip bytewise pixels with row copies.
+ */
+
+ITEST(rawimg_convert_crop_flip) {
+  struct rawimg *src=rawimg_test_source(24,"RGB\0",0,0);
+  ASSERT(src)
+  int x=17,y=9,w=300,h=200;
+  uint8_t xformv[]={0,RAWIMG_XFORM_XREV,RAWIMG_XFORM_YREV,RAWIMG_XFORM_XREV|RAWIMG_XFORM_YREV};
+  int i=0; for (;i<sizeof(xformv);i++) {
+    uint8_t xform=xformv[i];
+    struct rawimg *dst=rawimg_new_convert(src,24,x,y,w,h,xform,0,0);
+    ASSERT(dst,"xform=%d",xform)
+    ASSERT_INTS(dst->w,w)
+    ASSERT_INTS(dst->h,h)
+    ASSERT(!memcmp(dst->chorder,"RGB",3))
+    int dy=0; for (;dy<h;dy++) {
+      int sy=(xform&RAWIMG_XFORM_YREV)?(y+h-1-dy):(y+dy);
+      int dx=0; for (;dx<w;dx++) {
+        int sx=(xform&RAWIMG_XFORM_XREV)?(x+w-1-dx):(x+dx);
+        const uint8_t *sp=(uint8_t*)src->v+sy*src->stride+sx*3;
+        const uint8_t *dp=(uint8_t*)dst->v+dy*dst->stride+dx*3;
+        if (memcmp(sp,dp,3)) FAIL("xform=%d, mismatch at (%d,%d)",xform,dx,dy)
+      }
+    }
+    rawimg_del(dst);
+  }
+  rawimg_del(src);
+  return 0;
+}
@@ -0,0 +1,199 @@
+/* synth_playhead_test.c
+ * Accuracy of the audible song playhead, what egg_audio_get_playhead reports natively.
+ * We run the synth through a fake audio driver that keeps a known amount of audio queued, like a real device would.
+ * Time is simulated, so a minute of audio takes a fraction of a second and every run is the same.
+ * The game side samples the playhead at irregular intervals and we compare to the song time actually being "heard".
+ * Song has an intro and a loop, so we cross the loop point a few times.
+ */
+
+#include "test/test.h"
+#include "opt/hostio/hostio_audio.h"
+#include "opt/synth/synth.h"
+#include "opt/serial/serial.h"
+#include <math.h>
+
+#define PLAYHEAD_TEMPO 500 /* ms/beat */
+#define PLAYHEAD_INTRO_MS 2000
+#define PLAYHEAD_BODY_MS 4000
+#define PLAYHEAD_SECONDS 60
+
+static struct playhead {
+  int rate;
+  int latency_ms;
+  int block;
+  struct synth *synth;
+  struct hostio_audio *driver;
+} playhead={0};
+
+/* Fake driver.
+ * The "device" plays (playedc) frames as the simulation advances.
+ * Before playing, we refill it a block at a time, so at least the target latency remains queued after.
+ */
+
+struct hostio_audio_sim {
+  struct hostio_audio hdr;
+  int16_t *buf;
+  int block;
+  int target;
+  int64_t renderedc,playedc;
+};
+
+#define DRIVER ((struct hostio_audio_sim*)driver)
+
+static void _sim_del(struct hostio_audio *driver) {
+  if (DRIVER->buf) free(DRIVER->buf);
+}
+
+static int _sim_init(struct hostio_audio *driver,const struct hostio_audio_setup *setup) {
+  driver->rate=setup->rate;
+  driver->chanc=1;
+  if ((DRIVER->block=setup->buffer_size)<1) return -1;
+  if (!(DRIVER->buf=malloc(sizeof(int16_t)*DRIVER->block))) return -1;
+  DRIVER->target=(playhead.latency_ms*driver->rate)/1000;
+  return 0;
+}
+
+static void _sim_play(struct hostio_audio *driver,int play) {
+  driver->playing=play;
+}
+
+static int _sim_get_latency(struct hostio_audio *driver) {
+  return (int)(DRIVER->renderedc-DRIVER->playedc);
+}
+
+static const struct hostio_audio_type sim_type={
+  .name="sim",
+  .desc="Simulated latency, for the playhead test.",
+  .objlen=sizeof(struct hostio_audio_sim),
+  .appointment_only=1,
+  .del=_sim_del,
+  .init=_sim_init,
+  .play=_sim_play,
+  .get_latency=_sim_get_latency,
+};
+
+static void sim_advance(struct hostio_audio *driver,int framec) {
+  while (DRIVER->renderedc-DRIVER->playedc<framec+DRIVER->target) {
+    driver->delegate.cb_pcm_out(DRIVER->buf,DRIVER->block,driver);
+    DRIVER->renderedc+=DRIVER->block;
+  }
+  DRIVER->playedc+=framec;
+}
+
+#undef DRIVER
+
+static void playhead_cb_pcm_out(int16_t *v,int c,struct hostio_audio *driver) {
+  synth_updatei(v,c,playhead.synth);
+}
+
+/* Song: Delays only, no notes.
+ * Intro of 4 beats, then an 8-beat loop with uneven delays.
+ */
+
+static int playhead_compose_song(struct sr_encoder *dst) {
+  if (sr_encode_raw(dst,"\xbe\xee\xeeP",4)<0) return -1;
+  if (sr_encode_intbe(dst,PLAYHEAD_TEMPO,2)<0) return -1;
+  if (sr_encode_intbe(dst,42,2)<0) return -1; // startp
+  int loopp_p=dst->c;
+  if (sr_encode_zero(dst,2+8*4)<0) return -1; // loopp, then channel headers all zero: No channels.
+  int i=PLAYHEAD_INTRO_MS/125;
+  while (i-->0) if (sr_encode_u8(dst,125)<0) return -1;
+  ((uint8_t*)dst->v)[loopp_p]=dst->c>>8;
+  ((uint8_t*)dst->v)[loopp_p+1]=dst->c;
+  const uint8_t pattern[]={100,37,63,127,73}; // 400 ms
+  for (i=PLAYHEAD_BODY_MS/400;i-->0;) if (sr_encode_raw(dst,pattern,sizeof(pattern))<0) return -1;
+  return sr_encode_u8(dst,0);
+}
+
+/* Song time in ms, at some frame since the song started.
+ * Each pass through the loop after the first starts with a 1-frame pause at the loop point; the synth inserts that.
+ */
+
+static double playhead_expect_ms(int64_t framep) {
+  double frames_per_ms=playhead.rate/1000.0;
+  int64_t introc=llround(PLAYHEAD_INTRO_MS*frames_per_ms);
+  int64_t bodyc=llround(PLAYHEAD_BODY_MS*frames_per_ms);
+  if (framep<introc) return framep/frames_per_ms;
+  framep-=introc;
+  if (framep<bodyc) return PLAYHEAD_INTRO_MS+framep/frames_per_ms;
+  framep=(framep-bodyc)%(bodyc+1);
+  if (!framep) return PLAYHEAD_INTRO_MS;
+  return PLAYHEAD_INTRO_MS+(framep-1)/frames_per_ms;
+}
+
+/* Error in ms between a reported playhead and the expected one.
+ * Right at the loop point, being a hair early looks like being a whole loop late. That's not what we're measuring.
+ */
+
+static double playhead_error_ms(double beats,double expect_ms) {
+  double error=beats*PLAYHEAD_TEMPO-expect_ms;
+  if (error>PLAYHEAD_BODY_MS*0.5) error-=PLAYHEAD_BODY_MS;
+  else if (error<PLAYHEAD_BODY_MS*-0.5) error+=PLAYHEAD_BODY_MS;
+  return fabs(error);
+}
+
+/* Play a minute of the song, sampling at irregular intervals like a game's frames of 1 to 40 ms.
+ * The audible playhead must stay within a millisecond of what's heard.
+ * The uncorrected one must be off by about the latency, or we haven't tested anything.
+ */
+
+static int playhead_run(int rate,int latency_ms,int block) {
+  playhead.rate=rate;
+  playhead.latency_ms=latency_ms;
+  playhead.block=block;
+  struct sr_encoder song={0};
+  ASSERT_CALL(playhead_compose_song(&song))
+  ASSERT(playhead.synth=synth_new(playhead.rate,1,0))
+  struct hostio_audio_delegate delegate={
+    .cb_pcm_out=playhead_cb_pcm_out,
+  };
+  struct hostio_audio_setup setup={
+    .rate=playhead.rate,
+    .chanc=1,
+    .buffer_size=playhead.block,
+  };
+  ASSERT(playhead.driver=hostio_audio_new(&sim_type,&delegate,&setup))
+  synth_play_song_serial(playhead.synth,song.v,song.c,1,1);
+  playhead.driver->type->play(playhead.driver,1);
+
+  struct hostio_audio_sim *sim=(struct hostio_audio_sim*)playhead.driver;
+  int64_t endframe=(int64_t)PLAYHEAD_SECONDS*playhead.rate;
+  uint32_t rand=12345;
+  int samplec=0;
+  double audible_total=0.0,audible_max=0.0,raw_total=0.0,raw_max=0.0;
+  while (sim->playedc<endframe) {
+    rand=rand*1103515245+12345;
+    int stepc=1+(int)(((rand>>8)%40000)*(int64_t)playhead.rate/1000000);
+    sim_advance(playhead.driver,stepc);
+    double expect=playhead_expect_ms(sim->playedc);
+    int latency=playhead.driver->type->get_latency(playhead.driver);
+    double audible=playhead_error_ms(synth_get_audible_playhead(playhead.synth,latency),expect);
+    double raw=playhead_error_ms(synth_get_playhead(playhead.synth),expect);
+    audible_total+=audible;
+    raw_total+=raw;
+    if (audible>audible_max) audible_max=audible;
+    if (raw>raw_max) raw_max=raw;
+    samplec++;
+  }
+  hostio_audio_del(playhead.driver);
+  synth_del(playhead.synth);
+  sr_encoder_cleanup(&song);
+
+  fprintf(stderr,
+    "playhead %d Hz, latency %d ms, block %d, %d samples. Error mean/max, ms: audible %.03f/%.03f, uncorrected %.03f/%.03f\n",
+    rate,latency_ms,block,samplec,audible_total/samplec,audible_max,raw_total/samplec,raw_max
+  );
+  ASSERT(audible_max<=1.0,"%d Hz, latency %d ms, block %d: audible error up to %.03f ms",rate,latency_ms,block,audible_max)
+  if (latency_ms) {
+    ASSERT(raw_total/samplec>=latency_ms*0.5,"%d Hz, latency %d ms, block %d: uncorrected error only %.03f ms",rate,latency_ms,block,raw_total/samplec)
+  }
+  return 0;
+}
+
+ITEST(synth_audible_playhead_within_1ms) {
+  ASSERT_CALL(playhead_run(48000,80,512))
+  ASSERT_CALL(playhead_run(44100,20,1024))
+  ASSERT_CALL(playhead_run(22050,150,256))
+  ASSERT_CALL(playhead_run(48000,0,128))
+  return 0;
+}
@@ -14,8 +14,11 @@
  *************************************************************************/
 
 #define UTEST(fnname,...) if (test_filter(#fnname,#__VA_ARGS__,1)) { \
-  if (fnname()<0) { \
+  int _result=fnname(); \
+  if (_result<0) { \
     fprintf(stderr,"TEST FAIL %s [%s %s]\n",#fnname,__FILE__,#__VA_ARGS__); \
+  } else if (_result>0) { \
+    fprintf(stderr,"TEST SKIP %s [%s %s]\n",#fnname,__FILE__,#__VA_ARGS__); \
   } else { \
     fprintf(stderr,"TEST PASS %s [%s %s]\n",#fnname,__FILE__,#__VA_ARGS__); \
   } \
@@ -23,8 +26,11 @@
   fprintf(stderr,"TEST SKIP %s [%s %s]\n",#fnname,__FILE__,#__VA_ARGS__); \
 }
 #define XXX_UTEST(fnname,...) if (test_filter(#fnname,#__VA_ARGS__,0)) { \
-  if (fnname()<0) { \
+  int _result=fnname(); \
+  if (_result<0) { \
     fprintf(stderr,"TEST FAIL %s [%s %s]\n",#fnname,__FILE__,#__VA_ARGS__); \
+  } else if (_result>0) { \
+    fprintf(stderr,"TEST SKIP %s [%s %s]\n",#fnname,__FILE__,#__VA_ARGS__); \
   } else { \
     fprintf(stderr,"TEST PASS %s [%s %s]\n",#fnname,__FILE__,#__VA_ARGS__); \
   } \
@@ -41,6 +47,7 @@ int test_filter(const char *fnname,const char *tags,int if_unspecified);
  **************************************************************************/
  
 #define TEST_FAIL_RESULT -1
+#define TEST_SKIP_RESULT 1
 
 #define TEST_FAIL_MORE(k,fmt,...) { \
   fprintf(stderr,"TEST DETAIL | %20s: "fmt"\n",k,##__VA_ARGS__); \
@@ -60,6 +67,13 @@ int test_filter(const char *fnname,const char *tags,int if_unspecified);
   TEST_FAIL_END \
 }
 
+/* Neither pass nor fail, eg when the thing under test isn't compiled in.
+ */
+#define SKIP(fmt,...) { \
+  fprintf(stderr,"%s: Skipped: "fmt"\n",__func__,##__VA_ARGS__); \
+  return TEST_SKIP_RESULT; \
+}
+
 #define ASSERT(value,...) { \
   if (!(value)) { \
     TEST_FAIL_BEGIN(""__VA_ARGS__) \
@@ -16,6 +16,7 @@ extern struct eggrom {
   const char *dstpath;
   char command; // [cxt]
   char format;
+  int js_bytecode; // -c only. Nonzero to precompile js:1 for QuickJS.
   struct romw *romw; // -c only
   struct sr_encoder scratch; // Used during compile.
 } eggrom;
@@ -328,7 +328,7 @@ int main(int argc,char **argv) {
     // "--help"
     if (!strcmp(arg,"--help")) {
       fprintf(stderr,
-        "Usage: %s -c -oROMFILE [INPUTS]\n"
+        "Usage: %s -c -oROMFILE [-b] [INPUTS]\n"
         "   Or: %s -x -oDIRECTORY ROMFILE\n"
         "   Or: %s -t [-fFORMAT] ROMFILE\n"
         "\n"
@@ -340,6 +340,8 @@ int main(int argc,char **argv) {
         "  -fsummary    One line per type, with the totals for that type.\n"
         "\n"
         "INPUTS to mode -c can be files or directories.\n"
+        "-b for mode -c precompiles Javascript to QuickJS bytecode, keeping the source too. Only if eggrom was built with qjs.\n"
+        "   Runtimes only use the bytecode when launched with --trust-rom.\n"
       ,eggrom.exename,eggrom.exename,eggrom.exename);
       return 0;
     }
@@ -368,6 +370,13 @@ int main(int argc,char **argv) {
           }
           eggrom.dstpath=arg+2;
         } break;
+      case 'b': { // Javascript bytecode for -c
+          if (arg[2]) {
+            fprintf(stderr,"%s: Unexpected argument '%s'\n",eggrom.exename,arg);
+            return 1;
+          }
+          eggrom.js_bytecode=1;
+        } break;
       case 'f': { // Format for -t
                if (!strcmp(arg+2,"default")) eggrom.format=0;
           else if (!strcmp(arg+2,"machine")) eggrom.format='m';
@@ -34,10 +34,27 @@ int eggrom_tid_eval(const char *src,int srcc,int names_only) {
 }
 
 /* Friendly names for qualifier.
- * These could take (tid) into account, but for now we don't.
+ * wasm uses architecture names, everything else is language or plain integer.
  */
 
 int eggrom_qual_repr(char *dst,int dsta,uint8_t tid,uint16_t qual) {
+  if (tid==EGG_TID_wasm) {
+    const char *src=0;
+    switch (qual) {
+      #define _(tag) case EGG_WASM_QUAL_##tag: src=#tag; break;
+      EGG_WASM_QUAL_FOR_EACH
+      #undef _
+    }
+    if (src) {
+      int srcc=0; while (src[srcc]) srcc++;
+      if (srcc<=dsta) {
+        memcpy(dst,src,srcc);
+        if (srcc<dsta) dst[srcc]=0;
+      }
+      return srcc;
+    }
+    return sr_decuint_repr(dst,dsta,qual,0);
+  }
   uint8_t a=qual>>8,b=qual;
   if ((a>='a')&&(a<='z')&&(b>='a')&&(b<='z')) {
     if (dsta>=2) {
@@ -53,6 +70,11 @@ int eggrom_qual_repr(char *dst,int dsta,uint8_t tid,uint16_t qual) {
 int eggrom_qual_eval(const char *src,int srcc,uint8_t tid) {
   if (!src) return -1;
   if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  if (tid==EGG_TID_wasm) {
+    #define _(tag) if ((srcc==sizeof(#tag)-1)&&!memcmp(src,#tag,srcc)) return EGG_WASM_QUAL_##tag;
+    EGG_WASM_QUAL_FOR_EACH
+    #undef _
+  }
   if ((srcc==2)&&(src[0]>='a')&&(src[0]<='z')&&(src[1]>='a')&&(src[1]<='z')) {
     return (src[0]<<8)|src[1];
   }
@@ -74,6 +96,7 @@ static uint8_t eggrom_tid_from_sfx(const char *sfx,int sfxc) {
         if (!memcmp(sfx,"js",2)) return EGG_TID_js;
       } break;
     case 3: {
+        if (!memcmp(sfx,"aot",3)) return EGG_TID_wasm;
         if (!memcmp(sfx,"png",3)) return EGG_TID_image;
         if (!memcmp(sfx,"gif",3)) return EGG_TID_image;
         if (!memcmp(sfx,"jpg",3)) return EGG_TID_image;
@@ -100,6 +123,7 @@ static uint8_t eggrom_tid_from_sfx(const char *sfx,int sfxc) {
  
 static uint8_t eggrom_tid_from_serial(const uint8_t *src,int srcc) {
   if ((srcc>=4)&&!memcmp(src,"\0asm",4)) return EGG_TID_wasm;
+  if ((srcc>=4)&&!memcmp(src,"\0aot",4)) return EGG_TID_wasm;
   if ((srcc>=7)&&!memcmp(src,"\x89PNG\r\n\x1a\n",8)) return EGG_TID_image;
   if ((srcc>=6)&&!memcmp(src,"GIF87a",6)) return EGG_TID_image;
   if ((srcc>=6)&&!memcmp(src,"GIF89a",6)) return EGG_TID_image;
@@ -1,4 +1,7 @@
 #include "eggrom_internal.h"
+#if USE_qjs
+  #include "opt/qjs/qjs.h"
+#endif
 
 /* Concatenation context.
  */
@@ -379,6 +382,30 @@ static int eggrom_js_remove_sources(struct eggrom_js_context *ctx) {
   return 0;
 }
 
+/* Replace the text in (ctx->dst) with QuickJS bytecode, if requested.
+ * The output still contains the text. Runtimes that can't use the bytecode fall back to it.
+ */
+ 
+static int eggrom_js_compile_bytecode(struct eggrom_js_context *ctx) {
+  if (!eggrom.js_bytecode) return 0;
+  #if USE_qjs
+    void *bc=0;
+    int bcc=qjs_compile_bytecode(&bc,ctx->dst.v,ctx->dst.c,"js:1");
+    if (bcc<0) {
+      if (bcc!=-2) fprintf(stderr,"%s: Unspecified error compiling Javascript to bytecode.\n",eggrom.dstpath);
+      return -2;
+    }
+    sr_encoder_cleanup(&ctx->dst);
+    ctx->dst.v=bc;
+    ctx->dst.c=bcc;
+    ctx->dst.a=bcc;
+    return 0;
+  #else
+    fprintf(stderr,"%s: Javascript bytecode requested but eggrom was built without qjs.\n",eggrom.exename);
+    return -2;
+  #endif
+}
+
 /* Add a new resource to romw, from the text we previously generated at (ctx->dst).
  */
  
@@ -404,6 +431,7 @@ static int eggrom_js_combine_inner(struct eggrom_js_context *ctx) {
   if ((err=eggrom_js_discover_imports(ctx))<0) return err;
   if ((err=eggrom_js_sort_by_import_order(ctx))<0) return err;
   if ((err=eggrom_js_reduce_and_combine(ctx))<0) return err;
+  if ((err=eggrom_js_compile_bytecode(ctx))<0) return err;
   if ((err=eggrom_js_remove_sources(ctx))<0) return err;
   if ((err=eggrom_js_generate_combined_resource(ctx))<0) return err;
   return 0;
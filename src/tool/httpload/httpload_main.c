@@ -0,0 +1,220 @@
+/* httpload_main.c
+ * Latency test for the http unit's outbound requests.
+ * We listen on a local port, and a bunch of clients in the same context each GET from it as fast as they can,
+ * with (depth) requests outstanding per client.
+ * Each new request goes out from the previous one's callback, the way a game polling a server would do it.
+ * Reports requests per second, latency percentiles, and how many connections were new, reused, or pipelined.
+ * Use --close to send "Connection: close" and get the old one-connection-per-request behavior, for comparison.
+ * Pipelining only happens with --pipeline=N, and only matters with --depth>1.
+ */
+
+#include "opt/http/http.h"
+#include "opt/serial/serial.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
+#include <signal.h>
+
+static struct httpload {
+  const char *exename;
+  volatile int sigc;
+  int clientc;
+  int depth;
+  int seconds;
+  int port;
+  int close;
+  int pipeline;
+  int use_epoll;
+  struct http_context *http;
+  char url[64];
+  int urlc;
+  int running;
+  double *latencyv;
+  int latencyc,latencya;
+  int failc;
+} httpload={0};
+
+/* Signal.
+ */
+
+static void httpload_rcvsig(int sigid) {
+  switch (sigid) {
+    case SIGINT: if (++(httpload.sigc)>=3) {
+        fprintf(stderr,"%s: Too many unprocessed signals.\n",httpload.exename);
+        exit(1);
+      } break;
+  }
+}
+
+/* Server side: Tiny fixed response.
+ */
+
+static int httpload_cb_serve(struct http_xfer *req,struct http_xfer *rsp,void *userdata) {
+  if (sr_encode_raw(http_xfer_get_body(rsp),"{\"score\":12345}",15)<0) return -1;
+  http_xfer_add_header(rsp,"Content-Type",12,"application/json",16);
+  return http_xfer_set_status(rsp,200,"OK");
+}
+
+/* Client side: Send a request, carrying its start time as userdata.
+ * On response, record latency and send another.
+ */
+
+static int httpload_cb_response(struct http_xfer *req,struct http_xfer *rsp);
+
+static int httpload_send() {
+  double *then=malloc(sizeof(double));
+  if (!then) return -1;
+  *then=http_now();
+  struct http_xfer *req=http_request(httpload.http,"GET",httpload.url,httpload.urlc,httpload_cb_response,then);
+  if (!req) {
+    free(then);
+    httpload.failc++;
+    return -1;
+  }
+  if (httpload.close) http_xfer_add_header(req,"Connection",10,"close",5);
+  return 0;
+}
+
+static int httpload_cb_response(struct http_xfer *req,struct http_xfer *rsp) {
+  double *then=http_xfer_get_userdata(req);
+  double latency=http_now()-*then;
+  free(then);
+  if (http_xfer_get_status(rsp)!=200) httpload.failc++;
+  if (!httpload.running) return 0;
+  if (httpload.latencyc>=httpload.latencya) {
+    int na=httpload.latencya+65536;
+    if (na>INT_MAX/sizeof(double)) return -1;
+    void *nv=realloc(httpload.latencyv,sizeof(double)*na);
+    if (!nv) return -1;
+    httpload.latencyv=nv;
+    httpload.latencya=na;
+  }
+  httpload.latencyv[httpload.latencyc++]=latency;
+  httpload_send();
+  return 0;
+}
+
+/* Report.
+ */
+
+static int httpload_cmp_double(const void *a,const void *b) {
+  double A=*(const double*)a,B=*(const double*)b;
+  if (A<B) return -1;
+  if (A>B) return 1;
+  return 0;
+}
+
+static void httpload_report(double elapsed) {
+  struct http_stats stats;
+  http_context_get_stats(&stats,httpload.http);
+  if (httpload.latencyc<1) {
+    fprintf(stderr,"%s: No requests completed.\n",httpload.exename);
+    return;
+  }
+  qsort(httpload.latencyv,httpload.latencyc,sizeof(double),httpload_cmp_double);
+  double p50=httpload.latencyv[httpload.latencyc/2];
+  double p99=httpload.latencyv[(int)((httpload.latencyc-1)*0.99)];
+  double max=httpload.latencyv[httpload.latencyc-1];
+  fprintf(stderr,
+    "%s: %d clients, depth %d, %s. %d requests in %.03f s, %.0f/s. Latency p50 %.03f ms, p99 %.03f ms, max %.03f ms. %d failed.\n",
+    httpload.exename,httpload.clientc,httpload.depth,httpload.close?"close":"keep-alive",
+    httpload.latencyc,elapsed,httpload.latencyc/elapsed,
+    p50*1000.0,p99*1000.0,max*1000.0,httpload.failc
+  );
+  fprintf(stderr,
+    "%s: Connections: %d new, %d reused, %d pipelined, %d retried. %d responses.\n",
+    httpload.exename,stats.connectc,stats.reusec,stats.pipelinec,stats.retryc,stats.completec
+  );
+}
+
+/* Command line.
+ */
+
+static int httpload_arg_int(int *dst,const char *src,const char *name,int lo,int hi) {
+  int srcc=0; while (src[srcc]) srcc++;
+  if ((sr_int_eval(dst,src,srcc)<2)||(*dst<lo)||(*dst>hi)) {
+    fprintf(stderr,"%s: Expected integer in %d..%d for '%s', found '%s'.\n",httpload.exename,lo,hi,name,src);
+    return -1;
+  }
+  return 0;
+}
+
+/* Main.
+ */
+
+int main(int argc,char **argv) {
+  httpload.exename="httpload";
+  if ((argc>=1)&&argv[0]&&argv[0][0]) httpload.exename=argv[0];
+  httpload.clientc=10;
+  httpload.depth=1;
+  httpload.seconds=5;
+  httpload.port=8083;
+  int argi=1; for (;argi<argc;argi++) {
+    const char *arg=argv[argi];
+    if (!memcmp(arg,"--clients=",10)) {
+      if (httpload_arg_int(&httpload.clientc,arg+10,"clients",1,1000)<0) return 1;
+    } else if (!memcmp(arg,"--depth=",8)) {
+      if (httpload_arg_int(&httpload.depth,arg+8,"depth",1,100)<0) return 1;
+    } else if (!memcmp(arg,"--seconds=",10)) {
+      if (httpload_arg_int(&httpload.seconds,arg+10,"seconds",1,3600)<0) return 1;
+    } else if (!memcmp(arg,"--port=",7)) {
+      if (httpload_arg_int(&httpload.port,arg+7,"port",1,65535)<0) return 1;
+    } else if (!memcmp(arg,"--pipeline=",11)) {
+      if (httpload_arg_int(&httpload.pipeline,arg+11,"pipeline",0,100)<0) return 1;
+    } else if (!strcmp(arg,"--close")) {
+      httpload.close=1;
+    } else if (!strcmp(arg,"--epoll")) {
+      httpload.use_epoll=1;
+    } else {
+      fprintf(stderr,"Usage: %s [--clients=10] [--depth=1] [--seconds=5] [--port=8083] [--pipeline=0] [--close] [--epoll]\n",httpload.exename);
+      return 1;
+    }
+  }
+  signal(SIGINT,httpload_rcvsig);
+
+  struct http_context_delegate delegate={
+    .cb_serve=httpload_cb_serve,
+  };
+  if (!(httpload.http=http_context_new(&delegate))) return 1;
+  struct http_limits limits;
+  http_context_get_limits(&limits,httpload.http);
+  limits.requests=httpload.clientc*2+16; // Server and client sides both count.
+  limits.backlog=httpload.clientc*httpload.depth+16;
+  limits.pipeline=httpload.pipeline;
+  http_context_set_limits(httpload.http,&limits);
+  if (httpload.use_epoll&&(http_context_use_epoll(httpload.http)<0)) {
+    fprintf(stderr,"%s: epoll not available, using poll.\n",httpload.exename);
+  }
+  if (http_listen(httpload.http,1,httpload.port)<0) {
+    fprintf(stderr,"%s: Failed to open TCP server on port %d\n",httpload.exename,httpload.port);
+    return 1;
+  }
+  httpload.urlc=snprintf(httpload.url,sizeof(httpload.url),"http://127.0.0.1:%d/leaderboard",httpload.port);
+
+  httpload.running=1;
+  int i=0; for (;i<httpload.clientc*httpload.depth;i++) {
+    if (httpload_send()<0) {
+      fprintf(stderr,"%s: Failed to start request %d/%d.\n",httpload.exename,i,httpload.clientc*httpload.depth);
+      return 1;
+    }
+    // Connecting blocks, and we're also the server, so let it accept as we go.
+    if (http_update(httpload.http,0)<0) return 1;
+  }
+  double starttime=http_now();
+  double endtime=starttime+httpload.seconds;
+  double now=starttime;
+  while (!httpload.sigc&&(now<endtime)) {
+    if (http_update(httpload.http,10)<0) {
+      fprintf(stderr,"%s: Error updating http context.\n",httpload.exename);
+      break;
+    }
+    now=http_now();
+  }
+  httpload.running=0;
+
+  httpload_report(now-starttime);
+  http_context_del(httpload.http);
+  if (httpload.latencyv) free(httpload.latencyv);
+  return 0;
+}
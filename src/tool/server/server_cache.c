@@ -0,0 +1,339 @@
+/* server_cache.c
+ * Serving regular files, with an in-memory cache validated against mtime and size on every request.
+ * Small files live in the cache, along with a gzip variant for text-ish types.
+ * Large files are never cached; we hand the open file to http and it goes out via sendfile.
+ * Or if it's compressible and the client accepts gzip, we compress it on the fly, as a chunked stream.
+ * (For HTTP/1.0 clients, http sends that stream unchunked and closes the connection after.)
+ */
+
+#include "server_internal.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define SERVER_CACHE_FILE_LIMIT (1<<20) /* Bigger than this, serve from the file. */
+#define SERVER_CACHE_TOTAL_LIMIT (64<<20) /* Drop everything when the cache would exceed this. */
+#define SERVER_GZIP_MIN 1024 /* Not worth compressing anything smaller. */
+#define SERVER_STREAM_CHUNK 65536 /* Input and output sizes per step, gzipping large files on the fly. */
+
+/* Guess content type.
+ * Always returns something sensible.
+ */
+
+static const char *server_guess_content_type(const char *path,const uint8_t *src,int srcc) {
+
+  // Take (path)'s word for it, if it expresses an opinion.
+  char sfx[16];
+  int sfxc=0;
+  {
+    const char *sfxsrc=0;
+    int sfxsrcc=0,pathp=0;
+    for (;path[pathp];pathp++) {
+      if (path[pathp]=='/') {
+        sfxsrc=0;
+        sfxsrcc=0;
+      } else if (path[pathp]=='.') {
+        sfxsrc=path+pathp+1;
+        sfxsrcc=0;
+      } else if (sfxsrc) {
+        sfxsrcc++;
+      }
+    }
+    if (sfxsrcc<=sizeof(sfx)) {
+      for (;sfxc<sfxsrcc;sfxc++) {
+        if ((sfxsrc[sfxc]>='A')&&(sfxsrc[sfxc]<='Z')) sfx[sfxc]=sfxsrc[sfxc]+0x20;
+        else sfx[sfxc]=sfxsrc[sfxc];
+      }
+    }
+  }
+  switch (sfxc) {
+    case 1: switch (sfx[0]) {
+        case 'c': return "text/plain";
+        case 'h': return "text/plain";
+        case 'm': return "text/plain";
+        case 's': return "text/plain";
+      } break;
+    case 2: {
+        if (!memcmp(sfx,"js",2)) return "text/javascript";//TODO is it "application"?
+      } break;
+    case 3: {
+        if (!memcmp(sfx,"css",3)) return "text/css";
+        if (!memcmp(sfx,"htm",3)) return "text/html";
+        if (!memcmp(sfx,"png",3)) return "image/png";
+        if (!memcmp(sfx,"gif",3)) return "image/gif";
+        if (!memcmp(sfx,"bmp",3)) return "image/bmp";//not sure of this one
+        if (!memcmp(sfx,"ico",3)) return "image/x-icon";
+        if (!memcmp(sfx,"jpg",3)) return "image/jpeg";
+        if (!memcmp(sfx,"xml",3)) return "application/xml";
+        if (!memcmp(sfx,"txt",3)) return "text/plain";
+        if (!memcmp(sfx,"mid",3)) return "audio/midi";
+        if (!memcmp(sfx,"wav",3)) return "audio/wav";//TODO
+        if (!memcmp(sfx,"cxx",3)) return "text/plain";
+        if (!memcmp(sfx,"egg",3)) return "application/octet-stream";
+      } break;
+    case 4: {
+        if (!memcmp(sfx,"html",4)) return "text/html";
+        if (!memcmp(sfx,"jpeg",4)) return "image/jpeg";
+      } break;
+    case 5: {
+        if (!memcmp(sfx,"rlead",5)) return "image/x-rlead";//TODO what's the right syntax for vendor custom types?
+      } break;
+  }
+
+  // We could look for signatures and such, but why bother. Just name the files right in the first place.
+  // If the suffix didn't match, call it text/plain or application/octet-stream based on the first 256 bytes.
+  int p=256;
+  if (p>srcc) p=srcc;
+  while (p-->0) {
+    if (src[p]>=0x20) continue;
+    if (src[p]==0x0d) continue;
+    if (src[p]==0x0a) continue;
+    if (src[p]==0x09) continue;
+    return "application/octet-stream";
+  }
+  return "text/plain";
+}
+
+/* Nonzero if this content type usually compresses well.
+ * ROM files are already compressed internally, and images are their own thing.
+ */
+
+static int server_content_type_compressible(const char *type) {
+  if (!memcmp(type,"text/",5)) return 1;
+  if (!strcmp(type,"application/xml")) return 1;
+  if (!strcmp(type,"application/json")) return 1;
+  if (!strcmp(type,"audio/midi")) return 1;
+  return 0;
+}
+
+/* Cleanup.
+ */
+
+static void server_file_cleanup(struct server_file *file) {
+  if (file->path) free(file->path);
+  if (file->v) free(file->v);
+  if (file->gzv) free(file->gzv);
+}
+
+void server_cache_cleanup() {
+  if (server.filev) {
+    while (server.filec-->0) server_file_cleanup(server.filev+server.filec);
+    free(server.filev);
+  }
+  server.filev=0;
+  server.filec=server.filea=0;
+  server.filetotal=0;
+}
+
+/* Make the gzip variant of a cached file, if we haven't yet.
+ * If it doesn't help, we record (gzc) zero and won't try again.
+ */
+
+static void server_file_require_gzip(struct server_file *file) {
+  if (file->gzv||file->gztried) return;
+  file->gztried=1;
+  z_stream z={0};
+  if (deflateInit2(&z,Z_BEST_COMPRESSION,Z_DEFLATED,15+16,8,Z_DEFAULT_STRATEGY)!=Z_OK) return;
+  int dsta=deflateBound(&z,file->c);
+  void *dst=malloc(dsta);
+  if (!dst) {
+    deflateEnd(&z);
+    return;
+  }
+  z.next_in=(Bytef*)file->v;
+  z.avail_in=file->c;
+  z.next_out=dst;
+  z.avail_out=dsta;
+  int err=deflate(&z,Z_FINISH);
+  int dstc=dsta-z.avail_out;
+  deflateEnd(&z);
+  if ((err!=Z_STREAM_END)||(dstc>=file->c)) {
+    free(dst);
+    return;
+  }
+  file->gzv=dst;
+  file->gzc=dstc;
+  server.filetotal+=dstc;
+}
+
+/* Gzip a large file on the fly, as the socket drains.
+ */
+ 
+struct server_gzip_stream {
+  int fd;
+  int eof;
+  z_stream z;
+  int zinit;
+  uint8_t inv[SERVER_STREAM_CHUNK];
+};
+
+static void server_gzip_stream_del(void *userdata) {
+  struct server_gzip_stream *stream=userdata;
+  if (stream->fd>=0) close(stream->fd);
+  if (stream->zinit) deflateEnd(&stream->z);
+  free(stream);
+}
+
+static int server_gzip_stream_produce(struct sr_encoder *dst,void *userdata) {
+  struct server_gzip_stream *stream=userdata;
+  if (sr_encoder_require(dst,SERVER_STREAM_CHUNK)<0) return -1;
+  stream->z.next_out=(Bytef*)dst->v+dst->c;
+  stream->z.avail_out=SERVER_STREAM_CHUNK;
+  // deflate holds input until it has enough to say something. Keep feeding it until it does.
+  while (stream->z.avail_out==SERVER_STREAM_CHUNK) {
+    if (!stream->z.avail_in&&!stream->eof) {
+      int err=read(stream->fd,stream->inv,sizeof(stream->inv));
+      if (err<0) return -1;
+      if (!err) stream->eof=1;
+      stream->z.next_in=stream->inv;
+      stream->z.avail_in=err;
+    }
+    int err=deflate(&stream->z,stream->eof?Z_FINISH:Z_NO_FLUSH);
+    if (err==Z_STREAM_END) {
+      dst->c+=SERVER_STREAM_CHUNK-stream->z.avail_out;
+      return 0;
+    }
+    if ((err!=Z_OK)&&(err!=Z_BUF_ERROR)) return -1;
+  }
+  dst->c+=SERVER_STREAM_CHUNK-stream->z.avail_out;
+  return 1;
+}
+
+static int server_serve_gzip_stream(struct http_xfer *rsp,int fd) {
+  struct server_gzip_stream *stream=calloc(1,sizeof(struct server_gzip_stream));
+  if (!stream) {
+    close(fd);
+    return -1;
+  }
+  stream->fd=fd;
+  if (deflateInit2(&stream->z,Z_DEFAULT_COMPRESSION,Z_DEFLATED,15+16,8,Z_DEFAULT_STRATEGY)!=Z_OK) {
+    server_gzip_stream_del(stream);
+    return -1;
+  }
+  stream->zinit=1;
+  if (http_xfer_set_body_producer(rsp,-1,server_gzip_stream_produce,server_gzip_stream_del,stream)<0) {
+    server_gzip_stream_del(stream);
+    return -1;
+  }
+  return 0;
+}
+
+/* Find or load a file in the cache.
+ * (st) must be fresh from stat.
+ * We add entries for large files too, just without content, so we don't have to sniff their type every time.
+ */
+
+static struct server_file *server_cache_get(const char *path,const struct stat *st) {
+  struct server_file *file=server.filev;
+  int i=server.filec;
+  for (;i-->0;file++) {
+    if (strcmp(file->path,path)) continue;
+    if ((file->mtime_s==st->st_mtim.tv_sec)&&(file->mtime_ns==st->st_mtim.tv_nsec)&&(file->size==st->st_size)) {
+      server.cache_hitc++;
+      return file;
+    }
+    // Stale. Drop it and load fresh.
+    server.filetotal-=file->c+file->gzc;
+    server_file_cleanup(file);
+    server.filec--;
+    memmove(file,file+1,sizeof(struct server_file)*(server.filec-(file-server.filev)));
+    break;
+  }
+  server.cache_missc++;
+
+  struct server_file scratch={0};
+  scratch.mtime_s=st->st_mtim.tv_sec;
+  scratch.mtime_ns=st->st_mtim.tv_nsec;
+  scratch.size=st->st_size;
+  if (st->st_size<=SERVER_CACHE_FILE_LIMIT) {
+    if ((scratch.c=file_read(&scratch.v,path))<0) return 0;
+    scratch.content_type=server_guess_content_type(path,scratch.v,scratch.c);
+  } else {
+    uint8_t head[256];
+    int headc=0;
+    int fd=open(path,O_RDONLY);
+    if (fd<0) return 0;
+    if ((headc=read(fd,head,sizeof(head)))<0) headc=0;
+    close(fd);
+    scratch.content_type=server_guess_content_type(path,head,headc);
+  }
+
+  if (server.filetotal+scratch.c>SERVER_CACHE_TOTAL_LIMIT) server_cache_cleanup();
+  if (server.filec>=server.filea) {
+    int na=server.filea+32;
+    if (na>INT_MAX/sizeof(struct server_file)) { server_file_cleanup(&scratch); return 0; }
+    void *nv=realloc(server.filev,sizeof(struct server_file)*na);
+    if (!nv) { server_file_cleanup(&scratch); return 0; }
+    server.filev=nv;
+    server.filea=na;
+  }
+  if (!(scratch.path=strdup(path))) { server_file_cleanup(&scratch); return 0; }
+  file=server.filev+server.filec++;
+  *file=scratch;
+  server.filetotal+=file->c;
+  return file;
+}
+
+/* Serve a regular file verbatim.
+ */
+
+int server_serve_file(struct http_xfer *rsp,const char *path,int gzip_ok) {
+  struct stat st;
+  if ((stat(path,&st)<0)||!S_ISREG(st.st_mode)) return http_xfer_set_status(rsp,404,"Not found");
+  struct server_file *file=server_cache_get(path,&st);
+  if (!file) return http_xfer_set_status(rsp,404,"Not found");
+  http_xfer_add_header(rsp,"Content-Type",12,file->content_type,-1);
+
+  // Too big to cache: Send straight from the file, or stream it through gzip.
+  if (!file->v) {
+    int fd=open(path,O_RDONLY);
+    if (fd<0) return http_xfer_set_status(rsp,404,"Not found");
+    if (server_content_type_compressible(file->content_type)) {
+      http_xfer_add_header(rsp,"Vary",4,"Accept-Encoding",15);
+      if (gzip_ok) {
+        if (server_serve_gzip_stream(rsp,fd)<0) return -1;
+        http_xfer_add_header(rsp,"Content-Encoding",16,"gzip",4);
+        return http_xfer_set_status(rsp,200,"OK");
+      }
+    }
+    if (http_xfer_set_body_file(rsp,fd,file->size)<0) return -1;
+    return http_xfer_set_status(rsp,200,"OK");
+  }
+
+  const void *src=file->v;
+  int srcc=file->c;
+  if ((file->c>=SERVER_GZIP_MIN)&&server_content_type_compressible(file->content_type)) {
+    http_xfer_add_header(rsp,"Vary",4,"Accept-Encoding",15);
+    if (gzip_ok) {
+      server_file_require_gzip(file);
+      if (file->gzv) {
+        http_xfer_add_header(rsp,"Content-Encoding",16,"gzip",4);
+        src=file->gzv;
+        srcc=file->gzc;
+      }
+    }
+  }
+  if (sr_encode_raw(http_xfer_get_body(rsp),src,srcc)<0) return -1;
+  return http_xfer_set_status(rsp,200,"OK");
+}
+
+/* Check request for gzip.
+ */
+
+int server_accepts_gzip(const struct http_xfer *req) {
+  if (!req) return 0;
+  const char *src=0;
+  int srcc=http_xfer_get_header(&src,req,"Accept-Encoding",15);
+  int srcp=0;
+  while (srcp<srcc) {
+    if ((unsigned char)src[srcp]<=0x20) { srcp++; continue; }
+    if (src[srcp]==',') { srcp++; continue; }
+    const char *token=src+srcp;
+    int tokenc=0;
+    while ((srcp<srcc)&&(src[srcp]!=',')&&(src[srcp]!=';')&&((unsigned char)src[srcp]>0x20)) { srcp++; tokenc++; }
+    while ((srcp<srcc)&&(src[srcp]!=',')) srcp++; // Skip parameters. We're not going to parse "gzip;q=0".
+    if ((tokenc==4)&&!sr_memcasecmp(token,"gzip",4)) return 1;
+  }
+  return 0;
+}
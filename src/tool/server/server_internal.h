@@ -29,10 +29,55 @@ extern struct server {
     int procfd;
     struct http_xfer *rsp;
     char *path;
+    int gzip_ok;
+    int gen; // (watchgen) when make started.
   } *pendingv;
   int pendingc,pendinga;
   struct http_websocket **wsv;
   int wsc,wsa;
+  
+  // server_cache.c
+  struct server_file {
+    char *path;
+    long long mtime_s,mtime_ns;
+    long long size;
+    const char *content_type;
+    void *v; // Null if too big to cache.
+    int c;
+    void *gzv;
+    int gzc;
+    int gztried;
+  } *filev;
+  int filec,filea;
+  int filetotal; // Bytes of content, for the overall limit.
+  int cache_hitc,cache_missc;
+  
+  // server_watch.c
+  char **watchdirv; // From command line, or defaults.
+  int watchdirc,watchdira;
+  int watchfd;
+  int watchgen;
+  char **watchpathv; // Indexed by wd, sparse.
+  int watchpathc;
+  struct server_built {
+    char *path;
+    int gen;
+  } *builtv;
+  int builtc,builta;
+  int make_runc,make_skipc;
 } server;
 
+void server_cache_cleanup();
+int server_serve_file(struct http_xfer *rsp,const char *path,int gzip_ok);
+int server_accepts_gzip(const struct http_xfer *req);
+
+/* Nothing under the watched directories changed since (path)'s last successful make.
+ * Always false if we're not watching.
+ */
+void server_watch_cleanup();
+int server_watch_init();
+int server_watch_update();
+int server_watch_is_current(const char *path);
+void server_watch_set_built(const char *path,int gen);
+
 #endif
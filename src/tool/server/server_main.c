@@ -20,100 +20,6 @@ static void server_rcvsig(int sigid) {
   }
 }
 
-/* Guess content type.
- * Always returns something sensible.
- */
- 
-static const char *server_guess_content_type(const char *path,const uint8_t *src,int srcc) {
-  
-  // Take (path)'s word for it, if it expresses an opinion.
-  char sfx[16];
-  int sfxc=0;
-  {
-    const char *sfxsrc=0;
-    int sfxsrcc=0,pathp=0;
-    for (;path[pathp];pathp++) {
-      if (path[pathp]=='/') {
-        sfxsrc=0;
-        sfxsrcc=0;
-      } else if (path[pathp]=='.') {
-        sfxsrc=path+pathp+1;
-        sfxsrcc=0;
-      } else if (sfxsrc) {
-        sfxsrcc++;
-      }
-    }
-    if (sfxsrcc<=sizeof(sfx)) {
-      for (;sfxc<sfxsrcc;sfxc++) {
-        if ((sfxsrc[sfxc]>='A')&&(sfxsrc[sfxc]<='Z')) sfx[sfxc]=sfxsrc[sfxc]+0x20;
-        else sfx[sfxc]=sfxsrc[sfxc];
-      }
-    }
-  }
-  switch (sfxc) {
-    case 1: switch (sfx[0]) {
-        case 'c': return "text/plain";
-        case 'h': return "text/plain";
-        case 'm': return "text/plain";
-        case 's': return "text/plain";
-      } break;
-    case 2: {
-        if (!memcmp(sfx,"js",2)) return "text/javascript";//TODO is it "application"?
-      } break;
-    case 3: {
-        if (!memcmp(sfx,"css",3)) return "text/css";
-        if (!memcmp(sfx,"htm",3)) return "text/html";
-        if (!memcmp(sfx,"png",3)) return "image/png";
-        if (!memcmp(sfx,"gif",3)) return "image/gif";
-        if (!memcmp(sfx,"bmp",3)) return "image/bmp";//not sure of this one
-        if (!memcmp(sfx,"ico",3)) return "image/x-icon";
-        if (!memcmp(sfx,"jpg",3)) return "image/jpeg";
-        if (!memcmp(sfx,"xml",3)) return "application/xml";
-        if (!memcmp(sfx,"txt",3)) return "text/plain";
-        if (!memcmp(sfx,"mid",3)) return "audio/midi";
-        if (!memcmp(sfx,"wav",3)) return "audio/wav";//TODO
-        if (!memcmp(sfx,"cxx",3)) return "text/plain";
-        if (!memcmp(sfx,"egg",3)) return "application/octet-stream";
-      } break;
-    case 4: {
-        if (!memcmp(sfx,"html",4)) return "text/html";
-        if (!memcmp(sfx,"jpeg",4)) return "image/jpeg";
-      } break;
-    case 5: {
-        if (!memcmp(sfx,"rlead",5)) return "image/x-rlead";//TODO what's the right syntax for vendor custom types?
-      } break;
-  }
-  
-  // We could look for signatures and such, but why bother. Just name the files right in the first place.
-  // If the suffix didn't match, call it text/plain or application/octet-stream based on the first 256 bytes.
-  int p=256;
-  if (p>srcc) p=srcc;
-  while (p-->0) {
-    if (src[p]>=0x20) continue;
-    if (src[p]==0x0d) continue;
-    if (src[p]==0x0a) continue;
-    if (src[p]==0x09) continue;
-    return "application/octet-stream";
-  }
-  return "text/plain";
-}
-
-/* Serve a regular file verbatim.
- */
- 
-static int server_serve_file(struct http_xfer *req,struct http_xfer *rsp,const char *path) {
-  void *serial=0;
-  int serialc=file_read(&serial,path);
-  if (serialc<0) return http_xfer_set_status(rsp,404,"Not found");
-  if (sr_encode_raw(http_xfer_get_body(rsp),serial,serialc)<0) {
-    free(serial);
-    return -1;
-  }
-  http_xfer_add_header(rsp,"Content-Type",12,server_guess_content_type(path,serial,serialc),-1);
-  free(serial);
-  return http_xfer_set_status(rsp,200,"OK");
-}
-
 /* Strip working directory from an absolute path.
  */
  
@@ -137,10 +43,17 @@ static const char *server_strip_wd(const char *src) {
  
 static int server_make_then_serve_file(struct http_xfer *req,struct http_xfer *rsp,const char *path) {
   
+  // If we're watching inputs and nothing changed since the last build, it's current.
+  if (server_watch_is_current(path)) {
+    server.make_skipc++;
+    return server_serve_file(rsp,path,server_accepts_gzip(req));
+  }
+  
   const char *path0=path;
   if (!(path=server_strip_wd(path))) return http_xfer_set_status(rsp,404,"Not found");
   int fd=process_spawn(server.proc,"make",path);
   if (fd<0) return http_xfer_set_status(rsp,500,"Failed to launch child process");
+  server.make_runc++;
   
   if (server.pendingc>=server.pendinga) {
     int na=server.pendinga+8;
@@ -156,6 +69,8 @@ static int server_make_then_serve_file(struct http_xfer *req,struct http_xfer *r
   
   pending->procfd=fd;
   pending->rsp=rsp;
+  pending->gzip_ok=server_accepts_gzip(req);
+  pending->gen=server.watchgen;
   return 0;
 }
 
@@ -226,7 +141,7 @@ static int server_cb_serve_static(struct http_xfer *req,struct http_xfer *rsp) {
     char path[1024];
     int pathc=server_htdocs_path(path,sizeof(path),server.htdocsv[i],reqpath,reqpathc);
     if ((pathc>0)&&(pathc<sizeof(path))) {
-      return server_serve_file(req,rsp,path);
+      return server_serve_file(rsp,path,server_accepts_gzip(req));
     }
   }
   for (i=0;i<server.makeabledirc;i++) {
@@ -391,7 +306,8 @@ static void server_cb_term(void *userdata,int pid,int fd,int status) {
     http_xfer_set_status(pending->rsp,500,"Process status %d",status);
   } else {
     http_xfer_get_body(pending->rsp)->c=0; // drop any log output
-    server_serve_file(0,pending->rsp,pending->path);
+    server_watch_set_built(pending->path,pending->gen);
+    server_serve_file(pending->rsp,pending->path,pending->gzip_ok);
   }
   
   i=pending-server.pendingv;
@@ -463,6 +379,20 @@ static int server_arg_rom(const char *src) {
   return 0;
 }
 
+static int server_arg_watch(const char *src) {
+  if (server.watchdirc>=server.watchdira) {
+    int na=server.watchdira+4;
+    if (na>INT_MAX/sizeof(void*)) return -1;
+    void *nv=realloc(server.watchdirv,sizeof(void*)*na);
+    if (!nv) return -1;
+    server.watchdirv=nv;
+    server.watchdira=na;
+  }
+  if (!(server.watchdirv[server.watchdirc]=strdup(src))) return -1;
+  server.watchdirc++;
+  return 0;
+}
+
 /* Rebuild pollfdv.
  */
  
@@ -486,6 +416,20 @@ static int server_rebuild_pollfdv() {
   GATHER(http_get_files,server.http)
   GATHER(process_get_files,server.proc)
   #undef GATHER
+  if (server.watchfd>=0) {
+    if (pollfdc>=server.pollfda) {
+      int na=server.pollfda+16;
+      if (na>INT_MAX/sizeof(struct pollfd)) return -1;
+      void *nv=realloc(server.pollfdv,sizeof(struct pollfd)*na);
+      if (!nv) return -1;
+      server.pollfdv=nv;
+      server.pollfda=na;
+    }
+    struct pollfd *pollfd=server.pollfdv+pollfdc++;
+    pollfd->fd=server.watchfd;
+    pollfd->events=POLLIN;
+    pollfd->revents=0;
+  }
   return pollfdc;
 }
 
@@ -509,6 +453,8 @@ int main(int argc,char **argv) {
   server.exename="server";
   if ((argc>=1)&&argv[0]&&argv[0][0]) server.exename=argv[0];
   server.port=8080;
+  server.watchfd=-1;
+  signal(SIGINT,server_rcvsig);
   int local_only=1;
   int argi=1; for (;argi<argc;argi++) {
     const char *arg=argv[argi];
@@ -520,6 +466,8 @@ int main(int argc,char **argv) {
       if (server_arg_makeable_dir(arg+15)<0) return 1;
     } else if (!memcmp(arg,"--rom=",6)) {
       if (server_arg_rom(arg+6)<0) return 1;
+    } else if (!memcmp(arg,"--watch=",8)) {
+      if (server_arg_watch(arg+8)<0) return 1;
     } else if (!strcmp(arg,"--listen-remote")) {
       local_only=0;
     } else {
@@ -528,7 +476,7 @@ int main(int argc,char **argv) {
     }
   }
   if (!server.htdocsc&&!server.makeabledirc) {
-    fprintf(stderr,"Usage: %s [--port=8080] [--htdocs=DIR...] [--makeable-dir=DIR...] [--listen-remote]\n",server.exename);
+    fprintf(stderr,"Usage: %s [--port=8080] [--htdocs=DIR...] [--makeable-dir=DIR...] [--watch=DIR...] [--listen-remote]\n",server.exename);
     return 1;
   }
   
@@ -547,6 +495,13 @@ int main(int argc,char **argv) {
     return 1;
   }
   
+  // Watching is only useful if we run make. Default to the usual inputs.
+  if (!server.watchdirc&&(server.makeabledirc||server.romc)) {
+    if (file_get_type("src")=='d') server_arg_watch("src");
+    if (file_get_type("etc")=='d') server_arg_watch("etc");
+  }
+  if (server_watch_init()<0) return 1;
+  
   if (!local_only) fprintf(stderr,"%s:WARNING: Serving on external-facing interfaces per '--listen-remote'.\n",server.exename);
   fprintf(stderr,"%s: Serving on %d. SIGINT to quit.\n",server.exename,server.port);
   int status=0;
@@ -560,6 +515,10 @@ int main(int argc,char **argv) {
       int i=pollfdc;
       for (;i-->0;pollfd++) {
         if (!pollfd->revents) continue;
+        if (pollfd->fd==server.watchfd) {
+          server_watch_update();
+          continue;
+        }
         // http and process both fail safely for unknown fd, and never otherwise. So we don't have to track who owns which file.
         if (http_update_file(server.http,pollfd->fd)<0) {
           if (process_update_file(server.proc,pollfd->fd)<0) {
@@ -574,7 +533,13 @@ int main(int argc,char **argv) {
     }
   }
   
+  fprintf(stderr,
+    "%s: File cache %d hits, %d misses. Make ran %d times, skipped %d.\n",
+    server.exename,server.cache_hitc,server.cache_missc,server.make_runc,server.make_skipc
+  );
   http_context_del(server.http);
   process_context_del(server.proc);
+  server_cache_cleanup();
+  server_watch_cleanup();
   return status;
 }
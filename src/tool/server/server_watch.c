@@ -0,0 +1,156 @@
+/* server_watch.c
+ * Watch the build's input directories with inotify, so we can skip running make when nothing changed.
+ * Any event at all under a watched directory bumps (server.watchgen).
+ * A made file whose last successful build started at the current generation is up to date.
+ * If inotify isn't available or any watch fails, (server.watchfd) is <0 and we always make, like before.
+ */
+
+#include "server_internal.h"
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#define SERVER_WATCH_EVENTS (IN_CREATE|IN_DELETE|IN_MODIFY|IN_ATTRIB|IN_MOVED_FROM|IN_MOVED_TO|IN_DELETE_SELF|IN_MOVE_SELF)
+
+/* Cleanup.
+ */
+
+void server_watch_cleanup() {
+  if (server.watchfd>=0) close(server.watchfd);
+  server.watchfd=-1;
+  if (server.watchpathv) {
+    while (server.watchpathc-->0) {
+      if (server.watchpathv[server.watchpathc]) free(server.watchpathv[server.watchpathc]);
+    }
+    free(server.watchpathv);
+  }
+  server.watchpathv=0;
+  server.watchpathc=0;
+  if (server.builtv) {
+    while (server.builtc-->0) free(server.builtv[server.builtc].path);
+    free(server.builtv);
+  }
+  server.builtv=0;
+  server.builtc=server.builta=0;
+}
+
+/* Watch one directory and everything under it.
+ * We keep each watch's path, indexed by wd, so we can extend to new subdirectories.
+ */
+
+static int server_watch_dir(const char *path);
+
+static int server_watch_dir_cb(const char *path,const char *base,char type,void *userdata) {
+  if (base[0]=='.') return 0;
+  if (!type) type=file_get_type(path);
+  if (type!='d') return 0;
+  return server_watch_dir(path);
+}
+
+static int server_watch_dir(const char *path) {
+  int wd=inotify_add_watch(server.watchfd,path,SERVER_WATCH_EVENTS);
+  if (wd<0) {
+    fprintf(stderr,"%s: Failed to watch directory. Will run make for every request.\n",path);
+    return -1;
+  }
+  if (wd>=server.watchpathc) {
+    int na=wd+16;
+    if (na>INT_MAX/sizeof(void*)) return -1;
+    void *nv=realloc(server.watchpathv,sizeof(void*)*na);
+    if (!nv) return -1;
+    memset((char*)nv+sizeof(void*)*server.watchpathc,0,sizeof(void*)*(na-server.watchpathc));
+    server.watchpathv=nv;
+    server.watchpathc=na;
+  }
+  if (server.watchpathv[wd]) free(server.watchpathv[wd]);
+  if (!(server.watchpathv[wd]=strdup(path))) return -1;
+  return dir_read(path,server_watch_dir_cb,0);
+}
+
+/* Init.
+ */
+
+int server_watch_init() {
+  server.watchfd=-1;
+  if (server.watchdirc<1) return 0;
+  if ((server.watchfd=inotify_init1(IN_NONBLOCK|IN_CLOEXEC))<0) {
+    fprintf(stderr,"%s: inotify unavailable. Will run make for every request.\n",server.exename);
+    return 0;
+  }
+  int i=0; for (;i<server.watchdirc;i++) {
+    if (server_watch_dir(server.watchdirv[i])<0) {
+      server_watch_cleanup();
+      return 0;
+    }
+  }
+  return 0;
+}
+
+/* Read inotify.
+ */
+
+int server_watch_update() {
+  if (server.watchfd<0) return 0;
+  char tmp[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  for (;;) {
+    int tmpc=read(server.watchfd,tmp,sizeof(tmp));
+    if (tmpc<=0) return 0;
+    server.watchgen++;
+    int tmpp=0;
+    while (tmpp<=tmpc-(int)sizeof(struct inotify_event)) {
+      const struct inotify_event *event=(const struct inotify_event*)(tmp+tmpp);
+      tmpp+=sizeof(struct inotify_event);
+      if (tmpp>tmpc-(int)event->len) break;
+      tmpp+=event->len;
+      if (event->mask&IN_Q_OVERFLOW) continue; // Already bumped generation, nothing more to do.
+      if ((event->mask&IN_ISDIR)&&(event->mask&(IN_CREATE|IN_MOVED_TO))&&event->len&&(event->wd>=0)&&(event->wd<server.watchpathc)&&server.watchpathv[event->wd]) {
+        char path[1024];
+        int pathc=snprintf(path,sizeof(path),"%s/%s",server.watchpathv[event->wd],event->name);
+        if ((pathc<1)||(pathc>=sizeof(path))||(server_watch_dir(path)<0)) {
+          server_watch_cleanup();
+          return 0;
+        }
+      }
+    }
+  }
+}
+
+/* Built files.
+ */
+
+int server_watch_is_current(const char *path) {
+  if (server.watchfd<0) return 0;
+  server_watch_update(); // Don't wait for poll, something might have changed just now.
+  const struct server_built *built=server.builtv;
+  int i=server.builtc;
+  for (;i-->0;built++) {
+    if (strcmp(built->path,path)) continue;
+    if (built->gen!=server.watchgen) return 0;
+    return (file_get_type(path)=='f')?1:0;
+  }
+  return 0;
+}
+
+void server_watch_set_built(const char *path,int gen) {
+  if (server.watchfd<0) return;
+  struct server_built *built=server.builtv;
+  int i=server.builtc;
+  for (;i-->0;built++) {
+    if (!strcmp(built->path,path)) {
+      built->gen=gen;
+      return;
+    }
+  }
+  if (server.builtc>=server.builta) {
+    int na=server.builta+16;
+    if (na>INT_MAX/sizeof(struct server_built)) return;
+    void *nv=realloc(server.builtv,sizeof(struct server_built)*na);
+    if (!nv) return;
+    server.builtv=nv;
+    server.builta=na;
+  }
+  char *npath=strdup(path);
+  if (!npath) return;
+  built=server.builtv+server.builtc++;
+  built->path=npath;
+  built->gen=gen;
+}
@@ -0,0 +1,235 @@
+/* wsload_main.c
+ * Load test for the http unit's WebSocket service.
+ * We listen on a local port, open a bunch of WebSocket clients against it, all in the same context,
+ * and each client plays ping-pong with the server as fast as it can.
+ * With --burst=N, each ping is N small messages, like a game sending a frame's worth of position updates.
+ * The next burst goes out when the last echo of this one comes back.
+ * Reports round trips per second, messages per second, and latency percentiles.
+ */
+
+#include "opt/http/http.h"
+#include "opt/serial/serial.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
+#include <signal.h>
+
+static struct wsload {
+  const char *exename;
+  volatile int sigc;
+  int clientc;
+  int seconds;
+  int port;
+  int use_poll;
+  int burst;
+  struct http_context *http;
+  struct http_websocket **clientv; // WEAK, null once disconnected.
+  int *pendingv; // Per client, echoes outstanding in the current burst.
+  int acceptc; // Server side, upgrades so far.
+  int running;
+  double *latencyv;
+  int latencyc,latencya;
+  int lostc;
+} wsload={0};
+
+/* Signal.
+ */
+
+static void wsload_rcvsig(int sigid) {
+  switch (sigid) {
+    case SIGINT: if (++(wsload.sigc)>=3) {
+        fprintf(stderr,"%s: Too many unprocessed signals.\n",wsload.exename);
+        exit(1);
+      } break;
+  }
+}
+
+/* Send a ping, containing just the current time, (burst) times.
+ */
+
+static int wsload_ping(struct http_websocket *ws) {
+  int *pending=http_websocket_get_userdata(ws);
+  double now=http_now();
+  int i=wsload.burst; while (i-->0) {
+    if (http_websocket_send(ws,2,&now,sizeof(now))<0) return -1;
+  }
+  *pending=wsload.burst;
+  return 0;
+}
+
+/* Server side: Echo everything.
+ */
+
+static int wsload_cb_server_message(struct http_websocket *ws,int opcode,const void *v,int c) {
+  if (opcode<0) return 0;
+  return http_websocket_send(ws,opcode,v,c);
+}
+
+static int wsload_cb_serve(struct http_xfer *req,struct http_xfer *rsp,void *userdata) {
+  struct http_websocket *ws=http_websocket_check_upgrade(req,rsp);
+  if (!ws) return http_xfer_set_status(rsp,400,"WebSockets only");
+  http_websocket_set_callback(ws,wsload_cb_server_message);
+  wsload.acceptc++;
+  return 0;
+}
+
+/* Client side: Record latency and ping again.
+ */
+
+static int wsload_cb_client_message(struct http_websocket *ws,int opcode,const void *v,int c) {
+  if (opcode<0) {
+    int i=wsload.clientc;
+    while (i-->0) if (wsload.clientv[i]==ws) wsload.clientv[i]=0;
+    wsload.lostc++;
+    return 0;
+  }
+  if (c!=sizeof(double)) return 0;
+  int *pending=http_websocket_get_userdata(ws);
+  if (--(*pending)>0) return 0;
+  double then;
+  memcpy(&then,v,sizeof(double));
+  if (!wsload.running) return 0;
+  if (wsload.latencyc>=wsload.latencya) {
+    int na=wsload.latencya+65536;
+    if (na>INT_MAX/sizeof(double)) return -1;
+    void *nv=realloc(wsload.latencyv,sizeof(double)*na);
+    if (!nv) return -1;
+    wsload.latencyv=nv;
+    wsload.latencya=na;
+  }
+  wsload.latencyv[wsload.latencyc++]=http_now()-then;
+  return wsload_ping(ws);
+}
+
+/* Report.
+ */
+
+static int wsload_cmp_double(const void *a,const void *b) {
+  double A=*(const double*)a,B=*(const double*)b;
+  if (A<B) return -1;
+  if (A>B) return 1;
+  return 0;
+}
+
+static void wsload_report(double elapsed) {
+  if (wsload.latencyc<1) {
+    fprintf(stderr,"%s: No round trips completed.\n",wsload.exename);
+    return;
+  }
+  qsort(wsload.latencyv,wsload.latencyc,sizeof(double),wsload_cmp_double);
+  double p50=wsload.latencyv[wsload.latencyc/2];
+  double p99=wsload.latencyv[(int)((wsload.latencyc-1)*0.99)];
+  double max=wsload.latencyv[wsload.latencyc-1];
+  fprintf(stderr,
+    "%s: %d clients, burst %d, %s. %d round trips in %.03f s, %.0f/s, %.0f messages/s. Latency p50 %.03f ms, p99 %.03f ms, max %.03f ms. %d disconnected.\n",
+    wsload.exename,wsload.clientc,wsload.burst,wsload.use_poll?"poll":"epoll",
+    wsload.latencyc,elapsed,wsload.latencyc/elapsed,((double)wsload.latencyc*wsload.burst)/elapsed,
+    p50*1000.0,p99*1000.0,max*1000.0,wsload.lostc
+  );
+}
+
+/* Command line.
+ */
+
+static int wsload_arg_int(int *dst,const char *src,const char *name,int lo,int hi) {
+  int srcc=0; while (src[srcc]) srcc++;
+  if ((sr_int_eval(dst,src,srcc)<2)||(*dst<lo)||(*dst>hi)) {
+    fprintf(stderr,"%s: Expected integer in %d..%d for '%s', found '%s'.\n",wsload.exename,lo,hi,name,src);
+    return -1;
+  }
+  return 0;
+}
+
+/* Main.
+ */
+
+int main(int argc,char **argv) {
+  wsload.exename="wsload";
+  if ((argc>=1)&&argv[0]&&argv[0][0]) wsload.exename=argv[0];
+  wsload.clientc=100;
+  wsload.seconds=5;
+  wsload.port=8082;
+  wsload.burst=1;
+  int argi=1; for (;argi<argc;argi++) {
+    const char *arg=argv[argi];
+    if (!memcmp(arg,"--clients=",10)) {
+      if (wsload_arg_int(&wsload.clientc,arg+10,"clients",1,10000)<0) return 1;
+    } else if (!memcmp(arg,"--seconds=",10)) {
+      if (wsload_arg_int(&wsload.seconds,arg+10,"seconds",1,3600)<0) return 1;
+    } else if (!memcmp(arg,"--port=",7)) {
+      if (wsload_arg_int(&wsload.port,arg+7,"port",1,65535)<0) return 1;
+    } else if (!memcmp(arg,"--burst=",8)) {
+      if (wsload_arg_int(&wsload.burst,arg+8,"burst",1,1000)<0) return 1;
+    } else if (!strcmp(arg,"--poll")) {
+      wsload.use_poll=1;
+    } else {
+      fprintf(stderr,"Usage: %s [--clients=100] [--seconds=5] [--port=8082] [--burst=1] [--poll]\n",wsload.exename);
+      return 1;
+    }
+  }
+  signal(SIGINT,wsload_rcvsig);
+
+  struct http_context_delegate delegate={
+    .cb_serve=wsload_cb_serve,
+  };
+  if (!(wsload.http=http_context_new(&delegate))) return 1;
+  struct http_limits limits;
+  http_context_get_limits(&limits,wsload.http);
+  limits.requests=wsload.clientc+16;
+  limits.websockets=wsload.clientc*2+16;
+  http_context_set_limits(wsload.http,&limits);
+  if (!wsload.use_poll&&(http_context_use_epoll(wsload.http)<0)) {
+    fprintf(stderr,"%s: epoll not available, using poll.\n",wsload.exename);
+    wsload.use_poll=1;
+  }
+  if (http_listen(wsload.http,1,wsload.port)<0) {
+    fprintf(stderr,"%s: Failed to open TCP server on port %d\n",wsload.exename,wsload.port);
+    return 1;
+  }
+
+  // Connect all the clients, and wait for the server to accept them.
+  if (!(wsload.clientv=calloc(wsload.clientc,sizeof(void*)))) return 1;
+  if (!(wsload.pendingv=calloc(wsload.clientc,sizeof(int)))) return 1;
+  char url[64];
+  int urlc=snprintf(url,sizeof(url),"http://127.0.0.1:%d/",wsload.port);
+  int i=0; for (;i<wsload.clientc;i++) {
+    if (!(wsload.clientv[i]=http_websocket_connect(wsload.http,url,urlc,wsload_cb_client_message,0))) {
+      fprintf(stderr,"%s: Failed to connect client %d/%d.\n",wsload.exename,i,wsload.clientc);
+      return 1;
+    }
+    http_websocket_set_userdata(wsload.clientv[i],wsload.pendingv+i);
+    if (http_update(wsload.http,0)<0) return 1;
+  }
+  double deadline=http_now()+5.0;
+  while (!wsload.sigc&&(wsload.acceptc<wsload.clientc)&&(http_now()<deadline)) {
+    if (http_update(wsload.http,10)<0) return 1;
+  }
+  if (wsload.acceptc<wsload.clientc) {
+    fprintf(stderr,"%s: Only %d of %d clients connected.\n",wsload.exename,wsload.acceptc,wsload.clientc);
+  }
+
+  // Everybody serve.
+  wsload.running=1;
+  for (i=0;i<wsload.clientc;i++) {
+    if (wsload.clientv[i]) wsload_ping(wsload.clientv[i]);
+  }
+  double starttime=http_now();
+  double endtime=starttime+wsload.seconds;
+  double now=starttime;
+  while (!wsload.sigc&&(now<endtime)) {
+    if (http_update(wsload.http,10)<0) {
+      fprintf(stderr,"%s: Error updating http context.\n",wsload.exename);
+      break;
+    }
+    now=http_now();
+  }
+  wsload.running=0;
+
+  wsload_report(now-starttime);
+  http_context_del(wsload.http);
+  free(wsload.clientv);
+  free(wsload.pendingv);
+  if (wsload.latencyv) free(wsload.latencyv);
+  return 0;
+}
@@ -8,6 +8,7 @@ export class Input {
     this.canvas = canvas;
     
     this.evtq = [];
+    this.coalesceMask = 0; // Subset of evtmask that's EVTSTATE_COALESCE.
     this.evtmask = 
       (1<<Input.EVENT_INPUT)|
       (1<<Input.EVENT_CONNECT)|
@@ -19,6 +20,7 @@ export class Input {
       // MMOTION, MBUTTON, MWHEEL, TEXT: off by default
       (1<<Input.EVENT_KEY)|
       (1<<Input.EVENT_TOUCH)|
+      (1<<Input.EVENT_TEXTURE_LOADED)|
       // ACCELEROMETER: off by default
     0;
     
@@ -80,9 +82,38 @@ export class Input {
   
   pushEvent(eventType, v0=0, v1=0, v2=0, v3=0) {
     if (!(this.evtmask & (1 << eventType))) return;
+    if (this.coalesceMask & (1 << eventType)) {
+      const prev = this.findCoalescible(eventType, v0, v1);
+      if (prev) {
+        prev.v0 = v0;
+        prev.v1 = v1;
+        prev.v2 = v2;
+        prev.v3 = v3;
+        return;
+      }
+    }
     this.evtq.push({ eventType, v0, v1, v2, v3 });
   }
   
+  /* Same rules as native: MMOTION replaces the newest event if it's also MMOTION,
+   * and INPUT replaces any unread one with the same (devid,btnid).
+   */
+  findCoalescible(eventType, v0, v1) {
+    switch (eventType) {
+      case Input.EVENT_MMOTION: {
+          const evt = this.evtq[this.evtq.length - 1];
+          if (evt && (evt.eventType === Input.EVENT_MMOTION)) return evt;
+        } break;
+      case Input.EVENT_INPUT: {
+          for (let i=this.evtq.length; i-->0; ) {
+            const evt = this.evtq[i];
+            if ((evt.eventType === Input.EVENT_INPUT) && (evt.v0 === v0) && (evt.v1 === v1)) return evt;
+          }
+        } break;
+    }
+    return null;
+  }
+  
   /* Nonzero (IMPOSSIBLE or REQUIRED) if the given event can't be changed.
    * If subject to user change, we return zero (QUERY).
    */
@@ -102,6 +133,7 @@ export class Input {
       case Input.EVENT_TEXT: return 0;
       case Input.EVENT_TOUCH: return 0; //TODO Can we detect?
       case Input.EVENT_ACCELEROMETER: return 0; //TODO Can we detect?
+      case Input.EVENT_TEXTURE_LOADED: return 0;
     }
     return Input.EVTSTATE_IMPOSSIBLE;
   }
@@ -117,6 +149,7 @@ export class Input {
       (1<<Input.EVENT_WS_DISCONNECT)|
       (1<<Input.EVENT_WS_MESSAGE)|
       (1<<Input.EVENT_KEY)|
+      (1<<Input.EVENT_TEXTURE_LOADED)|
     0;
     if (initialMask !== this.evtmask) {
       for (let i=0; i<30; i++) {
@@ -482,16 +515,34 @@ export class Input {
     return events;
   }
   
+  event_next_packed(dst) {
+    let c = Math.min(this.evtq.length, Math.floor(dst.length / 5));
+    for (let i=0, p=0; i<c; i++) {
+      const evt = this.evtq[i];
+      dst[p++] = evt.eventType;
+      dst[p++] = evt.v0;
+      dst[p++] = evt.v1;
+      dst[p++] = evt.v2;
+      dst[p++] = evt.v3;
+    }
+    if (c >= this.evtq.length) this.evtq.length = 0;
+    else this.evtq.splice(0, c);
+    return c;
+  }
+  
   event_enable(type, state) {
     const hard = this.getEventHardState(type);
     if (hard) return hard;
-    if (state === Input.EVTSTATE_QUERY) {
-      return (this.evtmask & (1 << type)) ? Input.EVTSTATE_ENABLED : Input.EVTSTATE_DISABLED;
-    }
+    if (state === Input.EVTSTATE_QUERY) return this.getEventState(type);
     if ((state === Input.EVTSTATE_ENABLED) || (state === Input.EVTSTATE_REQUIRED)) {
       this.evtmask |= 1 << type;
+      this.coalesceMask &= ~(1 << type);
+    } else if (state === Input.EVTSTATE_COALESCE) {
+      this.evtmask |= 1 << type;
+      if ((type === Input.EVENT_MMOTION) || (type === Input.EVENT_INPUT)) this.coalesceMask |= 1 << type;
     } else if (state === Input.EVTSTATE_DISABLED) {
       this.evtmask &= ~(1 << type);
+      this.coalesceMask &= ~(1 << type);
     }
     const mouseEvents = (1 << Input.EVENT_MMOTION) | (1 << Input.EVENT_MBUTTON) | (1 << Input.EVENT_MWHEEL);
     this._checkCursorVisibility(this.evtmask & mouseEvents);
@@ -502,6 +553,11 @@ export class Input {
         this.accelerometerDisable();
       }
     }
+    return this.getEventState(type);
+  }
+  
+  getEventState(type) {
+    if (this.coalesceMask & (1 << type)) return Input.EVTSTATE_COALESCE;
     return (this.evtmask & (1 << type)) ? Input.EVTSTATE_ENABLED : Input.EVTSTATE_DISABLED;
   }
   
@@ -619,9 +675,11 @@ Input.EVENT_KEY           = 11; /* [hidusage,value,_,_] */
 Input.EVENT_TEXT          = 12; /* [codepoint,_,_,_] */
 Input.EVENT_TOUCH         = 13; /* [id,state,x,y] */
 Input.EVENT_ACCELEROMETER = 14; /* [x,y,z,_] */
+Input.EVENT_TEXTURE_LOADED = 15; /* [texid,status,_,_] */
   
 Input.EVTSTATE_QUERY = 0;
 Input.EVTSTATE_IMPOSSIBLE = 1;
 Input.EVTSTATE_DISABLED = 2;
 Input.EVTSTATE_ENABLED = 3;
 Input.EVTSTATE_REQUIRED = 4;
+Input.EVTSTATE_COALESCE = 5;
@@ -16,6 +16,7 @@ export class RenderGl {
     
     // (texid) exposed to client is the index in this array, plus one.
     this.textures = []; // {texid,fbid,w,h,fmt}
+    this.asyncLoads = []; // {texid,qual,imageid}
   
     this.tint = 0;
     this.alpha = 0xff;
@@ -79,6 +80,7 @@ export class RenderGl {
     if (texture.texid) this.gl.deleteTexture(texture.texid);
     if (texture.fbid) this.gl.deleteFramebuffer(texture.fbid);
     this.textures[texid - 1] = null;
+    this.asyncLoads = this.asyncLoads.filter(l => l.texid !== texid);
   }
   
   texture_new() {
@@ -116,6 +118,26 @@ export class RenderGl {
     return this.loadTexture(texture, image);
   }
   
+  /* We don't have a worker thread for this, but deferring the whole load to the start of the next render
+   * at least keeps it out of the game's update. Runtime calls flushAsyncLoads() and reports each as an event.
+   */
+  texture_load_image_async(texid, qual, imageid) {
+    if ((texid < 2) || (texid > this.textures.length)) return -1;
+    if (!this.textures[texid - 1]) return -1;
+    if (!this.rom.getResource(Rom.TID_image, qual, imageid)) return -1;
+    this.asyncLoads.push({ texid, qual, imageid });
+    return 0;
+  }
+  
+  flushAsyncLoads(cb) {
+    if (!this.asyncLoads.length) return;
+    const loads = this.asyncLoads;
+    this.asyncLoads = [];
+    for (const { texid, qual, imageid } of loads) {
+      cb(texid, this.texture_load_image(texid, qual, imageid));
+    }
+  }
+  
   texture_upload(texid, w, h, stride, fmt, src) {
     if ((texid < 1) || (texid > this.textures.length)) return -1;
     const texture = this.textures[texid - 1];
@@ -294,6 +316,56 @@ export class RenderGl {
     this.gl.disableVertexAttribArray(2);
   }
   
+  /* (src) is a Uint8Array of packed commands, see egg_draw_batch in egg.h.
+   * Returns the count of commands run.
+   */
+  draw_batch(src) {
+    const view = new DataView(src.buffer, src.byteOffset, src.byteLength);
+    let p = 0, cmdc = 0;
+    while (p <= src.length - 2) {
+      const rem = src.length - p;
+      switch (src[p]) {
+        case 0x01: { // MODE
+            if (rem < 8) return cmdc;
+            this.draw_mode(src[p + 1], view.getUint32(p + 4, true), src[p + 2]);
+            p += 8;
+          } break;
+        case 0x02: { // RECT
+            if (rem < 16) return cmdc;
+            this.draw_rect(
+              view.getUint16(p + 2, true),
+              view.getInt16(p + 4, true), view.getInt16(p + 6, true),
+              view.getInt16(p + 8, true), view.getInt16(p + 10, true),
+              view.getUint32(p + 12, true)
+            );
+            p += 16;
+          } break;
+        case 0x03: { // DECAL
+            if (rem < 18) return cmdc;
+            this.draw_decal(
+              view.getUint16(p + 2, true), view.getUint16(p + 4, true),
+              view.getInt16(p + 6, true), view.getInt16(p + 8, true),
+              view.getInt16(p + 10, true), view.getInt16(p + 12, true),
+              view.getInt16(p + 14, true), view.getInt16(p + 16, true),
+              src[p + 1]
+            );
+            p += 18;
+          } break;
+        case 0x04: { // TILE
+            if (rem < 8) return cmdc;
+            const c = view.getUint16(p + 6, true);
+            const len = 8 + c * 6;
+            if (rem < len) return cmdc;
+            this.draw_tile(view.getUint16(p + 2, true), view.getUint16(p + 4, true), src.subarray(p + 8, p + len), c);
+            p += len;
+          } break;
+        default: return cmdc;
+      }
+      cmdc++;
+    }
+    return cmdc;
+  }
+  
   draw_to_main() {
     const srctex = this.textures[0];
     if (!srctex) return;
@@ -100,7 +100,7 @@ export class Runtime {
         delete this.window.exportModule;
         resolve();//TODO Should we race a timeout, in case the game doesn't call exportModule?
       };
-      const jsstr = new TextDecoder("utf8").decode(jsbin);
+      const jsstr = new TextDecoder("utf8").decode(this._stripJsBytecode(jsbin));
       const tag = this.window.document.createElement("SCRIPT");
       tag.innerHTML = jsstr;
       tag.setAttribute("type", "module");
@@ -108,6 +108,16 @@ export class Runtime {
     });
   }
   
+  /* js:1 may be precompiled for QuickJS (eggrom -b): "\0EJB", u32 fingerprint, u32 bytecode length, bytecode, source.
+   * We can only use the source.
+   */
+  _stripJsBytecode(src) {
+    if ((src.length < 12) || src[0] || (src[1] !== 0x45) || (src[2] !== 0x4a) || (src[3] !== 0x42)) return src;
+    const bcc = (src[8] << 24) | (src[9] << 16) | (src[10] << 8) | src[11];
+    if ((bcc < 0) || (bcc > src.length - 12)) return new Uint8Array(0);
+    return new Uint8Array(src.buffer, src.byteOffset + 12 + bcc, src.length - 12 - bcc);
+  }
+  
   _loadClientWasm() {
     const wasmbin = this.rom.getResource(Rom.TID_wasm, 0, 1);
     if (!wasmbin) return Promise.resolve();
@@ -234,6 +244,9 @@ export class Runtime {
         return;
       }
       if (this.egg_client_render) {
+        this.render.flushAsyncLoads((texid, status) => {
+          this.input.pushEvent(Input.EVENT_TEXTURE_LOADED, texid, (status < 0) ? -1 : 0);
+        });
         this.render.draw_mode(0, 0, 0xff);
         this.egg_client_render(this.gl);
         this.render.draw_to_main();
@@ -249,6 +262,7 @@ export class Runtime {
     return {
       log: (fmt, ...vargs) => this.sysExtra.log(fmt, vargs),
       event_next: () => this.input.event_next(),
+      event_next_packed: (dst) => this.input.event_next_packed(dst),
       event_enable: (eventType, eventState) => this.input.event_enable(eventType, eventState),
       input_device_get_name: (devid) => this.input.input_device_get_name(devid),
       input_device_get_ids: (devid) => this.input.input_device_get_ids(devid),
@@ -260,6 +274,7 @@ export class Runtime {
       texture_del: (texid) => this.render.texture_del(texid),
       texture_new: () => this.render.texture_new(),
       texture_load_image: (texid, qual, imageid) => this.render.texture_load_image(texid, qual, imageid),
+      texture_load_image_async: (texid, qual, imageid) => this.render.texture_load_image_async(texid, qual, imageid),
       texture_upload: (texid, w, h, stride, fmt, src) => this.render.texture_upload(texid, w, h, stride, fmt, src),
       texture_get_header: (texid) => this.render.texture_get_header(texid),
       texture_clear: (texid) => this.render.texture_clear(texid),
@@ -267,10 +282,13 @@ export class Runtime {
       draw_rect: (dsttexid, x, y, w, h, pixel) => this.render.draw_rect(dsttexid, x, y, w, h, pixel),
       draw_decal: (dsttexid, srctexid, dstx, dsty, srcx, srcy, w, h, xform) => this.render.draw_decal(dsttexid, srctexid, dstx, dsty, srcx, srcy, w, h, xform),
       draw_tile: (dsttexid, srctexid, v, c) => this.render.draw_tile(dsttexid, srctexid, v, c),
+      draw_batch: (cmds, len) => this.render.draw_batch(new Uint8Array(cmds, 0, Math.max(0, Math.min(len, cmds.byteLength)))),
       audio_play_song: (qual, songid, force, repeat) => this.audio.audio_play_song(qual, songid, force, repeat),
       audio_play_sound: (qual, soundid, trim, pan) => this.audio.audio_play_sound(qual, soundid, trim, pan),
       audio_get_playhead: () => this.audio.audio_get_playhead(),
       res_get: (tid, qual, rid) => this.rom.getResource(tid, qual, rid),
+      res_map: (tid, qual, rid) => this.rom.getResource(tid, qual, rid), // No copy to share; the ROM itself.
+      res_unmap: (tid, qual, rid) => {},
       res_id_by_index: (index) => this.rom.getResourceIdsByIndex(index),
       store_set: (k, v) => this.sysExtra.store_set(k, v),
       store_get: (k) => this.sysExtra.store_get(k),
@@ -284,6 +302,7 @@ export class Runtime {
       ws_get_message: (wsid, msgid) => this.net.ws_get_message(wsid, msgid),
       ws_send: (wsid, opcode, v) => this.net.ws_send(wsid, opcode, v),
       time_real: () => Date.now() / 1000,
+      render_alpha: () => 1, // Variable timing: Every render follows an update that consumed all the time.
       time_get: () => this.sysExtra.time_get(),
       get_user_languages: () => this.sysExtra.get_user_languages(),
       request_termination: () => this.terminate(),
@@ -307,6 +326,7 @@ export class Runtime {
       egg_texture_del: (texid) => this.render.texture_del(texid),
       egg_texture_new: () => this.render.texture_new(),
       egg_texture_load_image: (texid, qual, imageid) => this.render.texture_load_image(texid, qual, imageid),
+      egg_texture_load_image_async: (texid, qual, imageid) => this.render.texture_load_image_async(texid, qual, imageid),
       egg_texture_upload: (texid, w, h, stride, fmt, src, srcc) => this.wasm_texture_upload(texid, w, h, stride, fmt, src, srcc),
       egg_texture_get_header: (wp, hp, fmtp, texid) => this.wasm_texture_get_header(wp, hp, fmtp, texid),
       egg_texture_clear: (texid) => this.render.texture_clear(texid),
@@ -314,10 +334,13 @@ export class Runtime {
       egg_draw_rect: (dsttexid, x, y, w, h, pixel) => this.render.draw_rect(dsttexid, x, y, w, h, pixel),
       egg_draw_decal: (dsttexid, srctexid, dstx, dsty, srcx, srcy, w, h, xform) => this.render.draw_decal(dsttexid, srctexid, dstx, dsty, srcx, srcy, w, h, xform),
       egg_draw_tile: (dsttexid, srctexid, v, c) => this.wasm_draw_tile(dsttexid, srctexid, v, c),
+      egg_draw_batch: (v, c) => this.render.draw_batch(this.wasm.getMemoryView(v, c)),
       egg_audio_play_song: (q, id, f, r) => this.audio.audio_play_song(q, id, f, r),
       egg_audio_play_sound: (q, id, t, p) => this.audio.audio_play_sound(q, id, t, p),
       egg_audio_get_playhead: () => this.audio.audio_get_playhead(),
       egg_res_get: (v, a, t, q, r) => this.wasm_res_get(v, a, t, q, r),
+      egg_res_map: (p, t, q, r) => 0, // Not supported; clients fall back to egg_res_get.
+      egg_res_unmap: (t, q, r) => {},
       egg_res_id_by_index: (t, q, r, p) => this.wasm_res_id_by_index(t, q, r, p),
       egg_store_set: (k, kc, v, vc) => this.wasm_store_set(k, kc, v, vc),
       egg_store_get: (v, vc, k, kc) => this.wasm_store_get(v, vc, k, kc),
@@ -332,6 +355,7 @@ export class Runtime {
       egg_ws_send: (id, o, v, c) => this.wasm_ws_send(id, o, v, c),
       egg_log: (f, v) => this.wasm_log(f, v),
       egg_time_real: () => Date.now() / 1000,
+      egg_render_alpha: () => 1,
       egg_time_get: (y, m, d, h, M, s, l) => this.wasm_time_get(y, m, d, h, M, s, l),
       egg_get_user_languages: (v, a) => this.wasm_get_user_languages(v, a),
       egg_request_termination: () => this.terminate(),